@@ -21,6 +21,7 @@ namespace ps2recomp
 	struct Function;
 	class R5900Decoder;
 	class ElfParser;
+	class DecodedImage;
 
 	using CFG = std::unordered_map<uint32_t, CFGNode>;
 
@@ -37,6 +38,7 @@ namespace ps2recomp
         std::string m_elfPath;
         std::unique_ptr<ElfParser> m_elfParser;
         std::unique_ptr<R5900Decoder> m_decoder;
+        std::unique_ptr<DecodedImage> m_decodedImage;
 
         std::vector<Function> m_functions;
         std::vector<Symbol> m_symbols;
@@ -51,9 +53,20 @@ namespace ps2recomp
  
         std::map<uint32_t, uint32_t> m_patches;
         std::map<uint32_t, std::string> m_patchReasons;
+        std::unordered_map<uint32_t, std::vector<Instruction>> m_functionInstructions; // decoded once, by start
         std::unordered_map<uint32_t, CFG> m_functionCFGs;
         std::vector<JumpTable> m_jumpTables;
+        std::vector<uint32_t> m_idleLoops; // backward branches of busy-wait loops, by address
         std::unordered_map<uint32_t, std::vector<FunctionCall>> m_functionCalls;
+
+        struct CallGraphNode
+        {
+            uint32_t start;
+            double hotness; // estimated instructions executed over a run
+            uint32_t component;
+            bool recursive;
+        };
+        std::vector<CallGraphNode> m_callGraphNodes; // analyzed functions, by address
  
         void initializeLibraryFunctions();
         void analyzeEntryPoint();
@@ -62,6 +75,7 @@ namespace ps2recomp
         void identifyPotentialPatches();
         void analyzeControlFlow();
         void detectJumpTables();
+        void detectIdleLoops();
         void analyzePerformanceCriticalPaths() const;
         void identifyRecursiveFunctions();
         void analyzeRegisterUsage() const;
@@ -75,6 +89,8 @@ namespace ps2recomp
  
         bool isSystemFunction(const std::string &name) const;
         bool isLibraryFunction(const std::string &name) const;
+        void decodeFunctions();
+        const std::vector<Instruction> &instructionsOf(const Function &function) const;
         std::vector<Instruction> decodeFunction(const Function &function) const;
         CFG buildCFG(const Function &function) const;
         std::string formatAddress(uint32_t address) const;
@@ -1,6 +1,10 @@
 #include "ps2recomp/elf_analyzer.h"
 #include "ps2recomp/elf_parser.h"
 #include "ps2recomp/r5900_decoder.h"
+#include "ps2recomp/decoded_image.h"
+#include "ps2recomp/call_graph.h"
+#include "ps2recomp/idle_loops.h"
+#include "ps2recomp/parallel.h"
 #include "ps2recomp/types.h"
 #include <iostream>
 #include <sstream>
@@ -48,6 +52,8 @@ namespace ps2recomp
         m_symbols = m_elfParser->extractSymbols();
         m_sections = m_elfParser->getSections();
         m_relocations = m_elfParser->getRelocations();
+        m_decodedImage = std::make_unique<DecodedImage>(*m_elfParser, m_sections, *m_decoder);
+        decodeFunctions();
 
         std::cout << "Extracted " << m_functions.size() << " functions" << std::endl;
         std::cout << "Extracted " << m_symbols.size() << " symbols" << std::endl;
@@ -60,6 +66,7 @@ namespace ps2recomp
         identifyPotentialPatches();
         analyzeControlFlow();
         detectJumpTables();
+        detectIdleLoops();
         analyzePerformanceCriticalPaths();
         identifyRecursiveFunctions();
         analyzeRegisterUsage();
@@ -72,7 +79,8 @@ namespace ps2recomp
                 !m_libFunctions.contains(func.name))
             {
                 categorizeFunction(func);
-                func.instructions = decodeFunction(func);
+                // A copy: generateToml still reads the cache through instructionsOf.
+                func.instructions = instructionsOf(func);
             }
         }
 
@@ -81,6 +89,7 @@ namespace ps2recomp
         std::cout << "- " << m_skipFunctions.size() << " functions to skip" << std::endl;
         std::cout << "- " << m_patches.size() << " potential patches identified" << std::endl;
         std::cout << "- " << m_jumpTables.size() << " jump tables detected" << std::endl;
+        std::cout << "- " << m_idleLoops.size() << " idle loops detected" << std::endl;
 
         return true;
     }
@@ -128,6 +137,13 @@ namespace ps2recomp
         file << "# Single file output mode (false for one file per function)\n";
         file << "single_file_output = true\n\n";
 
+        file << "# Group functions into this many translation units by call graph, with a precompiled\n";
+        file << "# header and a CMakeLists.txt for the output (0 disables; overrides single_file_output)\n";
+        file << "output_shards = 0\n\n";
+
+        file << "# Inline leaf functions of up to this many instructions at their jal call sites (0 disables)\n";
+        file << "inline_max_instructions = 0\n\n";
+
         file << "# Functions to stub (these will generate empty implementations)\n";
         file << "stubs = [\n";
         for (const auto &func : m_libFunctions)
@@ -152,7 +168,8 @@ namespace ps2recomp
             for (const auto &jt : m_jumpTables)
             {
                 file << "[[jump_tables.table]]\n";
-                file << "address = \"0x" << std::hex << jt.address << "\"\n"
+                file << "address = \"0x" << std::hex << jt.address << "\"\n";
+                file << "jr = \"0x" << jt.jumpAddress << "\"\n"
                      << std::dec;
                 file << "entries = [\n";
 
@@ -167,6 +184,21 @@ namespace ps2recomp
             }
         }
 
+        if (!m_idleLoops.empty())
+        {
+            file << "# Busy-wait loops, by the address of their backward branch. Each iteration calls\n";
+            file << "# PS2_IDLE_LOOP; list more under force, or turn detected ones off under disable.\n";
+            file << "[idle_loops]\n";
+            file << "loops = [\n";
+            for (uint32_t address : m_idleLoops)
+            {
+                file << "  \"0x" << std::hex << address << std::dec << "\",\n";
+            }
+            file << "]\n";
+            file << "force = []\n";
+            file << "disable = []\n\n";
+        }
+
         if (!m_patches.empty())
         {
             file << "# Patches to apply during recompilation\n";
@@ -181,6 +213,22 @@ namespace ps2recomp
             file << "]\n\n";
         }
 
+        if (!m_callGraphNodes.empty())
+        {
+            file << "# Static call graph estimates: hotness is the estimated instruction count over a run,\n";
+            file << "# from loop nesting and call frequency. Functions sharing a component call each other.\n";
+            file << "[call_graph]\n";
+            file << "functions = [\n";
+            for (const auto &node : m_callGraphNodes)
+            {
+                file << "  { address = \"0x" << std::hex << node.start << std::dec
+                     << "\", hotness = " << std::scientific << std::setprecision(3) << node.hotness
+                     << std::defaultfloat << ", component = " << node.component
+                     << ", recursive = " << (node.recursive ? "true" : "false") << " },\n";
+            }
+            file << "]\n\n";
+        }
+
         file << "# Performance critical functions (may need manual optimization)\n";
         file << "[performance]\n";
         file << "critical = [\n";
@@ -274,7 +322,7 @@ namespace ps2recomp
 
             m_skipFunctions.insert(it->name);
 
-            std::vector<Instruction> instructions = decodeFunction(*it);
+            const std::vector<Instruction> &instructions = instructionsOf(*it);
 
             for (const auto &inst : instructions)
             {
@@ -361,7 +409,7 @@ namespace ps2recomp
                 continue;
             }
 
-            std::vector<Instruction> instructions = decodeFunction(func);
+            const std::vector<Instruction> &instructions = instructionsOf(func);
 
             for (const auto &inst : instructions)
             {
@@ -508,7 +556,7 @@ namespace ps2recomp
                 continue;
             }
 
-            std::vector<Instruction> instructions = decodeFunction(func);
+            const std::vector<Instruction> &instructions = instructionsOf(func);
 
             for (size_t i = 0; i < instructions.size(); i++)
             {
@@ -545,7 +593,7 @@ namespace ps2recomp
                 continue;
             }
 
-            std::vector<Instruction> instructions = decodeFunction(func);
+            const std::vector<Instruction> &instructions = instructionsOf(func);
 
             for (size_t i = 0; i < instructions.size(); i++)
             {
@@ -656,7 +704,7 @@ namespace ps2recomp
                 continue;
             }
 
-            std::vector<Instruction> instructions = decodeFunction(func);
+            const std::vector<Instruction> &instructions = instructionsOf(func);
 
             for (const auto &inst : instructions)
             {
@@ -676,18 +724,28 @@ namespace ps2recomp
     {
         std::cout << "Analyzing control flow of functions..." << std::endl;
 
+        std::vector<const Function *> analyzed;
         for (const auto &func : m_functions)
         {
-            if (m_skipFunctions.contains(func.name) ||
-                m_libFunctions.contains(func.name))
+            if (!m_skipFunctions.contains(func.name) &&
+                !m_libFunctions.contains(func.name))
             {
-                continue;
+                analyzed.push_back(&func);
             }
+        }
 
-            CFG cfg = buildCFG(func);
-            m_functionCFGs[func.start] = cfg;
+        std::vector<CFG> cfgs(analyzed.size());
+        parallelFor(analyzed.size(), [&](size_t index)
+                    { cfgs[index] = buildCFG(*analyzed[index]); });
+        for (size_t index = 0; index < analyzed.size(); ++index)
+        {
+            m_functionCFGs[analyzed[index]->start] = std::move(cfgs[index]);
+        }
 
-            std::vector<Instruction> instructions = decodeFunction(func);
+        for (const Function *analyzedFunc : analyzed)
+        {
+            const Function &func = *analyzedFunc;
+            const std::vector<Instruction> &instructions = instructionsOf(func);
             for (const auto &inst : instructions)
             {
                 if (inst.opcode == OPCODE_JAL ||
@@ -731,15 +789,21 @@ namespace ps2recomp
     {
         std::cout << "Detecting jump tables..." << std::endl;
 
-        for (const auto &func : m_functions)
-        {
+        // Scanned in parallel, merged in m_functions order.
+        std::vector<std::string> reports(m_functions.size());
+        std::vector<std::vector<JumpTable>> tables(m_functions.size());
+        parallelFor(m_functions.size(), [&](size_t index)
+                    {
+            const Function &func = m_functions[index];
             if (m_skipFunctions.contains(func.name) ||
                 m_libFunctions.contains(func.name))
             {
-                continue;
+                return;
             }
 
-            std::vector<Instruction> instructions = decodeFunction(func);
+            std::stringstream out;
+
+            const std::vector<Instruction> &instructions = instructionsOf(func);
 
             for (size_t i = 0; i < instructions.size(); i++)
             {
@@ -761,7 +825,7 @@ namespace ps2recomp
                                 if (jumpInst.opcode == OPCODE_SPECIAL && jumpInst.function == SPECIAL_JR &&
                                     jumpInst.rs == loadInst.rt)
                                 {
-                                    std::cout << "Detected jump table in function " << func.name
+                                    out << "Detected jump table in function " << func.name
                                               << " at " << formatAddress(loadInst.address) << std::endl;
 
                                     uint32_t baseAddr = 0;
@@ -790,6 +854,7 @@ namespace ps2recomp
                                         JumpTable jumpTable;
                                         jumpTable.address = baseAddr;
                                         jumpTable.baseRegister = loadInst.rs;
+                                        jumpTable.jumpAddress = jumpInst.address;
 
                                         for (uint32_t e = 0; e < numEntries; e++)
                                         {
@@ -803,14 +868,14 @@ namespace ps2recomp
                                                 entry.target = targetAddr;
                                                 jumpTable.entries.push_back(entry);
 
-                                                std::cout << "  - Jump table entry " << e << ": 0x"
+                                                out << "  - Jump table entry " << e << ": 0x"
                                                           << std::hex << targetAddr << std::dec << std::endl;
                                             }
                                         }
 
                                         if (!jumpTable.entries.empty())
                                         {
-                                            m_jumpTables.push_back(jumpTable);
+                                            tables[index].push_back(jumpTable);
                                         }
                                     }
 
@@ -821,22 +886,72 @@ namespace ps2recomp
                     }
                 }
             }
+
+            reports[index] = out.str(); });
+
+        for (size_t index = 0; index < m_functions.size(); ++index)
+        {
+            std::cout << reports[index];
+            m_jumpTables.insert(m_jumpTables.end(), tables[index].begin(), tables[index].end());
         }
     }
 
-    void ElfAnalyzer::analyzePerformanceCriticalPaths() const
+    void ElfAnalyzer::detectIdleLoops()
     {
-        std::cout << "Analyzing performance-critical paths..." << std::endl;
+        std::cout << "Detecting idle loops..." << std::endl;
 
+        std::unordered_map<uint32_t, const Function *> byStart;
         for (const auto &func : m_functions)
         {
+            byStart[func.start] = &func;
+        }
+        auto isPolling = [&](uint32_t target)
+        {
+            auto it = byStart.find(target);
+            return it != byStart.end() && isPollingCall(it->second->name);
+        };
+
+        // Scanned in parallel, merged in m_functions order.
+        std::vector<std::vector<uint32_t>> loops(m_functions.size());
+        parallelFor(m_functions.size(), [&](size_t index)
+                    {
+            const Function &func = m_functions[index];
+            if (m_skipFunctions.contains(func.name) || m_libFunctions.contains(func.name))
+            {
+                return;
+            }
+            loops[index] = findIdleLoops(instructionsOf(func), isPolling); });
+
+        m_idleLoops.clear();
+        for (size_t index = 0; index < m_functions.size(); ++index)
+        {
+            for (uint32_t address : loops[index])
+            {
+                std::cout << "Idle loop in " << m_functions[index].name << " at " << formatAddress(address) << std::endl;
+                m_idleLoops.push_back(address);
+            }
+        }
+        std::sort(m_idleLoops.begin(), m_idleLoops.end());
+    }
+
+    void ElfAnalyzer::analyzePerformanceCriticalPaths() const
+    {
+        std::cout << "Analyzing performance-critical paths..." << std::endl;
+
+        // Functions are independent; each report is printed in m_functions order.
+        std::vector<std::string> reports(m_functions.size());
+        parallelFor(m_functions.size(), [&](size_t index)
+                    {
+            const Function &func = m_functions[index];
             if (m_skipFunctions.contains(func.name) ||
                 m_libFunctions.contains(func.name))
             {
-                continue;
+                return;
             }
 
-            std::vector<Instruction> instructions = decodeFunction(func);
+            std::stringstream out;
+
+            const std::vector<Instruction> &instructions = instructionsOf(func);
 
             for (const auto &inst : instructions)
             {
@@ -851,7 +966,7 @@ namespace ps2recomp
 
                         if (loopSize < 20)
                         {
-                            std::cout << "Found tight loop in function " << func.name
+                            out << "Found tight loop in function " << func.name
                                       << " from " << formatAddress(targetAddr)
                                       << " to " << formatAddress(inst.address)
                                       << " (size: " << loopSize << " instructions)" << std::endl;
@@ -871,12 +986,18 @@ namespace ps2recomp
 
                             if (hasMultimedia)
                             {
-                                std::cout << "  - Loop contains multimedia instructions" << std::endl;
+                                out << "  - Loop contains multimedia instructions" << std::endl;
                             }
                         }
                     }
                 }
             }
+
+            reports[index] = out.str(); });
+
+        for (const auto &report : reports)
+        {
+            std::cout << report;
         }
     }
 
@@ -885,9 +1006,8 @@ namespace ps2recomp
         std::cout << "Identifying recursive functions..." << std::endl;
 
         // lets ignore skip and library
-        std::unordered_set<std::string> eligible;
-        eligible.reserve(m_functions.size());
-
+        std::vector<const Function *> nodes;
+        std::unordered_map<uint32_t, uint32_t> nodeOf;
         for (const auto &func : m_functions)
         {
             if (m_skipFunctions.contains(func.name) ||
@@ -896,154 +1016,96 @@ namespace ps2recomp
                 continue;
             }
 
-            eligible.insert(func.name);
+            nodeOf[func.start] = static_cast<uint32_t>(nodes.size());
+            nodes.push_back(&func);
         }
 
-        std::unordered_map<std::string, std::vector<std::string>> callGraph;
-        callGraph.reserve(eligible.size());
+        // Instructions per call from loop nesting, and call edges weighted by the
+        // nesting of their call site.
+        std::vector<double> localWeights(nodes.size(), 1.0);
+        std::vector<std::vector<CallGraph::Edge>> nodeEdges(nodes.size());
+        parallelFor(nodes.size(), [&](size_t node)
+                    {
+            const Function &func = *nodes[node];
+            const std::vector<Instruction> &instructions = instructionsOf(func);
+            std::vector<uint32_t> depths = loopDepths(instructions, func.start, func.end);
 
-        for (const auto &func : m_functions)
-        {
-            if (!eligible.contains(func.name))
+            double local = 0.0;
+            for (uint32_t depth : depths)
             {
-                continue;
+                local += loopWeight(depth);
             }
+            localWeights[node] = std::max(1.0, local);
 
             auto itCalls = m_functionCalls.find(func.start);
-            if (itCalls == m_functionCalls.end())
+            if (itCalls == m_functionCalls.end() || instructions.empty())
             {
-                continue;
+                return;
             }
 
-            auto &edges = callGraph[func.name];
-            edges.reserve(itCalls->second.size());
-
             for (const auto &call : itCalls->second)
             {
-                // non-eligible nodes to graph.
-                if (!eligible.contains(call.calleeName))
+                auto calleeIt = nodeOf.find(call.calleeAddress);
+                if (calleeIt == nodeOf.end())
                 {
                     continue;
                 }
 
-                edges.push_back(call.calleeName);
-            }
-        }
-
-        std::unordered_map<std::string, int> index;
-        std::unordered_map<std::string, int> lowlink;
-        std::unordered_set<std::string> onStack;
-        std::vector<std::string> stack;
-
-        index.reserve(eligible.size());
-        lowlink.reserve(eligible.size());
-        onStack.reserve(eligible.size());
-        stack.reserve(eligible.size());
-
-        int currentIndex = 0;
-
-        std::vector<std::vector<std::string>> sccs;
-        sccs.reserve(256);
-
-        std::function<void(const std::string &)> strongconnect;
-        strongconnect = [&](const std::string &v)
-        {
-            index[v] = currentIndex;
-            lowlink[v] = currentIndex;
-            currentIndex++;
-
-            stack.push_back(v);
-            onStack.insert(v);
-
-            auto it = callGraph.find(v);
-            if (it != callGraph.end())
-            {
-                for (const auto &w : it->second)
-                {
-                    if (!index.contains(w))
-                    {
-                        strongconnect(w);
-                        lowlink[v] = std::min(lowlink[v], lowlink[w]);
-                    }
-                    else if (onStack.contains(w))
-                    {
-                        lowlink[v] = std::min(lowlink[v], index[w]);
-                    }
-                }
-            }
-
-            if (lowlink[v] == index[v])
-            {
-                std::vector<std::string> scc;
-                while (!stack.empty())
-                {
-                    std::string w = stack.back();
-                    stack.pop_back();
-                    onStack.erase(w);
-
-                    scc.push_back(w);
-                    if (w == v)
-                    {
-                        break;
-                    }
-                }
-
-                sccs.push_back(std::move(scc));
+                size_t site = (call.callerAddress - instructions.front().address) / 4;
+                double weight = site < depths.size() ? loopWeight(depths[site]) : 1.0;
+                nodeEdges[node].push_back({static_cast<uint32_t>(node), calleeIt->second, weight});
             }
-        };
+        });
 
-        for (const auto &name : eligible)
+        std::vector<CallGraph::Edge> edges;
+        for (const auto &outgoing : nodeEdges)
         {
-            if (!index.contains(name))
-            {
-                strongconnect(name);
-            }
+            edges.insert(edges.end(), outgoing.begin(), outgoing.end());
         }
 
-        // SCC size > 1 -> mutual recursion
-        // SCC size == 1 -> direct recursion if it calls itself
-        for (const auto &scc : sccs)
+        CallGraph graph(nodes.size(), edges);
+        std::vector<double> hotness = graph.estimateHotness(localWeights);
+
+        m_callGraphNodes.clear();
+        m_callGraphNodes.reserve(nodes.size());
+        for (uint32_t node = 0; node < nodes.size(); ++node)
         {
-            if (scc.size() > 1)
+            const Function &func = *nodes[node];
+            bool recursive = graph.isRecursive(node);
+            if (graph.componentSize(node) > 1)
             {
-                for (const auto &name : scc)
-                {
-                    std::cout << "Function " << name << " is part of a mutually recursive cycle" << std::endl;
-                }
-                continue;
+                std::cout << "Function " << func.name << " is part of a mutually recursive cycle" << std::endl;
             }
-
-            const std::string &name = scc[0];
-            auto it = callGraph.find(name);
-            if (it == callGraph.end())
+            else if (recursive)
             {
-                continue;
+                std::cout << "Function " << func.name << " is directly recursive" << std::endl;
             }
 
-            for (const auto &callee : it->second)
-            {
-                if (callee == name)
-                {
-                    std::cout << "Function " << name << " is directly recursive" << std::endl;
-                    break;
-                }
-            }
+            m_callGraphNodes.push_back({func.start, hotness[node], graph.component(node), recursive});
         }
+
+        std::cout << "Call graph: " << nodes.size() << " functions, " << edges.size() << " calls, "
+                  << graph.componentCount() << " components" << std::endl;
     }
 
     void ElfAnalyzer::analyzeRegisterUsage() const
     {
         std::cout << "Analyzing register usage patterns..." << std::endl;
 
-        for (const auto &func : m_functions)
-        {
+        // Functions are independent; each report is printed in m_functions order.
+        std::vector<std::string> reports(m_functions.size());
+        parallelFor(m_functions.size(), [&](size_t index)
+                    {
+            const Function &func = m_functions[index];
             if (m_skipFunctions.contains(func.name) ||
                 m_libFunctions.contains(func.name))
             {
-                continue;
+                return;
             }
 
-            std::vector<Instruction> instructions = decodeFunction(func);
+            std::stringstream out;
+
+            const std::vector<Instruction> &instructions = instructionsOf(func);
             std::set<uint32_t> regsRead, regsWritten;
 
             for (const auto &inst : instructions)
@@ -1109,24 +1171,30 @@ namespace ps2recomp
 
             if (hasStackOps)
             {
-                std::cout << "Function " << func.name << " allocates a stack frame" << std::endl;
+                out << "Function " << func.name << " allocates a stack frame" << std::endl;
 
                 if (savesFP)
-                    std::cout << "  - Saves frame pointer ($fp)" << std::endl;
+                    out << "  - Saves frame pointer ($fp)" << std::endl;
                 if (savesRA)
-                    std::cout << "  - Saves return address ($ra)" << std::endl;
+                    out << "  - Saves return address ($ra)" << std::endl;
             }
 
             if (regsRead.contains(4) || regsRead.contains(5) ||
                 regsRead.contains(6) || regsRead.contains(7))
             {
-                std::cout << "  - Uses argument registers (a0-a3)" << std::endl;
+                out << "  - Uses argument registers (a0-a3)" << std::endl;
             }
 
             if (regsWritten.contains(2) || regsWritten.contains(3))
             {
-                std::cout << "  - Sets return values (v0-v1)" << std::endl;
+                out << "  - Sets return values (v0-v1)" << std::endl;
             }
+
+            reports[index] = out.str(); });
+
+        for (const auto &report : reports)
+        {
+            std::cout << report;
         }
     }
 
@@ -1134,15 +1202,20 @@ namespace ps2recomp
     {
         std::cout << "Analyzing function signatures..." << std::endl;
 
-        for (const auto &func : m_functions)
-        {
+        // Functions are independent; each report is printed in m_functions order.
+        std::vector<std::string> reports(m_functions.size());
+        parallelFor(m_functions.size(), [&](size_t index)
+                    {
+            const Function &func = m_functions[index];
             if (m_skipFunctions.contains(func.name) ||
                 m_libFunctions.contains(func.name))
             {
-                continue;
+                return;
             }
 
-            std::vector<Instruction> instructions = decodeFunction(func);
+            std::stringstream out;
+
+            const std::vector<Instruction> &instructions = instructionsOf(func);
 
             int paramCount = 0;
             bool usesFloatingPoint = false;
@@ -1191,24 +1264,30 @@ namespace ps2recomp
 
             if (paramCount > 0 || usesFloatingPoint || usesDoublewords || returnsSomething)
             {
-                std::cout << "Function " << func.name << " signature analysis:" << std::endl;
+                out << "Function " << func.name << " signature analysis:" << std::endl;
                 if (paramCount > 0)
                 {
-                    std::cout << "  - Uses approximately " << paramCount << " parameter(s)" << std::endl;
+                    out << "  - Uses approximately " << paramCount << " parameter(s)" << std::endl;
                 }
                 if (usesFloatingPoint)
                 {
-                    std::cout << "  - Uses floating point operations" << std::endl;
+                    out << "  - Uses floating point operations" << std::endl;
                 }
                 if (usesDoublewords)
                 {
-                    std::cout << "  - Uses 64-bit operations" << std::endl;
+                    out << "  - Uses 64-bit operations" << std::endl;
                 }
                 if (returnsSomething)
                 {
-                    std::cout << "  - Returns a value" << std::endl;
+                    out << "  - Returns a value" << std::endl;
                 }
             }
+
+            reports[index] = out.str(); });
+
+        for (const auto &report : reports)
+        {
+            std::cout << report;
         }
     }
 
@@ -1295,7 +1374,7 @@ namespace ps2recomp
 
     bool ElfAnalyzer::identifyMemcpyPattern(const Function &func) const
     {
-        std::vector<Instruction> instructions = decodeFunction(func);
+        const std::vector<Instruction> &instructions = instructionsOf(func);
 
         bool hasLoop = false;
         bool loadsData = false;
@@ -1339,7 +1418,7 @@ namespace ps2recomp
 
     bool ElfAnalyzer::identifyMemsetPattern(const Function &func) const
     {
-        std::vector<Instruction> instructions = decodeFunction(func);
+        const std::vector<Instruction> &instructions = instructionsOf(func);
 
         bool hasLoop = false;
         bool usesConstant = false;
@@ -1382,7 +1461,7 @@ namespace ps2recomp
 
     bool ElfAnalyzer::identifyStringOperationPattern(const Function &func) const
     {
-        std::vector<Instruction> instructions = decodeFunction(func);
+        const std::vector<Instruction> &instructions = instructionsOf(func);
 
         bool hasLoop = false;
         bool checksZero = false;
@@ -1422,7 +1501,7 @@ namespace ps2recomp
 
     bool ElfAnalyzer::identifyMathPattern(const Function &func) const
     {
-        std::vector<Instruction> instructions = decodeFunction(func);
+        const std::vector<Instruction> &instructions = instructionsOf(func);
 
         int mathOps = 0;
         bool usesFPU = false;
@@ -1454,7 +1533,7 @@ namespace ps2recomp
     CFG ElfAnalyzer::buildCFG(const Function &function) const
     {
         CFG cfg;
-        std::vector<Instruction> instructions = decodeFunction(function);
+        const std::vector<Instruction> &instructions = instructionsOf(function);
         std::map<uint32_t, size_t> addrToIndex;
 
         for (size_t i = 0; i < instructions.size(); i++)
@@ -1717,20 +1796,18 @@ namespace ps2recomp
 
     std::vector<Instruction> ElfAnalyzer::decodeFunction(const Function &function) const
     {
-        std::vector<Instruction> instructions;
+        InstructionSpan cached = m_decodedImage->range(function.start, function.end);
+        std::vector<Instruction> instructions = cached.unpack();
 
-        for (uint32_t addr = function.start; addr < function.end; addr += 4)
+        for (uint32_t addr = function.start + static_cast<uint32_t>(cached.size() * 4); addr < function.end; addr += 4)
         {
-            uint32_t rawInstruction = 0;
-            if (!tryReadWord(m_elfParser.get(), addr, rawInstruction))
-            {
-                continue;
-            }
-
             try
             {
-                Instruction inst = m_decoder->decodeInstruction(addr, rawInstruction);
-                instructions.push_back(inst);
+                Instruction inst;
+                if (m_decodedImage->decode(addr, inst))
+                {
+                    instructions.push_back(inst);
+                }
             }
             catch (const std::exception &e)
             {
@@ -1742,6 +1819,27 @@ namespace ps2recomp
         return instructions;
     }
 
+    void ElfAnalyzer::decodeFunctions()
+    {
+        std::vector<std::vector<Instruction>> decoded(m_functions.size());
+        parallelFor(m_functions.size(), [&](size_t index)
+                    { decoded[index] = decodeFunction(m_functions[index]); });
+
+        m_functionInstructions.clear();
+        m_functionInstructions.reserve(m_functions.size());
+        for (size_t index = 0; index < m_functions.size(); ++index)
+        {
+            m_functionInstructions[m_functions[index].start] = std::move(decoded[index]);
+        }
+    }
+
+    const std::vector<Instruction> &ElfAnalyzer::instructionsOf(const Function &function) const
+    {
+        static const std::vector<Instruction> none;
+        auto it = m_functionInstructions.find(function.start);
+        return it != m_functionInstructions.end() ? it->second : none;
+    }
+
     std::string ElfAnalyzer::formatAddress(uint32_t address) const
     {
         std::stringstream ss;
@@ -1751,7 +1849,7 @@ namespace ps2recomp
 
     bool ElfAnalyzer::hasMMIInstructions(const Function &function) const
     {
-        std::vector<Instruction> instructions = decodeFunction(function);
+        const std::vector<Instruction> &instructions = instructionsOf(function);
 
         for (const auto &inst : instructions)
         {
@@ -1766,7 +1864,7 @@ namespace ps2recomp
 
     bool ElfAnalyzer::hasVUInstructions(const Function &function) const
     {
-        std::vector<Instruction> instructions = decodeFunction(function);
+        const std::vector<Instruction> &instructions = instructionsOf(function);
 
         for (const auto &inst : instructions)
         {
@@ -1795,7 +1893,7 @@ namespace ps2recomp
             return false;
         }
 
-        std::vector<Instruction> instructions = decodeFunction(function);
+        const std::vector<Instruction> &instructions = instructionsOf(function);
 
         bool hasHardwareIO = false;
         bool hasComplexMMI = false;
@@ -1864,7 +1962,7 @@ namespace ps2recomp
 
     bool ElfAnalyzer::isSelfModifyingCode(const Function &function) const
     {
-        std::vector<Instruction> instructions = decodeFunction(function);
+        const std::vector<Instruction> &instructions = instructionsOf(function);
 
         for (size_t i = 0; i < instructions.size(); i++)
         {
@@ -1910,7 +2008,7 @@ namespace ps2recomp
 
     bool ElfAnalyzer::isLoopHeavyFunction(const Function &function) const
     {
-        std::vector<Instruction> instructions = decodeFunction(function);
+        const std::vector<Instruction> &instructions = instructionsOf(function);
         int loopCount = 0;
 
         for (const auto &inst : instructions)
@@ -0,0 +1,251 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef WINAPI
+#define WINAPI __stdcall
+#endif
+extern "C"
+{
+    __declspec(dllimport) void *WINAPI GetCurrentThread(void);
+    __declspec(dllimport) uintptr_t WINAPI SetThreadAffinityMask(void *hThread, uintptr_t dwThreadAffinityMask);
+}
+#elif defined(__linux__)
+#include <sched.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// The body runs `iterations` times and must feed its results through DoNotOptimize.
+using BenchFn = std::function<void(uint64_t iterations)>;
+
+template <typename T>
+inline void DoNotOptimize(const T &value)
+{
+#if defined(_MSC_VER)
+    const volatile char *sink = reinterpret_cast<const volatile char *>(&value);
+    (void)*sink;
+    _ReadWriteBarrier();
+#else
+    asm volatile("" : : "r,m"(value) : "memory");
+#endif
+}
+
+struct BenchOptions
+{
+    std::string filter;
+    std::string jsonPath;
+    int repetitions = 15;
+    int warmupMs = 50;
+    int minSampleMs = 10;
+    int cpu = 0; // -1 disables pinning
+};
+
+struct BenchResult
+{
+    std::string name;
+    uint64_t iterations = 0;
+    std::vector<double> samples; // ns/op per repetition
+    double min = 0, median = 0, mean = 0, stddev = 0;
+};
+
+class MicroBench
+{
+private:
+    inline static std::map<std::string, BenchFn> m_benches;
+
+    static double TimeNs(const BenchFn &fn, uint64_t iterations)
+    {
+        auto start = std::chrono::steady_clock::now();
+        fn(iterations);
+        auto end = std::chrono::steady_clock::now();
+        return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    }
+
+    // Grows the batch until one sample takes at least minSampleMs.
+    static uint64_t Calibrate(const BenchFn &fn, const BenchOptions &options)
+    {
+        const double target = options.minSampleMs * 1e6;
+        uint64_t iterations = 1;
+        for (;;)
+        {
+            double ns = TimeNs(fn, iterations);
+            if (ns >= target || iterations >= (1ull << 40))
+                return iterations;
+            double scale = ns > 0 ? std::min(10.0, std::max(2.0, 1.2 * target / ns)) : 10.0;
+            iterations = static_cast<uint64_t>(iterations * scale);
+        }
+    }
+
+    static bool PinToCpu(int cpu)
+    {
+        if (cpu < 0)
+            return true;
+#if defined(_WIN32)
+        return SetThreadAffinityMask(GetCurrentThread(), uintptr_t(1) << cpu) != 0;
+#elif defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+        return false; // no hard affinity on this platform
+#endif
+    }
+
+    static std::string JsonEscape(const std::string &s)
+    {
+        std::string out;
+        for (char c : s)
+        {
+            if (c == '"' || c == '\\')
+                out += '\\';
+            out += c;
+        }
+        return out;
+    }
+
+    static void WriteJson(const std::string &path, const BenchOptions &options, bool pinned,
+                          const std::vector<BenchResult> &results)
+    {
+        std::ofstream out(path);
+        if (!out)
+        {
+            std::cerr << "Failed to write " << path << std::endl;
+            return;
+        }
+
+        std::time_t now = std::time(nullptr);
+        char date[32] = {};
+        std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+        out << std::setprecision(4) << std::fixed;
+        out << "{\n  \"context\": {\n";
+        out << "    \"date\": \"" << date << "\",\n";
+        out << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n";
+        out << "    \"pinned_cpu\": " << (pinned ? options.cpu : -1) << ",\n";
+        out << "    \"repetitions\": " << options.repetitions << ",\n";
+#if defined(NDEBUG)
+        out << "    \"build\": \"release\"\n";
+#else
+        out << "    \"build\": \"debug\"\n";
+#endif
+        out << "  },\n  \"benchmarks\": [\n";
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            const BenchResult &r = results[i];
+            out << "    {\"name\": \"" << JsonEscape(r.name) << "\", \"iterations\": " << r.iterations
+                << ", \"unit\": \"ns/op\", \"min\": " << r.min << ", \"median\": " << r.median
+                << ", \"mean\": " << r.mean << ", \"stddev\": " << r.stddev << ", \"samples\": [";
+            for (size_t s = 0; s < r.samples.size(); ++s)
+                out << (s ? ", " : "") << r.samples[s];
+            out << "]}" << (i + 1 < results.size() ? "," : "") << "\n";
+        }
+        out << "  ]\n}\n";
+    }
+
+public:
+    static void Add(const std::string &name, const BenchFn &fn)
+    {
+        m_benches[name] = fn;
+    }
+
+    static bool ParseArgs(int argc, char *argv[], BenchOptions &options)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--filter" && hasValue)
+                options.filter = argv[++i];
+            else if (arg == "--json" && hasValue)
+                options.jsonPath = argv[++i];
+            else if (arg == "--repetitions" && hasValue)
+                options.repetitions = std::max(1, std::atoi(argv[++i]));
+            else if (arg == "--warmup-ms" && hasValue)
+                options.warmupMs = std::max(0, std::atoi(argv[++i]));
+            else if (arg == "--min-sample-ms" && hasValue)
+                options.minSampleMs = std::max(1, std::atoi(argv[++i]));
+            else if (arg == "--cpu" && hasValue)
+                options.cpu = std::atoi(argv[++i]);
+            else
+            {
+                std::cerr << "Usage: " << argv[0]
+                          << " [--filter <substring>] [--json <file>] [--repetitions N]"
+                          << " [--warmup-ms N] [--min-sample-ms N] [--cpu N|-1]" << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static int Run(const BenchOptions &options)
+    {
+        bool pinned = PinToCpu(options.cpu);
+        if (!pinned)
+        {
+            std::cerr << "Warning: could not pin to cpu " << options.cpu << ", results may be noisy" << std::endl;
+        }
+
+        std::vector<BenchResult> results;
+        std::cout << std::left << std::setw(40) << "benchmark" << std::right
+                  << std::setw(12) << "median" << std::setw(12) << "min"
+                  << std::setw(12) << "stddev" << "  (ns/op)" << std::endl;
+
+        for (auto &b : m_benches)
+        {
+            const std::string &name = b.first;
+            const BenchFn &fn = b.second;
+            if (!options.filter.empty() && name.find(options.filter) == std::string::npos)
+                continue;
+
+            uint64_t iterations = Calibrate(fn, options);
+
+            auto warmupEnd = std::chrono::steady_clock::now() + std::chrono::milliseconds(options.warmupMs);
+            while (std::chrono::steady_clock::now() < warmupEnd)
+                fn(iterations);
+
+            BenchResult r;
+            r.name = name;
+            r.iterations = iterations;
+            for (int rep = 0; rep < options.repetitions; ++rep)
+                r.samples.push_back(TimeNs(fn, iterations) / static_cast<double>(iterations));
+
+            std::vector<double> sorted = r.samples;
+            std::sort(sorted.begin(), sorted.end());
+            size_t n = sorted.size();
+            r.min = sorted.front();
+            r.median = n % 2 ? sorted[n / 2] : 0.5 * (sorted[n / 2 - 1] + sorted[n / 2]);
+            for (double s : sorted)
+                r.mean += s;
+            r.mean /= static_cast<double>(n);
+            for (double s : sorted)
+                r.stddev += (s - r.mean) * (s - r.mean);
+            r.stddev = n > 1 ? std::sqrt(r.stddev / static_cast<double>(n - 1)) : 0.0;
+
+            std::cout << std::left << std::setw(40) << name << std::right << std::fixed << std::setprecision(3)
+                      << std::setw(12) << r.median << std::setw(12) << r.min << std::setw(12) << r.stddev << std::endl;
+            results.push_back(std::move(r));
+        }
+
+        if (!options.jsonPath.empty())
+            WriteJson(options.jsonPath, options, pinned && options.cpu >= 0, results);
+
+        return results.empty() ? 1 : 0;
+    }
+};
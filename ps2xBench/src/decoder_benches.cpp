@@ -0,0 +1,80 @@
+#include "MicroBench.h"
+#include "ps2recomp/r5900_decoder.h"
+#include <iterator>
+#include <random>
+#include <vector>
+
+using namespace ps2recomp;
+
+namespace
+{
+    // A rough mix of what compiled EE code looks like: mostly loads/stores and
+    // ALU ops, some branches and calls, a sprinkling of MMI and FPU.
+    std::vector<uint32_t> makeInstructionStream(size_t count)
+    {
+        std::mt19937 rng(42);
+        auto reg = [&]()
+        { return static_cast<uint32_t>(rng() % 32); };
+        auto imm = [&]()
+        { return static_cast<uint32_t>(rng() & 0xFFFF); };
+
+        static const uint32_t kImmediateOps[] = {OPCODE_ADDIU, OPCODE_LW, OPCODE_SW, OPCODE_LUI, OPCODE_ORI,
+                                                 OPCODE_ANDI, OPCODE_SLTI, OPCODE_LQ, OPCODE_SQ, OPCODE_LD,
+                                                 OPCODE_SD, OPCODE_LBU, OPCODE_SB, OPCODE_LWC1, OPCODE_SWC1};
+        static const uint32_t kSpecialOps[] = {SPECIAL_SLL, SPECIAL_ADDU, SPECIAL_SUBU, SPECIAL_AND, SPECIAL_OR,
+                                               SPECIAL_SLT, SPECIAL_SLTU, SPECIAL_DADDU, SPECIAL_MFLO, SPECIAL_MULT};
+        static const uint32_t kBranchOps[] = {OPCODE_BEQ, OPCODE_BNE, OPCODE_BLEZ, OPCODE_BGTZ, OPCODE_BEQL};
+
+        std::vector<uint32_t> words;
+        words.reserve(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            uint32_t pick = rng() % 100;
+            uint32_t raw;
+            if (pick < 45)
+            {
+                uint32_t op = kImmediateOps[rng() % std::size(kImmediateOps)];
+                raw = (op << 26) | (reg() << 21) | (reg() << 16) | imm();
+            }
+            else if (pick < 75)
+            {
+                uint32_t fn = kSpecialOps[rng() % std::size(kSpecialOps)];
+                raw = (OPCODE_SPECIAL << 26) | (reg() << 21) | (reg() << 16) | (reg() << 11) | ((rng() % 32) << 6) | fn;
+            }
+            else if (pick < 87)
+            {
+                uint32_t op = kBranchOps[rng() % std::size(kBranchOps)];
+                raw = (op << 26) | (reg() << 21) | (reg() << 16) | imm();
+            }
+            else if (pick < 92)
+            {
+                raw = (OPCODE_JAL << 26) | ((0x00100000 + (rng() % 0x100000) * 4) >> 2);
+            }
+            else if (pick < 96)
+            {
+                raw = (OPCODE_MMI << 26) | (reg() << 21) | (reg() << 16) | (reg() << 11) | (MMI0_PADDW << 6) | MMI_MMI0;
+            }
+            else
+            {
+                raw = (OPCODE_COP1 << 26) | (COP1_S << 21) | (reg() << 16) | (reg() << 11) | (reg() << 6) |
+                      (rng() % 4); // ADD.S/SUB.S/MUL.S/DIV.S
+            }
+            words.push_back(raw);
+        }
+        return words;
+    }
+}
+
+void register_decoder_benches()
+{
+    MicroBench::Add("decoder/decodeInstruction", [](uint64_t iterations)
+                    {
+        static const std::vector<uint32_t> words = makeInstructionStream(1 << 16);
+        static const R5900Decoder decoder;
+        const size_t mask = words.size() - 1;
+        for (uint64_t i = 0; i < iterations; ++i)
+        {
+            Instruction inst = decoder.decodeInstruction(0x00100000 + static_cast<uint32_t>((i & mask) * 4), words[i & mask]);
+            DoNotOptimize(inst);
+        } });
+}
@@ -0,0 +1,89 @@
+#include "MicroBench.h"
+#include "ps2_runtime.h"
+#include "ps2_runtime_macros.h"
+
+namespace
+{
+    // Each loop iteration is one dependent operation, so ns/op is latency-bound
+    // the same way a chain of recompiled instructions is.
+    template <typename Op>
+    BenchFn mmiChain(Op op)
+    {
+        return [op](uint64_t iterations)
+        {
+            __m128i a = _mm_set_epi32(0x01020304, 0x05060708, 0x090A0B0C, 0x0D0E0F10);
+            __m128i b = _mm_set_epi32(3, 7, 11, 13);
+            for (uint64_t i = 0; i < iterations; ++i)
+            {
+                a = op(a, b);
+                DoNotOptimize(a);
+            }
+        };
+    }
+}
+
+void register_macro_benches()
+{
+    static R5900Context ctx{};
+
+    MicroBench::Add("gpr/GPR_U32", [](uint64_t iterations)
+                    {
+        R5900Context *c = &ctx;
+        uint32_t sum = 0;
+        for (uint64_t i = 0; i < iterations; ++i)
+        {
+            sum += GPR_U32(c, (i & 31));
+        }
+        DoNotOptimize(sum); });
+
+    MicroBench::Add("gpr/GPR_U64", [](uint64_t iterations)
+                    {
+        R5900Context *c = &ctx;
+        uint64_t sum = 0;
+        for (uint64_t i = 0; i < iterations; ++i)
+        {
+            sum += GPR_U64(c, (i & 31));
+        }
+        DoNotOptimize(sum); });
+
+    MicroBench::Add("gpr/SET_GPR_U32", [](uint64_t iterations)
+                    {
+        R5900Context *c = &ctx;
+        for (uint64_t i = 0; i < iterations; ++i)
+        {
+            SET_GPR_U32(c, (i & 31), static_cast<uint32_t>(i));
+            DoNotOptimize(c->r[i & 31]);
+        } });
+
+    MicroBench::Add("gpr/SET_GPR_S64", [](uint64_t iterations)
+                    {
+        R5900Context *c = &ctx;
+        for (uint64_t i = 0; i < iterations; ++i)
+        {
+            SET_GPR_S64(c, (i & 31), static_cast<int64_t>(i));
+            DoNotOptimize(c->r[i & 31]);
+        } });
+
+    MicroBench::Add("gpr/addu_roundtrip", [](uint64_t iterations)
+                    {
+        // addu $t0, $t0, $t1 as the code generator emits it
+        R5900Context *c = &ctx;
+        SET_GPR_U32(c, 9, 3);
+        for (uint64_t i = 0; i < iterations; ++i)
+        {
+            SET_GPR_U32(c, 8, GPR_U32(c, 8) + GPR_U32(c, 9));
+            DoNotOptimize(c->r[8]);
+        } });
+
+    MicroBench::Add("mmi/PS2_PADDW", mmiChain([](__m128i a, __m128i b) { return PS2_PADDW(a, b); }));
+    MicroBench::Add("mmi/PS2_PMAXW", mmiChain([](__m128i a, __m128i b) { return PS2_PMAXW(a, b); }));
+    MicroBench::Add("mmi/PS2_PEXTLW", mmiChain([](__m128i a, __m128i b) { return PS2_PEXTLW(a, b); }));
+    MicroBench::Add("mmi/PS2_PCEQB", mmiChain([](__m128i a, __m128i b) { return PS2_PCEQB(a, b); }));
+    MicroBench::Add("mmi/PS2_PNOR", mmiChain([](__m128i a, __m128i b) { return PS2_PNOR(a, b); }));
+    MicroBench::Add("mmi/PS2_PPACH", mmiChain([](__m128i a, __m128i b) { return PS2_PPACH(a, b); }));
+    MicroBench::Add("mmi/PS2_PMADDW", mmiChain([](__m128i a, __m128i b) { return PS2_PMADDW(a, b); }));
+    MicroBench::Add("mmi/PS2_PSLLVW", mmiChain([](__m128i a, __m128i b) { return PS2_PSLLVW(a, b); }));
+    MicroBench::Add("mmi/PS2_PSRAVW", mmiChain([](__m128i a, __m128i b) { return PS2_PSRAVW(a, b); }));
+    MicroBench::Add("mmi/PS2_PCPYLD", mmiChain([](__m128i a, __m128i b) { return PS2_PCPYLD(a, b); }));
+    MicroBench::Add("mmi/PS2_PEXEW", mmiChain([](__m128i a, __m128i) { return PS2_PEXEW(a); }));
+}
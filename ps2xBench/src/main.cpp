@@ -0,0 +1,23 @@
+#include "MicroBench.h"
+
+void register_macro_benches();
+void register_memory_benches();
+void register_runtime_benches();
+void register_stub_benches();
+void register_decoder_benches();
+
+int main(int argc, char *argv[])
+{
+    BenchOptions options;
+    if (!MicroBench::ParseArgs(argc, argv, options))
+    {
+        return 1;
+    }
+
+    register_macro_benches();
+    register_memory_benches();
+    register_runtime_benches();
+    register_stub_benches();
+    register_decoder_benches();
+    return MicroBench::Run(options);
+}
@@ -0,0 +1,115 @@
+#include "MicroBench.h"
+#include "ps2_runtime.h"
+#include <memory>
+
+namespace
+{
+    constexpr uint32_t kBase = 0x00100000;
+    constexpr uint32_t kSpan = 0x00100000; // 1MB working set, stays cache-resident-ish
+
+    PS2Memory &benchMemory()
+    {
+        static std::unique_ptr<PS2Memory> memory;
+        if (!memory)
+        {
+            memory = std::make_unique<PS2Memory>();
+            memory->initialize();
+        }
+        return *memory;
+    }
+
+    // Scrambled but deterministic addresses so the loop isn't a pure stride.
+    inline uint32_t addressAt(uint64_t i, uint32_t align)
+    {
+        uint32_t offset = static_cast<uint32_t>(i * 2654435761u) & (kSpan - 1);
+        return kBase + (offset & ~(align - 1));
+    }
+}
+
+void register_memory_benches()
+{
+    MicroBench::Add("memory/read8", [](uint64_t iterations)
+                    {
+        PS2Memory &mem = benchMemory();
+        uint32_t sum = 0;
+        for (uint64_t i = 0; i < iterations; ++i)
+            sum += mem.read8(addressAt(i, 1));
+        DoNotOptimize(sum); });
+
+    MicroBench::Add("memory/read32", [](uint64_t iterations)
+                    {
+        PS2Memory &mem = benchMemory();
+        uint32_t sum = 0;
+        for (uint64_t i = 0; i < iterations; ++i)
+            sum += mem.read32(addressAt(i, 4));
+        DoNotOptimize(sum); });
+
+    MicroBench::Add("memory/read64", [](uint64_t iterations)
+                    {
+        PS2Memory &mem = benchMemory();
+        uint64_t sum = 0;
+        for (uint64_t i = 0; i < iterations; ++i)
+            sum += mem.read64(addressAt(i, 8));
+        DoNotOptimize(sum); });
+
+    MicroBench::Add("memory/read128", [](uint64_t iterations)
+                    {
+        PS2Memory &mem = benchMemory();
+        __m128i acc = _mm_setzero_si128();
+        for (uint64_t i = 0; i < iterations; ++i)
+            acc = _mm_xor_si128(acc, mem.read128(addressAt(i, 16)));
+        DoNotOptimize(acc); });
+
+    MicroBench::Add("memory/write8", [](uint64_t iterations)
+                    {
+        PS2Memory &mem = benchMemory();
+        for (uint64_t i = 0; i < iterations; ++i)
+            mem.write8(addressAt(i, 1), static_cast<uint8_t>(i));
+        DoNotOptimize(mem); });
+
+    MicroBench::Add("memory/write32", [](uint64_t iterations)
+                    {
+        PS2Memory &mem = benchMemory();
+        for (uint64_t i = 0; i < iterations; ++i)
+            mem.write32(addressAt(i, 4), static_cast<uint32_t>(i));
+        DoNotOptimize(mem); });
+
+    MicroBench::Add("memory/write64", [](uint64_t iterations)
+                    {
+        PS2Memory &mem = benchMemory();
+        for (uint64_t i = 0; i < iterations; ++i)
+            mem.write64(addressAt(i, 8), i);
+        DoNotOptimize(mem); });
+
+    MicroBench::Add("memory/write128", [](uint64_t iterations)
+                    {
+        PS2Memory &mem = benchMemory();
+        __m128i value = _mm_set1_epi32(0x5A5A5A5A);
+        for (uint64_t i = 0; i < iterations; ++i)
+            mem.write128(addressAt(i, 16), value);
+        DoNotOptimize(mem); });
+
+    MicroBench::Add("memory/read32_scratchpad", [](uint64_t iterations)
+                    {
+        PS2Memory &mem = benchMemory();
+        uint32_t sum = 0;
+        for (uint64_t i = 0; i < iterations; ++i)
+            sum += mem.read32(PS2_SCRATCHPAD_BASE + ((i * 4) & (PS2_SCRATCHPAD_SIZE - 4)));
+        DoNotOptimize(sum); });
+
+    MicroBench::Add("memory/translateAddress_kseg0", [](uint64_t iterations)
+                    {
+        PS2Memory &mem = benchMemory();
+        uint32_t sum = 0;
+        for (uint64_t i = 0; i < iterations; ++i)
+            sum += mem.translateAddress(0x80000000u | addressAt(i, 4));
+        DoNotOptimize(sum); });
+
+    MicroBench::Add("memory/translateAddress_kuseg", [](uint64_t iterations)
+                    {
+        PS2Memory &mem = benchMemory();
+        uint32_t sum = 0;
+        for (uint64_t i = 0; i < iterations; ++i)
+            sum += mem.translateAddress(addressAt(i, 4));
+        DoNotOptimize(sum); });
+}
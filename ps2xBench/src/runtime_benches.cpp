@@ -0,0 +1,75 @@
+#include "MicroBench.h"
+#include "ps2_runtime.h"
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace
+{
+    void dummyFunction(uint8_t *, R5900Context *, PS2Runtime *)
+    {
+    }
+
+    constexpr size_t kFunctionCount = 8192; // roughly a mid-sized game's worth of functions
+
+    struct LookupFixture
+    {
+        std::unique_ptr<PS2Runtime> runtime = std::make_unique<PS2Runtime>();
+        std::vector<uint32_t> addresses;
+    };
+
+    LookupFixture &lookupFixture()
+    {
+        static std::unique_ptr<LookupFixture> fixture;
+        if (!fixture)
+        {
+            fixture = std::make_unique<LookupFixture>();
+            std::mt19937 rng(1234);
+            uint32_t address = 0x00100000;
+            for (size_t i = 0; i < kFunctionCount; ++i)
+            {
+                address += 8 + (rng() % 256) * 4;
+                fixture->runtime->registerFunction(address, &dummyFunction);
+                fixture->addresses.push_back(address);
+            }
+            std::shuffle(fixture->addresses.begin(), fixture->addresses.end(), rng);
+        }
+        return *fixture;
+    }
+}
+
+void register_runtime_benches()
+{
+    MicroBench::Add("runtime/lookupFunction", [](uint64_t iterations)
+                    {
+        LookupFixture &f = lookupFixture();
+        const size_t mask = f.addresses.size() - 1;
+        for (uint64_t i = 0; i < iterations; ++i)
+        {
+            PS2Runtime::RecompiledFunction fn = f.runtime->lookupFunction(f.addresses[i & mask]);
+            DoNotOptimize(fn);
+        } });
+
+    MicroBench::Add("runtime/lookupFunction_same", [](uint64_t iterations)
+                    {
+        // Hot loop calling the same target, the case an inline cache would help.
+        LookupFixture &f = lookupFixture();
+        uint32_t address = f.addresses[0];
+        for (uint64_t i = 0; i < iterations; ++i)
+        {
+            PS2Runtime::RecompiledFunction fn = f.runtime->lookupFunction(address);
+            DoNotOptimize(fn);
+        } });
+
+    MicroBench::Add("runtime/hasFunction", [](uint64_t iterations)
+                    {
+        LookupFixture &f = lookupFixture();
+        const size_t mask = f.addresses.size() - 1;
+        uint32_t hits = 0;
+        for (uint64_t i = 0; i < iterations; ++i)
+        {
+            hits += f.runtime->hasFunction(f.addresses[i & mask] + ((i >> 13) & 4));
+        }
+        DoNotOptimize(hits); });
+}
@@ -0,0 +1,74 @@
+#include "MicroBench.h"
+#include "ps2_runtime.h"
+#include "ps2_runtime_macros.h"
+#include "ps2_stubs.h"
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    constexpr uint32_t kSrc = 0x00200000;
+    constexpr uint32_t kDst = 0x00300000;
+    constexpr uint32_t kStrA = 0x00400000;
+    constexpr uint32_t kStrB = 0x00400100;
+
+    struct StubFixture
+    {
+        std::vector<uint8_t> rdram = std::vector<uint8_t>(PS2_RAM_SIZE);
+        R5900Context ctx{};
+
+        StubFixture()
+        {
+            for (size_t i = 0; i < 4096; ++i)
+                rdram[kSrc + i] = static_cast<uint8_t>(i * 7);
+            // 63-character strings that differ only in the last byte
+            std::memset(&rdram[kStrA], 'a', 63);
+            std::memset(&rdram[kStrB], 'a', 63);
+            rdram[kStrB + 62] = 'b';
+        }
+
+        void call(void (*stub)(uint8_t *, R5900Context *, PS2Runtime *), uint32_t a0, uint32_t a1, uint32_t a2)
+        {
+            R5900Context *c = &ctx;
+            SET_GPR_U32(c, 4, a0);
+            SET_GPR_U32(c, 5, a1);
+            SET_GPR_U32(c, 6, a2);
+            stub(rdram.data(), c, nullptr);
+        }
+    };
+
+    StubFixture &stubFixture()
+    {
+        static StubFixture fixture;
+        return fixture;
+    }
+
+    BenchFn stubBench(void (*stub)(uint8_t *, R5900Context *, PS2Runtime *), uint32_t a0, uint32_t a1, uint32_t a2)
+    {
+        return [=](uint64_t iterations)
+        {
+            StubFixture &f = stubFixture();
+            for (uint64_t i = 0; i < iterations; ++i)
+            {
+                f.call(stub, a0, a1, a2);
+                DoNotOptimize(f.ctx.r[2]);
+            }
+        };
+    }
+}
+
+void register_stub_benches()
+{
+    MicroBench::Add("stubs/memcpy_16", stubBench(&ps2_stubs::memcpy, kDst, kSrc, 16));
+    MicroBench::Add("stubs/memcpy_256", stubBench(&ps2_stubs::memcpy, kDst, kSrc, 256));
+    MicroBench::Add("stubs/memcpy_4096", stubBench(&ps2_stubs::memcpy, kDst, kSrc, 4096));
+    MicroBench::Add("stubs/memmove_256", stubBench(&ps2_stubs::memmove, kSrc + 8, kSrc, 256));
+    MicroBench::Add("stubs/memset_256", stubBench(&ps2_stubs::memset, kDst, 0, 256));
+    MicroBench::Add("stubs/memset_4096", stubBench(&ps2_stubs::memset, kDst, 0, 4096));
+    MicroBench::Add("stubs/memcmp_256", stubBench(&ps2_stubs::memcmp, kSrc, kSrc, 256));
+    MicroBench::Add("stubs/strlen_63", stubBench(&ps2_stubs::strlen, kStrA, 0, 0));
+    MicroBench::Add("stubs/strcmp_63", stubBench(&ps2_stubs::strcmp, kStrA, kStrB, 0));
+    MicroBench::Add("stubs/strncmp_63", stubBench(&ps2_stubs::strncmp, kStrA, kStrB, 63));
+    MicroBench::Add("stubs/strcpy_63", stubBench(&ps2_stubs::strcpy, kDst, kStrA, 0));
+    MicroBench::Add("stubs/strchr_63", stubBench(&ps2_stubs::strchr, kStrB, 'b', 0));
+}
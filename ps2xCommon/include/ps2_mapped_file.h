@@ -0,0 +1,31 @@
+#ifndef PS2_MAPPED_FILE_H
+#define PS2_MAPPED_FILE_H
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+
+// Read-only memory mapping of a whole host file. Used for disc images, ELFs and
+// anything else that is only ever read, so the OS pages it in on demand instead
+// of the runtime keeping a heap copy.
+class MappedFile
+{
+public:
+    static std::shared_ptr<MappedFile> open(const std::filesystem::path &path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const uint8_t *data() const { return m_data; }
+    uint64_t size() const { return m_size; }
+
+private:
+    MappedFile() = default;
+
+    const uint8_t *m_data = nullptr;
+    uint64_t m_size = 0;
+    void *m_mapping = nullptr; // Windows file mapping handle
+};
+
+#endif // PS2_MAPPED_FILE_H
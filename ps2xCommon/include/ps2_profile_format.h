@@ -0,0 +1,19 @@
+#ifndef PS2_PROFILE_FORMAT_H
+#define PS2_PROFILE_FORMAT_H
+
+#include <cstdint>
+
+// Profile file written by an instrumented runtime (ps2_profile.h) and read back
+// by the recompiler (ps2recomp/profile_data.h):
+//   "PS2P" u32 magic, u32 version,
+//   varint function count, then (varint address delta, varint entries) per function,
+//   varint branch count, then (varint address delta, varint taken, varint not taken),
+// with both lists sorted by address and each delta taken from the previous address.
+// Varints are ps2_varint.h.
+namespace ps2_profile_format
+{
+    constexpr uint32_t kMagic = 0x50325350; // "PS2P"
+    constexpr uint32_t kVersion = 1;
+}
+
+#endif // PS2_PROFILE_FORMAT_H
@@ -0,0 +1,40 @@
+#ifndef PS2_VARINT_H
+#define PS2_VARINT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// LEB128-style unsigned varints, seven bits per byte with the high bit set on
+// every byte but the last. Used by the profile and journal files.
+namespace ps2_varint
+{
+    inline void put(std::vector<uint8_t> &out, uint64_t v)
+    {
+        while (v >= 0x80)
+        {
+            out.push_back(static_cast<uint8_t>(v) | 0x80);
+            v >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(v));
+    }
+
+    // Reads one varint at in[pos] and advances pos; false if it runs past the end
+    // or does not fit 64 bits.
+    inline bool get(const std::vector<uint8_t> &in, size_t &pos, uint64_t &v)
+    {
+        v = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            if (pos >= in.size())
+                return false;
+            uint8_t b = in[pos++];
+            v |= static_cast<uint64_t>(b & 0x7F) << shift;
+            if (!(b & 0x80))
+                return true;
+        }
+        return false;
+    }
+}
+
+#endif // PS2_VARINT_H
@@ -0,0 +1,83 @@
+#include "ps2_mapped_file.h"
+#include <fcntl.h>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+std::shared_ptr<MappedFile> MappedFile::open(const std::filesystem::path &path)
+{
+    std::shared_ptr<MappedFile> file(new MappedFile());
+#ifdef _WIN32
+    HANDLE handle = ::CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                                  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE)
+        return nullptr;
+
+    LARGE_INTEGER size{};
+    if (!::GetFileSizeEx(handle, &size) || size.QuadPart == 0)
+    {
+        ::CloseHandle(handle);
+        return nullptr;
+    }
+
+    HANDLE mapping = ::CreateFileMappingW(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    ::CloseHandle(handle);
+    if (!mapping)
+        return nullptr;
+
+    void *view = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view)
+    {
+        ::CloseHandle(mapping);
+        return nullptr;
+    }
+
+    file->m_mapping = mapping;
+    file->m_data = static_cast<const uint8_t *>(view);
+    file->m_size = static_cast<uint64_t>(size.QuadPart);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return nullptr;
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        ::close(fd);
+        return nullptr;
+    }
+
+    void *view = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // the mapping keeps its own reference
+    if (view == MAP_FAILED)
+        return nullptr;
+
+    file->m_data = static_cast<const uint8_t *>(view);
+    file->m_size = static_cast<uint64_t>(st.st_size);
+#endif
+    return file;
+}
+
+MappedFile::~MappedFile()
+{
+    if (!m_data)
+        return;
+#ifdef _WIN32
+    ::UnmapViewOfFile(m_data);
+    if (m_mapping)
+        ::CloseHandle(static_cast<HANDLE>(m_mapping));
+#else
+    ::munmap(const_cast<uint8_t *>(m_data), static_cast<size_t>(m_size));
+#endif
+}
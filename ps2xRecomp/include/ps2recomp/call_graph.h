@@ -0,0 +1,68 @@
+#ifndef PS2RECOMP_CALL_GRAPH_H
+#define PS2RECOMP_CALL_GRAPH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace ps2recomp
+{
+    struct Instruction;
+
+    // Static call graph over node indices, stored as CSR adjacency arrays, with its
+    // strongly connected components.
+    //
+    // Components come from an iterative Tarjan walk in O(V + E) and are numbered in
+    // reverse topological order: a component's callees all have lower ids, except
+    // for the calls inside the component itself.
+    class CallGraph
+    {
+    public:
+        struct Edge
+        {
+            uint32_t caller = 0;
+            uint32_t callee = 0;
+            double weight = 1.0; // estimated executions of the call site per call of caller
+        };
+
+        CallGraph(size_t nodeCount, const std::vector<Edge> &edges);
+
+        size_t nodeCount() const { return m_offsets.size() - 1; }
+        std::span<const uint32_t> callees(uint32_t node) const;
+        std::span<const double> calleeWeights(uint32_t node) const;
+
+        uint32_t component(uint32_t node) const { return m_component[node]; }
+        size_t componentCount() const { return m_componentSize.size(); }
+        size_t componentSize(uint32_t node) const { return m_componentSize[m_component[node]]; }
+
+        // Part of a cycle: a component of more than one node, or a node calling itself.
+        bool isRecursive(uint32_t node) const;
+
+        // Estimated instructions executed in each node over a run, given the
+        // instructions one call executes (localWeights). Every node is entered once
+        // on its own, plus once per weighted call from its callers, walking the
+        // components callers first. Calls inside a component multiply its count by
+        // one plus their summed weight instead of being followed around the cycle.
+        std::vector<double> estimateHotness(const std::vector<double> &localWeights) const;
+
+    private:
+        void findComponents();
+
+        std::vector<uint32_t> m_offsets; // node i's callees are m_targets[m_offsets[i], m_offsets[i + 1])
+        std::vector<uint32_t> m_targets;
+        std::vector<double> m_weights;
+        std::vector<uint32_t> m_component;
+        std::vector<uint32_t> m_componentSize;
+    };
+
+    // Loop nesting depth of every instruction in a function, counting backward
+    // branches inside [start, end) as loops around the instructions they jump over.
+    std::vector<uint32_t> loopDepths(const std::vector<Instruction> &instructions, uint32_t start, uint32_t end);
+
+    // Static execution estimate for code at the given loop depth: every level of
+    // nesting multiplies by 8, up to four levels.
+    double loopWeight(uint32_t depth);
+}
+
+#endif // PS2RECOMP_CALL_GRAPH_H
@@ -9,10 +9,13 @@
 
 namespace ps2recomp
 {
-	struct JumpTableEntry;
+	struct JumpTable;
 	struct Instruction;
 	struct Function;
 	struct Symbol;
+	class FunctionAnalysis;
+	class ControlFlowStructure;
+	class ProfileData;
 
 	extern const std::unordered_set<std::string> kKeywords;
 
@@ -36,9 +39,29 @@ namespace ps2recomp
         std::string generateFunctionRegistration(const std::vector<Function> &functions, const std::map<uint32_t, std::string> &stubs);
         std::string handleBranchDelaySlots(const Instruction &branchInst, const Instruction &delaySlot,
                                            const Function &function, const std::unordered_set<uint32_t> &internalTargets);
+        // C++ condition under which a conditional branch is taken, counted by
+        // PS2_PROFILE_BRANCH when instrumenting and passed through PS2_IDLE_LOOP
+        // when the branch closes an idle loop.
+        std::string branchCondition(const Instruction &branchInst) const;
+        // " [[likely]]"/" [[unlikely]]" for the statement run when the branch is (or is
+        // not) taken, if the profile says it goes one way almost always; else empty.
+        std::string branchHint(const Instruction &branchInst, bool whenTaken) const;
 
         void setRenamedFunctions(const std::unordered_map<uint32_t, std::string> &renames);
         void setBootstrapInfo(const BootstrapInfo &info);
+        // Leaf functions (with instructions filled in) to expand at their jal sites.
+        // Ones that cannot be expanded safely are dropped.
+        void setInlineFunctions(const std::vector<Function> &functions);
+        size_t inlineFunctionCount() const { return m_inlineFunctions.size(); }
+        // Counts from an instrumented run: cold functions get [[gnu::cold]] and
+        // one-sided branches a hint. The profile must outlive the generator's use.
+        void setProfile(const ProfileData *profile) { m_profile = profile; }
+        // Emit PS2_PROFILE_ENTER/PS2_PROFILE_BRANCH so a run can write a profile.
+        void setProfileInstrumentation(bool enabled) { m_instrumentProfile = enabled; }
+        // Backward branches of busy-wait loops; each iteration calls PS2_IDLE_LOOP.
+        void setIdleLoops(const std::unordered_set<uint32_t> &latches) { m_idleLoops = latches; }
+        // Analyzer jump tables; a jr that dispatches through one becomes a switch.
+        void setJumpTables(const std::vector<JumpTable> &tables);
         std::unordered_set<uint32_t> collectInternalBranchTargets(const Function &function,
                                                                   const std::vector<Instruction> &instructions);
 
@@ -46,6 +69,29 @@ namespace ps2recomp
         std::unordered_map<uint32_t, Symbol> m_symbols;
         std::unordered_map<uint32_t, std::string> m_renamedFunctions;
         BootstrapInfo m_bootstrapInfo;
+        const FunctionAnalysis *m_analysis = nullptr; // set while generateFunction runs
+        const ControlFlowStructure *m_structure = nullptr; // ditto
+        std::unordered_map<uint32_t, Function> m_inlineFunctions;
+        std::unordered_map<uint32_t, JumpTable> m_jumpTables; // by address of the jr
+        std::unordered_set<uint32_t> m_idleLoops;
+        const ProfileData *m_profile = nullptr;
+        bool m_instrumentProfile = false;
+        std::string m_labelSuffix; // keeps the labels of each inlined copy unique
+        uint32_t m_inlineCount = 0;
+
+        static bool canInline(const Function &function);
+        std::string generateInlineBody(const Function &callee);
+        std::string labelName(uint32_t address) const;
+
+        // Load/store address expression, folded to a constant when the base register is known.
+        std::string effectiveAddress(const Instruction &inst) const;
+        // "ctx->lo = ...; ctx->hi = ...;" (or lo1/hi1) for a 64-bit `result`, leaving out dead halves.
+        std::string storeHiLo(const Instruction &inst, bool pipeline1) const;
+
+        std::string plainBranchCondition(const Instruction &branchInst) const;
+        // "PS2_IDLE_LOOP(..., true);" for an idle loop written as for (;;), whose
+        // always-taken latch has no condition to wrap; else empty.
+        std::string idleLoopHook(const Instruction &branchInst) const;
 
         std::string translateInstruction(const Instruction &inst);
         std::string translateMMIInstruction(const Instruction &inst);
@@ -118,8 +164,9 @@ namespace ps2recomp
         std::string translateVU_VMINI(const Instruction &inst);
 
         // Jump Table Generation
-        std::string generateJumpTableSwitch(const Instruction &inst, uint32_t tableAddress,
-                                            const std::vector<JumpTableEntry> &entries);
+        const JumpTable *findJumpTable(const Instruction &inst) const;
+        std::string generateJumpTableSwitch(const Instruction &inst, const JumpTable &table,
+                                            const std::unordered_set<uint32_t> &internalTargets);
         std::string generateBootstrapFunction() const;
 
         const Symbol *findSymbolByAddress(uint32_t address) const;
@@ -0,0 +1,115 @@
+#ifndef PS2RECOMP_CONTROL_FLOW_H
+#define PS2RECOMP_CONTROL_FLOW_H
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace ps2recomp
+{
+    struct Instruction;
+
+    // Likely branches only run their delay slot when taken.
+    bool isLikelyBranch(const Instruction &inst);
+    // beq $zero, $zero and friends: always taken, the delay slot always runs.
+    bool isUnconditionalBranch(const Instruction &inst);
+    // j, jal, jr and jalr, as opposed to the pc-relative branches.
+    bool isJumpOrCall(const Instruction &inst);
+
+    // Target of a pc-relative branch.
+    uint32_t branchTarget(const Instruction &inst);
+    // Target of j/jal: the 26-bit field within the 256MB segment of the delay slot.
+    uint32_t buildAbsoluteJumpTarget(uint32_t address, uint32_t target);
+
+    // What the generator emits for one instruction, or a branch and its delay slot.
+    struct CodeUnit
+    {
+        size_t first = 0;          // index into the instruction stream
+        bool hasDelaySlot = false; // instructions[first + 1] is emitted with it
+    };
+
+    // How an intra-function branch is written out.
+    enum class BranchRole
+    {
+        Goto,        // goto label_xxx
+        Break,       // branch to the follow of the innermost enclosing loop
+        LoopLatch,   // back edge closing a loop region
+        IfCondition, // forward branch opening an if region
+        ElseSkip     // jump over the else arm at the end of the then arm
+    };
+
+    struct ControlRegion
+    {
+        enum class Kind
+        {
+            Loop,   // [begin, end): header at begin, latch at end - 1
+            IfThen, // branch at begin skips [begin + 1, end)
+            IfElse  // branch at begin to split, then arm [begin + 1, split) ends jumping to end
+        };
+
+        Kind kind = Kind::IfThen;
+        size_t begin = 0;
+        size_t split = 0;
+        size_t end = 0; // one past the last unit; the follow
+    };
+
+    // Recovers loops and if/else regions from the branch structure of a function
+    // so the generator can write them as do/while, for(;;) and if/else blocks.
+    //
+    // Only single-entry regions that nest properly are structured: nothing
+    // outside a region may branch into its interior (a loop header may still be
+    // entered from anywhere). Everything else, irreducible flow included, keeps
+    // using labels and gotos.
+    //
+    // switchTargets maps the address of a jr written as a switch to the internal
+    // addresses its cases jump to. Those targets always keep a label, and count as
+    // entries when checking that a region has a single one.
+    class ControlFlowStructure
+    {
+    public:
+        ControlFlowStructure(const std::vector<Instruction> &instructions,
+                             const std::unordered_set<uint32_t> &internalTargets,
+                             const std::unordered_map<uint32_t, std::vector<uint32_t>> &switchTargets = {});
+
+        const std::vector<CodeUnit> &units() const { return m_units; }
+
+        // Ordered by begin, enclosing regions before the regions they contain.
+        const std::vector<ControlRegion> &regions() const { return m_regions; }
+
+        // Role of the branch at address; Goto for anything that is not a structured branch.
+        BranchRole role(uint32_t address) const;
+
+        // Whether a goto still targets address, so its label has to be emitted.
+        bool needsLabel(uint32_t address) const { return m_labels.contains(address); }
+
+    private:
+        struct Branch
+        {
+            size_t unit = 0;
+            uint32_t address = 0;
+            uint32_t targetAddress = 0;
+            size_t target = SIZE_MAX; // target unit, SIZE_MAX when not an internal unit
+            bool targetIsStart = false; // target is the unit's first instruction, not its delay slot
+            bool unconditional = false;
+            bool links = false;
+        };
+
+        bool enteredFromOutside(size_t from, size_t to, size_t lo, size_t hi) const;
+        bool fits(const ControlRegion &region) const;
+        void findLoops();
+        void findConditionals();
+        void assignRoles();
+
+        std::vector<CodeUnit> m_units;
+        std::vector<Branch> m_branches;
+        std::unordered_map<size_t, size_t> m_branchOfUnit;
+        std::vector<std::vector<size_t>> m_predecessors; // branching and switch units per target unit
+        std::vector<ControlRegion> m_regions;
+        std::unordered_map<uint32_t, BranchRole> m_roles;
+        std::unordered_set<uint32_t> m_labels;
+    };
+}
+
+#endif // PS2RECOMP_CONTROL_FLOW_H
@@ -0,0 +1,126 @@
+#ifndef PS2RECOMP_DECODED_IMAGE_H
+#define PS2RECOMP_DECODED_IMAGE_H
+
+#include "ps2recomp/instructions.h"
+#include "ps2recomp/types.h"
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace ps2recomp
+{
+    class ElfParser;
+    class R5900Decoder;
+
+    // A decoded instruction in 12 bytes instead of sizeof(Instruction): the raw word,
+    // the decoder's flags as bits, and the few fields it derives beyond the raw bit
+    // fields. The address is implied by the position in the stream and the register,
+    // immediate and target fields are extracted from raw when asked for.
+    struct PackedInstruction
+    {
+        enum Flag : uint32_t
+        {
+            IS_MMI = 1u << 0,
+            IS_VU = 1u << 1,
+            IS_BRANCH = 1u << 2,
+            IS_JUMP = 1u << 3,
+            IS_CALL = 1u << 4,
+            IS_RETURN = 1u << 5,
+            HAS_DELAY_SLOT = 1u << 6,
+            IS_MULTIMEDIA = 1u << 7,
+            IS_STORE = 1u << 8,
+            IS_LOAD = 1u << 9,
+            IS_VECTOR = 1u << 10,
+            USES_Q_REG = 1u << 11,
+            USES_P_REG = 1u << 12,
+            MODIFIES_MAC = 1u << 13,
+            MODIFIES_GPR = 1u << 14,
+            MODIFIES_FPR = 1u << 15,
+            MODIFIES_VFR = 1u << 16,
+            MODIFIES_VIR = 1u << 17,
+            MODIFIES_VIC = 1u << 18,
+            MODIFIES_MEMORY = 1u << 19,
+            MODIFIES_CONTROL = 1u << 20,
+        };
+
+        // Bits 21-24 hold vectorInfo.vectorField, 25-26 fsf and 27-28 ftf.
+        static constexpr uint32_t VECTOR_FIELD_SHIFT = 21;
+        static constexpr uint32_t FSF_SHIFT = 25;
+        static constexpr uint32_t FTF_SHIFT = 27;
+
+        uint32_t raw = 0;
+        uint32_t flags = 0;
+        uint8_t mmiType = 0;
+        uint8_t mmiFunction = 0;
+        uint8_t pmfhlVariation = 0;
+        uint8_t vuFunction = 0;
+
+        static PackedInstruction pack(const Instruction &inst);
+        Instruction unpack(uint32_t address) const;
+
+        bool has(uint32_t flag) const { return (flags & flag) != 0; }
+        uint32_t opcode() const { return OPCODE(raw); }
+        uint32_t rs() const { return RS(raw); }
+        uint32_t rt() const { return RT(raw); }
+        uint32_t rd() const { return RD(raw); }
+        uint32_t function() const { return FUNCTION(raw); }
+        uint32_t simmediate() const { return SIMMEDIATE(raw); }
+        uint32_t target() const { return TARGET(raw); }
+    };
+
+    // Non-owning [begin, end) run of packed instructions, the first one at address.
+    // Functions and the entry points found inside them are views into the same stream.
+    struct InstructionSpan
+    {
+        uint32_t address = 0;
+        std::span<const PackedInstruction> words;
+
+        size_t size() const { return words.size(); }
+        bool empty() const { return words.empty(); }
+        uint32_t addressOf(size_t index) const { return address + static_cast<uint32_t>(index * 4); }
+        Instruction operator[](size_t index) const { return words[index].unpack(addressOf(index)); }
+
+        // Tail starting at target; empty when target is not one of the span's words.
+        InstructionSpan from(uint32_t target) const;
+
+        // Full Instructions for the passes that want them, built on demand.
+        std::vector<Instruction> unpack() const;
+    };
+
+    // Every word of the ELF's executable sections, decoded once into one contiguous
+    // packed stream. The analyzer and the recompiler look functions up here instead of
+    // decoding the same code again for every pass. Read-only after construction, so it
+    // can be shared across threads.
+    class DecodedImage
+    {
+    public:
+        DecodedImage(const ElfParser &parser, const std::vector<Section> &sections, const R5900Decoder &decoder);
+
+        // Cached instructions from start towards end, cut short where the executable
+        // section ends; empty when start is not in one.
+        InstructionSpan range(uint32_t start, uint32_t end) const;
+
+        // Instruction at address, from the cache or decoded from the ELF for words
+        // outside executable sections. False when the address has no file-backed word.
+        bool decode(uint32_t address, Instruction &out) const;
+
+        size_t instructionCount() const { return m_words.size(); }
+
+    private:
+        struct Segment
+        {
+            uint32_t start = 0;
+            uint32_t end = 0;  // exclusive
+            size_t first = 0;  // index of the word at start in m_words
+        };
+
+        const Segment *findSegment(uint32_t address) const;
+
+        const ElfParser &m_parser;
+        const R5900Decoder &m_decoder;
+        std::vector<Segment> m_segments; // sorted by start, non-overlapping
+        std::vector<PackedInstruction> m_words;
+    };
+}
+
+#endif // PS2RECOMP_DECODED_IMAGE_H
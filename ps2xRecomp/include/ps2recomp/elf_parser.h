@@ -2,10 +2,14 @@
 #define PS2RECOMP_ELF_PARSER_H
 
 #include <elfio/elfio.hpp>
+#include <istream>
+#include <span>
 #include <string>
 #include <vector>
 #include <memory>
 
+class MappedFile;
+
 namespace ps2recomp
 {
         struct Relocation;
@@ -28,9 +32,14 @@ namespace ps2recomp
                 std::vector<Section> getSections();
                 std::vector<Relocation> getRelocations();
 
-                // Helper methods
+                // Helper methods. Addresses resolve against loadable (SHF_ALLOC) sections only.
                 bool isValidAddress(uint32_t address) const;
                 uint32_t readWord(uint32_t address) const;
+                // File-backed bytes from address up to size, cut short where the loadable data
+                // ends; empty when address has no data (unmapped or .bss).
+                std::span<const uint8_t> getBytes(uint32_t address, uint32_t size) const;
+                // Copies up to count words from address into out; returns how many were copied.
+                size_t readWords(uint32_t address, size_t count, uint32_t *out) const;
                 uint8_t *getSectionData(const std::string &sectionName) const;
                 uint32_t getSectionAddress(const std::string &sectionName) const;
                 uint32_t getSectionSize(const std::string &sectionName) const;
@@ -38,6 +47,10 @@ namespace ps2recomp
 
         private:
                 std::string m_filePath;
+                // The mapping and the stream over it outlive m_elf, which loads lazily from them.
+                std::shared_ptr<MappedFile> m_file;
+                std::unique_ptr<std::streambuf> m_buffer;
+                std::unique_ptr<std::istream> m_stream;
                 std::unique_ptr<ELFIO::elfio> m_elf;
 
                 std::vector<Section> m_sections;
@@ -45,7 +58,22 @@ namespace ps2recomp
                 std::vector<Relocation> m_relocations;
                 std::vector<Function> m_extraFunctions;
 
+                // Sorted, non-overlapping address ranges of the loadable sections. Adjacent
+                // ranges are merged, and the bytes of ranges with data are stored back to
+                // back in m_image so any read inside one range is a single memcpy.
+                struct AddressRange
+                {
+                        uint32_t start;
+                        uint32_t end; // exclusive
+                        bool hasData;
+                        size_t imageOffset;
+                };
+                std::vector<AddressRange> m_addressRanges;
+                std::vector<uint8_t> m_image;
+
                 void loadSections();
+                void buildAddressIndex(const std::vector<size_t> &loadable);
+                const AddressRange *findRange(uint32_t address) const;
                 void loadSymbols();
                 void loadRelocations();
                 void loadDebugFunctions();
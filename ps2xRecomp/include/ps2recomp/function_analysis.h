@@ -0,0 +1,123 @@
+#ifndef PS2RECOMP_FUNCTION_ANALYSIS_H
+#define PS2RECOMP_FUNCTION_ANALYSIS_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace ps2recomp
+{
+    struct Instruction;
+
+    // R5900Context state tracked next to the GPRs and FPRs.
+    enum MachineState : uint32_t
+    {
+        STATE_HI = 1u << 0,
+        STATE_LO = 1u << 1,
+        STATE_HI1 = 1u << 2,
+        STATE_LO1 = 1u << 3,
+        STATE_SA = 1u << 4,
+        STATE_FCC = 1u << 5,   // FCR31 condition bit (C)
+        STATE_FCR31 = 1u << 6, // rest of FCR31 (flags, rounding mode)
+        STATE_VU0_STATUS = 1u << 7,
+        STATE_VU0_MAC = 1u << 8,
+        STATE_VU0_CLIP = 1u << 9,
+        STATE_ALL = (1u << 10) - 1
+    };
+
+    struct RegisterSet
+    {
+        uint32_t gpr = 0;   // bit per GPR; $zero is never set
+        uint32_t fpr = 0;   // bit per FPR; f31 doubles as the accumulator in generated code
+        uint32_t state = 0; // MachineState bits
+
+        static RegisterSet all() { return {0xFFFFFFFEu, 0xFFFFFFFFu, STATE_ALL}; }
+
+        bool empty() const { return (gpr | fpr | state) == 0; }
+        bool intersects(const RegisterSet &other) const
+        {
+            return (gpr & other.gpr) | (fpr & other.fpr) | (state & other.state);
+        }
+        RegisterSet without(const RegisterSet &other) const
+        {
+            return {gpr & ~other.gpr, fpr & ~other.fpr, state & ~other.state};
+        }
+        RegisterSet &operator|=(const RegisterSet &other)
+        {
+            gpr |= other.gpr;
+            fpr |= other.fpr;
+            state |= other.state;
+            return *this;
+        }
+        RegisterSet operator|(const RegisterSet &other) const { return RegisterSet(*this) |= other; }
+        RegisterSet operator&(const RegisterSet &other) const
+        {
+            return {gpr & other.gpr, fpr & other.fpr, state & other.state};
+        }
+        bool operator==(const RegisterSet &other) const = default;
+    };
+
+    // "$8, f2, hi" style list for comments in generated code.
+    std::string describeRegisters(const RegisterSet &set);
+
+    struct RegisterEffects
+    {
+        RegisterSet uses;     // read by the emitted code
+        RegisterSet mayDefs;  // written on some path
+        RegisterSet mustDefs; // fully overwritten on every path
+        bool barrier = false; // leaves the function or calls into the runtime/another function
+    };
+
+    RegisterEffects getRegisterEffects(const Instruction &inst);
+
+    // Loads and stores the generator emits through the memory helpers, GPR, FPU and VU0 forms.
+    bool isMemoryAccess(const Instruction &inst);
+    bool isMemoryStore(const Instruction &inst);
+
+    struct InstructionFacts
+    {
+        uint32_t address = 0;
+        uint32_t raw = 0;
+        uint8_t dest = 0;         // GPR resultValue refers to
+        bool baseKnown = false;   // load/store base register is a known constant
+        uint32_t baseValue = 0;   // effective address when baseKnown
+        bool resultKnown = false; // dest receives a known 32-bit constant
+        uint32_t resultValue = 0;
+        bool deadWrite = false;   // every write is dead and the instruction has no other effect
+        RegisterSet deadDefs;     // written registers that are not read before being overwritten
+    };
+
+    // Per-function analysis over the decoded instructions, in the order the
+    // generator emits them (delay slots before non-likely branch conditions).
+    //
+    // Constants are block-local: a register is "known" only when the whole
+    // register equals a zero-extended 32-bit value, which is what SET_GPR_U32
+    // stores. State is dropped at branch targets and calls; $gp is assumed to
+    // keep its ELF value in functions that never write it.
+    //
+    // Liveness is a backward pass over the function's control flow. Everything is
+    // live at calls, indirect jumps, syscalls, branches out of the function and
+    // the end of the function.
+    class FunctionAnalysis
+    {
+    public:
+        FunctionAnalysis(const std::vector<Instruction> &instructions,
+                         const std::unordered_set<uint32_t> &internalTargets, uint32_t gp);
+
+        // Facts for inst, or nullptr when inst is not part of the analysed stream.
+        const InstructionFacts *find(const Instruction &inst) const;
+
+    private:
+        void propagateConstants(const std::vector<Instruction> &instructions,
+                                const std::unordered_set<uint32_t> &internalTargets, uint32_t gp);
+        void computeLiveness(const std::vector<Instruction> &instructions,
+                             const std::unordered_set<uint32_t> &internalTargets);
+        InstructionFacts *slot(const Instruction &inst);
+
+        uint32_t m_base = 0;
+        std::vector<InstructionFacts> m_facts;
+    };
+}
+
+#endif // PS2RECOMP_FUNCTION_ANALYSIS_H
@@ -0,0 +1,27 @@
+#ifndef PS2RECOMP_IDLE_LOOPS_H
+#define PS2RECOMP_IDLE_LOOPS_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace ps2recomp
+{
+    struct Instruction;
+
+    // Syscall wrappers a wait loop calls to poll a semaphore, event flag, thread
+    // or RPC without blocking.
+    bool isPollingCall(const std::string &name);
+
+    // Backward branches that close busy-wait loops in one function's instructions:
+    // at most a few instructions, no stores, no calls other than polling ones, and
+    // every exit condition computed only from loads, polling call results and
+    // registers the loop does not change. Spinning on a vblank flag, a DMA status
+    // register or PollSema looks like this; a loop that counts or walks memory does
+    // not. isPolling is asked about each jal target.
+    std::vector<uint32_t> findIdleLoops(const std::vector<Instruction> &instructions,
+                                        const std::function<bool(uint32_t)> &isPolling);
+}
+
+#endif // PS2RECOMP_IDLE_LOOPS_H
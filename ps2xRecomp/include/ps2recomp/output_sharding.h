@@ -0,0 +1,30 @@
+#ifndef PS2RECOMP_OUTPUT_SHARDING_H
+#define PS2RECOMP_OUTPUT_SHARDING_H
+
+#include <cstddef>
+#include <vector>
+
+namespace ps2recomp
+{
+    struct Function;
+
+    // Groups functions into at most shardCount translation units.
+    //
+    // Functions are ordered by a depth-first walk of the call graph (callers and
+    // callees from Function::callers/callees, roots in address order), then the
+    // order is cut into contiguous runs of roughly equal total weight. Call chains
+    // end up in the same TU and next to each other in the host binary, and the TUs
+    // compile in similar time.
+    //
+    // weights[i] is the cost of functions[i], normally its instruction count; a
+    // weight of 0 leaves the function out. Returns indices into functions, one
+    // vector per non-empty shard.
+    //
+    // With hotness (one value per function, e.g. profiled entry counts), each shard
+    // then lists its functions hottest first, keeping call-graph order among equals.
+    std::vector<std::vector<size_t>> shardFunctions(const std::vector<Function> &functions,
+                                                     const std::vector<size_t> &weights, size_t shardCount,
+                                                     const std::vector<double> &hotness = {});
+}
+
+#endif // PS2RECOMP_OUTPUT_SHARDING_H
@@ -0,0 +1,63 @@
+#ifndef PS2RECOMP_PARALLEL_H
+#define PS2RECOMP_PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ps2recomp
+{
+    // Calls body(i) for every i in [0, count) on up to hardware_concurrency threads.
+    // Indices are handed out one at a time, so uneven work balances itself; callers
+    // write results to slot i and merge them in index order to stay deterministic.
+    // The first exception thrown by body is rethrown once all workers have stopped.
+    template <typename Body>
+    void parallelFor(size_t count, Body &&body)
+    {
+        size_t workers = std::min<size_t>(count, std::max(1u, std::thread::hardware_concurrency()));
+        if (workers <= 1)
+        {
+            for (size_t i = 0; i < count; ++i)
+                body(i);
+            return;
+        }
+
+        std::atomic<size_t> next{0};
+        std::exception_ptr error;
+        std::mutex errorMutex;
+        auto run = [&]()
+        {
+            for (size_t i = next++; i < count; i = next++)
+            {
+                try
+                {
+                    body(i);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (!error)
+                        error = std::current_exception();
+                    next = count;
+                }
+            }
+        };
+
+        std::vector<std::thread> threads;
+        threads.reserve(workers - 1);
+        for (size_t i = 1; i < workers; ++i)
+            threads.emplace_back(run);
+        run();
+        for (auto &thread : threads)
+            thread.join();
+
+        if (error)
+            std::rethrow_exception(error);
+    }
+}
+
+#endif // PS2RECOMP_PARALLEL_H
@@ -0,0 +1,46 @@
+#ifndef PS2RECOMP_PROFILE_DATA_H
+#define PS2RECOMP_PROFILE_DATA_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+namespace ps2recomp
+{
+    // Counts from a run of an instrumented build, as written by the runtime's
+    // ps2_profile in the format of ps2_profile_format.h (ps2xCommon).
+    class ProfileData
+    {
+    public:
+        struct BranchCounts
+        {
+            uint64_t taken = 0;
+            uint64_t notTaken = 0;
+        };
+
+        bool load(const std::string &path);
+        bool save(const std::string &path) const;
+
+        bool empty() const { return m_entries.empty(); }
+
+        // Times the function starting at address was entered.
+        uint64_t entries(uint32_t address) const;
+        // A profile was loaded and the function never ran in it.
+        bool isCold(uint32_t address) const { return !empty() && entries(address) == 0; }
+
+        // nullptr when the branch at address was never evaluated.
+        const BranchCounts *branch(uint32_t address) const;
+
+        void addEntries(uint32_t address, uint64_t count) { m_entries[address] += count; }
+        void addBranch(uint32_t address, uint64_t taken, uint64_t notTaken);
+
+        size_t functionCount() const { return m_entries.size(); }
+        size_t branchCount() const { return m_branches.size(); }
+
+    private:
+        std::unordered_map<uint32_t, uint64_t> m_entries;
+        std::unordered_map<uint32_t, BranchCounts> m_branches;
+    };
+}
+
+#endif // PS2RECOMP_PROFILE_DATA_H
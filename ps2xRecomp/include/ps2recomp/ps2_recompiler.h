@@ -3,6 +3,9 @@
 
 #include "code_generator.h"
 #include "config_manager.h"
+#include "decoded_image.h"
+#include "profile_data.h"
+#include "stage_profiler.h"
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -24,10 +27,16 @@ namespace ps2recomp
         bool recompile();
         void generateOutput();
 
+        // Stage timings go to profiler while it is set; it is not owned.
+        void setProfiler(StageProfiler *profiler) { m_profiler = profiler; }
+        size_t functionCount() const { return m_functions.size(); }
+        size_t decodedInstructionCount() const;
+
     private:
         ConfigManager m_configManager;
         std::unique_ptr<ElfParser> m_elfParser;
         std::unique_ptr<R5900Decoder> m_decoder;
+        std::unique_ptr<DecodedImage> m_decodedImage;
         std::unique_ptr<CodeGenerator> m_codeGenerator;
         RecompilerConfig m_config;
 
@@ -36,19 +45,28 @@ namespace ps2recomp
         std::vector<Section> m_sections;
         std::vector<Relocation> m_relocations;
 
-        std::unordered_map<uint32_t, std::vector<Instruction>> m_decodedFunctions;
+        std::unordered_map<uint32_t, InstructionSpan> m_decodedFunctions;
+        std::vector<std::vector<PackedInstruction>> m_ownedCode; // patched code and code outside m_decodedImage
         std::unordered_map<std::string, bool> m_skipFunctions;
         std::unordered_set<std::string> m_stubFunctions;
         std::map<uint32_t, std::string> m_generatedStubs;
         std::unordered_map<uint32_t, std::string> m_functionRenames;
+        std::unordered_set<uint32_t> m_callsUnknown; // functions with a jalr or a jal outside m_functions
+        ProfileData m_profile;
         CodeGenerator::BootstrapInfo m_bootstrapInfo;
+        StageProfiler *m_profiler = nullptr;
 
         bool decodeFunction(Function &function);
         void discoverAdditionalEntryPoints();
+        void linkCallGraph();
+        void selectInlineFunctions();
+        // Profiled entry count, or the analyzer's static estimate without a profile.
+        double functionHotness(const Function &function) const;
         bool shouldSkipFunction(const std::string &name) const;
         bool isStubFunction(const std::string &name) const;
         bool generateFunctionHeader();
         bool generateStubHeader();
+        void generateShardedOutput();
         bool writeToFile(const std::string &path, const std::string &content);
         std::filesystem::path getOutputPath(const Function &function) const;
         std::string sanitizeFunctionName(const std::string &name) const;
@@ -15,6 +15,8 @@ namespace ps2recomp
         ~R5900Decoder();
 
         Instruction decodeInstruction(uint32_t address, uint32_t rawInstruction) const;
+        // decodeInstruction without the table fast path, for checking the tables.
+        Instruction decodeInstructionSlow(uint32_t address, uint32_t rawInstruction) const;
 
         bool isBranchInstruction(const Instruction &inst) const;
         bool isJumpInstruction(const Instruction &inst) const;
@@ -30,6 +32,13 @@ namespace ps2recomp
         uint32_t getJumpTarget(const Instruction &inst) const;
 
     private:
+        Instruction decode(uint32_t address, uint32_t rawInstruction, bool useTables) const;
+
+        // Table lookup for the common integer, load/store, branch, MMI and FPU encodings;
+        // false when the word needs the full rabbitizer decode.
+        bool decodeFast(Instruction &inst) const;
+        void decodeWithRabbitizer(Instruction &inst) const;
+
         void decodeRType(Instruction &inst) const;
         void decodeIType(Instruction &inst) const;
         void decodeJType(Instruction &inst) const;
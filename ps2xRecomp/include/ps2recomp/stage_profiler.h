@@ -0,0 +1,53 @@
+#ifndef PS2RECOMP_STAGE_PROFILER_H
+#define PS2RECOMP_STAGE_PROFILER_H
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace ps2recomp
+{
+    // Wall time and peak RSS per recompiler stage, for `ps2_recomp --bench`.
+    class StageProfiler
+    {
+    public:
+        struct Stage
+        {
+            std::string name;
+            double seconds = 0.0;
+            uint64_t calls = 0;
+            uint64_t peakRssBytes = 0; // process peak after the stage last ran
+        };
+
+        class Scope
+        {
+        public:
+            Scope(StageProfiler *profiler, const char *name);
+            ~Scope();
+
+            Scope(const Scope &) = delete;
+            Scope &operator=(const Scope &) = delete;
+
+        private:
+            StageProfiler *m_profiler;
+            const char *m_name;
+            std::chrono::steady_clock::time_point m_start;
+        };
+
+        // Adds to the stage with this name, creating it in first-seen order.
+        void record(const std::string &name, double seconds);
+
+        const std::vector<Stage> &stages() const { return m_stages; }
+        void report(std::ostream &out, uint64_t functionCount, uint64_t instructionCount) const;
+
+        static uint64_t peakRssBytes();
+        static uint64_t currentRssBytes();
+
+    private:
+        std::vector<Stage> m_stages;
+    };
+}
+
+#endif // PS2RECOMP_STAGE_PROFILER_H
@@ -0,0 +1,33 @@
+#ifndef PS2RECOMP_SYNTHETIC_ELF_H
+#define PS2RECOMP_SYNTHETIC_ELF_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ps2recomp
+{
+    struct SyntheticElfOptions
+    {
+        uint32_t functionCount = 1000;
+        uint32_t minInstructions = 16;
+        uint32_t maxInstructions = 256;
+        uint32_t seed = 42;
+        uint32_t textAddress = 0x00100000;
+    };
+
+    // Function bodies of random but valid R5900 code: ALU, loads/stores, LUI/ADDIU
+    // pairs, branches that stay inside the function, JALs to other function starts,
+    // MMI and COP1 ops. Delay slots never hold control flow and every function ends
+    // in `jr $ra; nop`. Returns the words of the whole .text section; starts and
+    // sizes (in bytes) of each function are written to the two vectors.
+    std::vector<uint32_t> generateSyntheticText(const SyntheticElfOptions &options,
+                                                std::vector<uint32_t> &functionStarts,
+                                                std::vector<uint32_t> &functionSizes);
+
+    // Writes a little endian MIPS ET_EXEC with one PT_LOAD for .text and a symbol
+    // table naming every function, so ElfParser sees it like a stripped-down game ELF.
+    bool writeSyntheticElf(const std::string &path, const SyntheticElfOptions &options);
+}
+
+#endif // PS2RECOMP_SYNTHETIC_ELF_H
@@ -136,6 +136,7 @@ namespace ps2recomp
     {
         uint32_t address;
         uint32_t baseRegister;
+        uint32_t jumpAddress = 0; // the jr that dispatches through the table
         std::vector<JumpTableEntry> entries;
     };
 
@@ -167,9 +168,20 @@ namespace ps2recomp
         std::string outputPath;
         std::string ghidraMapPath;
         bool singleFileOutput;
+        uint32_t outputShards = 0; // > 0 groups functions into this many TUs plus a PCH and CMakeLists.txt
+        uint32_t inlineMaxInstructions = 0; // inline leaf functions up to this size at jal sites, 0 disables
+        std::string profilePath; // ps2_profile of an instrumented run; overrides functionHotness
+        bool instrumentProfile = false; // emit the counters a run needs to write a profile
         std::vector<std::string> skipFunctions;
         std::unordered_map<uint32_t, std::string> patches;
         std::vector<std::string> stubImplementations;
+        std::unordered_map<uint32_t, double> functionHotness; // [call_graph] static estimates, by start address
+        std::vector<JumpTable> jumpTables; // [jump_tables] from the analyzer, emitted as switches
+        // [idle_loops] backward branches of busy-wait loops: found by the analyzer, added
+        // by hand, and excluded by hand. The loops get a PS2_IDLE_LOOP hook.
+        std::vector<uint32_t> idleLoops;
+        std::vector<uint32_t> idleLoopsForced;
+        std::vector<uint32_t> idleLoopsDisabled;
     };
 
 } // namespace ps2recomp
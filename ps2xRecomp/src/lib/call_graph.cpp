@@ -0,0 +1,224 @@
+#include "ps2recomp/call_graph.h"
+#include "ps2recomp/control_flow.h"
+#include "ps2recomp/instructions.h"
+#include "ps2recomp/types.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace ps2recomp
+{
+    namespace
+    {
+        constexpr double kLoopIterations = 8.0;
+        constexpr uint32_t kMaxLoopDepth = 4;
+        constexpr double kMaxFrequency = 1e15; // keeps deep call chains finite
+        constexpr uint32_t kUnvisited = std::numeric_limits<uint32_t>::max();
+    }
+
+    CallGraph::CallGraph(size_t nodeCount, const std::vector<Edge> &edges)
+        : m_offsets(nodeCount + 1, 0)
+    {
+        for (const Edge &edge : edges)
+            ++m_offsets[edge.caller + 1];
+        for (size_t i = 0; i < nodeCount; ++i)
+            m_offsets[i + 1] += m_offsets[i];
+
+        m_targets.resize(edges.size());
+        m_weights.resize(edges.size());
+        std::vector<uint32_t> next(m_offsets.begin(), m_offsets.end() - 1);
+        for (const Edge &edge : edges)
+        {
+            uint32_t slot = next[edge.caller]++;
+            m_targets[slot] = edge.callee;
+            m_weights[slot] = edge.weight;
+        }
+
+        findComponents();
+    }
+
+    std::span<const uint32_t> CallGraph::callees(uint32_t node) const
+    {
+        return std::span<const uint32_t>(m_targets).subspan(m_offsets[node], m_offsets[node + 1] - m_offsets[node]);
+    }
+
+    std::span<const double> CallGraph::calleeWeights(uint32_t node) const
+    {
+        return std::span<const double>(m_weights).subspan(m_offsets[node], m_offsets[node + 1] - m_offsets[node]);
+    }
+
+    void CallGraph::findComponents()
+    {
+        size_t count = nodeCount();
+        std::vector<uint32_t> index(count, kUnvisited);
+        std::vector<uint32_t> lowlink(count, 0);
+        std::vector<bool> onStack(count, false);
+        std::vector<uint32_t> stack;
+        m_component.assign(count, 0);
+
+        struct Frame
+        {
+            uint32_t node;
+            uint32_t edge; // next edge of node to follow
+        };
+        std::vector<Frame> frames;
+        uint32_t nextIndex = 0;
+
+        auto visit = [&](uint32_t node)
+        {
+            index[node] = lowlink[node] = nextIndex++;
+            stack.push_back(node);
+            onStack[node] = true;
+            frames.push_back({node, m_offsets[node]});
+        };
+
+        for (uint32_t root = 0; root < count; ++root)
+        {
+            if (index[root] != kUnvisited)
+                continue;
+
+            visit(root);
+            while (!frames.empty())
+            {
+                uint32_t node = frames.back().node;
+                uint32_t edge = frames.back().edge;
+                if (edge < m_offsets[node + 1])
+                {
+                    frames.back().edge++;
+                    uint32_t callee = m_targets[edge];
+                    if (index[callee] == kUnvisited)
+                        visit(callee);
+                    else if (onStack[callee])
+                        lowlink[node] = std::min(lowlink[node], index[callee]);
+                    continue;
+                }
+
+                if (lowlink[node] == index[node])
+                {
+                    uint32_t id = static_cast<uint32_t>(m_componentSize.size());
+                    uint32_t size = 0;
+                    uint32_t member;
+                    do
+                    {
+                        member = stack.back();
+                        stack.pop_back();
+                        onStack[member] = false;
+                        m_component[member] = id;
+                        ++size;
+                    } while (member != node);
+                    m_componentSize.push_back(size);
+                }
+
+                frames.pop_back();
+                if (!frames.empty())
+                {
+                    uint32_t caller = frames.back().node;
+                    lowlink[caller] = std::min(lowlink[caller], lowlink[node]);
+                }
+            }
+        }
+    }
+
+    bool CallGraph::isRecursive(uint32_t node) const
+    {
+        if (componentSize(node) > 1)
+            return true;
+
+        std::span<const uint32_t> targets = callees(node);
+        return std::find(targets.begin(), targets.end(), node) != targets.end();
+    }
+
+    std::vector<double> CallGraph::estimateHotness(const std::vector<double> &localWeights) const
+    {
+        size_t components = componentCount();
+        std::vector<std::vector<uint32_t>> members(components);
+        for (uint32_t node = 0; node < nodeCount(); ++node)
+            members[m_component[node]].push_back(node);
+
+        std::vector<double> incoming(components, 0.0);
+        std::vector<double> frequency(components, 0.0);
+        for (size_t c = components; c-- > 0;)
+        {
+            double internal = 0.0;
+            for (uint32_t node : members[c])
+            {
+                std::span<const uint32_t> targets = callees(node);
+                std::span<const double> weights = calleeWeights(node);
+                for (size_t e = 0; e < targets.size(); ++e)
+                {
+                    if (m_component[targets[e]] == c)
+                        internal += weights[e];
+                }
+            }
+
+            frequency[c] = std::min(kMaxFrequency, (1.0 + incoming[c]) * (1.0 + internal));
+
+            for (uint32_t node : members[c])
+            {
+                std::span<const uint32_t> targets = callees(node);
+                std::span<const double> weights = calleeWeights(node);
+                for (size_t e = 0; e < targets.size(); ++e)
+                {
+                    uint32_t callee = m_component[targets[e]];
+                    if (callee != c)
+                        incoming[callee] = std::min(kMaxFrequency, incoming[callee] + frequency[c] * weights[e]);
+                }
+            }
+        }
+
+        std::vector<double> hotness(nodeCount(), 0.0);
+        for (uint32_t node = 0; node < nodeCount(); ++node)
+        {
+            double local = node < localWeights.size() ? localWeights[node] : 1.0;
+            hotness[node] = frequency[m_component[node]] * local;
+        }
+        return hotness;
+    }
+
+    std::vector<uint32_t> loopDepths(const std::vector<Instruction> &instructions, uint32_t start, uint32_t end)
+    {
+        if (instructions.empty())
+            return {};
+
+        std::vector<int32_t> delta(instructions.size() + 1, 0);
+
+        uint32_t base = instructions.front().address;
+        for (size_t i = 0; i < instructions.size(); ++i)
+        {
+            const Instruction &inst = instructions[i];
+            uint32_t target = 0;
+            if (inst.isBranch)
+                target = branchTarget(inst);
+            else if (inst.opcode == OPCODE_J)
+                target = buildAbsoluteJumpTarget(inst.address, inst.target);
+            else
+                continue;
+
+            if (target < start || target >= end || target > inst.address || target < base)
+                continue;
+
+            size_t first = (target - base) / 4;
+            if (first > i)
+                continue;
+
+            // The delay slot runs with every iteration too.
+            size_t last = std::min(i + (inst.hasDelaySlot ? 1 : 0), instructions.size() - 1);
+            delta[first] += 1;
+            delta[last + 1] -= 1;
+        }
+
+        std::vector<uint32_t> depths(instructions.size());
+        int32_t depth = 0;
+        for (size_t i = 0; i < instructions.size(); ++i)
+        {
+            depth += delta[i];
+            depths[i] = static_cast<uint32_t>(std::max(depth, 0));
+        }
+        return depths;
+    }
+
+    double loopWeight(uint32_t depth)
+    {
+        return std::pow(kLoopIterations, static_cast<double>(std::min(depth, kMaxLoopDepth)));
+    }
+}
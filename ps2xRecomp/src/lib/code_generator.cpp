@@ -1,5 +1,8 @@
 #include "ps2recomp/code_generator.h"
+#include "ps2recomp/control_flow.h"
+#include "ps2recomp/function_analysis.h"
 #include "ps2recomp/instructions.h"
+#include "ps2recomp/profile_data.h"
 #include "ps2recomp/types.h"
 #include <fmt/format.h>
 #include <sstream>
@@ -8,6 +11,7 @@
 #include <unordered_map>
 #include <iostream>
 #include <cctype>
+#include <string_view>
 
 namespace ps2recomp
 {
@@ -28,10 +32,30 @@ namespace ps2recomp
 
 namespace ps2recomp
 {
-    static uint32_t buildAbsoluteJumpTarget(uint32_t address, uint32_t target)
-    {
-        return ((address + 4) & 0xF0000000u) | (target << 2);
-    }
+    // A branch gets a hint once it ran this often and went one way this much of the time.
+    static constexpr uint64_t kHintMinimumCount = 64;
+    static constexpr double kHintRatio = 0.9;
+
+    // Functions generated as thin wrappers around the runtime's syscall implementation.
+    static const std::unordered_set<std::string> kSystemCallWrappers = {
+        "FlushCache", "ResetEE", "SetMemoryMode",
+        "CreateThread", "DeleteThread", "StartThread", "ExitThread", "ExitDeleteThread",
+        "TerminateThread", "SuspendThread", "ResumeThread", "GetThreadId", "ReferThreadStatus",
+        "SleepThread", "WakeupThread", "iWakeupThread", "ChangeThreadPriority",
+        "RotateThreadReadyQueue", "ReleaseWaitThread", "iReleaseWaitThread",
+        "CreateSema", "DeleteSema", "SignalSema", "iSignalSema", "WaitSema", "PollSema",
+        "iPollSema", "ReferSemaStatus", "iReferSemaStatus", "CreateEventFlag",
+        "DeleteEventFlag", "SetEventFlag", "iSetEventFlag", "ClearEventFlag",
+        "iClearEventFlag", "WaitEventFlag", "PollEventFlag", "iPollEventFlag",
+        "ReferEventFlagStatus", "iReferEventFlagStatus", "SetAlarm", "iSetAlarm",
+        "CancelAlarm", "iCancelAlarm", "EnableIntc", "DisableIntc", "EnableDmac",
+        "DisableDmac", "SifStopModule", "SifLoadModule", "SifInitRpc", "SifBindRpc",
+        "SifCallRpc", "SifRegisterRpc", "SifCheckStatRpc", "SifSetRpcQueue",
+        "SifRemoveRpcQueue", "SifRemoveRpc", "fioOpen", "fioClose", "fioRead", "fioWrite",
+        "fioLseek", "fioMkdir", "fioChdir", "fioRmdir", "fioGetstat", "fioRemove",
+        "GsSetCrt", "GsGetIMR", "GsPutIMR", "GsSetVideoMode", "GetOsdConfigParam",
+        "SetOsdConfigParam", "GetRomName", "sceSifLoadModule",
+        "SifSetDChain"};
 
     static std::string sanitizeIdentifierBody(const std::string &name)
     {
@@ -97,6 +121,65 @@ namespace ps2recomp
         m_bootstrapInfo = info;
     }
 
+    void CodeGenerator::setInlineFunctions(const std::vector<Function> &functions)
+    {
+        m_inlineFunctions.clear();
+        for (const auto &function : functions)
+        {
+            if (canInline(function))
+                m_inlineFunctions.emplace(function.start, function);
+        }
+    }
+
+    void CodeGenerator::setJumpTables(const std::vector<JumpTable> &tables)
+    {
+        m_jumpTables.clear();
+        for (const auto &table : tables)
+        {
+            if (table.jumpAddress != 0)
+                m_jumpTables[table.jumpAddress] = table;
+        }
+    }
+
+    // A leaf that only leaves through a final "jr $ra" and only branches within itself.
+    bool CodeGenerator::canInline(const Function &function)
+    {
+        const std::vector<Instruction> &instructions = function.instructions;
+        if (instructions.size() < 2 || kSystemCallWrappers.contains(function.name))
+            return false;
+
+        const Instruction &ret = instructions[instructions.size() - 2];
+        if (ret.opcode != OPCODE_SPECIAL || ret.function != SPECIAL_JR || ret.rs != 31 || !ret.hasDelaySlot)
+            return false;
+
+        for (size_t i = 0; i + 2 < instructions.size(); ++i)
+        {
+            const Instruction &inst = instructions[i];
+            if (inst.opcode == OPCODE_J || inst.opcode == OPCODE_JAL || inst.opcode == OPCODE_COP0)
+                return false;
+            if (inst.opcode == OPCODE_SPECIAL &&
+                (inst.function == SPECIAL_JR || inst.function == SPECIAL_JALR ||
+                 inst.function == SPECIAL_SYSCALL || inst.function == SPECIAL_BREAK))
+                return false;
+            if (inst.opcode == OPCODE_REGIMM && (inst.rt == REGIMM_BLTZAL || inst.rt == REGIMM_BGEZAL ||
+                                                 inst.rt == REGIMM_BLTZALL || inst.rt == REGIMM_BGEZALL))
+                return false;
+            if (inst.isBranch)
+            {
+                uint32_t target = branchTarget(inst);
+                if (target < function.start || target >= function.end)
+                    return false;
+            }
+        }
+
+        return !instructions.back().isBranch && !instructions.back().isJump;
+    }
+
+    std::string CodeGenerator::labelName(uint32_t address) const
+    {
+        return fmt::format("label_{:x}{}", address, m_labelSuffix);
+    }
+
     std::string CodeGenerator::getFunctionName(uint32_t address) const
     {
         auto it = m_renamedFunctions.find(address);
@@ -156,15 +239,21 @@ namespace ps2recomp
             }
             uint32_t target = buildAbsoluteJumpTarget(branchInst.address, branchInst.target);
             std::string funcName = getFunctionName(target);
-            if (!funcName.empty())
+            auto inlineIt = branchInst.opcode == OPCODE_JAL && m_labelSuffix.empty() ? m_inlineFunctions.find(target)
+                                                                                      : m_inlineFunctions.end();
+            if (inlineIt != m_inlineFunctions.end())
+            {
+                ss << generateInlineBody(inlineIt->second);
+            }
+            else if (!funcName.empty())
             {
                 if (branchInst.opcode == OPCODE_J)
                 {
-                    ss << "    " << funcName << "(rdram, ctx, runtime); return;\n";
+                    ss << "    PS2_TAIL_CALL(" << funcName << ");\n";
                 }
                 else
                 {
-                    ss << "    " << funcName << "(rdram, ctx, runtime);\n";
+                    ss << "    PS2_CALL(" << funcName << ");\n";
                 }
             }
             else
@@ -186,100 +275,32 @@ namespace ps2recomp
             {
                 ss << "    " << delaySlotCode << "\n";
             }
-            ss << "    ctx->pc = GPR_U32(ctx, " << static_cast<int>(rs_reg) << "); return;\n";
+            const JumpTable *table = m_labelSuffix.empty() ? findJumpTable(branchInst) : nullptr;
+            if (!m_labelSuffix.empty() && link_reg == 0 && rs_reg == 31)
+            {
+                // canInline only accepts this as the last instruction: fall out of the inlined body.
+                ss << "    ; // return\n";
+            }
+            else if (table)
+            {
+                std::string sw = generateJumpTableSwitch(branchInst, *table, internalTargets);
+                std::stringstream lines(sw);
+                for (std::string text; std::getline(lines, text);)
+                    ss << "    " << text << "\n";
+            }
+            else
+            {
+                ss << "    ctx->pc = GPR_U32(ctx, " << static_cast<int>(rs_reg) << "); return;\n";
+            }
         }
         else if (branchInst.isBranch)
         {
-            std::string conditionStr = "false";
+            std::string conditionStr = branchCondition(branchInst);
             std::string linkCode;
-
-            switch (branchInst.opcode)
+            if (branchInst.opcode == OPCODE_REGIMM &&
+                (rt_reg == REGIMM_BLTZAL || rt_reg == REGIMM_BGEZAL || rt_reg == REGIMM_BLTZALL || rt_reg == REGIMM_BGEZALL))
             {
-            case OPCODE_BEQ:
-                conditionStr = fmt::format("GPR_U32(ctx, {}) == GPR_U32(ctx, {})", rs_reg, rt_reg);
-                break;
-            case OPCODE_BNE:
-                conditionStr = fmt::format("GPR_U32(ctx, {}) != GPR_U32(ctx, {})", rs_reg, rt_reg);
-                break;
-            case OPCODE_BLEZ:
-                conditionStr = fmt::format("GPR_S32(ctx, {}) <= 0", rs_reg);
-                break;
-            case OPCODE_BGTZ:
-                conditionStr = fmt::format("GPR_S32(ctx, {}) > 0", rs_reg);
-                break;
-            case OPCODE_BEQL:
-                conditionStr = fmt::format("GPR_U32(ctx, {}) == GPR_U32(ctx, {})", rs_reg, rt_reg);
-                break;
-            case OPCODE_BNEL:
-                conditionStr = fmt::format("GPR_U32(ctx, {}) != GPR_U32(ctx, {})", rs_reg, rt_reg);
-                break;
-            case OPCODE_BLEZL:
-                conditionStr = fmt::format("GPR_S32(ctx, {}) <= 0", rs_reg);
-                break;
-            case OPCODE_BGTZL:
-                conditionStr = fmt::format("GPR_S32(ctx, {}) > 0", rs_reg);
-                break;
-            case OPCODE_REGIMM:
-                switch (rt_reg)
-                {
-                case REGIMM_BLTZ:
-                    conditionStr = fmt::format("GPR_S32(ctx, {}) < 0", rs_reg);
-                    break;
-                case REGIMM_BGEZ:
-                    conditionStr = fmt::format("GPR_S32(ctx, {}) >= 0", rs_reg);
-                    break;
-                case REGIMM_BLTZL:
-                    conditionStr = fmt::format("GPR_S32(ctx, {}) < 0", rs_reg);
-                    break;
-                case REGIMM_BGEZL:
-                    conditionStr = fmt::format("GPR_S32(ctx, {}) >= 0", rs_reg);
-                    break;
-                case REGIMM_BLTZAL:
-                    conditionStr = fmt::format("GPR_S32(ctx, {}) < 0", rs_reg);
-                    linkCode = fmt::format("SET_GPR_U32(ctx, 31, 0x{:X});", branchInst.address + 8);
-                    break;
-                case REGIMM_BGEZAL:
-                    conditionStr = fmt::format("GPR_S32(ctx, {}) >= 0", rs_reg);
-                    linkCode = fmt::format("SET_GPR_U32(ctx, 31, 0x{:X});", branchInst.address + 8);
-                    break;
-                case REGIMM_BLTZALL:
-                    conditionStr = fmt::format("GPR_S32(ctx, {}) < 0", rs_reg);
-                    linkCode = fmt::format("SET_GPR_U32(ctx, 31, 0x{:X});", branchInst.address + 8);
-                    break;
-                case REGIMM_BGEZALL:
-                    conditionStr = fmt::format("GPR_S32(ctx, {}) >= 0", rs_reg);
-                    linkCode = fmt::format("SET_GPR_U32(ctx, 31, 0x{:X});", branchInst.address + 8);
-                    break;
-                }
-                break;
-            case OPCODE_COP1:
-                if (branchInst.rs == COP1_BC)
-                {
-                    uint8_t bc_cond = branchInst.rt;
-                    if (bc_cond == COP1_BC_BCF || bc_cond == COP1_BC_BCFL)
-                    {
-                        conditionStr = "!(ctx->fcr31 & 0x800000)";
-                    }
-                    else
-                    {
-                        conditionStr = "(ctx->fcr31 & 0x800000)";
-                    }
-                }
-                break;
-            case OPCODE_COP2:
-                if (branchInst.rs == COP2_BC)
-                {
-                    uint8_t bc_cond = branchInst.rt;
-                    if (bc_cond == COP2_BC_BCF || bc_cond == COP2_BC_BCFL)
-                    {
-                        conditionStr = "!(ctx->vu0_status & 0x1)";
-                    }
-                    else
-                    {
-                        conditionStr = "(ctx->vu0_status & 0x1)";
-                    }
-                }
-                break;
+                linkCode = fmt::format("SET_GPR_U32(ctx, 31, 0x{:X});", branchInst.address + 8);
             }
 
             int32_t offset = branchInst.simmediate << 2;
@@ -289,24 +310,24 @@ namespace ps2recomp
             std::string funcName = getFunctionName(target);
             bool isInternalTarget = internalTargets.contains(target);
 
-            if (isInternalTarget)
+            if (isInternalTarget && m_structure && m_structure->role(branchInst.address) == BranchRole::Break)
+            {
+                targetAction = "break;";
+            }
+            else if (isInternalTarget)
             {
-                targetAction = fmt::format("goto label_{:x};", target);
+                targetAction = fmt::format("goto {};", labelName(target));
             }
             else if (!funcName.empty())
             {
-                targetAction = fmt::format("{}(rdram, ctx, runtime); return;", funcName);
+                targetAction = fmt::format("PS2_TAIL_CALL({});", funcName);
             }
             else
             {
                 targetAction = fmt::format("ctx->pc = 0x{:X}; return;", target);
             }
 
-            bool isLikely = (branchInst.opcode == OPCODE_BEQL || branchInst.opcode == OPCODE_BNEL ||
-                             branchInst.opcode == OPCODE_BLEZL || branchInst.opcode == OPCODE_BGTZL ||
-                             (branchInst.opcode == OPCODE_REGIMM && (branchInst.rt == REGIMM_BLTZL || branchInst.rt == REGIMM_BGEZL || branchInst.rt == REGIMM_BLTZALL || branchInst.rt == REGIMM_BGEZALL)) ||
-                             (branchInst.opcode == OPCODE_COP1 && branchInst.rs == COP1_BC && (branchInst.rt == COP1_BC_BCFL || branchInst.rt == COP1_BC_BCTL)) ||
-                             (branchInst.opcode == OPCODE_COP2 && branchInst.rs == COP2_BC && (branchInst.rt == COP2_BC_BCFL || branchInst.rt == COP2_BC_BCTL)));
+            bool isLikely = isLikelyBranch(branchInst);
 
             if (!linkCode.empty())
             {
@@ -315,7 +336,7 @@ namespace ps2recomp
 
             if (isLikely)
             {
-                ss << "    if (" << conditionStr << ") {\n";
+                ss << "    if (" << conditionStr << ")" << branchHint(branchInst, true) << " {\n";
                 if (hasValidDelaySlot)
                 {
                     ss << "        " << delaySlotCode << "\n";
@@ -329,7 +350,7 @@ namespace ps2recomp
                 {
                     ss << "    " << delaySlotCode << "\n";
                 }
-                ss << "    if (" << conditionStr << ") {\n";
+                ss << "    if (" << conditionStr << ")" << branchHint(branchInst, true) << " {\n";
                 ss << "        " << targetAction << "\n";
                 ss << "    }\n";
             }
@@ -345,6 +366,98 @@ namespace ps2recomp
         return ss.str();
     }
 
+    std::string CodeGenerator::branchCondition(const Instruction &branchInst) const
+    {
+        std::string condition = plainBranchCondition(branchInst);
+        if (m_instrumentProfile && !isUnconditionalBranch(branchInst))
+            condition = fmt::format("PS2_PROFILE_BRANCH(0x{:x}, {})", branchInst.address, condition);
+        if (m_idleLoops.contains(branchInst.address))
+            condition = fmt::format("PS2_IDLE_LOOP(0x{:x}, {})", branchInst.address, condition);
+        return condition;
+    }
+
+    std::string CodeGenerator::branchHint(const Instruction &branchInst, bool whenTaken) const
+    {
+        const ProfileData::BranchCounts *counts = m_profile ? m_profile->branch(branchInst.address) : nullptr;
+        if (!counts || counts->taken + counts->notTaken < kHintMinimumCount)
+            return "";
+
+        double taken = static_cast<double>(counts->taken) / static_cast<double>(counts->taken + counts->notTaken);
+        double ratio = whenTaken ? taken : 1.0 - taken;
+        if (ratio >= kHintRatio)
+            return " [[likely]]";
+        if (ratio <= 1.0 - kHintRatio)
+            return " [[unlikely]]";
+        return "";
+    }
+
+    std::string CodeGenerator::idleLoopHook(const Instruction &branchInst) const
+    {
+        if (!m_idleLoops.contains(branchInst.address))
+            return "";
+        return fmt::format("PS2_IDLE_LOOP(0x{:x}, true);", branchInst.address);
+    }
+
+    std::string CodeGenerator::plainBranchCondition(const Instruction &branchInst) const
+    {
+        uint8_t rs_reg = branchInst.rs;
+        uint8_t rt_reg = branchInst.rt;
+
+        switch (branchInst.opcode)
+        {
+        case OPCODE_BEQ:
+        case OPCODE_BEQL:
+            return fmt::format("GPR_U32(ctx, {}) == GPR_U32(ctx, {})", rs_reg, rt_reg);
+        case OPCODE_BNE:
+        case OPCODE_BNEL:
+            return fmt::format("GPR_U32(ctx, {}) != GPR_U32(ctx, {})", rs_reg, rt_reg);
+        case OPCODE_BLEZ:
+        case OPCODE_BLEZL:
+            return fmt::format("GPR_S32(ctx, {}) <= 0", rs_reg);
+        case OPCODE_BGTZ:
+        case OPCODE_BGTZL:
+            return fmt::format("GPR_S32(ctx, {}) > 0", rs_reg);
+        case OPCODE_REGIMM:
+            switch (rt_reg)
+            {
+            case REGIMM_BLTZ:
+            case REGIMM_BLTZL:
+            case REGIMM_BLTZAL:
+            case REGIMM_BLTZALL:
+                return fmt::format("GPR_S32(ctx, {}) < 0", rs_reg);
+            case REGIMM_BGEZ:
+            case REGIMM_BGEZL:
+            case REGIMM_BGEZAL:
+            case REGIMM_BGEZALL:
+                return fmt::format("GPR_S32(ctx, {}) >= 0", rs_reg);
+            }
+            break;
+        case OPCODE_COP1:
+            if (branchInst.rs == COP1_BC)
+            {
+                uint8_t bc_cond = branchInst.rt;
+                if (bc_cond == COP1_BC_BCF || bc_cond == COP1_BC_BCFL)
+                {
+                    return "!(ctx->fcr31 & 0x800000)";
+                }
+                return "(ctx->fcr31 & 0x800000)";
+            }
+            break;
+        case OPCODE_COP2:
+            if (branchInst.rs == COP2_BC)
+            {
+                uint8_t bc_cond = branchInst.rt;
+                if (bc_cond == COP2_BC_BCF || bc_cond == COP2_BC_BCFL)
+                {
+                    return "!(ctx->vu0_status & 0x1)";
+                }
+                return "(ctx->vu0_status & 0x1)";
+            }
+            break;
+        }
+        return "false";
+    }
+
     CodeGenerator::~CodeGenerator() = default;
 
     std::unordered_set<uint32_t> CodeGenerator::collectInternalBranchTargets(
@@ -378,31 +491,240 @@ namespace ps2recomp
         return targets;
     }
 
+    namespace
+    {
+        // Writes a function body, turning the regions of a ControlFlowStructure
+        // into nested blocks. Units outside any region come out exactly as
+        // before: label, address comment, translated code.
+        class StructuredEmitter
+        {
+        public:
+            StructuredEmitter(CodeGenerator &generator, const Function &function,
+                              const std::vector<Instruction> &instructions,
+                              const std::unordered_set<uint32_t> &internalTargets,
+                              const ControlFlowStructure &structure, std::ostream &out)
+                : m_generator(generator), m_function(function), m_instructions(instructions),
+                  m_internalTargets(internalTargets), m_structure(structure), m_out(out)
+            {
+            }
+
+            void emit(int depth = 0)
+            {
+                emitRange(0, m_structure.units().size(), depth);
+            }
+
+            // Instruction being translated when emit() throws.
+            const Instruction *current() const { return m_current; }
+
+        private:
+            void emitRange(size_t begin, size_t end, int depth)
+            {
+                const std::vector<ControlRegion> &regions = m_structure.regions();
+                for (size_t unit = begin; unit < end;)
+                {
+                    // Regions are visited in the order they are sorted in.
+                    if (m_nextRegion < regions.size() && regions[m_nextRegion].begin == unit)
+                    {
+                        const ControlRegion &region = regions[m_nextRegion++];
+                        if (region.kind == ControlRegion::Kind::Loop)
+                            emitLoop(region, depth);
+                        else
+                            emitConditional(region, depth);
+                        unit = region.end;
+                    }
+                    else
+                    {
+                        emitUnit(unit++, depth);
+                    }
+                }
+            }
+
+            void emitUnit(size_t index, int depth)
+            {
+                const CodeUnit &unit = m_structure.units()[index];
+                const Instruction &inst = m_instructions[unit.first];
+                openUnit(index, depth, false);
+
+                if (unit.hasDelaySlot)
+                    write(depth, m_generator.handleBranchDelaySlots(inst, m_instructions[unit.first + 1],
+                                                                    m_function, m_internalTargets));
+                else
+                    line(depth, m_generator.translateInstruction(inst));
+            }
+
+            // A conditional latch becomes do { body; ds; } while (cond). Likely and
+            // unconditional latches use for (;;), checking cond before the delay slot.
+            void emitLoop(const ControlRegion &region, int depth)
+            {
+                size_t latch = region.end - 1;
+                const Instruction &branch = m_instructions[m_structure.units()[latch].first];
+                bool likely = isLikelyBranch(branch);
+                bool unconditional = isUnconditionalBranch(branch);
+
+                line(depth, likely || unconditional ? "for (;;) {" : "do {");
+                emitRange(region.begin, latch, depth + 1);
+
+                openUnit(latch, depth + 1, true);
+                m_current = &branch;
+                if (unconditional)
+                {
+                    std::string hook = m_generator.idleLoopHook(branch);
+                    if (!hook.empty())
+                        line(depth + 1, hook);
+                }
+                std::string condition = m_generator.branchCondition(branch);
+                if (likely)
+                    line(depth + 1, fmt::format("if (!({})){} break;", condition, m_generator.branchHint(branch, false)));
+                emitDelaySlot(latch, depth + 1);
+
+                if (likely || unconditional)
+                    line(depth, "}");
+                else
+                    line(depth, fmt::format("}} while ({});", condition));
+            }
+
+            // Forward branch over the then arm; the arm of an if/else ends with "b follow".
+            // A likely branch only runs its delay slot when taken, so it goes in the else arm.
+            void emitConditional(const ControlRegion &region, int depth)
+            {
+                bool hasElse = region.kind == ControlRegion::Kind::IfElse;
+                const Instruction &branch = m_instructions[m_structure.units()[region.begin].first];
+                bool likely = isLikelyBranch(branch);
+
+                openUnit(region.begin, depth, false);
+                m_current = &branch;
+                std::string condition = m_generator.branchCondition(branch);
+                if (!likely)
+                    emitDelaySlot(region.begin, depth);
+
+                line(depth, fmt::format("if (!({})){} {{", condition, m_generator.branchHint(branch, false)));
+                emitRange(region.begin + 1, hasElse ? region.split - 1 : region.end, depth + 1);
+                if (hasElse)
+                {
+                    openUnit(region.split - 1, depth + 1, true);
+                    emitDelaySlot(region.split - 1, depth + 1);
+                }
+
+                bool takenCode = likely && hasDelaySlotCode(region.begin);
+                if (hasElse || takenCode)
+                {
+                    line(depth, "} else {");
+                    if (likely)
+                        emitDelaySlot(region.begin, depth + 1);
+                    if (hasElse)
+                        emitRange(region.split, region.end, depth + 1);
+                }
+                line(depth, "}");
+            }
+
+            // Labels still targeted by a goto, and the address comment. beforeClose
+            // adds an empty statement so a label may end a block.
+            void openUnit(size_t index, int depth, bool beforeClose)
+            {
+                const CodeUnit &unit = m_structure.units()[index];
+                const Instruction &inst = m_instructions[unit.first];
+                m_current = &inst;
+
+                label(inst.address, beforeClose);
+                line(depth, fmt::format("// 0x{:x}: 0x{:x}", inst.address, inst.raw));
+                if (unit.hasDelaySlot)
+                    label(m_instructions[unit.first + 1].address, beforeClose);
+            }
+
+            bool hasDelaySlotCode(size_t index) const
+            {
+                const CodeUnit &unit = m_structure.units()[index];
+                return unit.hasDelaySlot && m_instructions[unit.first + 1].raw != 0;
+            }
+
+            void emitDelaySlot(size_t index, int depth)
+            {
+                if (hasDelaySlotCode(index))
+                    line(depth, m_generator.translateInstruction(m_instructions[m_structure.units()[index].first + 1]));
+            }
+
+            void label(uint32_t address, bool beforeClose)
+            {
+                if (m_structure.needsLabel(address))
+                    m_out << m_generator.labelName(address) << (beforeClose ? ":;\n" : ":\n");
+            }
+
+            void line(int depth, const std::string &text)
+            {
+                m_out << std::string(4 * (depth + 1), ' ') << text << "\n";
+            }
+
+            // Re-indents code that is already indented for the function body.
+            void write(int depth, const std::string &code)
+            {
+                std::string indent(4 * depth, ' ');
+                size_t pos = 0;
+                while (pos < code.size())
+                {
+                    size_t next = code.find('\n', pos);
+                    next = next == std::string::npos ? code.size() : next + 1;
+                    m_out << indent << std::string_view(code).substr(pos, next - pos);
+                    pos = next;
+                }
+            }
+
+            CodeGenerator &m_generator;
+            const Function &m_function;
+            const std::vector<Instruction> &m_instructions;
+            const std::unordered_set<uint32_t> &m_internalTargets;
+            const ControlFlowStructure &m_structure;
+            std::ostream &m_out;
+            const Instruction *m_current = nullptr;
+            size_t m_nextRegion = 0;
+        };
+    }
+
+    // Expands a leaf at its jal site, after the link and the delay slot. The
+    // callee gets its own analysis and structure; its labels get a per-copy suffix.
+    std::string CodeGenerator::generateInlineBody(const Function &callee)
+    {
+        const FunctionAnalysis *callerAnalysis = m_analysis;
+        const ControlFlowStructure *callerStructure = m_structure;
+
+        std::unordered_set<uint32_t> internalTargets = collectInternalBranchTargets(callee, callee.instructions);
+        FunctionAnalysis analysis(callee.instructions, internalTargets, m_bootstrapInfo.valid ? m_bootstrapInfo.gp : 0);
+        ControlFlowStructure structure(callee.instructions, internalTargets);
+
+        std::stringstream ss;
+        ss << "    // inlined " << getFunctionName(callee.start) << "\n";
+        ss << "    {\n";
+        if (m_instrumentProfile)
+            ss << "        PS2_PROFILE_ENTER(0x" << std::hex << callee.start << std::dec << ");\n";
+
+        m_analysis = &analysis;
+        m_structure = &structure;
+        m_labelSuffix = fmt::format("_i{}", ++m_inlineCount);
+        try
+        {
+            StructuredEmitter emitter(*this, callee, callee.instructions, internalTargets, structure, ss);
+            emitter.emit(1);
+        }
+        catch (...)
+        {
+            m_analysis = callerAnalysis;
+            m_structure = callerStructure;
+            m_labelSuffix.clear();
+            throw;
+        }
+        m_analysis = callerAnalysis;
+        m_structure = callerStructure;
+        m_labelSuffix.clear();
+
+        ss << "    }\n";
+        return ss.str();
+    }
+
     std::string CodeGenerator::generateFunction(const Function &function, const std::vector<Instruction> &instructions, const bool &useHeaders)
     {
         std::stringstream ss;
 
-        static const std::unordered_set<std::string> systemCallNames = {
-            "FlushCache", "ResetEE", "SetMemoryMode",
-            "CreateThread", "DeleteThread", "StartThread", "ExitThread", "ExitDeleteThread",
-            "TerminateThread", "SuspendThread", "ResumeThread", "GetThreadId", "ReferThreadStatus",
-            "SleepThread", "WakeupThread", "iWakeupThread", "ChangeThreadPriority",
-            "RotateThreadReadyQueue", "ReleaseWaitThread", "iReleaseWaitThread",
-            "CreateSema", "DeleteSema", "SignalSema", "iSignalSema", "WaitSema", "PollSema",
-            "iPollSema", "ReferSemaStatus", "iReferSemaStatus", "CreateEventFlag",
-            "DeleteEventFlag", "SetEventFlag", "iSetEventFlag", "ClearEventFlag",
-            "iClearEventFlag", "WaitEventFlag", "PollEventFlag", "iPollEventFlag",
-            "ReferEventFlagStatus", "iReferEventFlagStatus", "SetAlarm", "iSetAlarm",
-            "CancelAlarm", "iCancelAlarm", "EnableIntc", "DisableIntc", "EnableDmac",
-            "DisableDmac", "SifStopModule", "SifLoadModule", "SifInitRpc", "SifBindRpc",
-            "SifCallRpc", "SifRegisterRpc", "SifCheckStatRpc", "SifSetRpcQueue",
-            "SifRemoveRpcQueue", "SifRemoveRpc", "fioOpen", "fioClose", "fioRead", "fioWrite",
-            "fioLseek", "fioMkdir", "fioChdir", "fioRmdir", "fioGetstat", "fioRemove",
-            "GsSetCrt", "GsGetIMR", "GsPutIMR", "GsSetVideoMode", "GetOsdConfigParam",
-            "SetOsdConfigParam", "GetRomName", "sceSifLoadModule",
-            "SifSetDChain"};
-
-        if (systemCallNames.contains(function.name))
+
+        if (kSystemCallWrappers.contains(function.name))
         {
             std::string sanitizedName = sanitizeFunctionName(function.name);
             ss << "// System call wrapper for " << function.name << "\n";
@@ -422,6 +744,27 @@ namespace ps2recomp
 
         std::unordered_set<uint32_t> internalTargets = collectInternalBranchTargets(function, instructions);
 
+        // Jump table cases that stay in the function become labels the switch jumps to.
+        std::unordered_map<uint32_t, std::vector<uint32_t>> switchTargets;
+        for (const auto &inst : instructions)
+        {
+            const JumpTable *table = findJumpTable(inst);
+            if (!table)
+                continue;
+
+            for (const auto &entry : table->entries)
+            {
+                if (entry.target >= function.start && entry.target < function.end)
+                {
+                    internalTargets.insert(entry.target);
+                    switchTargets[inst.address].push_back(entry.target);
+                }
+            }
+        }
+
+        FunctionAnalysis analysis(instructions, internalTargets, m_bootstrapInfo.valid ? m_bootstrapInfo.gp : 0);
+        m_analysis = &analysis;
+
         ss << "// Function: " << function.name << "\n";
         ss << "// Address: 0x" << std::hex << function.start << " - 0x" << function.end << std::dec << "\n";
         std::string sanitizedName = getFunctionName(function.start);
@@ -431,60 +774,80 @@ namespace ps2recomp
             nameBuilder << "Errorfunc_" << std::hex << function.start; // this should never happen but lets put here just to track
             sanitizedName = nameBuilder.str();
         }
+        if (m_profile && m_profile->isCold(function.start))
+            ss << "[[gnu::cold]] ";
         ss << "void " << sanitizedName << "(uint8_t* rdram, R5900Context* ctx, PS2Runtime *runtime) {\n\n";
+        if (m_instrumentProfile)
+            ss << "    PS2_PROFILE_ENTER(0x" << std::hex << function.start << std::dec << ");\n";
 
-        for (size_t i = 0; i < instructions.size(); ++i)
-        {
-            const Instruction &inst = instructions[i];
+        ControlFlowStructure structure(instructions, internalTargets, switchTargets);
+        m_structure = &structure;
+        m_inlineCount = 0;
 
-            if (internalTargets.contains(inst.address))
-            {
-                ss << "label_" << std::hex << inst.address << std::dec << ":\n";
-            }
-
-            ss << "    // 0x" << std::hex << inst.address << ": 0x" << inst.raw << std::dec << "\n";
-
-            try
-            {
-                if (inst.hasDelaySlot && i + 1 < instructions.size())
-                {
-                    const Instruction &delaySlot = instructions[i + 1];
+        StructuredEmitter emitter(*this, function, instructions, internalTargets, structure, ss);
+        try
+        {
+            emitter.emit();
+        }
+        catch (const std::exception &e)
+        {
+            const Instruction &inst = *emitter.current();
+            std::cerr << "Error in CodeGenerator::generateFunction while translating instruction\n"
+                      << "  Function: " << function.name << "\n"
+                      << "  Start: 0x" << std::hex << function.start << "\n"
+                      << "  Instruction address: 0x" << inst.address << "\n"
+                      << "  Raw: 0x" << inst.raw << "\n"
+                      << "  What: " << e.what() << std::endl;
+
+            m_analysis = nullptr;
+            m_structure = nullptr;
+            throw;
+        }
 
-                    if (internalTargets.contains(delaySlot.address))
-                    {
-                        ss << "label_" << std::hex << delaySlot.address << std::dec << ":\n";
-                    }
+        m_analysis = nullptr;
+        m_structure = nullptr;
+        ss << "    PS2_FELL_OFF_END();\n";
+        ss << "}\n";
 
-                    ss << handleBranchDelaySlots(inst, delaySlot, function, internalTargets);
+        return ss.str();
+    }
 
-                    // Skip the delay slot instruction as we've already handled it
-                    ++i;
-                }
-                else
-                {
-                    ss << "    " << translateInstruction(inst) << "\n";
-                }
-            }
-            catch (const std::exception &e)
-            {
-                std::cerr << "Error in CodeGenerator::generateFunction while translating instruction\n"
-                          << "  Function: " << function.name << "\n"
-                          << "  Start: 0x" << std::hex << function.start << "\n"
-                          << "  Instruction address: 0x" << inst.address << "\n"
-                          << "  Raw: 0x" << inst.raw << "\n"
-                          << "  What: " << e.what() << std::endl;
-
-                throw;
-            }
+    std::string CodeGenerator::effectiveAddress(const Instruction &inst) const
+    {
+        const InstructionFacts *facts = m_analysis ? m_analysis->find(inst) : nullptr;
+        if (facts && facts->baseKnown)
+        {
+            return fmt::format("0x{:X}", facts->baseValue);
         }
+        return fmt::format("ADD32(GPR_U32(ctx, {}), {})", inst.rs, inst.simmediate);
+    }
 
-        ss << "}\n";
+    std::string CodeGenerator::storeHiLo(const Instruction &inst, bool pipeline1) const
+    {
+        const InstructionFacts *facts = m_analysis ? m_analysis->find(inst) : nullptr;
+        uint32_t dead = facts ? facts->deadDefs.state : 0;
+        bool keepLo = !(dead & (pipeline1 ? STATE_LO1 : STATE_LO));
+        bool keepHi = !(dead & (pipeline1 ? STATE_HI1 : STATE_HI));
+        const char *suffix = pipeline1 ? "1" : "";
 
-        return ss.str();
+        std::string out;
+        if (keepLo)
+            out += fmt::format("ctx->lo{} = (uint32_t)result;", suffix);
+        if (keepHi)
+            out += fmt::format("{}ctx->hi{} = (uint32_t)(result >> 32);", keepLo ? " " : "", suffix);
+        return out;
     }
 
     std::string CodeGenerator::translateInstruction(const Instruction &inst)
     {
+        if (const InstructionFacts *facts = m_analysis ? m_analysis->find(inst) : nullptr)
+        {
+            if (facts->deadWrite)
+                return fmt::format("// dead write to {} removed", describeRegisters(facts->deadDefs));
+            if (facts->resultKnown)
+                return fmt::format("SET_GPR_U32(ctx, {}, 0x{:X});", facts->dest, facts->resultValue);
+        }
+
         if (inst.isMMI)
         {
             return translateMMIInstruction(inst);
@@ -531,39 +894,39 @@ namespace ps2recomp
         case OPCODE_LUI:
             return fmt::format("SET_GPR_U32(ctx, {}, ((uint32_t){} << 16));", inst.rt, inst.immediate);
         case OPCODE_LB:
-            return fmt::format("SET_GPR_S32(ctx, {}, (int8_t)READ8(ADD32(GPR_U32(ctx, {}), {})));", inst.rt, inst.rs, inst.simmediate);
+            return fmt::format("SET_GPR_S32(ctx, {}, (int8_t)READ8({}));", inst.rt, effectiveAddress(inst));
         case OPCODE_LH:
-            return fmt::format("SET_GPR_S32(ctx, {}, (int16_t)READ16(ADD32(GPR_U32(ctx, {}), {})));", inst.rt, inst.rs, inst.simmediate);
+            return fmt::format("SET_GPR_S32(ctx, {}, (int16_t)READ16({}));", inst.rt, effectiveAddress(inst));
         case OPCODE_LW:
-            return fmt::format("SET_GPR_U32(ctx, {}, READ32(ADD32(GPR_U32(ctx, {}), {})));", inst.rt, inst.rs, inst.simmediate);
+            return fmt::format("SET_GPR_U32(ctx, {}, READ32({}));", inst.rt, effectiveAddress(inst));
         case OPCODE_LBU:
-            return fmt::format("SET_GPR_U32(ctx, {}, (uint8_t)READ8(ADD32(GPR_U32(ctx, {}), {})));", inst.rt, inst.rs, inst.simmediate);
+            return fmt::format("SET_GPR_U32(ctx, {}, (uint8_t)READ8({}));", inst.rt, effectiveAddress(inst));
         case OPCODE_LHU:
-            return fmt::format("SET_GPR_U32(ctx, {}, (uint16_t)READ16(ADD32(GPR_U32(ctx, {}), {})));", inst.rt, inst.rs, inst.simmediate);
+            return fmt::format("SET_GPR_U32(ctx, {}, (uint16_t)READ16({}));", inst.rt, effectiveAddress(inst));
         case OPCODE_LWU:
-            return fmt::format("SET_GPR_U32(ctx, {}, READ32(ADD32(GPR_U32(ctx, {}), {})));", inst.rt, inst.rs, inst.simmediate);
+            return fmt::format("SET_GPR_U32(ctx, {}, READ32({}));", inst.rt, effectiveAddress(inst));
         case OPCODE_SB:
-            return fmt::format("WRITE8(ADD32(GPR_U32(ctx, {}), {}), (uint8_t)GPR_U32(ctx, {}));", inst.rs, inst.simmediate, inst.rt);
+            return fmt::format("WRITE8({}, (uint8_t)GPR_U32(ctx, {}));", effectiveAddress(inst), inst.rt);
         case OPCODE_SH:
-            return fmt::format("WRITE16(ADD32(GPR_U32(ctx, {}), {}), (uint16_t)GPR_U32(ctx, {}));", inst.rs, inst.simmediate, inst.rt);
+            return fmt::format("WRITE16({}, (uint16_t)GPR_U32(ctx, {}));", effectiveAddress(inst), inst.rt);
         case OPCODE_SW:
-            return fmt::format("WRITE32(ADD32(GPR_U32(ctx, {}), {}), GPR_U32(ctx, {}));", inst.rs, inst.simmediate, inst.rt);
+            return fmt::format("WRITE32({}, GPR_U32(ctx, {}));", effectiveAddress(inst), inst.rt);
         case OPCODE_LQ:
-            return fmt::format("SET_GPR_VEC(ctx, {}, READ128(ADD32(GPR_U32(ctx, {}), {})));", inst.rt, inst.rs, inst.simmediate);
+            return fmt::format("SET_GPR_VEC(ctx, {}, READ128({}));", inst.rt, effectiveAddress(inst));
         case OPCODE_SQ:
-            return fmt::format("WRITE128(ADD32(GPR_U32(ctx, {}), {}), GPR_VEC(ctx, {}));", inst.rs, inst.simmediate, inst.rt);
+            return fmt::format("WRITE128({}, GPR_VEC(ctx, {}));", effectiveAddress(inst), inst.rt);
         case OPCODE_LD:
-            return fmt::format("SET_GPR_U64(ctx, {}, READ64(ADD32(GPR_U32(ctx, {}), {})));", inst.rt, inst.rs, inst.simmediate);
+            return fmt::format("SET_GPR_U64(ctx, {}, READ64({}));", inst.rt, effectiveAddress(inst));
         case OPCODE_SD:
-            return fmt::format("WRITE64(ADD32(GPR_U32(ctx, {}), {}), GPR_U64(ctx, {}));", inst.rs, inst.simmediate, inst.rt);
+            return fmt::format("WRITE64({}, GPR_U64(ctx, {}));", effectiveAddress(inst), inst.rt);
         case OPCODE_LWC1:
-            return fmt::format("{{ uint32_t val = READ32(ADD32(GPR_U32(ctx, {}), {})); ctx->f[{}] = *(float*)&val; }}", inst.rs, inst.simmediate, inst.rt);
+            return fmt::format("{{ uint32_t val = READ32({}); ctx->f[{}] = *(float*)&val; }}", effectiveAddress(inst), inst.rt);
         case OPCODE_SWC1:
-            return fmt::format("{{ float val = ctx->f[{}]; WRITE32(ADD32(GPR_U32(ctx, {}), {}), *(uint32_t*)&val); }}", inst.rt, inst.rs, inst.simmediate);
+            return fmt::format("{{ float val = ctx->f[{}]; WRITE32({}, *(uint32_t*)&val); }}", inst.rt, effectiveAddress(inst));
         case OPCODE_LDC2: // was OPCODE_LQC2 need to check
-            return fmt::format("ctx->vu0_vf[{}] = _mm_castsi128_ps(READ128(ADD32(GPR_U32(ctx, {}), {})));", inst.rt, inst.rs, inst.simmediate);
+            return fmt::format("ctx->vu0_vf[{}] = _mm_castsi128_ps(READ128({}));", inst.rt, effectiveAddress(inst));
         case OPCODE_SDC2: // was OPCODE_SQC2 need to check
-            return fmt::format("WRITE128(ADD32(GPR_U32(ctx, {}), {}), _mm_castps_si128(ctx->vu0_vf[{}]));", inst.rs, inst.simmediate, inst.rt);
+            return fmt::format("WRITE128({}, _mm_castps_si128(ctx->vu0_vf[{}]));", effectiveAddress(inst), inst.rt);
         case OPCODE_DADDI:
             return fmt::format(
                 "{{ int64_t src = (int64_t)GPR_S64(ctx, {}); "
@@ -592,76 +955,76 @@ namespace ps2recomp
             return fmt::format("// Likely branch instruction at 0x{:X} - Handled by branch logic", inst.address);
 
         case OPCODE_LDL:
-            return fmt::format("{{ uint32_t addr = ADD32(GPR_U32(ctx, {}), {}); "
+            return fmt::format("{{ uint32_t addr = {}; "
                                "uint32_t shift = (addr & 7) << 3; "
                                "uint64_t mask = 0xFFFFFFFFFFFFFFFFULL << shift; "
                                "uint64_t aligned_data = READ64(addr & ~7ULL); "
                                "SET_GPR_U64(ctx, {}, (GPR_U64(ctx, {}) & ~mask) | (aligned_data & mask)); }}",
-                               inst.rs, inst.simmediate, inst.rt, inst.rt);
+                               effectiveAddress(inst), inst.rt, inst.rt);
 
         case OPCODE_LDR:
-            return fmt::format("{{ uint32_t addr = ADD32(GPR_U32(ctx, {}), {}); "
+            return fmt::format("{{ uint32_t addr = {}; "
                                "uint32_t shift = ((~addr) & 7) << 3; "
                                "uint64_t mask = 0xFFFFFFFFFFFFFFFFULL >> shift; "
                                "uint64_t aligned_data = READ64(addr & ~7ULL); "
                                "SET_GPR_U64(ctx, {}, (GPR_U64(ctx, {}) & ~mask) | (aligned_data & mask)); }}",
-                               inst.rs, inst.simmediate, inst.rt, inst.rt);
+                               effectiveAddress(inst), inst.rt, inst.rt);
 
         case OPCODE_LWL:
-            return fmt::format("{{ uint32_t addr = ADD32(GPR_U32(ctx, {}), {}); "
+            return fmt::format("{{ uint32_t addr = {}; "
                                "uint32_t shift = ((~addr) & 3) << 3; /* big-endian */ "
                                "uint32_t mask  = 0xFFFFFFFF >> shift; "
                                "uint32_t word  = READ32(addr & ~3); "
                                "SET_GPR_U32(ctx, {}, (GPR_U32(ctx,{}) & ~mask) | ((word >> shift) & mask)); }}",
-                               inst.rs, inst.simmediate, inst.rt, inst.rt);
+                               effectiveAddress(inst), inst.rt, inst.rt);
 
         case OPCODE_LWR:
-            return fmt::format("{{ uint32_t addr = ADD32(GPR_U32(ctx, {}), {}); "
+            return fmt::format("{{ uint32_t addr = {}; "
                                "uint32_t shift = (addr & 3) << 3; "
                                "uint32_t mask  = 0xFFFFFFFF << shift; "
                                "uint32_t word  = READ32(addr & ~3); "
                                "SET_GPR_U32(ctx, {}, (GPR_U32(ctx,{}) & ~mask) | (word << shift)); }}",
-                               inst.rs, inst.simmediate, inst.rt, inst.rt);
+                               effectiveAddress(inst), inst.rt, inst.rt);
 
         case OPCODE_SWL:
-            return fmt::format("{{ uint32_t addr = ADD32(GPR_U32(ctx, {}), {}); "
+            return fmt::format("{{ uint32_t addr = {}; "
                                "uint32_t shift = (addr & 3) << 3; "
                                "uint32_t mask = 0xFFFFFFFF << shift; "
                                "uint32_t aligned_addr = addr & ~3; "
                                "uint32_t old_data = READ32(aligned_addr); "
                                "uint32_t new_data = (old_data & ~mask) | (GPR_U32(ctx, {}) & mask); "
                                "WRITE32(aligned_addr, new_data); }}",
-                               inst.rs, inst.simmediate, inst.rt);
+                               effectiveAddress(inst), inst.rt);
 
         case OPCODE_SWR:
-            return fmt::format("{{ uint32_t addr = ADD32(GPR_U32(ctx, {}), {}); "
+            return fmt::format("{{ uint32_t addr = {}; "
                                "uint32_t shift = ((~addr) & 3) << 3; "
                                "uint32_t mask = 0xFFFFFFFF >> shift; "
                                "uint32_t aligned_addr = addr & ~3; "
                                "uint32_t old_data = READ32(aligned_addr); "
                                "uint32_t new_data = (old_data & ~mask) | (GPR_U32(ctx, {}) & mask); "
                                "WRITE32(aligned_addr, new_data); }}",
-                               inst.rs, inst.simmediate, inst.rt);
+                               effectiveAddress(inst), inst.rt);
 
         case OPCODE_SDL:
-            return fmt::format("{{ uint32_t addr = ADD32(GPR_U32(ctx, {}), {}); "
+            return fmt::format("{{ uint32_t addr = {}; "
                                "uint32_t shift = (addr & 7) << 3; "
                                "uint64_t mask = 0xFFFFFFFFFFFFFFFFULL << shift; "
                                "uint64_t aligned_addr = addr & ~7ULL; "
                                "uint64_t old_data = READ64(aligned_addr); "
                                "uint64_t new_data = (old_data & ~mask) | (GPR_U64(ctx, {}) & mask); "
                                "WRITE64(aligned_addr, new_data); }}",
-                               inst.rs, inst.simmediate, inst.rt);
+                               effectiveAddress(inst), inst.rt);
 
         case OPCODE_SDR:
-            return fmt::format("{{ uint32_t addr = ADD32(GPR_U32(ctx, {}), {}); "
+            return fmt::format("{{ uint32_t addr = {}; "
                                "uint32_t shift = ((~addr) & 7) << 3; "
                                "uint64_t mask = 0xFFFFFFFFFFFFFFFFULL >> shift; "
                                "uint64_t aligned_addr = addr & ~7ULL; "
                                "uint64_t old_data = READ64(aligned_addr); "
                                "uint64_t new_data = (old_data & ~mask) | (GPR_U64(ctx, {}) & mask); "
                                "WRITE64(aligned_addr, new_data); }}",
-                               inst.rs, inst.simmediate, inst.rt);
+                               effectiveAddress(inst), inst.rt);
         case OPCODE_CACHE:
             return "// CACHE instruction (ignored)";
         case OPCODE_PREF:
@@ -710,9 +1073,9 @@ namespace ps2recomp
         case SPECIAL_MTLO:
             return fmt::format("ctx->lo = GPR_U32(ctx, {});", inst.rs);
         case SPECIAL_MULT:
-            return fmt::format("{{ int64_t result = (int64_t)GPR_S32(ctx, {}) * (int64_t)GPR_S32(ctx, {}); ctx->lo = (uint32_t)result; ctx->hi = (uint32_t)(result >> 32); }}", inst.rs, inst.rt);
+            return fmt::format("{{ int64_t result = (int64_t)GPR_S32(ctx, {}) * (int64_t)GPR_S32(ctx, {}); {} }}", inst.rs, inst.rt, storeHiLo(inst, false));
         case SPECIAL_MULTU:
-            return fmt::format("{{ uint64_t result = (uint64_t)GPR_U32(ctx, {}) * (uint64_t)GPR_U32(ctx, {}); ctx->lo = (uint32_t)result; ctx->hi = (uint32_t)(result >> 32); }}", inst.rs, inst.rt);
+            return fmt::format("{{ uint64_t result = (uint64_t)GPR_U32(ctx, {}) * (uint64_t)GPR_U32(ctx, {}); {} }}", inst.rs, inst.rt, storeHiLo(inst, false));
         case SPECIAL_DIV:
             return fmt::format("{{ int32_t divisor = GPR_S32(ctx, {}); if (divisor != 0) {{ ctx->lo = (uint32_t)(GPR_S32(ctx, {}) / divisor); ctx->hi = (uint32_t)(GPR_S32(ctx, {}) % divisor); }} else {{ ctx->lo = (GPR_S32(ctx,{}) < 0) ? 1 : -1; ctx->hi = GPR_S32(ctx,{}); }} }}", inst.rt, inst.rs, inst.rt, inst.rs, inst.rt);
         case SPECIAL_DIVU:
@@ -1135,9 +1498,9 @@ namespace ps2recomp
         case MMI_MTLO1:
             return fmt::format("ctx->lo1 = GPR_U32(ctx, {});", rs);
         case MMI_MULT1:
-            return fmt::format("{{ int64_t result = (int64_t)GPR_S32(ctx, {}) * (int64_t)GPR_S32(ctx, {}); ctx->lo1 = (uint32_t)result; ctx->hi1 = (uint32_t)(result >> 32); }}", rs, rt);
+            return fmt::format("{{ int64_t result = (int64_t)GPR_S32(ctx, {}) * (int64_t)GPR_S32(ctx, {}); {} }}", rs, rt, storeHiLo(inst, true));
         case MMI_MULTU1:
-            return fmt::format("{{ uint64_t result = (uint64_t)GPR_U32(ctx, {}) * (uint64_t)GPR_U32(ctx, {}); ctx->lo1 = (uint32_t)result; ctx->hi1 = (uint32_t)(result >> 32); }}", rs, rt);
+            return fmt::format("{{ uint64_t result = (uint64_t)GPR_U32(ctx, {}) * (uint64_t)GPR_U32(ctx, {}); {} }}", rs, rt, storeHiLo(inst, true));
         case MMI_DIV1:
             return fmt::format("{{ int32_t divisor = GPR_S32(ctx, {}); if (divisor != 0) {{ ctx->lo1 = (uint32_t)(GPR_S32(ctx, {}) / divisor); ctx->hi1 = (uint32_t)(GPR_S32(ctx, {}) % divisor); }} else {{ ctx->lo1= (GPR_S32(ctx,{}) < 0) ? 1 : -1; ctx->hi1=GPR_S32(ctx,{}); }} }}", rt, rs, rt, rs, rt);
         case MMI_DIVU1:
@@ -1742,16 +2105,13 @@ namespace ps2recomp
 
     std::string CodeGenerator::translatePMADDW(const Instruction &inst)
     {
-        return fmt::format("{{ __m128i p01 = _mm_mul_epu32(GPR_VEC(ctx, {}), GPR_VEC(ctx, {})); \n"                                       // [p1, p0] 64b each
-                           "   __m128i p23 = _mm_mul_epu32(_mm_srli_si128(GPR_VEC(ctx, {}), 8), _mm_srli_si128(GPR_VEC(ctx, {}), 8)); \n" // [p3, p2] 64b each
-                           "   uint64_t acc = ((uint64_t)ctx->hi << 32) | ctx->lo; \n"
-                           "   acc += _mm_cvtsi128_si64(p01); \n"                    // Add product 0
-                           "   acc += _mm_cvtsi128_si64(_mm_srli_si128(p01, 8)); \n" // Add product 1
-                           "   acc += _mm_cvtsi128_si64(p23); \n"                    // Add product 2
-                           "   acc += _mm_cvtsi128_si64(_mm_srli_si128(p23, 8)); \n" // Add product 3
-                           "   ctx->lo = (uint32_t)acc; ctx->hi = (uint32_t)(acc >> 32); \n"
-                           "   SET_GPR_U64(ctx, {}, acc); }}", // Store 64-bit acc result in rd
-                           inst.rs, inst.rt, inst.rs, inst.rt, inst.rd);
+        // Signed words 0 and 2 multiply-add into HI/LO and HI1/LO1; rd gets both 64b sums
+        return fmt::format("{{ __m128i acc = _mm_set_epi32((int32_t)ctx->hi1, (int32_t)ctx->lo1, (int32_t)ctx->hi, (int32_t)ctx->lo); \n"
+                           "   __m128i sum = _mm_add_epi64(acc, _mm_mul_epi32(GPR_VEC(ctx, {}), GPR_VEC(ctx, {}))); \n" // [sum1, sum0] 64b each
+                           "   ctx->lo = (uint32_t)_mm_cvtsi128_si32(sum); ctx->hi = (uint32_t)_mm_extract_epi32(sum, 1); \n"
+                           "   ctx->lo1 = (uint32_t)_mm_extract_epi32(sum, 2); ctx->hi1 = (uint32_t)_mm_extract_epi32(sum, 3); \n"
+                           "   SET_GPR_VEC(ctx, {}, sum); }}",
+                           inst.rs, inst.rt, inst.rd);
     }
 
     std::string CodeGenerator::translatePDIVW(const Instruction &inst)
@@ -1775,12 +2135,8 @@ namespace ps2recomp
     {
         // Parallel multiply add halfword -> results to HI/LO and rd
         return fmt::format("{{ __m128i prod = _mm_madd_epi16(GPR_VEC(ctx, {}), GPR_VEC(ctx, {})); \n" // Packed multiply and add adjacent pairs
-                           "   int32_t p0 = _mm_cvtsi128_si32(prod); \n"
-                           "   int32_t p1 = _mm_cvtsi128_si32(_mm_srli_si128(prod, 4)); \n"
-                           "   int32_t p2 = _mm_cvtsi128_si32(_mm_srli_si128(prod, 8)); \n"
-                           "   int32_t p3 = _mm_cvtsi128_si32(_mm_srli_si128(prod, 12)); \n"
                            "   int64_t acc = ((int64_t)ctx->hi << 32) | ctx->lo; \n"
-                           "   acc += (int64_t)p0 + (int64_t)p1 + (int64_t)p2 + (int64_t)p3; \n"
+                           "   acc += _mm_custom_hadd_epi32_s64(prod); \n"
                            "   ctx->lo = (uint32_t)acc; ctx->hi = (uint32_t)(acc >> 32); \n"
                            "   SET_GPR_U64(ctx, {}, acc); }}",
                            inst.rs, inst.rt, inst.rd);
@@ -1794,12 +2150,8 @@ namespace ps2recomp
                            "   __m128i prod_ev = _mm_mullo_epi16(evens, _mm_shuffle_epi32(GPR_VEC(ctx, {}), _MM_SHUFFLE(2,0,2,0))); \n"
                            "   __m128i prod_od = _mm_mullo_epi16(odds,  _mm_shuffle_epi32(GPR_VEC(ctx, {}), _MM_SHUFFLE(3,1,3,1))); \n"
                            "   __m128i sum_pairs = _mm_add_epi16(prod_ev, prod_od); \n"                            // Add rs[0]*rt[0] + rs[1]*rt[1], etc.
-                           "   int32_t h0 = _mm_extract_epi16(sum_pairs, 0) + _mm_extract_epi16(sum_pairs, 1); \n" // Horizontal add within low 32b
-                           "   int32_t h1 = _mm_extract_epi16(sum_pairs, 2) + _mm_extract_epi16(sum_pairs, 3); \n" // Horizontal add within next 32b
-                           "   int32_t h2 = _mm_extract_epi16(sum_pairs, 4) + _mm_extract_epi16(sum_pairs, 5); \n"
-                           "   int32_t h3 = _mm_extract_epi16(sum_pairs, 6) + _mm_extract_epi16(sum_pairs, 7); \n"
                            "   int64_t acc = ((int64_t)ctx->hi << 32) | ctx->lo; \n"
-                           "   acc += (int64_t)h0 + (int64_t)h1 + (int64_t)h2 + (int64_t)h3; \n"
+                           "   acc += _mm_custom_hadd_epu16(sum_pairs); \n" // Horizontal add of all eight halfwords
                            "   ctx->lo = (uint32_t)acc; ctx->hi = (uint32_t)(acc >> 32); \n"
                            "   SET_GPR_U64(ctx, {}, acc); }}",
                            inst.rs, inst.rt, inst.rs, inst.rt, inst.rd);
@@ -1824,11 +2176,7 @@ namespace ps2recomp
     {
         // Parallel multiply halfword, results sum to HI/LO and rd
         return fmt::format("{{ __m128i prod = _mm_madd_epi16(GPR_VEC(ctx, {}), GPR_VEC(ctx, {})); \n"
-                           "   int32_t p0 = _mm_cvtsi128_si32(prod); \n"
-                           "   int32_t p1 = _mm_cvtsi128_si32(_mm_srli_si128(prod, 4)); \n"
-                           "   int32_t p2 = _mm_cvtsi128_si32(_mm_srli_si128(prod, 8)); \n"
-                           "   int32_t p3 = _mm_cvtsi128_si32(_mm_srli_si128(prod, 12)); \n"
-                           "   int64_t result = (int64_t)p0 + (int64_t)p1 + (int64_t)p2 + (int64_t)p3; \n"
+                           "   int64_t result = _mm_custom_hadd_epi32_s64(prod); \n"
                            "   ctx->lo = (uint32_t)result; ctx->hi = (uint32_t)(result >> 32); \n"
                            "   SET_GPR_U64(ctx, {}, result); }}",
                            inst.rs, inst.rt, inst.rd);
@@ -1837,17 +2185,15 @@ namespace ps2recomp
     std::string CodeGenerator::translatePDIVBW(const Instruction &inst)
     {
         // Divide each element of rs by the first element of rt
-        return fmt::format("{{ int32_t div = GPR_S32(ctx, {}); \n"
-                           "   int32_t r0 = GPR_S32(ctx, {}); int32_t r1 = GPR_S32(ctx, {}); \n"
-                           "   int32_t r2 = GPR_S32(ctx, {}); int32_t r3 = GPR_S32(ctx, {}); \n"
-                           "   int32_t q0=0, q1=0, q2=0, q3=0; \n"
+        return fmt::format("{{ int32_t div = GPR_S32(ctx, {}); __m128i src = GPR_VEC(ctx, {}); \n"
+                           "   int32_t r0 = _mm_cvtsi128_si32(src); \n"
+                           "   __m128i q = _mm_setzero_si128(); \n"
                            "   if (div != 0) {{ \n"
-                           "       q0 = r0 / div; ctx->lo = q0; ctx->hi = r0 % div; \n" // HI/LO only from first element
-                           "       q1 = r1 / div; q2 = r2 / div; q3 = r3 / div; \n"
+                           "       q = _mm_custom_div_epi32(src, div); \n"
+                           "       ctx->lo = _mm_cvtsi128_si32(q); ctx->hi = (uint32_t)r0 - (uint32_t)_mm_cvtsi128_si32(q) * (uint32_t)div; \n" // HI/LO only from first element
                            "   }} else {{ ctx->lo = (r0 < 0) ? 1 : -1; ctx->hi = r0; }} \n"
-                           "   SET_GPR_VEC(ctx, {}, _mm_set_epi32(q3, q2, q1, q0)); }}",
-                           inst.rt, inst.rs + 0, inst.rs + 1, inst.rs + 2, inst.rs + 3, // TODO check if GPR_S32 allows offset indexing
-                           inst.rd);
+                           "   SET_GPR_VEC(ctx, {}, q); }}",
+                           inst.rt, inst.rs, inst.rd);
     }
 
     std::string CodeGenerator::translatePEXEW(const Instruction &inst)
@@ -1866,14 +2212,12 @@ namespace ps2recomp
 
     std::string CodeGenerator::translatePMULTUW(const Instruction &inst)
     {
-        // Parallel multiply unsigned word -> results to HI/LO and rd (lower 32 bits)
-        return fmt::format("{{ __m128i p01 = _mm_mul_epu32(GPR_VEC(ctx, {}), GPR_VEC(ctx, {})); \n"
-                           "   __m128i p23 = _mm_mul_epu32(_mm_srli_si128(GPR_VEC(ctx, {}), 8), _mm_srli_si128(GPR_VEC(ctx, {}), 8)); \n"
-                           "   uint64_t res0 = _mm_cvtsi128_si64(p01); uint64_t res1 = _mm_cvtsi128_si64(_mm_srli_si128(p01, 8)); \n"
-                           "   uint64_t res2 = _mm_cvtsi128_si64(p23); uint64_t res3 = _mm_cvtsi128_si64(_mm_srli_si128(p23, 8)); \n"
-                           "   ctx->lo = (uint32_t)res0; ctx->hi = (uint32_t)(res0 >> 32); \n" // HI/LO from first product only
-                           "   SET_GPR_VEC(ctx, {}, _mm_set_epi32((uint32_t)res3, (uint32_t)res2, (uint32_t)res1, (uint32_t)res0)); }}",
-                           inst.rs, inst.rt, inst.rs, inst.rt, inst.rd);
+        // Unsigned words 0 and 2 multiply into HI/LO and HI1/LO1; rd gets both 64b products
+        return fmt::format("{{ __m128i prod = _mm_mul_epu32(GPR_VEC(ctx, {}), GPR_VEC(ctx, {})); \n" // [prod1, prod0] 64b each
+                           "   ctx->lo = (uint32_t)_mm_cvtsi128_si32(prod); ctx->hi = (uint32_t)_mm_extract_epi32(prod, 1); \n"
+                           "   ctx->lo1 = (uint32_t)_mm_extract_epi32(prod, 2); ctx->hi1 = (uint32_t)_mm_extract_epi32(prod, 3); \n"
+                           "   SET_GPR_VEC(ctx, {}, prod); }}",
+                           inst.rs, inst.rt, inst.rd);
     }
 
     std::string CodeGenerator::translatePDIVUW(const Instruction &inst)
@@ -2306,36 +2650,42 @@ namespace ps2recomp
         return ss.str();
     }
 
-    std::string CodeGenerator::generateJumpTableSwitch(const Instruction &inst, uint32_t tableAddress,
-                                                       const std::vector<JumpTableEntry> &entries)
+    const JumpTable *CodeGenerator::findJumpTable(const Instruction &inst) const
     {
-        std::stringstream ss;
+        if (inst.opcode != OPCODE_SPECIAL || inst.function != SPECIAL_JR)
+            return nullptr;
 
-        uint32_t indexReg = inst.rs;
+        auto it = m_jumpTables.find(inst.address);
+        return it != m_jumpTables.end() ? &it->second : nullptr;
+    }
 
-        ss << "switch (ctx->r[" << indexReg << "]) {\n";
+    // Switches on the address the jr is about to jump to: targets in the function
+    // are gotos, others tail calls, and anything the table missed leaves through pc.
+    std::string CodeGenerator::generateJumpTableSwitch(const Instruction &inst, const JumpTable &table,
+                                                       const std::unordered_set<uint32_t> &internalTargets)
+    {
+        std::stringstream ss;
+
+        std::vector<uint32_t> targets;
+        for (const auto &entry : table.entries)
+            targets.push_back(entry.target);
+        std::sort(targets.begin(), targets.end());
+        targets.erase(std::unique(targets.begin(), targets.end()), targets.end());
 
-        for (const auto &[index, target] : entries)
+        ss << "switch (GPR_U32(ctx, " << static_cast<int>(inst.rs) << ")) {\n";
+        for (uint32_t target : targets)
         {
-            ss << "    case " << index << ": {\n";
+            ss << "    case 0x" << std::hex << target << std::dec << ": ";
 
             std::string funcName = getFunctionName(target);
-            if (!funcName.empty())
-            {
-                ss << "        " << funcName << "(rdram, ctx, runtime);\n";
-            }
+            if (internalTargets.contains(target))
+                ss << "goto " << labelName(target) << ";\n";
+            else if (!funcName.empty())
+                ss << "PS2_TAIL_CALL(" << funcName << ");\n";
             else
-            {
-                ss << "        func_" << std::hex << target << std::dec << "(rdram, ctx,  runtime);\n";
-            }
-
-            ss << "        return;\n";
-            ss << "    }\n";
+                ss << "ctx->pc = 0x" << std::hex << target << std::dec << "; return;\n";
         }
-
-        ss << "    default:\n";
-        ss << "        // Unknown jump table target\n";
-        ss << "        return;\n";
+        ss << "    default: ctx->pc = GPR_U32(ctx, " << static_cast<int>(inst.rs) << "); return;\n";
         ss << "}\n";
 
         return ss.str();
@@ -2387,7 +2737,7 @@ namespace ps2recomp
         }
         if (!m_bootstrapInfo.entryName.empty())
         {
-            ss << "    " << m_bootstrapInfo.entryName << "(rdram, ctx, runtime);\n";
+            ss << "    PS2_CALL(" << m_bootstrapInfo.entryName << ");\n";
         }
         else
         {
@@ -4,6 +4,7 @@
 #include <iostream>
 #include <stdexcept>
 #include <sstream>
+#include <map>
 
 namespace ps2recomp
 {
@@ -29,6 +30,10 @@ namespace ps2recomp
             config.ghidraMapPath = toml::find_or<std::string>(general, "ghidra_output", "");
             config.outputPath = toml::find<std::string>(general, "output");
             config.singleFileOutput = toml::find_or<bool>(general, "single_file_output", false);
+            config.outputShards = toml::find_or<uint32_t>(general, "output_shards", 0);
+            config.inlineMaxInstructions = toml::find_or<uint32_t>(general, "inline_max_instructions", 0);
+            config.profilePath = toml::find_or<std::string>(general, "profile", "");
+            config.instrumentProfile = toml::find_or<bool>(general, "instrument_profile", false);
 
             if (general.contains("stubs") && general.at("stubs").is_array())
             {
@@ -90,6 +95,96 @@ namespace ps2recomp
                     }
                 }
             }
+
+            if (data.contains("call_graph") && data.at("call_graph").is_table())
+            {
+                const auto &callGraph = toml::find(data, "call_graph");
+                if (callGraph.contains("functions") && callGraph.at("functions").is_array())
+                {
+                    for (const auto &node : toml::find(callGraph, "functions").as_array())
+                    {
+                        if (!node.contains("address") || !node.at("address").is_string() || !node.contains("hotness"))
+                        {
+                            continue;
+                        }
+
+                        uint32_t address = std::stoul(toml::find<std::string>(node, "address"), nullptr, 0);
+                        const auto &hotness = node.at("hotness");
+                        if (hotness.is_floating())
+                        {
+                            config.functionHotness[address] = hotness.as_floating();
+                        }
+                        else if (hotness.is_integer())
+                        {
+                            config.functionHotness[address] = static_cast<double>(hotness.as_integer());
+                        }
+                    }
+                }
+            }
+
+            // Tables without the jr that uses them can't be matched to a dispatch and are ignored.
+            if (data.contains("jump_tables") && data.at("jump_tables").is_table())
+            {
+                const auto &jumpTables = toml::find(data, "jump_tables");
+                if (jumpTables.contains("table") && jumpTables.at("table").is_array())
+                {
+                    for (const auto &table : toml::find(jumpTables, "table").as_array())
+                    {
+                        if (!table.contains("address") || !table.contains("jr") || !table.contains("entries") ||
+                            !table.at("entries").is_array())
+                        {
+                            continue;
+                        }
+
+                        JumpTable jumpTable{};
+                        jumpTable.address = std::stoul(toml::find<std::string>(table, "address"), nullptr, 0);
+                        jumpTable.jumpAddress = std::stoul(toml::find<std::string>(table, "jr"), nullptr, 0);
+                        for (const auto &entry : toml::find(table, "entries").as_array())
+                        {
+                            if (!entry.contains("index") || !entry.contains("target"))
+                            {
+                                continue;
+                            }
+
+                            JumpTableEntry jumpEntry;
+                            jumpEntry.index = static_cast<uint32_t>(toml::find<int64_t>(entry, "index"));
+                            jumpEntry.target = std::stoul(toml::find<std::string>(entry, "target"), nullptr, 0);
+                            jumpTable.entries.push_back(jumpEntry);
+                        }
+
+                        if (!jumpTable.entries.empty())
+                        {
+                            config.jumpTables.push_back(jumpTable);
+                        }
+                    }
+                }
+            }
+
+            if (data.contains("idle_loops") && data.at("idle_loops").is_table())
+            {
+                const auto &idleLoops = toml::find(data, "idle_loops");
+                auto readAddresses = [&](const char *key, std::vector<uint32_t> &out)
+                {
+                    if (!idleLoops.contains(key) || !idleLoops.at(key).is_array())
+                    {
+                        return;
+                    }
+                    for (const auto &value : toml::find(idleLoops, key).as_array())
+                    {
+                        if (value.is_string())
+                        {
+                            out.push_back(std::stoul(value.as_string(), nullptr, 0));
+                        }
+                        else if (value.is_integer())
+                        {
+                            out.push_back(static_cast<uint32_t>(value.as_integer()));
+                        }
+                    }
+                };
+                readAddresses("loops", config.idleLoops);
+                readAddresses("force", config.idleLoopsForced);
+                readAddresses("disable", config.idleLoopsDisabled);
+            }
         }
         catch (const std::exception &e)
         {
@@ -109,6 +204,10 @@ namespace ps2recomp
         general["ghidra_output"] = config.ghidraMapPath;
         general["output"] = config.outputPath;
         general["single_file_output"] = config.singleFileOutput;
+        general["output_shards"] = config.outputShards;
+        general["inline_max_instructions"] = config.inlineMaxInstructions;
+        general["profile"] = config.profilePath;
+        general["instrument_profile"] = config.instrumentProfile;
         general["skip"] = config.skipFunctions;
         general["stubs"] = config.stubImplementations;
         data["general"] = general;
@@ -128,6 +227,79 @@ namespace ps2recomp
         patches["instructions"] = instPatches;
         data["patches"] = patches;
 
+        if (!config.functionHotness.empty())
+        {
+            std::map<uint32_t, double> sorted(config.functionHotness.begin(), config.functionHotness.end());
+            toml::array nodes;
+            for (const auto &[addr, hotness] : sorted)
+            {
+                std::ostringstream addrStream;
+                addrStream << "0x" << std::hex << addr;
+
+                toml::table node;
+                node["address"] = addrStream.str();
+                node["hotness"] = hotness;
+                nodes.push_back(node);
+            }
+            toml::table callGraph;
+            callGraph["functions"] = nodes;
+            data["call_graph"] = callGraph;
+        }
+
+        if (!config.jumpTables.empty())
+        {
+            toml::array tables;
+            for (const auto &jumpTable : config.jumpTables)
+            {
+                std::ostringstream addrStream;
+                addrStream << "0x" << std::hex << jumpTable.address;
+                std::ostringstream jrStream;
+                jrStream << "0x" << std::hex << jumpTable.jumpAddress;
+
+                toml::array entries;
+                for (const auto &[index, target] : jumpTable.entries)
+                {
+                    std::ostringstream targetStream;
+                    targetStream << "0x" << std::hex << target;
+
+                    toml::table entry;
+                    entry["index"] = index;
+                    entry["target"] = targetStream.str();
+                    entries.push_back(entry);
+                }
+
+                toml::table table;
+                table["address"] = addrStream.str();
+                table["jr"] = jrStream.str();
+                table["entries"] = entries;
+                tables.push_back(table);
+            }
+            toml::table jumpTables;
+            jumpTables["table"] = tables;
+            data["jump_tables"] = jumpTables;
+        }
+
+        if (!config.idleLoops.empty() || !config.idleLoopsForced.empty() || !config.idleLoopsDisabled.empty())
+        {
+            auto writeAddresses = [](const std::vector<uint32_t> &addresses)
+            {
+                toml::array out;
+                for (uint32_t address : addresses)
+                {
+                    std::ostringstream addrStream;
+                    addrStream << "0x" << std::hex << address;
+                    out.push_back(addrStream.str());
+                }
+                return out;
+            };
+
+            toml::table idleLoops;
+            idleLoops["loops"] = writeAddresses(config.idleLoops);
+            idleLoops["force"] = writeAddresses(config.idleLoopsForced);
+            idleLoops["disable"] = writeAddresses(config.idleLoopsDisabled);
+            data["idle_loops"] = idleLoops;
+        }
+
         std::ofstream file(m_configPath);
         if (!file)
         {
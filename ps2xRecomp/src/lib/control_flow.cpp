@@ -0,0 +1,330 @@
+#include "ps2recomp/control_flow.h"
+#include "ps2recomp/instructions.h"
+#include "ps2recomp/types.h"
+#include <algorithm>
+#include <utility>
+
+namespace ps2recomp
+{
+    bool isLikelyBranch(const Instruction &inst)
+    {
+        switch (inst.opcode)
+        {
+        case OPCODE_BEQL:
+        case OPCODE_BNEL:
+        case OPCODE_BLEZL:
+        case OPCODE_BGTZL:
+            return true;
+        case OPCODE_REGIMM:
+            return inst.rt == REGIMM_BLTZL || inst.rt == REGIMM_BGEZL ||
+                   inst.rt == REGIMM_BLTZALL || inst.rt == REGIMM_BGEZALL;
+        case OPCODE_COP1:
+            return inst.rs == COP1_BC && (inst.rt == COP1_BC_BCFL || inst.rt == COP1_BC_BCTL);
+        case OPCODE_COP2:
+            return inst.rs == COP2_BC && (inst.rt == COP2_BC_BCFL || inst.rt == COP2_BC_BCTL);
+        default:
+            return false;
+        }
+    }
+
+    bool isUnconditionalBranch(const Instruction &inst)
+    {
+        return (inst.opcode == OPCODE_BEQ && inst.rs == inst.rt) ||
+               (inst.opcode == OPCODE_REGIMM && inst.rt == REGIMM_BGEZ && inst.rs == 0);
+    }
+
+    bool isJumpOrCall(const Instruction &inst)
+    {
+        return inst.opcode == OPCODE_J || inst.opcode == OPCODE_JAL ||
+               (inst.opcode == OPCODE_SPECIAL && (inst.function == SPECIAL_JR || inst.function == SPECIAL_JALR));
+    }
+
+    uint32_t branchTarget(const Instruction &inst)
+    {
+        return inst.address + 4 + (static_cast<int32_t>(inst.simmediate) << 2);
+    }
+
+    uint32_t buildAbsoluteJumpTarget(uint32_t address, uint32_t target)
+    {
+        return ((address + 4) & 0xF0000000u) | (target << 2);
+    }
+
+    static bool isBranchAndLink(const Instruction &inst)
+    {
+        return inst.opcode == OPCODE_REGIMM && (inst.rt == REGIMM_BLTZAL || inst.rt == REGIMM_BGEZAL ||
+                                                inst.rt == REGIMM_BLTZALL || inst.rt == REGIMM_BGEZALL);
+    }
+
+    // Same filter as CodeGenerator::handleBranchDelaySlots: J/JAL and JR/JALR never goto.
+    static bool isConditionalBranch(const Instruction &inst)
+    {
+        if (inst.opcode == OPCODE_J || inst.opcode == OPCODE_JAL)
+            return false;
+        if (inst.opcode == OPCODE_SPECIAL && (inst.function == SPECIAL_JR || inst.function == SPECIAL_JALR))
+            return false;
+        return inst.isBranch;
+    }
+
+    // Ranges of units a region emits as nested blocks.
+    static size_t childRanges(const ControlRegion &region, std::pair<size_t, size_t> ranges[2])
+    {
+        switch (region.kind)
+        {
+        case ControlRegion::Kind::Loop:
+            ranges[0] = {region.begin, region.end - 1};
+            return 1;
+        case ControlRegion::Kind::IfThen:
+            ranges[0] = {region.begin + 1, region.end};
+            return 1;
+        case ControlRegion::Kind::IfElse:
+            ranges[0] = {region.begin + 1, region.split - 1};
+            ranges[1] = {region.split, region.end};
+            return 2;
+        }
+        return 0;
+    }
+
+    static bool nestsIn(const ControlRegion &inner, const ControlRegion &outer)
+    {
+        std::pair<size_t, size_t> ranges[2];
+        size_t count = childRanges(outer, ranges);
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (ranges[i].first <= inner.begin && inner.end <= ranges[i].second)
+                return true;
+        }
+        return false;
+    }
+
+    ControlFlowStructure::ControlFlowStructure(const std::vector<Instruction> &instructions,
+                                               const std::unordered_set<uint32_t> &internalTargets,
+                                               const std::unordered_map<uint32_t, std::vector<uint32_t>> &switchTargets)
+    {
+        std::unordered_map<uint32_t, size_t> unitAt;
+        for (size_t i = 0; i < instructions.size();)
+        {
+            CodeUnit unit;
+            unit.first = i;
+            unit.hasDelaySlot = instructions[i].hasDelaySlot && i + 1 < instructions.size();
+
+            unitAt[instructions[i].address] = m_units.size();
+            if (unit.hasDelaySlot)
+                unitAt[instructions[i + 1].address] = m_units.size();
+
+            m_units.push_back(unit);
+            i += unit.hasDelaySlot ? 2 : 1;
+        }
+
+        m_predecessors.resize(m_units.size());
+        for (size_t u = 0; u < m_units.size(); ++u)
+        {
+            const Instruction &inst = instructions[m_units[u].first];
+            if (!m_units[u].hasDelaySlot || !isConditionalBranch(inst))
+                continue;
+
+            uint32_t target = branchTarget(inst);
+            if (!internalTargets.contains(target))
+                continue;
+
+            Branch branch;
+            branch.unit = u;
+            branch.address = inst.address;
+            branch.targetAddress = target;
+            branch.unconditional = isUnconditionalBranch(inst);
+            branch.links = isBranchAndLink(inst);
+
+            auto it = unitAt.find(target);
+            if (it != unitAt.end())
+            {
+                branch.target = it->second;
+                branch.targetIsStart = instructions[m_units[it->second].first].address == target;
+                m_predecessors[branch.target].push_back(u);
+            }
+
+            m_branchOfUnit[u] = m_branches.size();
+            m_branches.push_back(branch);
+        }
+
+        // Switch cases are gotos the regions have to respect, never structured branches.
+        for (size_t u = 0; u < m_units.size(); ++u)
+        {
+            auto it = switchTargets.find(instructions[m_units[u].first].address);
+            if (it == switchTargets.end())
+                continue;
+
+            for (uint32_t target : it->second)
+            {
+                m_labels.insert(target);
+                auto targetIt = unitAt.find(target);
+                if (targetIt != unitAt.end())
+                    m_predecessors[targetIt->second].push_back(u);
+            }
+        }
+
+        findLoops();
+        findConditionals();
+
+        std::sort(m_regions.begin(), m_regions.end(), [](const ControlRegion &a, const ControlRegion &b)
+                  { return a.begin != b.begin ? a.begin < b.begin : a.end > b.end; });
+
+        assignRoles();
+    }
+
+    BranchRole ControlFlowStructure::role(uint32_t address) const
+    {
+        auto it = m_roles.find(address);
+        return it != m_roles.end() ? it->second : BranchRole::Goto;
+    }
+
+    bool ControlFlowStructure::enteredFromOutside(size_t from, size_t to, size_t lo, size_t hi) const
+    {
+        for (size_t unit = from; unit < to; ++unit)
+        {
+            for (size_t source : m_predecessors[unit])
+            {
+                if (source < lo || source >= hi)
+                    return true;
+            }
+        }
+        return false;
+    }
+
+    bool ControlFlowStructure::fits(const ControlRegion &region) const
+    {
+        for (const ControlRegion &other : m_regions)
+        {
+            bool disjoint = region.end <= other.begin || other.end <= region.begin;
+            if (!disjoint && !nestsIn(region, other) && !nestsIn(other, region))
+                return false;
+        }
+        return true;
+    }
+
+    void ControlFlowStructure::findLoops()
+    {
+        std::vector<ControlRegion> loops;
+        for (const Branch &branch : m_branches)
+        {
+            if (branch.links || !branch.targetIsStart || branch.target > branch.unit)
+                continue;
+
+            ControlRegion loop;
+            loop.kind = ControlRegion::Kind::Loop;
+            loop.begin = branch.target;
+            loop.end = branch.unit + 1;
+
+            // Entering anywhere but the header makes the loop irreducible.
+            if (enteredFromOutside(loop.begin + 1, loop.end, loop.begin, loop.end))
+                continue;
+
+            loops.push_back(loop);
+        }
+
+        // Outer loops first, so a conflicting inner candidate is the one dropped.
+        std::sort(loops.begin(), loops.end(), [](const ControlRegion &a, const ControlRegion &b)
+                  { return a.begin != b.begin ? a.begin < b.begin : a.end > b.end; });
+
+        for (const ControlRegion &loop : loops)
+        {
+            if (fits(loop))
+                m_regions.push_back(loop);
+        }
+    }
+
+    void ControlFlowStructure::findConditionals()
+    {
+        for (const Branch &branch : m_branches)
+        {
+            if (branch.links || branch.unconditional || !branch.targetIsStart || branch.target == SIZE_MAX ||
+                branch.target <= branch.unit + 1)
+                continue;
+
+            size_t join = branch.target;
+            if (enteredFromOutside(branch.unit + 1, join, branch.unit + 1, join))
+                continue;
+
+            // A then arm ending in "b follow" with a single-entry arm after it is an if/else.
+            auto skip = m_branchOfUnit.find(join - 1);
+            if (skip != m_branchOfUnit.end())
+            {
+                const Branch &jump = m_branches[skip->second];
+                if (jump.unconditional && !jump.links && jump.targetIsStart && jump.target != SIZE_MAX &&
+                    jump.target > join)
+                {
+                    ControlRegion region;
+                    region.kind = ControlRegion::Kind::IfElse;
+                    region.begin = branch.unit;
+                    region.split = join;
+                    region.end = jump.target;
+
+                    bool singleEntry = !enteredFromOutside(join + 1, region.end, join, region.end);
+                    for (size_t source : m_predecessors[join])
+                    {
+                        if (source != branch.unit && (source < join || source >= region.end))
+                            singleEntry = false;
+                    }
+
+                    if (singleEntry && fits(region))
+                    {
+                        m_regions.push_back(region);
+                        continue;
+                    }
+                }
+            }
+
+            ControlRegion region;
+            region.kind = ControlRegion::Kind::IfThen;
+            region.begin = branch.unit;
+            region.end = join;
+            if (fits(region))
+                m_regions.push_back(region);
+        }
+    }
+
+    void ControlFlowStructure::assignRoles()
+    {
+        auto addressOf = [this](size_t unit)
+        {
+            const Branch &branch = m_branches[m_branchOfUnit.at(unit)];
+            return branch.address;
+        };
+
+        for (const ControlRegion &region : m_regions)
+        {
+            switch (region.kind)
+            {
+            case ControlRegion::Kind::Loop:
+                m_roles[addressOf(region.end - 1)] = BranchRole::LoopLatch;
+                break;
+            case ControlRegion::Kind::IfElse:
+                m_roles[addressOf(region.split - 1)] = BranchRole::ElseSkip;
+                [[fallthrough]];
+            case ControlRegion::Kind::IfThen:
+                m_roles[addressOf(region.begin)] = BranchRole::IfCondition;
+                break;
+            }
+        }
+
+        for (const Branch &branch : m_branches)
+        {
+            if (m_roles.contains(branch.address))
+                continue;
+
+            // Regions are sorted outermost first, so the last match is the innermost loop.
+            const ControlRegion *loop = nullptr;
+            for (const ControlRegion &region : m_regions)
+            {
+                if (region.kind == ControlRegion::Kind::Loop && region.begin <= branch.unit && branch.unit < region.end - 1)
+                    loop = &region;
+            }
+
+            if (loop && branch.targetIsStart && branch.target == loop->end)
+            {
+                m_roles[branch.address] = BranchRole::Break;
+                continue;
+            }
+
+            m_labels.insert(branch.targetAddress);
+        }
+    }
+}
@@ -0,0 +1,195 @@
+#include "ps2recomp/decoded_image.h"
+#include "ps2recomp/elf_parser.h"
+#include "ps2recomp/r5900_decoder.h"
+#include <algorithm>
+
+namespace ps2recomp
+{
+    PackedInstruction PackedInstruction::pack(const Instruction &inst)
+    {
+        PackedInstruction packed;
+        packed.raw = inst.raw;
+
+        uint32_t flags = 0;
+        flags |= inst.isMMI ? IS_MMI : 0;
+        flags |= inst.isVU ? IS_VU : 0;
+        flags |= inst.isBranch ? IS_BRANCH : 0;
+        flags |= inst.isJump ? IS_JUMP : 0;
+        flags |= inst.isCall ? IS_CALL : 0;
+        flags |= inst.isReturn ? IS_RETURN : 0;
+        flags |= inst.hasDelaySlot ? HAS_DELAY_SLOT : 0;
+        flags |= inst.isMultimedia ? IS_MULTIMEDIA : 0;
+        flags |= inst.isStore ? IS_STORE : 0;
+        flags |= inst.isLoad ? IS_LOAD : 0;
+        flags |= inst.vectorInfo.isVector ? IS_VECTOR : 0;
+        flags |= inst.vectorInfo.usesQReg ? USES_Q_REG : 0;
+        flags |= inst.vectorInfo.usesPReg ? USES_P_REG : 0;
+        flags |= inst.vectorInfo.modifiesMAC ? MODIFIES_MAC : 0;
+        flags |= inst.modificationInfo.modifiesGPR ? MODIFIES_GPR : 0;
+        flags |= inst.modificationInfo.modifiesFPR ? MODIFIES_FPR : 0;
+        flags |= inst.modificationInfo.modifiesVFR ? MODIFIES_VFR : 0;
+        flags |= inst.modificationInfo.modifiesVIR ? MODIFIES_VIR : 0;
+        flags |= inst.modificationInfo.modifiesVIC ? MODIFIES_VIC : 0;
+        flags |= inst.modificationInfo.modifiesMemory ? MODIFIES_MEMORY : 0;
+        flags |= inst.modificationInfo.modifiesControl ? MODIFIES_CONTROL : 0;
+        flags |= static_cast<uint32_t>(inst.vectorInfo.vectorField & 0xF) << VECTOR_FIELD_SHIFT;
+        flags |= static_cast<uint32_t>(inst.vectorInfo.fsf & 0x3) << FSF_SHIFT;
+        flags |= static_cast<uint32_t>(inst.vectorInfo.ftf & 0x3) << FTF_SHIFT;
+        packed.flags = flags;
+
+        packed.mmiType = inst.mmiType;
+        packed.mmiFunction = inst.mmiFunction;
+        packed.pmfhlVariation = inst.pmfhlVariation;
+        packed.vuFunction = inst.vuFunction;
+        return packed;
+    }
+
+    Instruction PackedInstruction::unpack(uint32_t address) const
+    {
+        Instruction inst;
+        inst.address = address;
+        inst.raw = raw;
+        inst.opcode = OPCODE(raw);
+        inst.rs = RS(raw);
+        inst.rt = RT(raw);
+        inst.rd = RD(raw);
+        inst.sa = SA(raw);
+        inst.function = FUNCTION(raw);
+        inst.immediate = IMMEDIATE(raw);
+        inst.simmediate = SIMMEDIATE(raw);
+        inst.target = TARGET(raw);
+
+        inst.isMMI = has(IS_MMI);
+        inst.isVU = has(IS_VU);
+        inst.isBranch = has(IS_BRANCH);
+        inst.isJump = has(IS_JUMP);
+        inst.isCall = has(IS_CALL);
+        inst.isReturn = has(IS_RETURN);
+        inst.hasDelaySlot = has(HAS_DELAY_SLOT);
+        inst.isMultimedia = has(IS_MULTIMEDIA);
+        inst.isStore = has(IS_STORE);
+        inst.isLoad = has(IS_LOAD);
+
+        inst.mmiType = mmiType;
+        inst.mmiFunction = mmiFunction;
+        inst.pmfhlVariation = pmfhlVariation;
+        inst.vuFunction = vuFunction;
+
+        inst.vectorInfo.isVector = has(IS_VECTOR);
+        inst.vectorInfo.usesQReg = has(USES_Q_REG);
+        inst.vectorInfo.usesPReg = has(USES_P_REG);
+        inst.vectorInfo.modifiesMAC = has(MODIFIES_MAC);
+        inst.vectorInfo.vectorField = (flags >> VECTOR_FIELD_SHIFT) & 0xF;
+        inst.vectorInfo.fsf = (flags >> FSF_SHIFT) & 0x3;
+        inst.vectorInfo.ftf = (flags >> FTF_SHIFT) & 0x3;
+
+        inst.modificationInfo.modifiesGPR = has(MODIFIES_GPR);
+        inst.modificationInfo.modifiesFPR = has(MODIFIES_FPR);
+        inst.modificationInfo.modifiesVFR = has(MODIFIES_VFR);
+        inst.modificationInfo.modifiesVIR = has(MODIFIES_VIR);
+        inst.modificationInfo.modifiesVIC = has(MODIFIES_VIC);
+        inst.modificationInfo.modifiesMemory = has(MODIFIES_MEMORY);
+        inst.modificationInfo.modifiesControl = has(MODIFIES_CONTROL);
+        return inst;
+    }
+
+    InstructionSpan InstructionSpan::from(uint32_t target) const
+    {
+        if (target < address || (target - address) % 4 != 0 || (target - address) / 4 >= words.size())
+            return {};
+
+        return {target, words.subspan((target - address) / 4)};
+    }
+
+    std::vector<Instruction> InstructionSpan::unpack() const
+    {
+        std::vector<Instruction> instructions;
+        instructions.reserve(words.size());
+        for (size_t i = 0; i < words.size(); ++i)
+            instructions.push_back(words[i].unpack(addressOf(i)));
+        return instructions;
+    }
+
+    DecodedImage::DecodedImage(const ElfParser &parser, const std::vector<Section> &sections,
+                               const R5900Decoder &decoder)
+        : m_parser(parser), m_decoder(decoder)
+    {
+        std::vector<const Section *> code;
+        size_t total = 0;
+        for (const auto &section : sections)
+        {
+            if (section.isCode && section.data && section.size >= 4)
+            {
+                code.push_back(&section);
+                total += section.size / 4;
+            }
+        }
+        std::sort(code.begin(), code.end(), [](const Section *a, const Section *b)
+                  { return a->address < b->address; });
+
+        m_words.reserve(total);
+        std::vector<uint32_t> words;
+        for (const Section *section : code)
+        {
+            uint32_t start = (section->address + 3) & ~3u;
+            uint32_t end = section->address + (section->size & ~3u);
+            if (!m_segments.empty())
+                start = std::max(start, m_segments.back().end);
+            if (start >= end)
+                continue;
+
+            words.resize((end - start) / 4);
+            size_t count = m_parser.readWords(start, words.size(), words.data());
+            if (count == 0)
+                continue;
+
+            Segment segment;
+            segment.start = start;
+            segment.end = start + static_cast<uint32_t>(count * 4);
+            segment.first = m_words.size();
+            for (size_t i = 0; i < count; ++i)
+                m_words.push_back(PackedInstruction::pack(m_decoder.decodeInstruction(start + static_cast<uint32_t>(i * 4), words[i])));
+
+            m_segments.push_back(segment);
+        }
+    }
+
+    const DecodedImage::Segment *DecodedImage::findSegment(uint32_t address) const
+    {
+        auto it = std::upper_bound(m_segments.begin(), m_segments.end(), address,
+                                   [](uint32_t value, const Segment &segment)
+                                   { return value < segment.start; });
+        if (it == m_segments.begin())
+            return nullptr;
+
+        --it;
+        return address < it->end ? &*it : nullptr;
+    }
+
+    InstructionSpan DecodedImage::range(uint32_t start, uint32_t end) const
+    {
+        const Segment *segment = findSegment(start);
+        if (!segment || (start & 3) != 0 || end <= start)
+            return {start, {}};
+
+        size_t first = segment->first + (start - segment->start) / 4;
+        size_t count = std::min<size_t>((end - start + 3) / 4, (segment->end - start) / 4);
+        return {start, std::span<const PackedInstruction>(m_words).subspan(first, count)};
+    }
+
+    bool DecodedImage::decode(uint32_t address, Instruction &out) const
+    {
+        if (const Segment *segment = findSegment(address); segment && (address & 3) == 0)
+        {
+            out = m_words[segment->first + (address - segment->start) / 4].unpack(address);
+            return true;
+        }
+
+        uint32_t word = 0;
+        if (m_parser.readWords(address, 1, &word) != 1)
+            return false;
+
+        out = m_decoder.decodeInstruction(address, word);
+        return true;
+    }
+}
@@ -1,5 +1,6 @@
 #include "ps2recomp/elf_parser.h"
 #include "ps2recomp/types.h"
+#include "ps2_mapped_file.h"
 #include <iostream>
 #include <stdexcept>
 #include <unordered_set>
@@ -21,6 +22,7 @@
 #include <sstream>
 #include <algorithm>
 #include <cstring>
+#include <streambuf>
 
 namespace
 {
@@ -29,7 +31,53 @@ namespace
         return name.rfind("sub_", 0) == 0;
     }
 
-    void AppendLoadSegmentsAsSections(const ELFIO::elfio &elf, std::vector<ps2recomp::Section> &sections)
+    // Read-only streambuf over a memory block, so ELFIO can parse a mapped file in place.
+    class MemoryBuffer : public std::streambuf
+    {
+    public:
+        MemoryBuffer(const uint8_t *data, size_t size)
+        {
+            char *begin = reinterpret_cast<char *>(const_cast<uint8_t *>(data));
+            setg(begin, begin, begin + size);
+        }
+
+    protected:
+        pos_type seekoff(off_type offset, std::ios_base::seekdir dir, std::ios_base::openmode which) override
+        {
+            if (!(which & std::ios_base::in))
+            {
+                return pos_type(off_type(-1));
+            }
+
+            char *base = dir == std::ios_base::beg ? eback() : dir == std::ios_base::cur ? gptr() : egptr();
+            off_type target = (base - eback()) + offset;
+            if (target < 0 || target > egptr() - eback())
+            {
+                return pos_type(off_type(-1));
+            }
+
+            setg(eback(), eback() + target, egptr());
+            return pos_type(target);
+        }
+
+        pos_type seekpos(pos_type position, std::ios_base::openmode which) override
+        {
+            return seekoff(off_type(position), std::ios_base::beg, which);
+        }
+    };
+
+    // File bytes [offset, offset + size) of the mapping, or nullptr when they are not all in the file.
+    uint8_t *MappedBytes(const MappedFile &file, uint64_t offset, uint64_t size)
+    {
+        if (offset > file.size() || size > file.size() - offset)
+        {
+            return nullptr;
+        }
+        return const_cast<uint8_t *>(file.data() + offset);
+    }
+
+    void AppendLoadSegmentsAsSections(const ELFIO::elfio &elf, const MappedFile &file,
+                                      std::vector<ps2recomp::Section> &sections)
     {
         const ELFIO::Elf_Half segCount = elf.segments.size();
         if (segCount == 0)
@@ -66,8 +114,7 @@ namespace
                 load.isData = (flags & ELFIO::PF_W) != 0 || (flags & ELFIO::PF_R) != 0;
                 load.isBSS = false;
                 load.isReadOnly = (flags & ELFIO::PF_W) == 0;
-                load.data = const_cast<uint8_t *>(
-                    reinterpret_cast<const uint8_t *>(segment->get_data()));
+                load.data = MappedBytes(file, segment->get_offset(), fileSize);
 
                 sections.push_back(load);
             }
@@ -599,41 +646,56 @@ namespace ps2recomp
 
     bool ElfParser::isValidAddress(uint32_t address) const
     {
-        for (const auto &section : m_sections)
+        return findRange(address) != nullptr;
+    }
+
+    uint32_t ElfParser::readWord(uint32_t address) const
+    {
+        uint32_t word = 0;
+        if (readWords(address, 1, &word) != 1)
         {
-            if (address >= section.address && address < (section.address + section.size))
-            {
-                return true;
-            }
+            throw std::runtime_error("Invalid address for readWord: " + std::to_string(address));
         }
-
-        return false;
+        return word;
     }
 
-    uint32_t ElfParser::readWord(uint32_t address) const
+    std::span<const uint8_t> ElfParser::getBytes(uint32_t address, uint32_t size) const
     {
-        for (const auto &section : m_sections)
+        const AddressRange *range = findRange(address);
+        if (!range || !range->hasData)
         {
-            if (address < section.address || section.size < sizeof(uint32_t))
-            {
-                continue;
-            }
+            return {};
+        }
 
-            const uint32_t offset = address - section.address;
-            if (offset > section.size - static_cast<uint32_t>(sizeof(uint32_t)))
-            {
-                continue;
-            }
+        uint32_t offset = address - range->start;
+        uint32_t available = range->end - address;
+        return {m_image.data() + range->imageOffset + offset, std::min(size, available)};
+    }
 
-            if (section.data)
-            {
-                uint32_t word = 0;
-                std::memcpy(&word, section.data + offset, sizeof(word));
-                return word;
-            }
+    size_t ElfParser::readWords(uint32_t address, size_t count, uint32_t *out) const
+    {
+        uint64_t bytes = static_cast<uint64_t>(count) * sizeof(uint32_t);
+        std::span<const uint8_t> data = getBytes(address, static_cast<uint32_t>(std::min<uint64_t>(bytes, UINT32_MAX)));
+        size_t words = data.size() / sizeof(uint32_t);
+        if (words > 0)
+        {
+            std::memcpy(out, data.data(), words * sizeof(uint32_t));
+        }
+        return words;
+    }
+
+    const ElfParser::AddressRange *ElfParser::findRange(uint32_t address) const
+    {
+        auto it = std::upper_bound(m_addressRanges.begin(), m_addressRanges.end(), address,
+                                   [](uint32_t value, const AddressRange &range)
+                                   { return value < range.start; });
+        if (it == m_addressRanges.begin())
+        {
+            return nullptr;
         }
 
-        throw std::runtime_error("Invalid address for readWord: " + std::to_string(address));
+        --it;
+        return address < it->end ? &*it : nullptr;
     }
 
     uint8_t *ElfParser::getSectionData(const std::string &sectionName) const
@@ -769,7 +831,18 @@ namespace ps2recomp
 
     bool ElfParser::parse()
     {
-        if (!m_elf->load(m_filePath))
+        // ELFIO parses the mapping lazily, and section data points straight into it,
+        // so debug sections are never copied onto the heap.
+        m_file = MappedFile::open(m_filePath);
+        if (!m_file)
+        {
+            std::cerr << "Error: Could not map ELF file: " << m_filePath << std::endl;
+            return false;
+        }
+        m_buffer = std::make_unique<MemoryBuffer>(m_file->data(), static_cast<size_t>(m_file->size()));
+        m_stream = std::make_unique<std::istream>(m_buffer.get());
+
+        if (!m_elf->load(*m_stream, true))
         {
             std::cerr << "Error: Could not load ELF file: " << m_filePath << std::endl;
             return false;
@@ -793,6 +866,7 @@ namespace ps2recomp
     void ElfParser::loadSections()
     {
         m_sections.clear();
+        std::vector<size_t> loadable;
 
         ELFIO::Elf_Half sec_num = m_elf->sections.size();
 
@@ -812,24 +886,99 @@ namespace ps2recomp
 
             if (psec->get_size() > 0 && psec->get_type() != ELFIO::SHT_NOBITS)
             {
-                section.data = (uint8_t *)psec->get_data();
+                section.data = MappedBytes(*m_file, psec->get_offset(), psec->get_size());
             }
             else
             {
                 section.data = nullptr;
             }
 
+            if ((psec->get_flags() & ELFIO::SHF_ALLOC) && section.size > 0)
+            {
+                loadable.push_back(m_sections.size());
+            }
             m_sections.push_back(section);
         }
 
         if (m_sections.empty())
         {
-            AppendLoadSegmentsAsSections(*m_elf, m_sections);
+            AppendLoadSegmentsAsSections(*m_elf, *m_file, m_sections);
             if (!m_sections.empty())
             {
                 std::cout << "Info: ELF has no section headers; using loadable segments as sections ("
                           << m_sections.size() << " entries)." << std::endl;
             }
+            for (size_t i = 0; i < m_sections.size(); ++i)
+            {
+                loadable.push_back(i);
+            }
+        }
+
+        buildAddressIndex(loadable);
+    }
+
+    void ElfParser::buildAddressIndex(const std::vector<size_t> &loadable)
+    {
+        m_addressRanges.clear();
+        m_image.clear();
+
+        std::vector<const Section *> sorted;
+        for (size_t index : loadable)
+        {
+            const Section &section = m_sections[index];
+            if (section.size > 0 && static_cast<uint64_t>(section.address) + section.size <= UINT32_MAX)
+            {
+                sorted.push_back(&section);
+            }
+        }
+        std::sort(sorted.begin(), sorted.end(), [](const Section *a, const Section *b)
+                  { return a->address < b->address; });
+
+        // Merge touching or overlapping sections of the same kind (file-backed or .bss).
+        // Data ranges only grow at their end, so their image bytes stay contiguous.
+        for (const Section *section : sorted)
+        {
+            uint32_t start = section->address;
+            uint32_t end = section->address + section->size;
+            bool hasData = section->data != nullptr;
+
+            AddressRange *last = m_addressRanges.empty() ? nullptr : &m_addressRanges.back();
+            if (last && start <= last->end && last->hasData == hasData)
+            {
+                if (end > last->end)
+                {
+                    if (hasData)
+                    {
+                        m_image.resize(m_image.size() + (end - last->end), 0);
+                    }
+                    last->end = end;
+                }
+            }
+            else
+            {
+                if (last && start < last->end)
+                {
+                    // Overlap between data and .bss: the later section keeps what is left.
+                    start = last->end;
+                    if (start >= end)
+                    {
+                        continue;
+                    }
+                }
+                m_addressRanges.push_back({start, end, hasData, m_image.size()});
+                if (hasData)
+                {
+                    m_image.resize(m_image.size() + (end - start), 0);
+                }
+                last = &m_addressRanges.back();
+            }
+
+            if (hasData && last->hasData)
+            {
+                uint32_t copyStart = std::max(section->address, last->start);
+                std::memcpy(m_image.data() + last->imageOffset + (copyStart - last->start),
+                            section->data + (copyStart - section->address), end - copyStart);
+            }
         }
     }
 
@@ -0,0 +1,1132 @@
+#include "ps2recomp/function_analysis.h"
+#include "ps2recomp/control_flow.h"
+#include "ps2recomp/instructions.h"
+#include "ps2recomp/types.h"
+#include <array>
+#include <iterator>
+#include <unordered_map>
+
+namespace ps2recomp
+{
+    static constexpr uint32_t kGpReg = 28;
+    static constexpr uint32_t kRaReg = 31;
+    static constexpr uint32_t kFpuAcc = 31;
+
+    static uint32_t gprBit(uint32_t reg)
+    {
+        return reg != 0 ? (1u << reg) : 0u;
+    }
+
+    static RegisterSet gprs(uint32_t mask)
+    {
+        return {mask, 0, 0};
+    }
+
+    static RegisterSet fprs(uint32_t mask)
+    {
+        return {0, mask, 0};
+    }
+
+    static RegisterSet states(uint32_t mask)
+    {
+        return {0, 0, mask};
+    }
+
+    static uint32_t fprBit(uint32_t reg)
+    {
+        return 1u << (reg & 31);
+    }
+
+    static void makeBarrier(RegisterEffects &fx)
+    {
+        fx.barrier = true;
+        fx.uses = RegisterSet::all();
+        fx.mayDefs = RegisterSet::all();
+        fx.mustDefs = {};
+    }
+
+    static void reads(RegisterEffects &fx, const RegisterSet &set)
+    {
+        fx.uses |= set;
+    }
+
+    static void writes(RegisterEffects &fx, const RegisterSet &set)
+    {
+        fx.mayDefs |= set;
+        fx.mustDefs |= set;
+    }
+
+    static void mayWrite(RegisterEffects &fx, const RegisterSet &set)
+    {
+        fx.mayDefs |= set;
+    }
+
+    bool isMemoryAccess(const Instruction &inst)
+    {
+        if (inst.isMMI)
+            return false;
+
+        switch (inst.opcode)
+        {
+        case OPCODE_LB:
+        case OPCODE_LH:
+        case OPCODE_LW:
+        case OPCODE_LBU:
+        case OPCODE_LHU:
+        case OPCODE_LWU:
+        case OPCODE_LD:
+        case OPCODE_LQ:
+        case OPCODE_LWL:
+        case OPCODE_LWR:
+        case OPCODE_LDL:
+        case OPCODE_LDR:
+        case OPCODE_SB:
+        case OPCODE_SH:
+        case OPCODE_SW:
+        case OPCODE_SD:
+        case OPCODE_SQ:
+        case OPCODE_SWL:
+        case OPCODE_SWR:
+        case OPCODE_SDL:
+        case OPCODE_SDR:
+        case OPCODE_LWC1:
+        case OPCODE_SWC1:
+        case OPCODE_LDC2:
+        case OPCODE_SDC2:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    bool isMemoryStore(const Instruction &inst)
+    {
+        if (inst.isMMI)
+            return false;
+
+        switch (inst.opcode)
+        {
+        case OPCODE_SB:
+        case OPCODE_SH:
+        case OPCODE_SW:
+        case OPCODE_SD:
+        case OPCODE_SQ:
+        case OPCODE_SWL:
+        case OPCODE_SWR:
+        case OPCODE_SDL:
+        case OPCODE_SDR:
+        case OPCODE_SWC1:
+        case OPCODE_SDC2:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // Memory accesses whose rt is a GPR operand rather than a destination or coprocessor register.
+    static bool readsRtAsData(const Instruction &inst)
+    {
+        switch (inst.opcode)
+        {
+        case OPCODE_SB:
+        case OPCODE_SH:
+        case OPCODE_SW:
+        case OPCODE_SD:
+        case OPCODE_SQ:
+        case OPCODE_SWL:
+        case OPCODE_SWR:
+        case OPCODE_SDL:
+        case OPCODE_SDR:
+        case OPCODE_LWL:
+        case OPCODE_LWR:
+        case OPCODE_LDL:
+        case OPCODE_LDR:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // Register the generator links before running the delay slot, or 0.
+    static uint32_t linkRegister(const Instruction &inst)
+    {
+        if (inst.opcode == OPCODE_JAL)
+            return kRaReg;
+        if (inst.opcode == OPCODE_SPECIAL && inst.function == SPECIAL_JALR)
+            return inst.rd != 0 ? inst.rd : kRaReg;
+        if (inst.opcode == OPCODE_REGIMM && (inst.rt == REGIMM_BLTZAL || inst.rt == REGIMM_BGEZAL ||
+                                             inst.rt == REGIMM_BLTZALL || inst.rt == REGIMM_BGEZALL))
+            return kRaReg;
+        return 0;
+    }
+
+    static void getMMIEffects(const Instruction &inst, RegisterEffects &fx)
+    {
+        const uint32_t rs = gprBit(inst.rs);
+        const uint32_t rt = gprBit(inst.rt);
+        const uint32_t rd = gprBit(inst.rd);
+
+        switch (inst.function)
+        {
+        case MMI_MFHI1:
+            reads(fx, states(STATE_HI1));
+            writes(fx, gprs(rd));
+            break;
+        case MMI_MFLO1:
+            reads(fx, states(STATE_LO1));
+            writes(fx, gprs(rd));
+            break;
+        case MMI_MTHI1:
+            reads(fx, gprs(rs));
+            writes(fx, states(STATE_HI1));
+            break;
+        case MMI_MTLO1:
+            reads(fx, gprs(rs));
+            writes(fx, states(STATE_LO1));
+            break;
+        case MMI_MULT1:
+        case MMI_MULTU1:
+        case MMI_DIV1:
+        case MMI_DIVU1:
+            reads(fx, gprs(rs | rt));
+            writes(fx, states(STATE_HI1 | STATE_LO1));
+            break;
+        case MMI_MADD:
+        case MMI_MADDU:
+        case MMI_MSUB:
+        case MMI_MSUBU:
+            reads(fx, gprs(rs | rt) | states(STATE_HI | STATE_LO));
+            writes(fx, states(STATE_HI | STATE_LO));
+            break;
+        case MMI_MADD1:
+        case MMI_MADDU1:
+            reads(fx, gprs(rs | rt) | states(STATE_HI1 | STATE_LO1));
+            writes(fx, states(STATE_HI1 | STATE_LO1));
+            break;
+        case MMI_PLZCW:
+            reads(fx, gprs(rs));
+            writes(fx, gprs(rd));
+            break;
+        case MMI_PSLLH:
+        case MMI_PSRLH:
+        case MMI_PSRAH:
+        case MMI_PSLLW:
+        case MMI_PSRLW:
+        case MMI_PSRAW:
+            reads(fx, gprs(rt));
+            writes(fx, gprs(rd));
+            break;
+        default: // MMI0-3, PMFHL/PMTHL: too many shapes, assume the worst short of a call
+            reads(fx, gprs(rs | rt | rd) | states(STATE_HI | STATE_LO | STATE_HI1 | STATE_LO1 | STATE_SA));
+            mayWrite(fx, gprs(rd) | states(STATE_HI | STATE_LO | STATE_HI1 | STATE_LO1));
+            break;
+        }
+    }
+
+    static void getFPUEffects(const Instruction &inst, RegisterEffects &fx)
+    {
+        const uint32_t rt = gprBit(inst.rt);
+        const uint32_t ft = fprBit(inst.rt);
+        const uint32_t fs = fprBit(inst.rd);
+        const uint32_t fd = fprBit(inst.sa);
+        const uint32_t acc = fprBit(kFpuAcc);
+
+        switch (inst.rs)
+        {
+        case COP1_MF:
+            reads(fx, fprs(fs));
+            writes(fx, gprs(rt));
+            return;
+        case COP1_MT:
+            reads(fx, gprs(rt));
+            writes(fx, fprs(fs));
+            return;
+        case COP1_CF:
+            if (inst.rd == 31)
+                reads(fx, states(STATE_FCC | STATE_FCR31));
+            writes(fx, gprs(rt));
+            return;
+        case COP1_CT:
+            reads(fx, gprs(rt));
+            if (inst.rd == 31)
+                writes(fx, states(STATE_FCC | STATE_FCR31));
+            return;
+        case COP1_BC:
+            reads(fx, states(STATE_FCC));
+            return;
+        case COP1_W:
+            if (inst.function == COP1_W_CVT_S)
+            {
+                reads(fx, fprs(fs));
+                writes(fx, fprs(fd));
+            }
+            else
+            {
+                makeBarrier(fx);
+            }
+            return;
+        case COP1_S:
+            break;
+        default:
+            makeBarrier(fx);
+            return;
+        }
+
+        switch (inst.function)
+        {
+        case COP1_S_ADD:
+        case COP1_S_SUB:
+        case COP1_S_MUL:
+        case COP1_S_MAX:
+        case COP1_S_MIN:
+            reads(fx, fprs(fs | ft));
+            writes(fx, fprs(fd));
+            break;
+        case COP1_S_DIV:
+            reads(fx, fprs(fs | ft) | states(STATE_FCR31));
+            writes(fx, fprs(fd));
+            mayWrite(fx, states(STATE_FCR31)); // divide-by-zero flag
+            break;
+        case COP1_S_SQRT:
+        case COP1_S_ABS:
+        case COP1_S_MOV:
+        case COP1_S_NEG:
+        case COP1_S_ROUND_W:
+        case COP1_S_TRUNC_W:
+        case COP1_S_CEIL_W:
+        case COP1_S_FLOOR_W:
+        case COP1_S_CVT_W:
+        case COP1_S_RSQRT:
+            reads(fx, fprs(fs));
+            writes(fx, fprs(fd));
+            break;
+        case COP1_S_ADDA:
+        case COP1_S_SUBA:
+        case COP1_S_MULA:
+            reads(fx, fprs(fs | ft));
+            writes(fx, fprs(acc));
+            break;
+        case COP1_S_MADD:
+        case COP1_S_MSUB:
+            reads(fx, fprs(fs | ft | acc));
+            writes(fx, fprs(fd));
+            break;
+        case COP1_S_MADDA:
+        case COP1_S_MSUBA:
+            reads(fx, fprs(fs | ft | acc));
+            writes(fx, fprs(acc));
+            break;
+        case COP1_S_C_F:
+        case COP1_S_C_SF:
+            writes(fx, states(STATE_FCC));
+            break;
+        default:
+            if (inst.function >= COP1_S_C_F && inst.function <= COP1_S_C_NGT)
+            {
+                // Compares only replace the C bit; the rest of FCR31 is carried over.
+                reads(fx, fprs(fs | ft));
+                writes(fx, states(STATE_FCC));
+            }
+            else
+            {
+                makeBarrier(fx);
+            }
+            break;
+        }
+    }
+
+    static void getVUEffects(const Instruction &inst, RegisterEffects &fx)
+    {
+        const uint32_t rt = gprBit(inst.rt);
+
+        auto controlFlag = [](uint32_t reg) -> uint32_t
+        {
+            switch (reg)
+            {
+            case VU0_CR_STATUS:
+                return STATE_VU0_STATUS;
+            case VU0_CR_MAC:
+                return STATE_VU0_MAC;
+            case VU0_CR_CLIP:
+                return STATE_VU0_CLIP;
+            default:
+                return 0;
+            }
+        };
+
+        switch (inst.rs)
+        {
+        case COP2_QMFC2:
+            writes(fx, gprs(rt));
+            break;
+        case COP2_CFC2:
+            reads(fx, states(controlFlag(inst.rd)));
+            mayWrite(fx, gprs(rt));
+            break;
+        case COP2_QMTC2:
+            reads(fx, gprs(rt));
+            break;
+        case COP2_CTC2:
+            reads(fx, gprs(rt));
+            writes(fx, states(controlFlag(inst.rd)));
+            break;
+        case COP2_BC:
+            reads(fx, states(STATE_VU0_STATUS));
+            break;
+        default:
+            if (inst.rs >= COP2_CO && (inst.function == VU0_S1_VCALLMS || inst.function == VU0_S1_VCALLMSR))
+                makeBarrier(fx);
+            break;
+        }
+    }
+
+    // Mirrors what CodeGenerator emits, not the full R5900 semantics: e.g. MULT only
+    // writes HI/LO there, and ADD/ADDI may call into the runtime on overflow.
+    RegisterEffects getRegisterEffects(const Instruction &inst)
+    {
+        RegisterEffects fx;
+        const uint32_t rs = gprBit(inst.rs);
+        const uint32_t rt = gprBit(inst.rt);
+        const uint32_t rd = gprBit(inst.rd);
+
+        if (inst.isMMI || inst.opcode == OPCODE_MMI)
+        {
+            getMMIEffects(inst, fx);
+            return fx;
+        }
+
+        switch (inst.opcode)
+        {
+        case OPCODE_SPECIAL:
+            switch (inst.function)
+            {
+            case SPECIAL_SLL:
+            case SPECIAL_SRL:
+            case SPECIAL_SRA:
+            case SPECIAL_DSLL:
+            case SPECIAL_DSRL:
+            case SPECIAL_DSRA:
+            case SPECIAL_DSLL32:
+            case SPECIAL_DSRL32:
+            case SPECIAL_DSRA32:
+                reads(fx, gprs(rt));
+                writes(fx, gprs(rd));
+                break;
+            case SPECIAL_SLLV:
+            case SPECIAL_SRLV:
+            case SPECIAL_SRAV:
+            case SPECIAL_DSLLV:
+            case SPECIAL_DSRLV:
+            case SPECIAL_DSRAV:
+            case SPECIAL_ADDU:
+            case SPECIAL_SUBU:
+            case SPECIAL_AND:
+            case SPECIAL_OR:
+            case SPECIAL_XOR:
+            case SPECIAL_NOR:
+            case SPECIAL_SLT:
+            case SPECIAL_SLTU:
+            case SPECIAL_DADD:
+            case SPECIAL_DADDU:
+            case SPECIAL_DSUB:
+            case SPECIAL_DSUBU:
+                reads(fx, gprs(rs | rt));
+                writes(fx, gprs(rd));
+                break;
+            case SPECIAL_MOVZ:
+            case SPECIAL_MOVN:
+                reads(fx, gprs(rs | rt | rd));
+                mayWrite(fx, gprs(rd));
+                break;
+            case SPECIAL_MFHI:
+                reads(fx, states(STATE_HI));
+                writes(fx, gprs(rd));
+                break;
+            case SPECIAL_MFLO:
+                reads(fx, states(STATE_LO));
+                writes(fx, gprs(rd));
+                break;
+            case SPECIAL_MFSA:
+                reads(fx, states(STATE_SA));
+                writes(fx, gprs(rd));
+                break;
+            case SPECIAL_MTHI:
+                reads(fx, gprs(rs));
+                writes(fx, states(STATE_HI));
+                break;
+            case SPECIAL_MTLO:
+                reads(fx, gprs(rs));
+                writes(fx, states(STATE_LO));
+                break;
+            case SPECIAL_MTSA:
+                reads(fx, gprs(rs));
+                writes(fx, states(STATE_SA));
+                break;
+            case SPECIAL_MULT:
+            case SPECIAL_MULTU:
+            case SPECIAL_DIV:
+            case SPECIAL_DIVU:
+                reads(fx, gprs(rs | rt));
+                writes(fx, states(STATE_HI | STATE_LO));
+                break;
+            case SPECIAL_SYNC:
+                break;
+            default: // JR, JALR, SYSCALL, BREAK, traps, ADD/SUB and anything unknown
+                makeBarrier(fx);
+                break;
+            }
+            break;
+
+        case OPCODE_REGIMM:
+            switch (inst.rt)
+            {
+            case REGIMM_BLTZ:
+            case REGIMM_BGEZ:
+            case REGIMM_BLTZL:
+            case REGIMM_BGEZL:
+                reads(fx, gprs(rs));
+                break;
+            case REGIMM_BLTZAL:
+            case REGIMM_BGEZAL:
+            case REGIMM_BLTZALL:
+            case REGIMM_BGEZALL:
+                reads(fx, gprs(rs));
+                writes(fx, gprs(gprBit(kRaReg)));
+                break;
+            case REGIMM_MTSAB:
+            case REGIMM_MTSAH:
+                reads(fx, gprs(rs));
+                writes(fx, states(STATE_SA));
+                break;
+            default:
+                makeBarrier(fx);
+                break;
+            }
+            break;
+
+        case OPCODE_J:
+        case OPCODE_JAL:
+            makeBarrier(fx);
+            break;
+
+        case OPCODE_BEQ:
+        case OPCODE_BNE:
+        case OPCODE_BEQL:
+        case OPCODE_BNEL:
+            reads(fx, gprs(rs | rt));
+            break;
+        case OPCODE_BLEZ:
+        case OPCODE_BGTZ:
+        case OPCODE_BLEZL:
+        case OPCODE_BGTZL:
+            reads(fx, gprs(rs));
+            break;
+
+        case OPCODE_ADDIU:
+        case OPCODE_SLTI:
+        case OPCODE_SLTIU:
+        case OPCODE_ANDI:
+        case OPCODE_ORI:
+        case OPCODE_XORI:
+        case OPCODE_DADDIU:
+        case OPCODE_LB:
+        case OPCODE_LH:
+        case OPCODE_LW:
+        case OPCODE_LBU:
+        case OPCODE_LHU:
+        case OPCODE_LWU:
+        case OPCODE_LD:
+        case OPCODE_LQ:
+            reads(fx, gprs(rs));
+            writes(fx, gprs(rt));
+            break;
+        case OPCODE_LWL:
+        case OPCODE_LWR:
+        case OPCODE_LDL:
+        case OPCODE_LDR:
+            reads(fx, gprs(rs | rt));
+            writes(fx, gprs(rt));
+            break;
+        case OPCODE_LUI:
+            writes(fx, gprs(rt));
+            break;
+
+        case OPCODE_SB:
+        case OPCODE_SH:
+        case OPCODE_SW:
+        case OPCODE_SD:
+        case OPCODE_SQ:
+        case OPCODE_SWL:
+        case OPCODE_SWR:
+        case OPCODE_SDL:
+        case OPCODE_SDR:
+            reads(fx, gprs(rs | rt));
+            break;
+        case OPCODE_LWC1:
+            reads(fx, gprs(rs));
+            writes(fx, fprs(fprBit(inst.rt)));
+            break;
+        case OPCODE_SWC1:
+            reads(fx, gprs(rs) | fprs(fprBit(inst.rt)));
+            break;
+        case OPCODE_LDC2:
+        case OPCODE_SDC2:
+            reads(fx, gprs(rs));
+            break;
+        case OPCODE_CACHE:
+        case OPCODE_PREF:
+            break;
+
+        case OPCODE_COP0:
+            if (inst.rs == COP0_MF)
+                mayWrite(fx, gprs(rt));
+            else if (inst.rs == COP0_MT)
+                reads(fx, gprs(rt));
+            else if (inst.rs != COP0_BC)
+                makeBarrier(fx); // ERET, TLB ops, EI/DI
+            break;
+        case OPCODE_COP1:
+            getFPUEffects(inst, fx);
+            break;
+        case OPCODE_COP2:
+            getVUEffects(inst, fx);
+            break;
+
+        default: // ADDI/DADDI (overflow exceptions) and anything we do not know
+            makeBarrier(fx);
+            break;
+        }
+
+        return fx;
+    }
+
+    std::string describeRegisters(const RegisterSet &set)
+    {
+        static const char *const kStateNames[] = {"hi", "lo", "hi1", "lo1", "sa", "fcc", "fcr31",
+                                                  "vu0_status", "vu0_mac", "vu0_clip"};
+        std::string out;
+        auto append = [&](const std::string &name)
+        {
+            if (!out.empty())
+                out += ", ";
+            out += name;
+        };
+
+        for (uint32_t reg = 1; reg < 32; ++reg)
+        {
+            if (set.gpr & (1u << reg))
+                append("$" + std::to_string(reg));
+        }
+        for (uint32_t reg = 0; reg < 32; ++reg)
+        {
+            if (set.fpr & (1u << reg))
+                append("f" + std::to_string(reg));
+        }
+        for (uint32_t bit = 0; bit < std::size(kStateNames); ++bit)
+        {
+            if (set.state & (1u << bit))
+                append(kStateNames[bit]);
+        }
+        return out;
+    }
+
+    namespace
+    {
+        struct ConstantState
+        {
+            uint32_t known = 0;
+            std::array<uint32_t, 32> values = {};
+
+            bool get(uint32_t reg, uint32_t &value) const
+            {
+                if (reg == 0)
+                {
+                    value = 0;
+                    return true;
+                }
+                if (!(known & (1u << reg)))
+                    return false;
+                value = values[reg];
+                return true;
+            }
+
+            void set(uint32_t reg, uint32_t value)
+            {
+                if (reg == 0)
+                    return;
+                known |= 1u << reg;
+                values[reg] = value;
+            }
+        };
+
+        // Result of inst if every operand it reads is known. Only covers what the
+        // generated code computes as a zero-extended 32-bit value.
+        bool foldResult(const Instruction &inst, const ConstantState &state, uint8_t &dest, uint32_t &result)
+        {
+            uint32_t a = 0;
+            uint32_t b = 0;
+
+            if (inst.isMMI)
+                return false;
+
+            switch (inst.opcode)
+            {
+            case OPCODE_LUI:
+                dest = static_cast<uint8_t>(inst.rt);
+                result = inst.immediate << 16;
+                return true;
+            case OPCODE_ADDIU:
+            case OPCODE_ANDI:
+            case OPCODE_ORI:
+            case OPCODE_XORI:
+            case OPCODE_DADDIU:
+                if (!state.get(inst.rs, a))
+                    return false;
+                dest = static_cast<uint8_t>(inst.rt);
+                switch (inst.opcode)
+                {
+                case OPCODE_ADDIU:
+                    result = a + inst.simmediate;
+                    return true;
+                case OPCODE_ANDI:
+                    result = a & inst.immediate;
+                    return true;
+                case OPCODE_ORI:
+                    result = a | inst.immediate;
+                    return true;
+                case OPCODE_XORI:
+                    result = a ^ inst.immediate;
+                    return true;
+                default:
+                {
+                    // 64-bit add; only fold when the sum still fits the zero-extended form.
+                    if (inst.simmediate & 0x80000000u)
+                        return false;
+                    uint64_t sum = static_cast<uint64_t>(a) + inst.simmediate;
+                    result = static_cast<uint32_t>(sum);
+                    return sum <= 0xFFFFFFFFull;
+                }
+                }
+            case OPCODE_SPECIAL:
+                break;
+            default:
+                return false;
+            }
+
+            switch (inst.function)
+            {
+            case SPECIAL_SLL:
+            case SPECIAL_SRL:
+            case SPECIAL_SRA:
+                if (!state.get(inst.rt, b))
+                    return false;
+                dest = static_cast<uint8_t>(inst.rd);
+                if (inst.function == SPECIAL_SLL)
+                    result = b << inst.sa;
+                else if (inst.function == SPECIAL_SRL)
+                    result = b >> inst.sa;
+                else
+                    result = static_cast<uint32_t>(static_cast<int32_t>(b) >> inst.sa);
+                return true;
+            case SPECIAL_SLLV:
+            case SPECIAL_SRLV:
+            case SPECIAL_SRAV:
+            case SPECIAL_ADDU:
+            case SPECIAL_SUBU:
+            case SPECIAL_AND:
+            case SPECIAL_OR:
+            case SPECIAL_XOR:
+            case SPECIAL_NOR:
+            case SPECIAL_SLT:
+            case SPECIAL_SLTU:
+            case SPECIAL_DADD:
+            case SPECIAL_DADDU:
+            case SPECIAL_DSUB:
+            case SPECIAL_DSUBU:
+                if (!state.get(inst.rs, a) || !state.get(inst.rt, b))
+                    return false;
+                dest = static_cast<uint8_t>(inst.rd);
+                break;
+            default:
+                return false;
+            }
+
+            switch (inst.function)
+            {
+            case SPECIAL_SLLV:
+                result = b << (a & 0x1F);
+                return true;
+            case SPECIAL_SRLV:
+                result = b >> (a & 0x1F);
+                return true;
+            case SPECIAL_SRAV:
+                result = static_cast<uint32_t>(static_cast<int32_t>(b) >> (a & 0x1F));
+                return true;
+            case SPECIAL_ADDU:
+                result = a + b;
+                return true;
+            case SPECIAL_SUBU:
+                result = a - b;
+                return true;
+            case SPECIAL_AND:
+                result = a & b;
+                return true;
+            case SPECIAL_OR:
+                result = a | b;
+                return true;
+            case SPECIAL_XOR:
+                result = a ^ b;
+                return true;
+            case SPECIAL_NOR:
+                result = ~(a | b);
+                return true;
+            case SPECIAL_SLT:
+                result = static_cast<int32_t>(a) < static_cast<int32_t>(b) ? 1 : 0;
+                return true;
+            case SPECIAL_SLTU:
+                result = a < b ? 1 : 0;
+                return true;
+            case SPECIAL_DADD:
+            case SPECIAL_DADDU:
+            {
+                uint64_t sum = static_cast<uint64_t>(a) + b;
+                result = static_cast<uint32_t>(sum);
+                return sum <= 0xFFFFFFFFull;
+            }
+            default: // DSUB/DSUBU
+                result = a - b;
+                return a >= b;
+            }
+        }
+    }
+
+    FunctionAnalysis::FunctionAnalysis(const std::vector<Instruction> &instructions,
+                                       const std::unordered_set<uint32_t> &internalTargets, uint32_t gp)
+    {
+        if (instructions.empty())
+            return;
+
+        m_base = instructions.front().address;
+        uint32_t span = (instructions.back().address - m_base) / 4 + 1;
+        if (instructions.back().address < m_base || span > instructions.size() * 4)
+            span = static_cast<uint32_t>(instructions.size());
+        m_facts.resize(span);
+
+        for (const Instruction &inst : instructions)
+        {
+            if (InstructionFacts *facts = slot(inst))
+            {
+                facts->address = inst.address;
+                facts->raw = inst.raw;
+            }
+        }
+
+        propagateConstants(instructions, internalTargets, gp);
+        computeLiveness(instructions, internalTargets);
+    }
+
+    InstructionFacts *FunctionAnalysis::slot(const Instruction &inst)
+    {
+        if (inst.address < m_base || (inst.address - m_base) % 4 != 0)
+            return nullptr;
+
+        size_t index = (inst.address - m_base) / 4;
+        return index < m_facts.size() ? &m_facts[index] : nullptr;
+    }
+
+    const InstructionFacts *FunctionAnalysis::find(const Instruction &inst) const
+    {
+        if (inst.address < m_base || (inst.address - m_base) % 4 != 0)
+            return nullptr;
+
+        size_t index = (inst.address - m_base) / 4;
+        if (index >= m_facts.size())
+            return nullptr;
+
+        const InstructionFacts &facts = m_facts[index];
+        if (facts.address != inst.address || facts.raw != inst.raw)
+            return nullptr;
+        return &facts;
+    }
+
+    void FunctionAnalysis::propagateConstants(const std::vector<Instruction> &instructions,
+                                              const std::unordered_set<uint32_t> &internalTargets, uint32_t gp)
+    {
+        // $gp only counts as a constant if nothing in this function writes it.
+        bool gpStable = gp != 0;
+        for (const Instruction &inst : instructions)
+        {
+            RegisterEffects fx = getRegisterEffects(inst);
+            if (!fx.barrier && (fx.mayDefs.gpr & gprBit(kGpReg)))
+            {
+                gpStable = false;
+                break;
+            }
+        }
+
+        ConstantState state;
+        auto reset = [&]()
+        {
+            state.known = 0;
+            if (gpStable)
+                state.set(kGpReg, gp);
+        };
+
+        auto visit = [&](const Instruction &inst)
+        {
+            InstructionFacts *facts = slot(inst);
+            if (!facts)
+                return;
+
+            uint32_t base = 0;
+            if (isMemoryAccess(inst) && state.get(inst.rs, base))
+            {
+                facts->baseKnown = true;
+                facts->baseValue = base + inst.simmediate;
+            }
+
+            uint8_t dest = 0;
+            uint32_t result = 0;
+            if (foldResult(inst, state, dest, result) && dest != 0)
+            {
+                facts->dest = dest;
+                facts->resultKnown = true;
+                facts->resultValue = result;
+            }
+
+            RegisterEffects fx = getRegisterEffects(inst);
+            if (fx.barrier)
+            {
+                reset();
+                return;
+            }
+
+            state.known &= ~fx.mayDefs.gpr;
+            if (facts->resultKnown)
+                state.set(facts->dest, facts->resultValue);
+        };
+
+        reset();
+        for (size_t i = 0; i < instructions.size(); ++i)
+        {
+            const Instruction &inst = instructions[i];
+            if (internalTargets.contains(inst.address))
+                reset();
+
+            if (!inst.hasDelaySlot || i + 1 >= instructions.size())
+            {
+                visit(inst);
+                continue;
+            }
+
+            // The generator puts a delay slot label ahead of the whole branch sequence.
+            const Instruction &delaySlot = instructions[i + 1];
+            if (internalTargets.contains(delaySlot.address))
+                reset();
+
+            // Link registers are written before the delay slot runs.
+            if (uint32_t link = linkRegister(inst))
+                state.set(link, inst.address + 8);
+
+            ConstantState beforeDelaySlot = state;
+            if (delaySlot.raw != 0)
+                visit(delaySlot);
+
+            if (getRegisterEffects(inst).barrier)
+            {
+                reset();
+            }
+            else if (isLikelyBranch(inst))
+            {
+                // Falling through skips the delay slot, so only keep what it leaves untouched.
+                uint32_t clobbered = getRegisterEffects(delaySlot).mayDefs.gpr;
+                state.known = beforeDelaySlot.known & ~clobbered;
+                state.values = beforeDelaySlot.values;
+                if (gpStable)
+                    state.set(kGpReg, gp);
+            }
+
+            ++i;
+        }
+    }
+
+    void FunctionAnalysis::computeLiveness(const std::vector<Instruction> &instructions,
+                                           const std::unordered_set<uint32_t> &internalTargets)
+    {
+        // One node per instruction, wired in the order the generator emits code:
+        //   non-likely: link, delay slot, condition, jump
+        //   likely:     link, condition, { delay slot, jump }
+        // so the condition of a non-likely branch is read at the end of its delay slot.
+        struct Node
+        {
+            RegisterSet uses;
+            RegisterSet defs;
+            RegisterSet extraOut; // read right after the node (branch condition)
+            bool barrier = false;
+            bool exits = false; // control may leave the function afterwards
+            size_t succ[2] = {SIZE_MAX, SIZE_MAX};
+        };
+
+        const size_t count = instructions.size();
+        std::vector<Node> nodes(count);
+        std::vector<RegisterEffects> effects(count);
+
+        // Registers read by the code that will actually be emitted for inst.
+        auto effectiveUses = [&](const Instruction &inst, const RegisterEffects &fx)
+        {
+            const InstructionFacts *facts = find(inst);
+            if (facts && facts->resultKnown)
+                return RegisterSet{};
+
+            RegisterSet uses = fx.uses;
+            if (facts && facts->baseKnown)
+            {
+                uses.gpr &= ~gprBit(inst.rs);
+                if (readsRtAsData(inst))
+                    uses.gpr |= gprBit(inst.rt);
+            }
+            return uses;
+        };
+
+        // A label on a delay slot is emitted ahead of its branch, so jumps there land on the branch.
+        std::unordered_map<uint32_t, size_t> nodeAt;
+        nodeAt.reserve(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            nodeAt.emplace(instructions[i].address, i);
+            if (instructions[i].hasDelaySlot && i + 1 < count)
+            {
+                nodeAt.emplace(instructions[i + 1].address, i);
+                ++i;
+            }
+        }
+
+        auto targetNode = [&](const Instruction &branch) -> size_t
+        {
+            uint32_t target = branchTarget(branch);
+            if (!internalTargets.contains(target))
+                return SIZE_MAX;
+            auto it = nodeAt.find(target);
+            return it != nodeAt.end() ? it->second : SIZE_MAX;
+        };
+
+        auto fallthrough = [&](Node &node, size_t next, int edge)
+        {
+            if (next < count)
+                node.succ[edge] = next;
+            else
+                node.exits = true;
+        };
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            const Instruction &inst = instructions[i];
+            effects[i] = getRegisterEffects(inst);
+            Node &node = nodes[i];
+
+            if (!inst.hasDelaySlot || i + 1 >= count)
+            {
+                node.uses = effectiveUses(inst, effects[i]);
+                node.defs = effects[i].mustDefs;
+                node.barrier = effects[i].barrier;
+                fallthrough(node, i + 1, 0);
+                continue;
+            }
+
+            const Instruction &delaySlot = instructions[i + 1];
+            effects[i + 1] = getRegisterEffects(delaySlot);
+            Node &slotNode = nodes[i + 1];
+            slotNode.uses = effectiveUses(delaySlot, effects[i + 1]);
+            slotNode.defs = effects[i + 1].mustDefs;
+            slotNode.barrier = effects[i + 1].barrier;
+
+            if (uint32_t link = linkRegister(inst))
+                node.defs = gprs(gprBit(link));
+            node.succ[0] = i + 1;
+
+            if (isJumpOrCall(inst))
+            {
+                // Calls, tail calls and indirect jumps: everything is observable afterwards.
+                slotNode.exits = true;
+            }
+            else if (inst.isBranch)
+            {
+                RegisterSet condition = effects[i].uses;
+                size_t target = targetNode(inst);
+                if (isLikelyBranch(inst))
+                {
+                    node.uses = condition;
+                    fallthrough(node, i + 2, 1);
+                    if (target != SIZE_MAX)
+                        slotNode.succ[0] = target;
+                    else
+                        slotNode.exits = true;
+                }
+                else
+                {
+                    slotNode.extraOut = condition;
+                    fallthrough(slotNode, i + 2, 0);
+                    if (target != SIZE_MAX)
+                        slotNode.succ[1] = target;
+                    else
+                        slotNode.exits = true;
+                }
+            }
+            else
+            {
+                node.uses = effectiveUses(inst, effects[i]);
+                node.defs = effects[i].mustDefs;
+                node.barrier = effects[i].barrier;
+                fallthrough(slotNode, i + 2, 0);
+            }
+
+            ++i;
+        }
+
+        std::vector<RegisterSet> liveIn(count);
+        std::vector<RegisterSet> liveOut(count);
+        bool changed = true;
+        while (changed)
+        {
+            changed = false;
+            for (size_t i = count; i-- > 0;)
+            {
+                const Node &node = nodes[i];
+                RegisterSet out = node.exits ? RegisterSet::all() : node.extraOut;
+                for (size_t succ : node.succ)
+                {
+                    if (succ != SIZE_MAX)
+                        out |= liveIn[succ];
+                }
+
+                RegisterSet in = node.barrier ? RegisterSet::all() : node.uses | out.without(node.defs);
+                liveOut[i] = out;
+                if (!(in == liveIn[i]))
+                {
+                    liveIn[i] = in;
+                    changed = true;
+                }
+            }
+        }
+
+        auto markDeadWrites = [&](size_t i)
+        {
+            InstructionFacts *facts = slot(instructions[i]);
+            const RegisterEffects &fx = effects[i];
+            if (!facts || fx.barrier)
+                return;
+
+            facts->deadDefs = fx.mustDefs.without(liveOut[i]);
+            facts->deadWrite = !fx.mustDefs.empty() && fx.mayDefs == fx.mustDefs &&
+                               facts->deadDefs == fx.mustDefs;
+        };
+
+        // Branches themselves are never dropped; their delay slots can be.
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (instructions[i].hasDelaySlot && i + 1 < count)
+                ++i;
+            markDeadWrites(i);
+        }
+    }
+}
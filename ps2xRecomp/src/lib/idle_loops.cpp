@@ -0,0 +1,210 @@
+#include "ps2recomp/idle_loops.h"
+#include "ps2recomp/control_flow.h"
+#include "ps2recomp/function_analysis.h"
+#include "ps2recomp/instructions.h"
+#include "ps2recomp/types.h"
+#include <algorithm>
+#include <array>
+#include <unordered_set>
+
+namespace ps2recomp
+{
+    namespace
+    {
+        constexpr size_t kMaxIdleLoopInstructions = 16;
+        constexpr uint32_t kCallResults = (1u << 2) | (1u << 3) | (1u << 31); // $v0, $v1 and the link
+
+        // GPRs a branch compares; false when it links or tests anything but GPRs.
+        bool branchRegisters(const Instruction &inst, uint32_t &mask)
+        {
+            switch (inst.opcode)
+            {
+            case OPCODE_BEQ:
+            case OPCODE_BNE:
+            case OPCODE_BEQL:
+            case OPCODE_BNEL:
+                mask = (1u << inst.rs) | (1u << inst.rt);
+                break;
+            case OPCODE_BLEZ:
+            case OPCODE_BGTZ:
+            case OPCODE_BLEZL:
+            case OPCODE_BGTZL:
+                mask = 1u << inst.rs;
+                break;
+            case OPCODE_REGIMM:
+                if (inst.rt != REGIMM_BLTZ && inst.rt != REGIMM_BGEZ && inst.rt != REGIMM_BLTZL && inst.rt != REGIMM_BGEZL)
+                    return false;
+                mask = 1u << inst.rs;
+                break;
+            default:
+                return false;
+            }
+            mask &= ~1u;
+            return true;
+        }
+
+        // What a register holds at some point of an iteration, ordered so the
+        // combination of two inputs is the larger one.
+        enum class Value : uint8_t
+        {
+            Stable,  // the same every iteration
+            Loaded,  // comes from memory, IO or a poll this iteration, through stable math
+            Changing // depends on what earlier iterations computed (counters, pointers)
+        };
+
+        // Whether the loop in instructions[begin, end) only waits on loads and polls.
+        bool isIdleLoop(const std::vector<Instruction> &instructions, size_t begin, size_t end, size_t latch,
+                        const std::function<bool(uint32_t)> &isPolling)
+        {
+            uint32_t first = instructions[begin].address;
+            uint32_t last = instructions[end - 1].address;
+
+            std::vector<RegisterEffects> effects(end - begin);
+            std::vector<bool> polls(end - begin, false);
+            std::vector<uint32_t> exits(end - begin, 0); // GPRs an exit compares, per branch
+            RegisterSet written;
+            for (size_t k = begin; k < end; ++k)
+            {
+                const Instruction &inst = instructions[k];
+                if (isMemoryStore(inst) || inst.isStore)
+                    return false;
+
+                if (inst.opcode == OPCODE_JAL)
+                {
+                    uint32_t target = buildAbsoluteJumpTarget(inst.address, inst.target);
+                    if (!isPolling(target))
+                        return false;
+                    polls[k - begin] = true;
+                    written.gpr |= kCallResults;
+                    continue;
+                }
+
+                if (inst.isBranch && !isJumpOrCall(inst))
+                {
+                    uint32_t mask = 0;
+                    if (!branchRegisters(inst, mask))
+                        return false;
+
+                    uint32_t target = branchTarget(inst);
+                    bool leaves = target < first || target > last;
+                    if (!isUnconditionalBranch(inst) && (k == latch || leaves))
+                        exits[k - begin] = mask | 0x1; // bit 0 marks an exit even when it only tests $zero
+                    continue;
+                }
+
+                RegisterEffects fx = getRegisterEffects(inst);
+                if (fx.barrier || ((fx.mayDefs.fpr | fx.mayDefs.state) & (fx.uses.fpr | fx.uses.state)))
+                    return false;
+                effects[k - begin] = fx;
+                written |= fx.mayDefs;
+            }
+
+            // Walk the body in order until the values entering an iteration settle; a
+            // register the loop writes starts out as Changing until shown otherwise.
+            std::array<Value, 32> entry;
+            for (uint32_t reg = 0; reg < 32; ++reg)
+                entry[reg] = (written.gpr >> reg) & 1 ? Value::Changing : Value::Stable;
+
+            for (size_t pass = 0; pass <= end - begin; ++pass)
+            {
+                std::array<Value, 32> value = entry;
+                bool hasExit = false;
+                bool waits = false;
+                bool changes = false;
+                auto input = [&](uint32_t mask)
+                {
+                    Value result = Value::Stable;
+                    for (uint32_t reg = 1; reg < 32; ++reg)
+                    {
+                        if ((mask >> reg) & 1)
+                            result = std::max(result, value[reg]);
+                    }
+                    return result;
+                };
+
+                for (size_t k = begin; k < end; ++k)
+                {
+                    const Instruction &inst = instructions[k];
+                    if (uint32_t mask = exits[k - begin])
+                    {
+                        Value condition = input(mask);
+                        hasExit = true;
+                        waits = waits || condition == Value::Loaded;
+                        changes = changes || condition == Value::Changing;
+                        continue;
+                    }
+
+                    uint32_t defs;
+                    Value result;
+                    if (polls[k - begin])
+                    {
+                        defs = kCallResults;
+                        result = Value::Loaded;
+                    }
+                    else if (isMemoryAccess(inst) || (inst.opcode == OPCODE_COP0 && inst.rs == COP0_MF))
+                    {
+                        defs = effects[k - begin].mayDefs.gpr;
+                        result = input(1u << inst.rs) == Value::Changing ? Value::Changing : Value::Loaded;
+                    }
+                    else
+                    {
+                        defs = effects[k - begin].mayDefs.gpr;
+                        result = input(effects[k - begin].uses.gpr);
+                        if ((effects[k - begin].uses.fpr & written.fpr) || (effects[k - begin].uses.state & written.state))
+                            result = Value::Changing;
+                    }
+
+                    for (uint32_t reg = 1; reg < 32; ++reg)
+                    {
+                        if ((defs >> reg) & 1)
+                            value[reg] = result;
+                    }
+                }
+
+                if (value == entry)
+                    return hasExit && waits && !changes;
+                entry = value;
+            }
+            return false;
+        }
+    }
+
+    bool isPollingCall(const std::string &name)
+    {
+        static const std::unordered_set<std::string> kPollingCalls = {
+            "PollSema", "iPollSema", "ReferSemaStatus", "iReferSemaStatus",
+            "PollEventFlag", "iPollEventFlag", "ReferEventFlagStatus", "iReferEventFlagStatus",
+            "ReferThreadStatus", "SifCheckStatRpc", "sceSifCheckStatRpc", "sceSifDmaStat", "GsGetIMR"};
+        return kPollingCalls.contains(name);
+    }
+
+    std::vector<uint32_t> findIdleLoops(const std::vector<Instruction> &instructions,
+                                        const std::function<bool(uint32_t)> &isPolling)
+    {
+        std::vector<uint32_t> loops;
+        if (instructions.empty())
+            return loops;
+
+        uint32_t base = instructions.front().address;
+        for (size_t latch = 0; latch + 1 < instructions.size(); ++latch)
+        {
+            const Instruction &inst = instructions[latch];
+            // The latch has to be the exit test, so the hook sees the loop being left.
+            if (!inst.isBranch || !inst.hasDelaySlot || isJumpOrCall(inst) || isUnconditionalBranch(inst))
+                continue;
+
+            uint32_t target = branchTarget(inst);
+            if (target > inst.address || target < base || (target - base) % 4 != 0)
+                continue;
+
+            size_t begin = (target - base) / 4;
+            size_t end = latch + 2; // through the delay slot
+            if (instructions[begin].address != target || end - begin > kMaxIdleLoopInstructions)
+                continue;
+
+            if (isIdleLoop(instructions, begin, end, latch, isPolling))
+                loops.push_back(inst.address);
+        }
+        return loops;
+    }
+}
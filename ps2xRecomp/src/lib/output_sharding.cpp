@@ -0,0 +1,119 @@
+#include "ps2recomp/output_sharding.h"
+#include "ps2recomp/types.h"
+#include <algorithm>
+#include <unordered_map>
+
+namespace ps2recomp
+{
+    // Call-graph order: each root followed by everything reachable from it that has
+    // not been placed yet, lowest callee address first.
+    static std::vector<size_t> localityOrder(const std::vector<Function> &functions,
+                                             const std::vector<size_t> &weights)
+    {
+        std::unordered_map<uint32_t, size_t> byStart;
+        std::vector<size_t> byAddress;
+        for (size_t i = 0; i < functions.size(); ++i)
+        {
+            if (weights[i] == 0)
+                continue;
+            byStart.emplace(functions[i].start, i);
+            byAddress.push_back(i);
+        }
+        std::sort(byAddress.begin(), byAddress.end(), [&](size_t a, size_t b)
+                  { return functions[a].start < functions[b].start; });
+
+        auto edges = [&](const std::vector<uint32_t> &addresses)
+        {
+            std::vector<size_t> result;
+            for (uint32_t address : addresses)
+            {
+                auto it = byStart.find(address);
+                if (it != byStart.end())
+                    result.push_back(it->second);
+            }
+            std::sort(result.begin(), result.end(), [&](size_t a, size_t b)
+                      { return functions[a].start < functions[b].start; });
+            result.erase(std::unique(result.begin(), result.end()), result.end());
+            return result;
+        };
+
+        std::vector<size_t> order;
+        order.reserve(byAddress.size());
+        std::vector<bool> placed(functions.size(), false);
+        std::vector<size_t> stack;
+
+        auto walk = [&](size_t root)
+        {
+            stack.push_back(root);
+            while (!stack.empty())
+            {
+                size_t index = stack.back();
+                stack.pop_back();
+                if (placed[index])
+                    continue;
+                placed[index] = true;
+                order.push_back(index);
+
+                std::vector<size_t> callees = edges(functions[index].callees);
+                for (auto it = callees.rbegin(); it != callees.rend(); ++it)
+                {
+                    if (!placed[*it])
+                        stack.push_back(*it);
+                }
+            }
+        };
+
+        for (size_t index : byAddress)
+        {
+            if (edges(functions[index].callers).empty())
+                walk(index);
+        }
+        // Whatever is left is only reachable from cycles.
+        for (size_t index : byAddress)
+        {
+            if (!placed[index])
+                walk(index);
+        }
+
+        return order;
+    }
+
+    std::vector<std::vector<size_t>> shardFunctions(const std::vector<Function> &functions,
+                                                     const std::vector<size_t> &weights, size_t shardCount,
+                                                     const std::vector<double> &hotness)
+    {
+        std::vector<size_t> order = localityOrder(functions, weights);
+        if (order.empty() || shardCount == 0)
+            return {};
+
+        size_t total = 0;
+        for (size_t index : order)
+            total += weights[index];
+
+        // A function goes to the shard its weight midpoint falls in, so boundaries only
+        // ever move forward and an oversized function does not drag its neighbours along.
+        std::vector<std::vector<size_t>> shards(std::min(shardCount, order.size()));
+        size_t before = 0;
+        for (size_t index : order)
+        {
+            size_t midpoint = before + weights[index] / 2;
+            size_t shard = std::min(shards.size() - 1, midpoint * shards.size() / total);
+            shards[shard].push_back(index);
+            before += weights[index];
+        }
+
+        shards.erase(std::remove_if(shards.begin(), shards.end(), [](const std::vector<size_t> &shard)
+                                    { return shard.empty(); }),
+                     shards.end());
+
+        if (!hotness.empty())
+        {
+            for (auto &shard : shards)
+            {
+                std::stable_sort(shard.begin(), shard.end(), [&](size_t a, size_t b)
+                                 { return hotness[a] > hotness[b]; });
+            }
+        }
+        return shards;
+    }
+}
@@ -0,0 +1,131 @@
+#include "ps2recomp/profile_data.h"
+#include "ps2_profile_format.h"
+#include "ps2_varint.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace ps2recomp
+{
+    bool ProfileData::load(const std::string &path)
+    {
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if (!in)
+        {
+            std::cerr << "Failed to open profile: " << path << std::endl;
+            return false;
+        }
+
+        std::vector<uint8_t> data(static_cast<size_t>(in.tellg()));
+        in.seekg(0);
+        in.read(reinterpret_cast<char *>(data.data()), data.size());
+
+        uint32_t header[2] = {};
+        if (!in || data.size() < sizeof(header))
+        {
+            std::cerr << "Profile is truncated: " << path << std::endl;
+            return false;
+        }
+        std::memcpy(header, data.data(), sizeof(header));
+        if (header[0] != ps2_profile_format::kMagic || header[1] != ps2_profile_format::kVersion)
+        {
+            std::cerr << "Not a version " << ps2_profile_format::kVersion << " profile: " << path << std::endl;
+            return false;
+        }
+
+        std::unordered_map<uint32_t, uint64_t> entries;
+        std::unordered_map<uint32_t, BranchCounts> branches;
+        size_t pos = sizeof(header);
+        uint64_t count = 0;
+        bool ok = ps2_varint::get(data, pos, count);
+        uint64_t address = 0;
+        for (uint64_t i = 0; ok && i < count; ++i)
+        {
+            uint64_t delta = 0, entered = 0;
+            ok = ps2_varint::get(data, pos, delta) && ps2_varint::get(data, pos, entered);
+            address += delta;
+            entries[static_cast<uint32_t>(address)] += entered;
+        }
+
+        ok = ok && ps2_varint::get(data, pos, count);
+        address = 0;
+        for (uint64_t i = 0; ok && i < count; ++i)
+        {
+            uint64_t delta = 0;
+            BranchCounts counts;
+            ok = ps2_varint::get(data, pos, delta) && ps2_varint::get(data, pos, counts.taken) && ps2_varint::get(data, pos, counts.notTaken);
+            address += delta;
+            branches[static_cast<uint32_t>(address)] = counts;
+        }
+
+        if (!ok)
+        {
+            std::cerr << "Profile is corrupt: " << path << std::endl;
+            return false;
+        }
+
+        m_entries = std::move(entries);
+        m_branches = std::move(branches);
+        return true;
+    }
+
+    bool ProfileData::save(const std::string &path) const
+    {
+        std::vector<std::pair<uint32_t, uint64_t>> entries(m_entries.begin(), m_entries.end());
+        std::sort(entries.begin(), entries.end());
+        std::vector<std::pair<uint32_t, BranchCounts>> branches(m_branches.begin(), m_branches.end());
+        std::sort(branches.begin(), branches.end(), [](const auto &a, const auto &b)
+                  { return a.first < b.first; });
+
+        std::vector<uint8_t> data;
+        ps2_varint::put(data, entries.size());
+        uint32_t previous = 0;
+        for (const auto &[address, count] : entries)
+        {
+            ps2_varint::put(data, address - previous);
+            ps2_varint::put(data, count);
+            previous = address;
+        }
+        ps2_varint::put(data, branches.size());
+        previous = 0;
+        for (const auto &[address, counts] : branches)
+        {
+            ps2_varint::put(data, address - previous);
+            ps2_varint::put(data, counts.taken);
+            ps2_varint::put(data, counts.notTaken);
+            previous = address;
+        }
+
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        uint32_t header[2] = {ps2_profile_format::kMagic, ps2_profile_format::kVersion};
+        out.write(reinterpret_cast<const char *>(header), sizeof(header));
+        out.write(reinterpret_cast<const char *>(data.data()), data.size());
+        if (!out)
+        {
+            std::cerr << "Failed to write profile: " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    uint64_t ProfileData::entries(uint32_t address) const
+    {
+        auto it = m_entries.find(address);
+        return it != m_entries.end() ? it->second : 0;
+    }
+
+    const ProfileData::BranchCounts *ProfileData::branch(uint32_t address) const
+    {
+        auto it = m_branches.find(address);
+        return it != m_branches.end() ? &it->second : nullptr;
+    }
+
+    void ProfileData::addBranch(uint32_t address, uint64_t taken, uint64_t notTaken)
+    {
+        BranchCounts &counts = m_branches[address];
+        counts.taken += taken;
+        counts.notTaken += notTaken;
+    }
+}
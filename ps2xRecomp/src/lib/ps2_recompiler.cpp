@@ -1,8 +1,12 @@
 #include "ps2recomp/ps2_recompiler.h"
+#include "ps2recomp/control_flow.h"
 #include "ps2recomp/instructions.h"
 #include "ps2recomp/types.h"
 #include "ps2recomp/elf_parser.h"
 #include "ps2recomp/r5900_decoder.h"
+#include "ps2recomp/decoded_image.h"
+#include "ps2recomp/output_sharding.h"
+#include "ps2recomp/parallel.h"
 #include "ps2_runtime_calls.h"
 #include <iostream>
 #include <fstream>
@@ -10,10 +14,12 @@
 #include <algorithm>
 #include <stdexcept>
 #include <filesystem>
+#include <iomanip>
 #include <cctype>
 #include <unordered_set>
 #include <optional>
 #include <limits>
+#include <set>
 
 namespace fs = std::filesystem;
 
@@ -28,11 +34,6 @@ namespace ps2recomp
             Stub
         };
 
-        uint32_t decodeAbsoluteJumpTarget(uint32_t address, uint32_t target)
-        {
-            return ((address + 4) & 0xF0000000u) | (target << 2);
-        }
-
         bool isReservedCxxIdentifier(const std::string &name)
         {
             if (name.size() >= 2 && name[0] == '_' && name[1] == '_')
@@ -90,6 +91,50 @@ namespace ps2recomp
             }
             return StubTarget::Unknown;
         }
+
+        struct FunctionInterval
+        {
+            uint32_t start;  // the interval runs up to the next entry's start
+            size_t function; // index into functions, SIZE_MAX when no function covers it
+        };
+
+        // Sorted address intervals, each owned by the first function in functions that
+        // contains it: the same answer as a linear scan, found with one binary search.
+        std::vector<FunctionInterval> buildFunctionIntervals(const std::vector<Function> &functions)
+        {
+            std::vector<std::pair<uint32_t, size_t>> starts;
+            std::vector<std::pair<uint32_t, size_t>> ends;
+            for (size_t i = 0; i < functions.size(); ++i)
+            {
+                if (functions[i].start < functions[i].end)
+                {
+                    starts.emplace_back(functions[i].start, i);
+                    ends.emplace_back(functions[i].end, i);
+                }
+            }
+            std::sort(starts.begin(), starts.end());
+            std::sort(ends.begin(), ends.end());
+
+            std::vector<FunctionInterval> intervals;
+            std::set<size_t> active;
+            size_t s = 0;
+            size_t e = 0;
+            while (s < starts.size() || e < ends.size())
+            {
+                uint32_t boundary = e == ends.size() || (s < starts.size() && starts[s].first < ends[e].first)
+                                        ? starts[s].first
+                                        : ends[e].first;
+                for (; e < ends.size() && ends[e].first == boundary; ++e)
+                    active.erase(ends[e].second);
+                for (; s < starts.size() && starts[s].first == boundary; ++s)
+                    active.insert(starts[s].second);
+
+                size_t owner = active.empty() ? SIZE_MAX : *active.begin();
+                if (intervals.empty() || intervals.back().function != owner)
+                    intervals.push_back({boundary, owner});
+            }
+            return intervals;
+        }
     }
 
     PS2Recompiler::PS2Recompiler(const std::string &configPath)
@@ -115,10 +160,13 @@ namespace ps2recomp
             }
 
             m_elfParser = std::make_unique<ElfParser>(m_config.inputPath);
-            if (!m_elfParser->parse())
             {
-                std::cerr << "Failed to parse ELF file: " << m_config.inputPath << std::endl;
-                return false;
+                StageProfiler::Scope scope(m_profiler, "parse");
+                if (!m_elfParser->parse())
+                {
+                    std::cerr << "Failed to parse ELF file: " << m_config.inputPath << std::endl;
+                    return false;
+                }
             }
 
             if (!m_config.ghidraMapPath.empty())
@@ -126,10 +174,13 @@ namespace ps2recomp
                 m_elfParser->loadGhidraFunctionMap(m_config.ghidraMapPath);
             }
 
-            m_functions = m_elfParser->extractFunctions();
-            m_symbols = m_elfParser->extractSymbols();
-            m_sections = m_elfParser->getSections();
-            m_relocations = m_elfParser->getRelocations();
+            {
+                StageProfiler::Scope scope(m_profiler, "extractFunctions");
+                m_functions = m_elfParser->extractFunctions();
+                m_symbols = m_elfParser->extractSymbols();
+                m_sections = m_elfParser->getSections();
+                m_relocations = m_elfParser->getRelocations();
+            }
 
             if (m_functions.empty())
             {
@@ -196,8 +247,34 @@ namespace ps2recomp
                       << m_relocations.size() << " relocations." << std::endl;
 
             m_decoder = std::make_unique<R5900Decoder>();
+            {
+                StageProfiler::Scope scope(m_profiler, "decodeImage");
+                m_decodedImage = std::make_unique<DecodedImage>(*m_elfParser, m_sections, *m_decoder);
+            }
             m_codeGenerator = std::make_unique<CodeGenerator>(m_symbols);
             m_codeGenerator->setBootstrapInfo(m_bootstrapInfo);
+            m_codeGenerator->setJumpTables(m_config.jumpTables);
+
+            std::unordered_set<uint32_t> idleLoops(m_config.idleLoops.begin(), m_config.idleLoops.end());
+            idleLoops.insert(m_config.idleLoopsForced.begin(), m_config.idleLoopsForced.end());
+            for (uint32_t address : m_config.idleLoopsDisabled)
+            {
+                idleLoops.erase(address);
+            }
+            m_codeGenerator->setIdleLoops(idleLoops);
+
+            m_codeGenerator->setProfileInstrumentation(m_config.instrumentProfile);
+
+            if (!m_config.profilePath.empty())
+            {
+                if (!m_profile.load(m_config.profilePath))
+                {
+                    return false;
+                }
+                std::cout << "Loaded profile with " << m_profile.functionCount() << " functions and "
+                          << m_profile.branchCount() << " branches" << std::endl;
+                m_codeGenerator->setProfile(&m_profile);
+            }
 
             fs::create_directories(m_config.outputPath);
 
@@ -235,7 +312,12 @@ namespace ps2recomp
                     continue;
                 }
 
-                if (!decodeFunction(function))
+                bool decoded;
+                {
+                    StageProfiler::Scope scope(m_profiler, "decodeFunction");
+                    decoded = decodeFunction(function);
+                }
+                if (!decoded)
                 {
                     ++failedCount;
                     std::cerr << "Skipping function due decode failure: " << function.name << std::endl;
@@ -252,7 +334,21 @@ namespace ps2recomp
 #endif
             }
 
-            discoverAdditionalEntryPoints();
+            {
+                StageProfiler::Scope scope(m_profiler, "discoverAdditionalEntryPoints");
+                discoverAdditionalEntryPoints();
+            }
+
+            {
+                StageProfiler::Scope scope(m_profiler, "linkCallGraph");
+                linkCallGraph();
+            }
+
+            if (m_config.inlineMaxInstructions > 0)
+            {
+                StageProfiler::Scope scope(m_profiler, "selectInlineFunctions");
+                selectInlineFunctions();
+            }
 
             if (failedCount > 0)
             {
@@ -271,6 +367,7 @@ namespace ps2recomp
 
     void PS2Recompiler::generateOutput()
     {
+        StageProfiler::Scope scope(m_profiler, "generateOutput");
         try
         {
             m_functionRenames.clear();
@@ -372,7 +469,11 @@ namespace ps2recomp
 
             generateFunctionHeader();
 
-            if (m_config.singleFileOutput)
+            if (m_config.outputShards > 0)
+            {
+                generateShardedOutput();
+            }
+            else if (m_config.singleFileOutput)
             {
                 std::stringstream combinedOutput;
 
@@ -403,7 +504,7 @@ namespace ps2recomp
                         }
                         else
                         {
-                            const auto &instructions = m_decodedFunctions.at(function.start);
+                            std::vector<Instruction> instructions = m_decodedFunctions.at(function.start).unpack();
                             std::string code = m_codeGenerator->generateFunction(function, instructions, false);
                             combinedOutput << code << "\n\n";
                         }
@@ -456,7 +557,7 @@ namespace ps2recomp
                         }
                         else
                         {
-                            const auto &instructions = m_decodedFunctions.at(function.start);
+                            std::vector<Instruction> instructions = m_decodedFunctions.at(function.start).unpack();
                             code = m_codeGenerator->generateFunction(function, instructions, true);
                         }
                     }
@@ -491,6 +592,147 @@ namespace ps2recomp
         }
     }
 
+    void PS2Recompiler::generateShardedOutput()
+    {
+        std::vector<size_t> weights(m_functions.size(), 0);
+        for (size_t i = 0; i < m_functions.size(); ++i)
+        {
+            const Function &function = m_functions[i];
+            if (function.isStub)
+            {
+                weights[i] = 1;
+            }
+            else if (function.isRecompiled)
+            {
+                auto decodedIt = m_decodedFunctions.find(function.start);
+                weights[i] = decodedIt != m_decodedFunctions.end() ? std::max<size_t>(1, decodedIt->second.size()) : 1;
+            }
+        }
+
+        // Functions that never ran in the profile go to their own TUs, away from the
+        // hot code; the rest are ordered hottest first inside each shard.
+        std::vector<size_t> coldWeights(m_functions.size(), 0);
+        std::vector<double> hotness(m_functions.size(), 0.0);
+        bool hasHotness = false;
+        for (size_t i = 0; i < m_functions.size(); ++i)
+        {
+            const Function &function = m_functions[i];
+            if (function.isRecompiled && !function.isStub && m_profile.isCold(function.start))
+            {
+                coldWeights[i] = weights[i];
+                weights[i] = 0;
+            }
+            hotness[i] = functionHotness(function);
+            hasHotness = hasHotness || hotness[i] > 0.0;
+        }
+        if (!hasHotness)
+        {
+            hotness.clear();
+        }
+
+        std::vector<std::vector<size_t>> shards = shardFunctions(m_functions, weights, m_config.outputShards, hotness);
+        fs::path outputDir(m_config.outputPath);
+
+        // Every shard includes the same headers, so the generated CMakeLists.txt
+        // precompiles them once.
+        std::stringstream pch;
+        pch << "#pragma once\n\n";
+        pch << "#include \"ps2_recompiled_functions.h\"\n";
+        pch << "#include \"ps2_runtime_macros.h\"\n";
+        pch << "#include \"ps2_runtime.h\"\n";
+        pch << "#include \"ps2_recompiled_stubs.h\"\n";
+        pch << "#include \"ps2_syscalls.h\"\n";
+        pch << "#include \"ps2_stubs.h\"\n";
+        writeToFile((outputDir / "ps2_recompiled_pch.h").string(), pch.str());
+
+        std::vector<std::string> sources;
+        if (shards.empty() && m_bootstrapInfo.valid)
+        {
+            shards.emplace_back();
+        }
+
+        size_t hotShardCount = shards.size();
+        std::vector<std::vector<size_t>> coldShards =
+            shardFunctions(m_functions, coldWeights, std::max<size_t>(1, m_config.outputShards / 4));
+        shards.insert(shards.end(), coldShards.begin(), coldShards.end());
+
+        for (size_t shard = 0; shard < shards.size(); ++shard)
+        {
+            std::stringstream out;
+            out << "#include \"ps2_recompiled_pch.h\"\n\n";
+            if (shard == 0 && m_bootstrapInfo.valid)
+            {
+                out << m_codeGenerator->generateBootstrapFunction() << "\n\n";
+            }
+
+            for (size_t index : shards[shard])
+            {
+                const Function &function = m_functions[index];
+                try
+                {
+                    if (function.isStub)
+                    {
+                        out << m_generatedStubs.at(function.start) << "\n\n";
+                    }
+                    else
+                    {
+                        std::vector<Instruction> instructions = m_decodedFunctions.at(function.start).unpack();
+                        out << m_codeGenerator->generateFunction(function, instructions, false) << "\n\n";
+                    }
+                }
+                catch (const std::exception &e)
+                {
+                    std::cerr << "Error generating code for function "
+                              << function.name << " (start 0x"
+                              << std::hex << function.start << "): "
+                              << e.what() << std::endl;
+                    throw;
+                }
+            }
+
+            std::stringstream name;
+            if (shard < hotShardCount)
+            {
+                name << "ps2_recompiled_shard_" << std::setw(3) << std::setfill('0') << shard << ".cpp";
+            }
+            else
+            {
+                name << "ps2_recompiled_cold_" << std::setw(3) << std::setfill('0') << (shard - hotShardCount) << ".cpp";
+            }
+            sources.push_back(name.str());
+            writeToFile((outputDir / name.str()).string(), out.str());
+        }
+        sources.push_back("register_functions.cpp");
+
+        std::stringstream cmake;
+        cmake << "# Generated by ps2recomp. Pull into a project with add_subdirectory() and link\n";
+        cmake << "# ps2_recompiled next to ps2_runtime.\n";
+        cmake << "cmake_minimum_required(VERSION 3.16)\n\n";
+        cmake << "add_library(ps2_recompiled OBJECT\n";
+        for (const auto &source : sources)
+        {
+            cmake << "    " << source << "\n";
+        }
+        cmake << ")\n\n";
+        cmake << "target_include_directories(ps2_recompiled PUBLIC ${CMAKE_CURRENT_SOURCE_DIR})\n";
+        cmake << "target_link_libraries(ps2_recompiled PUBLIC ps2_runtime)\n";
+        cmake << "target_precompile_headers(ps2_recompiled PRIVATE ps2_recompiled_pch.h)\n";
+        writeToFile((outputDir / "CMakeLists.txt").string(), cmake.str());
+
+        std::cout << "Wrote " << m_functions.size() << " functions in " << shards.size()
+                  << " shards (" << coldShards.size() << " cold) to: " << m_config.outputPath << std::endl;
+    }
+
+    size_t PS2Recompiler::decodedInstructionCount() const
+    {
+        size_t count = 0;
+        for (const auto &[start, instructions] : m_decodedFunctions)
+        {
+            count += instructions.size();
+        }
+        return count;
+    }
+
     bool PS2Recompiler::generateStubHeader()
     {
         try
@@ -575,6 +817,102 @@ namespace ps2recomp
         }
     }
 
+    void PS2Recompiler::linkCallGraph()
+    {
+        std::unordered_map<uint32_t, Function *> byStart;
+        for (auto &function : m_functions)
+        {
+            function.callers.clear();
+            function.callees.clear();
+            if (function.isRecompiled)
+                byStart[function.start] = &function;
+        }
+
+        // Same edges as ElfAnalyzer's m_functionCalls: static jal targets that start a known
+        // function. Calls through a register or to anything else are only remembered.
+        m_callsUnknown.clear();
+        for (auto &function : m_functions)
+        {
+            auto decodedIt = m_decodedFunctions.find(function.start);
+            if (!function.isRecompiled || decodedIt == m_decodedFunctions.end())
+                continue;
+
+            const InstructionSpan &instructions = decodedIt->second;
+            for (size_t i = 0; i < instructions.size(); ++i)
+            {
+                const PackedInstruction &inst = instructions.words[i];
+                if (inst.opcode() == OPCODE_JAL)
+                {
+                    auto calleeIt = byStart.find(buildAbsoluteJumpTarget(instructions.addressOf(i), inst.target()));
+                    if (calleeIt == byStart.end())
+                    {
+                        m_callsUnknown.insert(function.start);
+                        continue;
+                    }
+                    function.callees.push_back(calleeIt->first);
+                    calleeIt->second->callers.push_back(function.start);
+                }
+                else if (inst.opcode() == OPCODE_SPECIAL && inst.function() == SPECIAL_JALR)
+                {
+                    m_callsUnknown.insert(function.start);
+                }
+            }
+        }
+    }
+
+    double PS2Recompiler::functionHotness(const Function &function) const
+    {
+        if (!m_profile.empty())
+            return static_cast<double>(m_profile.entries(function.start));
+
+        auto it = m_config.functionHotness.find(function.start);
+        return it != m_config.functionHotness.end() ? it->second : 0.0;
+    }
+
+    void PS2Recompiler::selectInlineFunctions()
+    {
+        // The hottest tenth of the functions may be inlined at twice the size limit.
+        std::vector<double> hotness;
+        for (const auto &function : m_functions)
+        {
+            double value = function.isRecompiled ? functionHotness(function) : 0.0;
+            if (value > 0.0)
+                hotness.push_back(value);
+        }
+        double hotThreshold = std::numeric_limits<double>::infinity();
+        if (!hotness.empty())
+        {
+            auto nth = hotness.begin() + hotness.size() * 9 / 10;
+            std::nth_element(hotness.begin(), nth, hotness.end());
+            hotThreshold = *nth;
+        }
+
+        // Anything calling through a register, or a stub, is never a leaf. Leaves that
+        // never ran in the profile stay out of line.
+        std::vector<Function> leaves;
+        for (const auto &function : m_functions)
+        {
+            if (!function.isRecompiled || !function.callees.empty() || m_callsUnknown.contains(function.start) ||
+                function.callers.empty() || m_profile.isCold(function.start))
+                continue;
+
+            const auto &instructions = m_decodedFunctions.at(function.start);
+            size_t limit = m_config.inlineMaxInstructions;
+            if (functionHotness(function) >= hotThreshold)
+                limit *= 2;
+            if (instructions.size() > limit)
+                continue;
+
+            Function leaf = function;
+            leaf.instructions = instructions.unpack();
+            leaves.push_back(std::move(leaf));
+        }
+
+        m_codeGenerator->setInlineFunctions(leaves);
+        std::cout << "Inlining " << m_codeGenerator->inlineFunctionCount() << " leaf functions of at most "
+                  << m_config.inlineMaxInstructions << " instructions" << std::endl;
+    }
+
     void PS2Recompiler::discoverAdditionalEntryPoints()
     {
         std::unordered_set<uint32_t> existingStarts;
@@ -583,60 +921,70 @@ namespace ps2recomp
             existingStarts.insert(function.start);
         }
 
-        auto getStaticBranchTarget = [](const Instruction &inst) -> std::optional<uint32_t>
+        auto getStaticBranchTarget = [](const PackedInstruction &inst, uint32_t address) -> std::optional<uint32_t>
         {
-            if (inst.opcode == OPCODE_J || inst.opcode == OPCODE_JAL)
+            if (inst.opcode() == OPCODE_J || inst.opcode() == OPCODE_JAL)
             {
-                return decodeAbsoluteJumpTarget(inst.address, inst.target);
+                return buildAbsoluteJumpTarget(address, inst.target());
             }
 
-            if (inst.opcode == OPCODE_SPECIAL &&
-                (inst.function == SPECIAL_JR || inst.function == SPECIAL_JALR))
+            if (inst.opcode() == OPCODE_SPECIAL &&
+                (inst.function() == SPECIAL_JR || inst.function() == SPECIAL_JALR))
             {
                 return std::nullopt;
             }
 
-            if (inst.isBranch)
+            if (inst.has(PackedInstruction::IS_BRANCH))
             {
-                int32_t offset = static_cast<int32_t>(inst.simmediate) << 2;
-                return inst.address + 4 + offset;
+                int32_t offset = static_cast<int32_t>(inst.simmediate()) << 2;
+                return address + 4 + offset;
             }
 
             return std::nullopt;
         };
 
+        std::vector<FunctionInterval> intervals = buildFunctionIntervals(m_functions);
         auto findContainingFunction = [&](uint32_t address) -> const Function *
         {
-            for (const auto &function : m_functions)
+            auto it = std::upper_bound(intervals.begin(), intervals.end(), address,
+                                       [](uint32_t value, const FunctionInterval &interval)
+                                       { return value < interval.start; });
+            if (it == intervals.begin() || (--it)->function == SIZE_MAX)
             {
-                if (address >= function.start && address < function.end)
-                {
-                    return &function;
-                }
+                return nullptr;
             }
-            return nullptr;
+            return &m_functions[it->function];
         };
 
-        std::vector<Function> newEntries;
-
-        for (const auto &function : m_functions)
+        // Each function's candidates are collected on its own, then merged in
+        // m_functions order so the result does not depend on scheduling.
+        struct Candidate
         {
+            uint32_t target;
+            const Function *containing;
+            InstructionSpan slice;
+        };
+        std::vector<std::vector<Candidate>> candidates(m_functions.size());
+
+        parallelFor(m_functions.size(), [&](size_t index)
+                    {
+            const Function &function = m_functions[index];
             if (!function.isRecompiled || function.isStub)
             {
-                continue;
+                return;
             }
 
             auto decodedIt = m_decodedFunctions.find(function.start);
             if (decodedIt == m_decodedFunctions.end())
             {
-                continue;
+                return;
             }
 
-            const auto &instructions = decodedIt->second;
+            const InstructionSpan &instructions = decodedIt->second;
 
-            for (const auto &inst : instructions)
+            for (size_t i = 0; i < instructions.size(); ++i)
             {
-                auto targetOpt = getStaticBranchTarget(inst);
+                auto targetOpt = getStaticBranchTarget(instructions.words[i], instructions.addressOf(i));
                 if (!targetOpt.has_value())
                 {
                     continue;
@@ -644,12 +992,7 @@ namespace ps2recomp
 
                 uint32_t target = targetOpt.value();
 
-                if ((target & 0x3) != 0 || !m_elfParser->isValidAddress(target))
-                {
-                    continue;
-                }
-
-                if (existingStarts.contains(target))
+                if ((target & 0x3) != 0 || existingStarts.contains(target) || !m_elfParser->isValidAddress(target))
                 {
                     continue;
                 }
@@ -666,30 +1009,38 @@ namespace ps2recomp
                     continue;
                 }
 
-                const auto &containingInstructions = containingDecodedIt->second;
-                auto sliceIt = std::find_if(containingInstructions.begin(), containingInstructions.end(),
-                                            [&](const Instruction &candidate)
-                                            { return candidate.address == target; });
+                // The entry point's code is a view into the containing function's words.
+                InstructionSpan slice = containingDecodedIt->second.from(target);
+                if (slice.empty())
+                {
+                    continue;
+                }
+
+                candidates[index].push_back({target, containingFunction, slice});
+            } });
 
-                if (sliceIt == containingInstructions.end())
+        std::vector<Function> newEntries;
+        for (const auto &functionCandidates : candidates)
+        {
+            for (const Candidate &candidate : functionCandidates)
+            {
+                if (!existingStarts.insert(candidate.target).second)
                 {
                     continue;
                 }
 
-                std::vector<Instruction> slicedInstructions(sliceIt, containingInstructions.end());
-                m_decodedFunctions[target] = slicedInstructions;
+                m_decodedFunctions[candidate.target] = candidate.slice;
 
                 Function entryFunction;
                 std::stringstream name;
-                name << "entry_" << std::hex << target;
+                name << "entry_" << std::hex << candidate.target;
                 entryFunction.name = name.str();
-                entryFunction.start = target;
-                entryFunction.end = containingFunction->end;
+                entryFunction.start = candidate.target;
+                entryFunction.end = candidate.containing->end;
                 entryFunction.isRecompiled = true;
                 entryFunction.isStub = false;
 
                 newEntries.push_back(entryFunction);
-                existingStarts.insert(target);
             }
         }
 
@@ -707,17 +1058,37 @@ namespace ps2recomp
 
     bool PS2Recompiler::decodeFunction(Function &function)
     {
-        std::vector<Instruction> instructions;
-        bool truncated = false;
-
         uint32_t start = function.start;
         uint32_t end = function.end;
 
+        // Functions inside the executable sections are views into the decoded image.
+        // Patched functions and code outside those sections get words of their own.
+        InstructionSpan cached = m_decodedImage->range(start, end);
+        bool patched = false;
+        for (uint32_t address = start; address < end && !patched && !m_config.patches.empty(); address += 4)
+        {
+            patched = m_config.patches.contains(address);
+        }
+
+        if (!patched && !cached.empty() && cached.addressOf(cached.size()) >= end)
+        {
+            m_decodedFunctions.insert_or_assign(function.start, cached);
+            return true;
+        }
+
+        std::vector<PackedInstruction> instructions;
+        bool truncated = false;
+
+        std::vector<uint32_t> words(end > start ? (end - start + 3) / 4 : 0);
+        size_t readable = m_elfParser->readWords(start, words.size(), words.data());
+        instructions.reserve(readable);
+
         for (uint32_t address = start; address < end; address += 4)
         {
             try
             {
-                if (!m_elfParser->isValidAddress(address))
+                size_t index = (address - start) / 4;
+                if (index >= readable)
                 {
                     std::cerr << "Invalid address: 0x" << std::hex << address << std::dec
                               << " in function: " << function.name
@@ -726,7 +1097,7 @@ namespace ps2recomp
                     break;
                 }
 
-                uint32_t rawInstruction = m_elfParser->readWord(address);
+                uint32_t rawInstruction = words[index];
 
                 auto patchIt = m_config.patches.find(address);
                 if (patchIt != m_config.patches.end())
@@ -744,9 +1115,15 @@ namespace ps2recomp
                     }
                 }
 
+                if (patchIt == m_config.patches.end() && index < cached.size())
+                {
+                    instructions.push_back(cached.words[index]);
+                    continue;
+                }
+
                 Instruction inst = m_decoder->decodeInstruction(address, rawInstruction);
 
-                instructions.push_back(inst);
+                instructions.push_back(PackedInstruction::pack(inst));
             }
             catch (const std::exception &e)
             {
@@ -767,10 +1144,12 @@ namespace ps2recomp
 
         if (truncated)
         {
-            function.end = instructions.back().address + 4;
+            function.end = start + static_cast<uint32_t>(instructions.size() * 4);
         }
 
-        m_decodedFunctions.insert_or_assign(function.start, std::move(instructions));
+        // The vector's buffer stays put when m_ownedCode grows, so the span stays valid.
+        m_ownedCode.push_back(std::move(instructions));
+        m_decodedFunctions.insert_or_assign(function.start, InstructionSpan{start, m_ownedCode.back()});
 
         return true;
     }
@@ -4,6 +4,97 @@
 
 namespace ps2recomp
 {
+    namespace
+    {
+        // Encodings decodeFast handles without rabbitizer. The flags give the same
+        // results decodeWithRabbitizer derives from the rabbitizer descriptor; anything
+        // with HI/LO, link, trap, COP0 or VU side effects is left to rabbitizer.
+        enum FastFlags : uint16_t
+        {
+            FAST_VALID = 1 << 0,
+            FAST_BRANCH = 1 << 1, // conditional branch with a delay slot
+            FAST_JUMP = 1 << 2,   // j
+            FAST_LOAD = 1 << 3,
+            FAST_STORE = 1 << 4,
+            FAST_WRITES_RT = 1 << 5,
+            FAST_WRITES_RD = 1 << 6,
+            FAST_WRITES_FPR = 1 << 7
+        };
+
+        struct FastTables
+        {
+            uint16_t primary[64] = {};
+            uint16_t special[64] = {};
+            uint16_t regimm[32] = {};
+            uint16_t mmi[64] = {};
+            uint16_t mmiGroup[4][32] = {}; // MMI0..MMI3 by sa
+            uint16_t cop1S[64] = {};
+        };
+
+        constexpr FastTables buildFastTables()
+        {
+            FastTables t;
+
+            constexpr uint16_t immediate = FAST_VALID | FAST_WRITES_RT;
+            for (uint32_t op : {OPCODE_ADDI, OPCODE_ADDIU, OPCODE_SLTI, OPCODE_SLTIU, OPCODE_ANDI, OPCODE_ORI,
+                                OPCODE_XORI, OPCODE_LUI, OPCODE_DADDI, OPCODE_DADDIU})
+                t.primary[op] = immediate;
+            for (uint32_t op : {OPCODE_BEQ, OPCODE_BNE, OPCODE_BLEZ, OPCODE_BGTZ,
+                                OPCODE_BEQL, OPCODE_BNEL, OPCODE_BLEZL, OPCODE_BGTZL})
+                t.primary[op] = FAST_VALID | FAST_BRANCH;
+            t.primary[OPCODE_J] = FAST_VALID | FAST_JUMP;
+            for (uint32_t op : {OPCODE_LB, OPCODE_LH, OPCODE_LWL, OPCODE_LW, OPCODE_LBU, OPCODE_LHU, OPCODE_LWR,
+                                OPCODE_LWU, OPCODE_LD, OPCODE_LDL, OPCODE_LDR, OPCODE_LQ})
+                t.primary[op] = FAST_VALID | FAST_LOAD | FAST_WRITES_RT;
+            t.primary[OPCODE_LWC1] = FAST_VALID | FAST_LOAD | FAST_WRITES_FPR;
+            for (uint32_t op : {OPCODE_SB, OPCODE_SH, OPCODE_SWL, OPCODE_SW, OPCODE_SDL, OPCODE_SDR, OPCODE_SWR,
+                                OPCODE_SD, OPCODE_SQ, OPCODE_SWC1})
+                t.primary[op] = FAST_VALID | FAST_STORE;
+
+            constexpr uint16_t writesRd = FAST_VALID | FAST_WRITES_RD;
+            for (uint32_t fn : {SPECIAL_SLL, SPECIAL_SRL, SPECIAL_SRA, SPECIAL_SLLV, SPECIAL_SRLV, SPECIAL_SRAV,
+                                SPECIAL_MOVZ, SPECIAL_MOVN, SPECIAL_MFHI, SPECIAL_MFLO, SPECIAL_DSLLV,
+                                SPECIAL_DSRLV, SPECIAL_DSRAV, SPECIAL_ADD, SPECIAL_ADDU, SPECIAL_SUB, SPECIAL_SUBU,
+                                SPECIAL_AND, SPECIAL_OR, SPECIAL_XOR, SPECIAL_NOR, SPECIAL_MFSA, SPECIAL_SLT,
+                                SPECIAL_SLTU, SPECIAL_DADD, SPECIAL_DADDU, SPECIAL_DSUB, SPECIAL_DSUBU,
+                                SPECIAL_DSLL, SPECIAL_DSRL, SPECIAL_DSRA, SPECIAL_DSLL32, SPECIAL_DSRL32,
+                                SPECIAL_DSRA32})
+                t.special[fn] = writesRd;
+            t.special[SPECIAL_SYNC] = FAST_VALID;
+
+            for (uint32_t rt : {REGIMM_BLTZ, REGIMM_BGEZ, REGIMM_BLTZL, REGIMM_BGEZL})
+                t.regimm[rt] = FAST_VALID | FAST_BRANCH;
+
+            for (uint32_t fn : {MMI_PLZCW, MMI_MFHI1, MMI_MFLO1, MMI_PSLLH, MMI_PSRLH, MMI_PSRAH, MMI_PSLLW,
+                                MMI_PSRLW, MMI_PSRAW})
+                t.mmi[fn] = writesRd;
+            for (uint32_t sa : {MMI0_PADDW, MMI0_PSUBW, MMI0_PCGTW, MMI0_PMAXW, MMI0_PADDH, MMI0_PSUBH, MMI0_PCGTH,
+                                MMI0_PMAXH, MMI0_PADDB, MMI0_PSUBB, MMI0_PCGTB, MMI0_PADDSW, MMI0_PSUBSW,
+                                MMI0_PEXTLW, MMI0_PPACW, MMI0_PADDSH, MMI0_PSUBSH, MMI0_PEXTLH, MMI0_PPACH,
+                                MMI0_PADDSB, MMI0_PSUBSB, MMI0_PEXTLB, MMI0_PPACB, MMI0_PEXT5, MMI0_PPAC5})
+                t.mmiGroup[0][sa] = writesRd;
+            for (uint32_t sa : {MMI1_PABSW, MMI1_PCEQW, MMI1_PMINW, MMI1_PADSBH, MMI1_PABSH, MMI1_PCEQH,
+                                MMI1_PMINH, MMI1_PCEQB, MMI1_PADDUW, MMI1_PSUBUW, MMI1_PEXTUW, MMI1_PADDUH,
+                                MMI1_PSUBUH, MMI1_PEXTUH, MMI1_PADDUB, MMI1_PSUBUB, MMI1_PEXTUB, MMI1_QFSRV})
+                t.mmiGroup[1][sa] = writesRd;
+            for (uint32_t sa : {MMI2_PSLLVW, MMI2_PSRLVW, MMI2_PMFHI, MMI2_PMFLO, MMI2_PINTH, MMI2_PCPYLD,
+                                MMI2_PAND, MMI2_PXOR, MMI2_PEXEH, MMI2_PREVH, MMI2_PEXEW, MMI2_PROT3W})
+                t.mmiGroup[2][sa] = writesRd;
+            for (uint32_t sa : {MMI3_PSRAVW, MMI3_PINTEH, MMI3_PCPYUD, MMI3_POR, MMI3_PNOR, MMI3_PEXCH,
+                                MMI3_PCPYH, MMI3_PEXCW})
+                t.mmiGroup[3][sa] = writesRd;
+
+            for (uint32_t fn : {COP1_S_ADD, COP1_S_SUB, COP1_S_MUL, COP1_S_DIV, COP1_S_SQRT, COP1_S_ABS,
+                                COP1_S_MOV, COP1_S_NEG, COP1_S_RSQRT, COP1_S_MAX, COP1_S_MIN, COP1_S_CVT_W})
+                t.cop1S[fn] = FAST_VALID | FAST_WRITES_FPR;
+            for (uint32_t fn = COP1_S_C_F; fn < 0x40; ++fn)
+                t.cop1S[fn] = FAST_VALID; // c.cond.s only sets the condition bit
+
+            return t;
+        }
+
+        constexpr FastTables kFastTables = buildFastTables();
+    }
 
     R5900Decoder::R5900Decoder()
     {
@@ -14,6 +105,16 @@ namespace ps2recomp
     }
 
     Instruction R5900Decoder::decodeInstruction(uint32_t address, uint32_t rawInstruction) const
+    {
+        return decode(address, rawInstruction, true);
+    }
+
+    Instruction R5900Decoder::decodeInstructionSlow(uint32_t address, uint32_t rawInstruction) const
+    {
+        return decode(address, rawInstruction, false);
+    }
+
+    Instruction R5900Decoder::decode(uint32_t address, uint32_t rawInstruction, bool useTables) const
 	{
         Instruction inst;
 
@@ -60,6 +161,121 @@ namespace ps2recomp
         inst.modificationInfo.modifiesMemory = false;
         inst.modificationInfo.modifiesControl = false;
 
+        if (!useTables || !decodeFast(inst))
+        {
+            decodeWithRabbitizer(inst);
+        }
+
+        inst.isMMI = inst.opcode == OPCODE_MMI;
+        inst.isVU = inst.opcode == OPCODE_COP2 ||
+                    inst.opcode == OPCODE_LWC2 ||
+                    inst.opcode == OPCODE_LDC2 ||
+                    inst.opcode == OPCODE_SWC2 ||
+                    inst.opcode == OPCODE_SDC2;
+
+        if (inst.opcode == OPCODE_COP2)
+        {
+            decodeCOP2(inst);
+        }
+        else if (inst.opcode == OPCODE_LWC2 || inst.opcode == OPCODE_LDC2)
+        {
+            inst.isVU = true;
+            inst.modificationInfo.modifiesVFR = true;
+        }
+        else if (inst.opcode == OPCODE_SWC2 || inst.opcode == OPCODE_SDC2)
+        {
+            inst.isVU = true;
+            inst.modificationInfo.modifiesMemory = true;
+        }
+
+        if (inst.opcode == OPCODE_LQ || inst.opcode == OPCODE_SQ)
+        {
+            inst.isMultimedia = true;
+        }
+
+        if (inst.isMMI || inst.isVU)
+        {
+            inst.isMultimedia = true;
+            inst.vectorInfo.isVector = inst.isVU; // Only VU ops are truly vector
+        }
+
+        return inst;
+    }
+
+    bool R5900Decoder::decodeFast(Instruction &inst) const
+    {
+        uint16_t flags = 0;
+        switch (inst.opcode)
+        {
+        case OPCODE_SPECIAL:
+            flags = kFastTables.special[inst.function];
+            break;
+        case OPCODE_REGIMM:
+            flags = kFastTables.regimm[inst.rt];
+            break;
+        case OPCODE_MMI:
+            switch (inst.function)
+            {
+            case MMI_MMI0:
+                flags = kFastTables.mmiGroup[0][inst.sa];
+                break;
+            case MMI_MMI1:
+                flags = kFastTables.mmiGroup[1][inst.sa];
+                break;
+            case MMI_MMI2:
+                flags = kFastTables.mmiGroup[2][inst.sa];
+                break;
+            case MMI_MMI3:
+                flags = kFastTables.mmiGroup[3][inst.sa];
+                break;
+            default:
+                flags = kFastTables.mmi[inst.function];
+                break;
+            }
+            break;
+        case OPCODE_COP1:
+            if (inst.rs == COP1_MF)
+                flags = FAST_VALID | FAST_WRITES_RT;
+            else if (inst.rs == COP1_MT)
+                flags = FAST_VALID | FAST_WRITES_FPR;
+            else if (inst.rs == COP1_BC && inst.rt <= COP1_BC_BCTL)
+                flags = FAST_VALID | FAST_BRANCH;
+            else if (inst.rs == COP1_S)
+                flags = kFastTables.cop1S[inst.function];
+            else if (inst.rs == COP1_W && inst.function == COP1_W_CVT_S)
+                flags = FAST_VALID | FAST_WRITES_FPR;
+            break;
+        default:
+            flags = kFastTables.primary[inst.opcode];
+            break;
+        }
+
+        if (!(flags & FAST_VALID))
+        {
+            return false;
+        }
+
+        if (flags & (FAST_BRANCH | FAST_JUMP))
+        {
+            inst.isBranch = (flags & FAST_BRANCH) != 0;
+            inst.isJump = (flags & FAST_JUMP) != 0;
+            inst.hasDelaySlot = true;
+            inst.modificationInfo.modifiesControl = true;
+        }
+        inst.isLoad = (flags & FAST_LOAD) != 0;
+        inst.isStore = (flags & FAST_STORE) != 0;
+        inst.modificationInfo.modifiesMemory = inst.isStore;
+        inst.modificationInfo.modifiesGPR = ((flags & FAST_WRITES_RT) && inst.rt != 0) ||
+                                            ((flags & FAST_WRITES_RD) && inst.rd != 0);
+        inst.modificationInfo.modifiesFPR = (flags & FAST_WRITES_FPR) != 0;
+        return true;
+    }
+
+    void R5900Decoder::decodeWithRabbitizer(Instruction &inst) const
+    {
+        const uint32_t rawInstruction = inst.raw;
+        const uint32_t address = inst.address;
+
         RabbitizerInstruction rabbitizerInst;
         RabbitizerInstructionR5900_init(&rabbitizerInst, rawInstruction, address);
         RabbitizerInstructionR5900_processUniqueId(&rabbitizerInst);
@@ -76,13 +292,6 @@ namespace ps2recomp
         inst.isLoad = RabbitizerInstrDescriptor_doesLoad(desc);
         inst.isStore = RabbitizerInstrDescriptor_doesStore(desc);
 
-        inst.isMMI = inst.opcode == OPCODE_MMI;
-        inst.isVU = inst.opcode == OPCODE_COP2 ||
-                    inst.opcode == OPCODE_LWC2 ||
-                    inst.opcode == OPCODE_LDC2 ||
-                    inst.opcode == OPCODE_SWC2 ||
-                    inst.opcode == OPCODE_SDC2;
-
         bool modifiesGpr = false;
         if (RabbitizerInstrDescriptor_modifiesRs(desc) && inst.rs != 0)
         {
@@ -140,35 +349,7 @@ namespace ps2recomp
             }
         }
 
-        if (inst.opcode == OPCODE_COP2)
-        {
-            decodeCOP2(inst);
-        }
-        else if (inst.opcode == OPCODE_LWC2 || inst.opcode == OPCODE_LDC2)
-        {
-            inst.isVU = true;
-            inst.modificationInfo.modifiesVFR = true;
-        }
-        else if (inst.opcode == OPCODE_SWC2 || inst.opcode == OPCODE_SDC2)
-        {
-            inst.isVU = true;
-            inst.modificationInfo.modifiesMemory = true;
-        }
-
-        if (inst.opcode == OPCODE_LQ || inst.opcode == OPCODE_SQ)
-        {
-            inst.isMultimedia = true;
-        }
-
-        if (inst.isMMI || inst.isVU)
-        {
-            inst.isMultimedia = true;
-            inst.vectorInfo.isVector = inst.isVU; // Only VU ops are truly vector
-        }
-
         RabbitizerInstructionR5900_destroy(&rabbitizerInst);
-
-        return inst;
     }
 
     void R5900Decoder::decodeRType(Instruction &inst) const
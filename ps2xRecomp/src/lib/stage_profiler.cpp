@@ -0,0 +1,120 @@
+#include "ps2recomp/stage_profiler.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+namespace ps2recomp
+{
+    StageProfiler::Scope::Scope(StageProfiler *profiler, const char *name)
+        : m_profiler(profiler), m_name(name), m_start(std::chrono::steady_clock::now())
+    {
+    }
+
+    StageProfiler::Scope::~Scope()
+    {
+        if (m_profiler)
+        {
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - m_start;
+            m_profiler->record(m_name, elapsed.count());
+        }
+    }
+
+    void StageProfiler::record(const std::string &name, double seconds)
+    {
+        auto it = std::find_if(m_stages.begin(), m_stages.end(),
+                               [&](const Stage &stage)
+                               { return stage.name == name; });
+        if (it == m_stages.end())
+        {
+            m_stages.push_back({name});
+            it = m_stages.end() - 1;
+        }
+        it->seconds += seconds;
+        it->calls++;
+        it->peakRssBytes = peakRssBytes();
+    }
+
+    void StageProfiler::report(std::ostream &out, uint64_t functionCount, uint64_t instructionCount) const
+    {
+        double total = 0.0;
+        for (const auto &stage : m_stages)
+        {
+            total += stage.seconds;
+        }
+
+        out << std::left << std::setw(32) << "stage" << std::right << std::setw(12) << "seconds"
+            << std::setw(8) << "%" << std::setw(14) << "peak RSS MB" << "\n";
+        out << std::fixed;
+        for (const auto &stage : m_stages)
+        {
+            out << std::left << std::setw(32) << stage.name << std::right
+                << std::setw(12) << std::setprecision(4) << stage.seconds
+                << std::setw(8) << std::setprecision(1) << (total > 0 ? 100.0 * stage.seconds / total : 0.0)
+                << std::setw(14) << std::setprecision(1) << stage.peakRssBytes / (1024.0 * 1024.0) << "\n";
+        }
+        out << std::left << std::setw(32) << "total" << std::right << std::setw(12) << std::setprecision(4) << total << "\n";
+
+        if (total > 0)
+        {
+            out << std::setprecision(0) << functionCount << " functions (" << functionCount / total << "/s), "
+                << instructionCount << " instructions (" << instructionCount / total << "/s)\n";
+        }
+        out << std::defaultfloat;
+    }
+
+    uint64_t StageProfiler::peakRssBytes()
+    {
+#if defined(_WIN32)
+        PROCESS_MEMORY_COUNTERS counters{};
+        if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        {
+            return counters.PeakWorkingSetSize;
+        }
+        return 0;
+#else
+        struct rusage usage{};
+        if (getrusage(RUSAGE_SELF, &usage) != 0)
+        {
+            return 0;
+        }
+#if defined(__APPLE__)
+        return static_cast<uint64_t>(usage.ru_maxrss); // bytes on macOS
+#else
+        return static_cast<uint64_t>(usage.ru_maxrss) * 1024; // KiB elsewhere
+#endif
+#endif
+    }
+
+    uint64_t StageProfiler::currentRssBytes()
+    {
+#if defined(_WIN32)
+        PROCESS_MEMORY_COUNTERS counters{};
+        if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        {
+            return counters.WorkingSetSize;
+        }
+        return 0;
+#elif defined(__linux__)
+        std::ifstream statm("/proc/self/statm");
+        uint64_t pages = 0;
+        uint64_t resident = 0;
+        if (statm >> pages >> resident)
+        {
+            return resident * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+        }
+        return 0;
+#else
+        return peakRssBytes();
+#endif
+    }
+}
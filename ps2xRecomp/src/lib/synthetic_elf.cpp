@@ -0,0 +1,272 @@
+#include "ps2recomp/synthetic_elf.h"
+#include "ps2recomp/instructions.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+
+namespace ps2recomp
+{
+    namespace
+    {
+        constexpr uint32_t kTextOffset = 0x1000;
+        constexpr uint32_t kEhdrSize = 52;
+        constexpr uint32_t kPhdrSize = 32;
+        constexpr uint32_t kShdrSize = 40;
+        constexpr uint32_t kSymSize = 16;
+
+        constexpr uint32_t REG_RA = 31;
+
+        class ByteWriter
+        {
+        public:
+            void u8(uint8_t v) { m_data.push_back(v); }
+            void u16(uint16_t v)
+            {
+                u8(static_cast<uint8_t>(v));
+                u8(static_cast<uint8_t>(v >> 8));
+            }
+            void u32(uint32_t v)
+            {
+                u16(static_cast<uint16_t>(v));
+                u16(static_cast<uint16_t>(v >> 16));
+            }
+            void bytes(const std::string &s) { m_data.insert(m_data.end(), s.begin(), s.end()); }
+            void padTo(size_t offset) { m_data.resize(std::max(m_data.size(), offset), 0); }
+            void align(size_t alignment) { padTo((m_data.size() + alignment - 1) & ~(alignment - 1)); }
+            size_t size() const { return m_data.size(); }
+            const std::vector<uint8_t> &data() const { return m_data; }
+
+        private:
+            std::vector<uint8_t> m_data;
+        };
+
+        class InstructionSource
+        {
+        public:
+            explicit InstructionSource(uint32_t seed) : m_rng(seed) {}
+
+            uint32_t reg() { return m_rng() % 32; }
+            uint32_t imm() { return m_rng() & 0xFFFF; }
+            uint32_t below(uint32_t n) { return n ? m_rng() % n : 0; }
+
+            // Anything that is not control flow, i.e. legal in a delay slot.
+            uint32_t plain()
+            {
+                static const uint32_t kImmediateOps[] = {OPCODE_ADDIU, OPCODE_LW, OPCODE_SW, OPCODE_ORI,
+                                                         OPCODE_ANDI, OPCODE_SLTI, OPCODE_LQ, OPCODE_SQ, OPCODE_LD,
+                                                         OPCODE_SD, OPCODE_LBU, OPCODE_SB, OPCODE_LWC1, OPCODE_SWC1};
+                static const uint32_t kSpecialOps[] = {SPECIAL_SLL, SPECIAL_ADDU, SPECIAL_SUBU, SPECIAL_AND, SPECIAL_OR,
+                                                       SPECIAL_SLT, SPECIAL_SLTU, SPECIAL_DADDU, SPECIAL_MFLO, SPECIAL_MULT};
+
+                uint32_t pick = below(100);
+                if (pick < 50)
+                {
+                    uint32_t op = kImmediateOps[below(std::size(kImmediateOps))];
+                    return (op << 26) | (reg() << 21) | (reg() << 16) | imm();
+                }
+                if (pick < 88)
+                {
+                    uint32_t fn = kSpecialOps[below(std::size(kSpecialOps))];
+                    if (fn == SPECIAL_SLL)
+                        return (OPCODE_SPECIAL << 26) | (reg() << 16) | (reg() << 11) | (below(32) << 6) | fn;
+                    if (fn == SPECIAL_MFLO)
+                        return (OPCODE_SPECIAL << 26) | (reg() << 11) | fn;
+                    return (OPCODE_SPECIAL << 26) | (reg() << 21) | (reg() << 16) | (reg() << 11) | fn;
+                }
+                if (pick < 94)
+                {
+                    return (OPCODE_MMI << 26) | (reg() << 21) | (reg() << 16) | (reg() << 11) | (MMI0_PADDW << 6) | MMI_MMI0;
+                }
+                // ADD.S/SUB.S/MUL.S/DIV.S
+                return (OPCODE_COP1 << 26) | (COP1_S << 21) | (reg() << 16) | (reg() << 11) | (reg() << 6) | below(4);
+            }
+
+        private:
+            std::mt19937 m_rng;
+        };
+    }
+
+    std::vector<uint32_t> generateSyntheticText(const SyntheticElfOptions &options,
+                                                std::vector<uint32_t> &functionStarts,
+                                                std::vector<uint32_t> &functionSizes)
+    {
+        InstructionSource src(options.seed);
+        const uint32_t minCount = std::max<uint32_t>(options.minInstructions, 4);
+        const uint32_t maxCount = std::max(options.maxInstructions, minCount);
+
+        functionStarts.clear();
+        functionSizes.clear();
+        uint32_t address = options.textAddress;
+        for (uint32_t i = 0; i < options.functionCount; ++i)
+        {
+            uint32_t count = minCount + src.below(maxCount - minCount + 1);
+            functionStarts.push_back(address);
+            functionSizes.push_back(count * 4);
+            address += count * 4;
+        }
+
+        std::vector<uint32_t> words;
+        words.reserve((address - options.textAddress) / 4);
+        for (uint32_t f = 0; f < options.functionCount; ++f)
+        {
+            const uint32_t count = functionSizes[f] / 4;
+            const uint32_t body = count - 2; // the tail is jr $ra; nop
+
+            uint32_t i = 0;
+            if (body >= 2)
+            {
+                // Most compiled functions open with a constant address load.
+                uint32_t r = 1 + src.below(25);
+                words.push_back((OPCODE_LUI << 26) | (r << 16) | src.imm());
+                words.push_back((OPCODE_ADDIU << 26) | (r << 21) | (r << 16) | src.imm());
+                i = 2;
+            }
+
+            while (i < body)
+            {
+                uint32_t pick = src.below(100);
+                if (i + 1 < body && pick < 12)
+                {
+                    static const uint32_t kBranchOps[] = {OPCODE_BEQ, OPCODE_BNE, OPCODE_BLEZ, OPCODE_BGTZ, OPCODE_BEQL};
+                    uint32_t op = kBranchOps[src.below(std::size(kBranchOps))];
+                    uint32_t target = src.below(body);
+                    int32_t offset = static_cast<int32_t>(target) - static_cast<int32_t>(i + 1);
+                    uint32_t rt = (op == OPCODE_BLEZ || op == OPCODE_BGTZ) ? 0 : src.reg();
+                    words.push_back((op << 26) | (src.reg() << 21) | (rt << 16) | (static_cast<uint32_t>(offset) & 0xFFFF));
+                    words.push_back(src.plain());
+                    i += 2;
+                }
+                else if (i + 1 < body && pick < 17 && options.functionCount > 1)
+                {
+                    uint32_t callee = functionStarts[src.below(options.functionCount)];
+                    words.push_back((OPCODE_JAL << 26) | ((callee >> 2) & 0x03FFFFFF));
+                    words.push_back(src.plain());
+                    i += 2;
+                }
+                else
+                {
+                    words.push_back(src.plain());
+                    ++i;
+                }
+            }
+
+            words.push_back((OPCODE_SPECIAL << 26) | (REG_RA << 21) | SPECIAL_JR);
+            words.push_back(0);
+        }
+        return words;
+    }
+
+    bool writeSyntheticElf(const std::string &path, const SyntheticElfOptions &options)
+    {
+        std::vector<uint32_t> starts;
+        std::vector<uint32_t> sizes;
+        std::vector<uint32_t> text = generateSyntheticText(options, starts, sizes);
+        const uint32_t textSize = static_cast<uint32_t>(text.size() * 4);
+
+        std::string strtab(1, '\0');
+        std::vector<uint32_t> nameOffsets;
+        nameOffsets.reserve(starts.size());
+        for (size_t i = 0; i < starts.size(); ++i)
+        {
+            nameOffsets.push_back(static_cast<uint32_t>(strtab.size()));
+            strtab += (i == 0 ? std::string("_start") : "synth_" + std::to_string(i));
+            strtab += '\0';
+        }
+
+        const std::string shstrtab = std::string("\0.text\0.symtab\0.strtab\0.shstrtab\0", 33);
+        const uint32_t kNameText = 1, kNameSymtab = 7, kNameStrtab = 15, kNameShstrtab = 23;
+
+        const uint32_t symtabOffset = (kTextOffset + textSize + 3) & ~3u;
+        const uint32_t symtabSize = static_cast<uint32_t>((starts.size() + 1) * kSymSize);
+        const uint32_t strtabOffset = symtabOffset + symtabSize;
+        const uint32_t shstrtabOffset = strtabOffset + static_cast<uint32_t>(strtab.size());
+        const uint32_t shdrOffset = (shstrtabOffset + static_cast<uint32_t>(shstrtab.size()) + 3) & ~3u;
+
+        ByteWriter out;
+
+        // ELF header
+        out.bytes(std::string("\x7f" "ELF", 4));
+        out.u8(1); // ELFCLASS32
+        out.u8(1); // ELFDATA2LSB
+        out.u8(1); // EV_CURRENT
+        out.padTo(16);
+        out.u16(2);  // ET_EXEC
+        out.u16(8);  // EM_MIPS
+        out.u32(1);  // EV_CURRENT
+        out.u32(options.textAddress);
+        out.u32(kEhdrSize);
+        out.u32(shdrOffset);
+        out.u32(0x20924001); // noreorder, 5900, mips3
+        out.u16(kEhdrSize);
+        out.u16(kPhdrSize);
+        out.u16(1);
+        out.u16(kShdrSize);
+        out.u16(5);
+        out.u16(4); // .shstrtab
+
+        // PT_LOAD for .text
+        out.u32(1);
+        out.u32(kTextOffset);
+        out.u32(options.textAddress);
+        out.u32(options.textAddress);
+        out.u32(textSize);
+        out.u32(textSize);
+        out.u32(5); // R+X
+        out.u32(kTextOffset);
+
+        out.padTo(kTextOffset);
+        for (uint32_t word : text)
+        {
+            out.u32(word);
+        }
+
+        out.padTo(symtabOffset);
+        for (int i = 0; i < 4; ++i)
+        {
+            out.u32(0);
+        }
+        for (size_t i = 0; i < starts.size(); ++i)
+        {
+            out.u32(nameOffsets[i]);
+            out.u32(starts[i]);
+            out.u32(sizes[i]);
+            out.u8(0x12); // STB_GLOBAL, STT_FUNC
+            out.u8(0);
+            out.u16(1); // .text
+        }
+        out.bytes(strtab);
+        out.bytes(shstrtab);
+        out.padTo(shdrOffset);
+
+        auto sectionHeader = [&](uint32_t name, uint32_t type, uint32_t flags, uint32_t addr, uint32_t offset,
+                                 uint32_t size, uint32_t link, uint32_t info, uint32_t align, uint32_t entsize)
+        {
+            out.u32(name);
+            out.u32(type);
+            out.u32(flags);
+            out.u32(addr);
+            out.u32(offset);
+            out.u32(size);
+            out.u32(link);
+            out.u32(info);
+            out.u32(align);
+            out.u32(entsize);
+        };
+        sectionHeader(0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+        sectionHeader(kNameText, 1, 0x6, options.textAddress, kTextOffset, textSize, 0, 0, 16, 0); // PROGBITS, AX
+        sectionHeader(kNameSymtab, 2, 0, 0, symtabOffset, symtabSize, 3, 1, 4, kSymSize);
+        sectionHeader(kNameStrtab, 3, 0, 0, strtabOffset, static_cast<uint32_t>(strtab.size()), 0, 0, 1, 0);
+        sectionHeader(kNameShstrtab, 3, 0, 0, shstrtabOffset, static_cast<uint32_t>(shstrtab.size()), 0, 0, 1, 0);
+
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+            std::cerr << "Failed to create synthetic ELF: " << path << std::endl;
+            return false;
+        }
+        file.write(reinterpret_cast<const char *>(out.data().data()), static_cast<std::streamsize>(out.size()));
+        return static_cast<bool>(file);
+    }
+}
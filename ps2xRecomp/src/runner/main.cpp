@@ -1,14 +1,111 @@
 #include "ps2recomp/ps2_recompiler.h"
+#include "ps2recomp/synthetic_elf.h"
+#include <cstdlib>
+#include <filesystem>
 #include <iostream>
+#include <streambuf>
 #include <string>
 
 using namespace ps2recomp;
 
+namespace
+{
+    class NullBuffer : public std::streambuf
+    {
+    protected:
+        int overflow(int c) override { return c; }
+    };
+
+    bool runStages(PS2Recompiler &recompiler)
+    {
+        if (!recompiler.initialize())
+        {
+            std::cerr << "Failed to initialize recompiler\n";
+            return false;
+        }
+
+        if (!recompiler.recompile())
+        {
+            std::cerr << "Recompilation failed\n";
+            return false;
+        }
+
+        recompiler.generateOutput();
+        return true;
+    }
+
+    // Runs every stage with the progress chatter on stdout muted and prints the
+    // per-stage table instead. Errors still go to stderr.
+    int runBench(const std::string &configPath)
+    {
+        StageProfiler profiler;
+        PS2Recompiler recompiler(configPath);
+        recompiler.setProfiler(&profiler);
+
+        uint64_t startRss = StageProfiler::currentRssBytes();
+        NullBuffer nullBuffer;
+        std::streambuf *stdoutBuffer = std::cout.rdbuf(&nullBuffer);
+        bool ok = runStages(recompiler);
+        std::cout.rdbuf(stdoutBuffer);
+
+        if (!ok)
+        {
+            return 1;
+        }
+
+        std::cout << "Benchmark of " << configPath << " (RSS at start "
+                  << startRss / (1024 * 1024) << " MB)\n";
+        profiler.report(std::cout, recompiler.functionCount(), recompiler.decodedInstructionCount());
+        return 0;
+    }
+
+    int runSyntheticBench(const SyntheticElfOptions &options, bool keep)
+    {
+        namespace fs = std::filesystem;
+        fs::path dir = fs::temp_directory_path() /
+                       ("ps2recomp_bench_" + std::to_string(options.functionCount) + "_" + std::to_string(options.seed));
+        fs::create_directories(dir);
+
+        fs::path elfPath = dir / "synthetic.elf";
+        fs::path configPath = dir / "config.toml";
+        if (!writeSyntheticElf(elfPath.string(), options))
+        {
+            return 1;
+        }
+
+        RecompilerConfig config{};
+        config.inputPath = elfPath.string();
+        config.outputPath = (dir / "output").string();
+        config.singleFileOutput = false;
+        ConfigManager(configPath.string()).saveConfig(config);
+
+        std::cout << "Synthetic ELF: " << options.functionCount << " functions of "
+                  << options.minInstructions << "-" << options.maxInstructions
+                  << " instructions, seed " << options.seed << "\n";
+        int result = runBench(configPath.string());
+
+        if (keep)
+        {
+            std::cout << "Kept benchmark files in " << dir << "\n";
+        }
+        else
+        {
+            std::error_code ec;
+            fs::remove_all(dir, ec);
+        }
+        return result;
+    }
+}
+
 void printUsage()
 {
     std::cout << "PS2Recomp - A static recompiler for PlayStation 2 ELF files\n";
     std::cout << "Usage: ps2recomp <config.toml>\n";
+    std::cout << "       ps2recomp --bench <config.toml>\n";
+    std::cout << "       ps2recomp --bench --synthetic <functions> [--seed N] [--min N] [--max N] [--keep]\n";
     std::cout << "  config.toml: Configuration file for the recompiler\n";
+    std::cout << "  --bench: Time each recompiler stage and report peak memory\n";
+    std::cout << "  --synthetic: Benchmark a generated ELF of random R5900 functions\n";
 }
 
 int main(int argc, char *argv[])
@@ -19,26 +116,55 @@ int main(int argc, char *argv[])
         return 1;
     }
 
-    std::string configPath = argv[1];
-
     try
     {
-        PS2Recompiler recompiler(configPath);
-
-        if (!recompiler.initialize())
+        if (std::string(argv[1]) == "--bench")
         {
-            std::cerr << "Failed to initialize recompiler\n";
-            return 1;
+            SyntheticElfOptions options;
+            std::string configPath;
+            bool synthetic = false;
+            bool keep = false;
+            for (int i = 2; i < argc; ++i)
+            {
+                std::string arg = argv[i];
+                bool hasValue = i + 1 < argc;
+                if (arg == "--synthetic" && hasValue)
+                {
+                    synthetic = true;
+                    options.functionCount = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 0));
+                }
+                else if (arg == "--seed" && hasValue)
+                    options.seed = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 0));
+                else if (arg == "--min" && hasValue)
+                    options.minInstructions = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 0));
+                else if (arg == "--max" && hasValue)
+                    options.maxInstructions = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 0));
+                else if (arg == "--keep")
+                    keep = true;
+                else if (configPath.empty() && arg.rfind("--", 0) != 0)
+                    configPath = arg;
+                else
+                {
+                    printUsage();
+                    return 1;
+                }
+            }
+
+            if (synthetic == configPath.empty())
+            {
+                printUsage();
+                return 1;
+            }
+            return synthetic ? runSyntheticBench(options, keep) : runBench(configPath);
         }
 
-        if (!recompiler.recompile())
+        std::string configPath = argv[1];
+        PS2Recompiler recompiler(configPath);
+        if (!runStages(recompiler))
         {
-            std::cerr << "Recompilation failed\n";
             return 1;
         }
 
-        recompiler.generateOutput();
-
         std::cout << "Recompilation completed successfully\n";
         return 0;
     }
@@ -47,4 +173,4 @@ int main(int argc, char *argv[])
         std::cerr << "Error: " << e.what() << std::endl;
         return 1;
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,45 @@
+#ifndef PS2_HOST_FILES_H
+#define PS2_HOST_FILES_H
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <string>
+
+// Host file table shared by the fio syscalls and the libc file stubs.
+//
+// Handles are (generation << kHostFileSlotBits) | slot. A slot's generation is
+// bumped on every close, so a stale handle never aliases a file reopened into
+// the same slot. Lookups are lock-free; reads and writes go straight to the raw
+// host fd with pread/pwrite at the descriptor's own offset, so guest threads
+// streaming different files never contend with each other. A call pins its
+// slot while it uses the fd, and close waits for those calls before releasing
+// the descriptor.
+namespace ps2_host_files
+{
+    constexpr uint32_t kHostFileSlotBits = 8;
+    constexpr uint32_t kMaxHostFiles = 1u << kHostFileSlotBits;
+
+    // Host open(2) flags for PS2 FIO open flags / a C fopen mode string.
+    int hostFlagsFromFio(int ps2Flags);
+    int hostFlagsFromMode(const char *mode);
+
+    // Returns a positive handle, or -1 with errno set.
+    int32_t open(const std::string &hostPath, int hostFlags);
+    // Read-only handle over [data, data + size), kept alive by owner (e.g. an mmap'd archive).
+    int32_t openMemory(std::shared_ptr<const void> owner, const uint8_t *data, uint64_t size);
+    int close(int32_t handle);
+    bool isValid(int32_t handle);
+
+    // Return the byte count transferred, or -1 with errno set.
+    int64_t read(int32_t handle, void *dst, size_t size);
+    int64_t write(int32_t handle, const void *src, size_t size);
+    int64_t readAt(int32_t handle, void *dst, size_t size, int64_t offset);
+
+    // whence is SEEK_SET/SEEK_CUR/SEEK_END. Returns the new offset or -1.
+    int64_t seek(int32_t handle, int64_t offset, int whence);
+    int64_t tell(int32_t handle);
+    int64_t size(int32_t handle);
+}
+
+#endif // PS2_HOST_FILES_H
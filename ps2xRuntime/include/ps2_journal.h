@@ -0,0 +1,53 @@
+#ifndef PS2_JOURNAL_H
+#define PS2_JOURNAL_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+// Record/replay of the inputs that make a run non-deterministic: pad reads, CD
+// completion, alarm and vblank ordering, host time and thread start order.
+//
+// While recording, every hook appends (event, guest thread, value/bytes) to a
+// binary journal in the order the hooks actually ran. While replaying, a thread
+// that reaches a hook blocks until the next journal record belongs to it, then
+// gets the recorded value instead of the live one. If the guest stops following
+// the journal, replay is dropped with a warning and the run continues live.
+namespace ps2_journal
+{
+    enum class Mode
+    {
+        Off,
+        Record,
+        Replay
+    };
+
+    enum EventKind : uint8_t
+    {
+        EVENT_PAD_READ = 1,
+        EVENT_CD_SYNC = 2,
+        EVENT_ALARM = 3,
+        EVENT_VBLANK = 4,
+        EVENT_HOST_TIME = 5,
+        EVENT_THREAD_START = 6,
+    };
+
+    bool startRecording(const std::string &path);
+    bool startReplay(const std::string &path);
+    void stop(); // flushes a recording
+    Mode mode();
+
+    // Guest thread id the calling host thread runs (1 for the main thread).
+    void setCurrentThread(int threadId);
+
+    // Ordering-only event.
+    void sequence(EventKind kind);
+
+    // Returns live while off or recording (and logs it), the recorded value when replaying.
+    uint64_t value(EventKind kind, uint64_t live);
+
+    // Same for a buffer: recorded as-is, overwritten on replay.
+    void bytes(EventKind kind, uint8_t *data, size_t size);
+}
+
+#endif // PS2_JOURNAL_H
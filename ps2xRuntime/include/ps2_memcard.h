@@ -0,0 +1,97 @@
+#ifndef PS2_MEMCARD_H
+#define PS2_MEMCARD_H
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Memory card slots for the libmc (sceMc*) stubs.
+//
+// Each port holds its whole directory tree in memory: listings and metadata are
+// answered from there, file contents are loaded on first open. Writes only touch
+// the in-memory copy; dirty files are handed to a write-back thread on
+// sceMcFlush/sceMcClose, or once they have been idle for a while, so the game
+// thread never waits on the host disk.
+namespace ps2_memcard
+{
+    constexpr int kMaxPorts = 2;
+    constexpr int kMaxOpenFiles = 32;
+    constexpr uint32_t kClusterSize = 1024;
+    constexpr uint32_t kCardClusters = 8135; // allocatable clusters on an 8 MB card
+
+    // sceMcRes* result codes
+    constexpr int32_t kResSucceed = 0;
+    constexpr int32_t kResChangedCard = -1;
+    constexpr int32_t kResNoFormat = -2;
+    constexpr int32_t kResFullDevice = -3;
+    constexpr int32_t kResNoEntry = -4;
+    constexpr int32_t kResDeniedPermit = -5;
+    constexpr int32_t kResNotEmpty = -6;
+    constexpr int32_t kResUpLimitHandle = -7;
+
+    // Directory entry mode bits (as stored on the card and returned in AttrFile)
+    constexpr uint16_t kModeRead = 0x0001;
+    constexpr uint16_t kModeWrite = 0x0002;
+    constexpr uint16_t kModeExecute = 0x0004;
+    constexpr uint16_t kModeProtected = 0x0008;
+    constexpr uint16_t kModeFile = 0x0010;
+    constexpr uint16_t kModeDirectory = 0x0020;
+    constexpr uint16_t kMode0400 = 0x0400;
+    constexpr uint16_t kModeHidden = 0x2000;
+    constexpr uint16_t kModeExists = 0x8000;
+
+    // sceMcStDateTime
+    struct DateTime
+    {
+        uint8_t resv = 0;
+        uint8_t sec = 0;
+        uint8_t min = 0;
+        uint8_t hour = 0;
+        uint8_t day = 1;
+        uint8_t month = 1;
+        uint16_t year = 2000;
+    };
+
+    struct EntryInfo
+    {
+        std::string name;
+        uint16_t mode = 0;
+        uint32_t size = 0;
+        DateTime created;
+        DateTime modified;
+    };
+
+    // A regular file is taken as a raw .ps2 image (with or without page ECC),
+    // a directory is used as the card root. Missing directories are created.
+    bool mountDirectory(int port, const std::filesystem::path &root);
+    bool mountImage(int port, const std::filesystem::path &image);
+    void unmount(int port);
+
+    // Queues every dirty file and, if wait is set, blocks until the writer is idle.
+    void flushAll(bool wait);
+
+    int32_t getInfo(int port, int32_t &type, int32_t &freeClusters, int32_t &format);
+    int32_t open(int port, const std::string &path, int mode);
+    int32_t close(int32_t fd);
+    int32_t read(int32_t fd, void *dst, int32_t size);
+    int32_t write(int32_t fd, const void *src, int32_t size);
+    int32_t seek(int32_t fd, int32_t offset, int whence);
+    int32_t flush(int32_t fd);
+    int32_t mkdir(int port, const std::string &path);
+    int32_t chdir(int port, const std::string &path, std::string &previous);
+    int32_t remove(int port, const std::string &path);
+    int32_t rename(int port, const std::string &from, const std::string &toName);
+    // valid: 0x01 created, 0x02 modified, 0x04 attributes, 0x08 name
+    int32_t setFileInfo(int port, const std::string &path, const EntryInfo &info, uint32_t valid);
+    int32_t format(int port);
+    int32_t unformat(int port);
+    int32_t getEntSpace(int port, const std::string &path);
+
+    // Wildcard ('*', '?') listing. When continueListing is set the previous
+    // pattern is resumed after the entries already returned.
+    int32_t getDir(int port, const std::string &pattern, bool continueListing, int32_t maxEntries,
+                   std::vector<EntryInfo> &out);
+}
+
+#endif // PS2_MEMCARD_H
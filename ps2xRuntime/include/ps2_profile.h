@@ -0,0 +1,40 @@
+#ifndef PS2_PROFILE_H
+#define PS2_PROFILE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Execution profile of an instrumented build (instrument_profile = true in the
+// recompiler config), fed back to ps2recomp through [general] profile.
+//
+// Generated code calls enter() at every function entry and branch() for every
+// conditional branch it evaluates. Counts go to a per-thread table and are merged
+// when the profile is written, in the format of ps2_profile_format.h.
+namespace ps2_profile
+{
+    inline std::atomic<bool> g_active{false};
+
+    bool start(const std::string &path);
+    void stop(); // writes the profile
+    inline bool active() { return g_active.load(std::memory_order_relaxed); }
+
+    void recordEntry(uint32_t address);
+    void recordBranch(uint32_t address, bool taken);
+
+    inline void enter(uint32_t address)
+    {
+        if (active())
+            recordEntry(address);
+    }
+
+    // Returns taken, so it can wrap a branch condition.
+    inline bool branch(uint32_t address, bool taken)
+    {
+        if (active())
+            recordBranch(address, taken);
+        return taken;
+    }
+}
+
+#endif // PS2_PROFILE_H
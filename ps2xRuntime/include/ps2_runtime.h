@@ -15,8 +15,10 @@
     #include <smmintrin.h> // For SSE4.1 instructions
 #endif
 #include <atomic>
+#include <condition_variable>
 #include <filesystem>
 #include <iostream>
+#include <mutex>
 
 constexpr uint32_t PS2_RAM_SIZE = 32 * 1024 * 1024; // 32MB
 constexpr uint32_t PS2_RAM_MASK = 0x1FFFFFF;        // Mask for 32MB alignment
@@ -456,12 +458,45 @@ public:
     bool loadELF(const std::string &elfPath);
     void run();
 
+    // Snapshot of the main CPU context and all of PS2Memory. Generated code does not
+    // keep ctx->pc current and nests host frames for guest calls, so the context is
+    // only resumable where the game thread is back in its dispatch loop about to
+    // enter a function: saveState() asks for a snapshot there and returns at once,
+    // and the game thread takes it (copy-on-write, compressed in the background) the
+    // next time it reaches that point. Callable from any thread.
+    void saveState(const std::string &statePath);
+    // Rejects states whose pc is not the entry of a registered function.
+    bool loadState(const std::string &statePath);
+
     using RecompiledFunction = void (*)(uint8_t *, R5900Context *, PS2Runtime *);
 
     void registerFunction(uint32_t address, RecompiledFunction func);
     RecompiledFunction lookupFunction(uint32_t address);
     bool hasFunction(uint32_t address) const;
 
+    // Return address given to the entry point and to thread entries; dispatch() stops there.
+    static constexpr uint32_t kGuestExitAddress = 0xFFFFFFF0u;
+    // Set by the epilogue of a generated function whose code ran off its end
+    // (PS2_FELL_OFF_END); dispatch() stops the thread there.
+    static constexpr uint32_t kFellOffEndAddress = 0xFFFFFFF4u;
+
+    // Runs recompiled code from ctx->pc until it returns to exitPc. Generated code
+    // that cannot resolve a jump sets ctx->pc and returns; the function at that pc
+    // is looked up and run next, so indirect control flow does not nest host frames.
+    void dispatch(uint8_t *rdram, R5900Context *ctx, uint32_t exitPc);
+    // lookupFunction for the dispatcher: per-thread cache, then the flat table, then
+    // the hash map. nullptr (and no warning) when nothing is registered at address.
+    RecompiledFunction findFunction(uint32_t address);
+    // Flat table over the registered code range; run() builds it before starting the game.
+    void buildDispatchTable();
+
+    // Called with the latch outcome of every iteration of a loop the recompiler found
+    // busy-waiting on memory, IO or a polling syscall (PS2_IDLE_LOOP); returns taken.
+    // Short waits just spin; a loop that keeps going yields, then sleeps until the next
+    // vblank (the next event the run loop raises) or a millisecond, whichever comes
+    // first. Leaving the loop (taken false) starts the next wait over from spinning.
+    bool idleLoop(uint32_t address, bool taken);
+
     void SignalException(R5900Context *ctx, PS2Exception exception);
 
     void executeVU0Microprogram(uint8_t *rdram, R5900Context *ctx, uint32_t address);
@@ -485,17 +520,38 @@ public:
     inline PS2Memory &memory() { return m_memory; }
     inline const PS2Memory &memory() const { return m_memory; }
 
+    // Host input and frame state sampled by the run loop for the pad and GS stubs.
+    inline uint16_t padButtons() const { return m_padButtons.load(std::memory_order_relaxed); }
+    inline uint64_t vblankCount() const { return m_vblankCount.load(std::memory_order_relaxed); }
+    // Blocks until the run loop raises the next vblank and returns its count.
+    uint64_t waitForVblank();
+
 public:
     bool check_overflow = false;
+    // Set before run() to write a ps2_profile of the run there (needs an instrumented build).
+    std::string profilePath;
 
 private:
     void HandleIntegerOverflow(R5900Context *ctx);
+    // Takes the snapshot saveState() asked for; the game thread's dispatch loop only.
+    void writeRequestedState();
 
 private:
     PS2Memory m_memory;
     R5900Context m_cpuContext;
+    bool m_stateLoaded = false;
+    std::atomic<bool> m_stateRequested{false};
+    std::mutex m_stateMutex;
+    std::string m_requestedStatePath; // guarded by m_stateMutex
+    std::atomic<uint16_t> m_padButtons{0xFFFF}; // active low, as on the wire
+    std::atomic<uint64_t> m_vblankCount{0};
+    std::mutex m_vblankMutex;
+    std::condition_variable m_vblankSignal; // notified on every vblank, for idleLoop and waitForVblank
 
     std::unordered_map<uint32_t, RecompiledFunction> m_functionTable;
+    std::vector<RecompiledFunction> m_dispatchTable; // indexed by (address - m_dispatchBase) / 4
+    uint32_t m_dispatchBase = 0;
+    std::atomic<uint32_t> m_functionGeneration{0}; // invalidates the per-thread dispatch caches
 
     struct LoadedModule
     {
@@ -508,4 +564,21 @@ private:
     std::vector<LoadedModule> m_loadedModules;
 };
 
+// Tail call left behind by PS2_TAIL_CALL on compilers without guaranteed tail
+// calls. The function that set it has already returned; ps2RunCall runs it.
+inline thread_local PS2Runtime::RecompiledFunction ps2PendingTailCall = nullptr;
+
+// Calls fn, then every tail call it (and its tail callees) hand back, so a chain
+// of guest tail calls runs in a loop instead of nesting host frames. Anything
+// that enters recompiled code from the host must go through this.
+inline void ps2RunCall(PS2Runtime::RecompiledFunction fn, uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
+{
+    fn(rdram, ctx, runtime);
+    while (PS2Runtime::RecompiledFunction next = ps2PendingTailCall)
+    {
+        ps2PendingTailCall = nullptr;
+        next(rdram, ctx, runtime);
+    }
+}
+
 #endif // PS2_RUNTIME_H
@@ -1,6 +1,7 @@
 #ifndef PS2_RUNTIME_MACROS_H
 #define PS2_RUNTIME_MACROS_H
 #include <cstdint>
+#include "ps2_profile.h"
 #if defined(_MSC_VER)
 	#include <intrin.h>
 #elif defined(USE_SSE2NEON)
@@ -8,6 +9,47 @@
 #else
 	#include <immintrin.h> // For SSE/AVX intrinsics
 #endif
+
+// Widest x86 extension the build targets (PS2X_SIMD in CMake). SSE4.1 is the
+// baseline; ARM64 goes through sse2neon with a few native NEON paths below.
+// AVX-512VL only adds the three-input logic op PNOR uses: on 128-bit lanes the
+// AVX2 shift, multiply and divide forms are already single instructions.
+#if defined(__AVX512F__) && defined(__AVX512VL__)
+	#define PS2_SIMD_AVX512VL 1
+#endif
+#if defined(__AVX2__)
+	#define PS2_SIMD_AVX2 1
+#endif
+
+// Calls between recompiled functions. A guest tail call (j to a function, a
+// branch into another function) must not grow the host stack: with clang it is
+// a guaranteed tail call, elsewhere the target is handed back to the nearest
+// PS2_CALL, which runs it once the current function has returned (ps2RunCall
+// in ps2_runtime.h).
+#if defined(__clang__) && defined(__has_cpp_attribute)
+	#if __has_cpp_attribute(clang::musttail)
+		#define PS2_HAS_MUSTTAIL 1
+	#endif
+#endif
+#if defined(PS2_HAS_MUSTTAIL)
+	#define PS2_CALL(fn) fn(rdram, ctx, runtime)
+	#define PS2_TAIL_CALL(fn) [[clang::musttail]] return fn(rdram, ctx, runtime)
+#else
+	#define PS2_CALL(fn) ps2RunCall(fn, rdram, ctx, runtime)
+	#define PS2_TAIL_CALL(fn) do { ps2PendingTailCall = fn; return; } while (0)
+#endif
+
+// Closes every generated function; reached only when no jump or return left it.
+#define PS2_FELL_OFF_END() (ctx->pc = PS2Runtime::kFellOffEndAddress)
+
+// Emitted by builds recompiled with instrument_profile; counted while a profile
+// is being written (ps2_profile.h).
+#define PS2_PROFILE_ENTER(address) ps2_profile::enter(address)
+#define PS2_PROFILE_BRANCH(address, cond) ps2_profile::branch(address, (cond))
+
+// Wraps the latch condition of loops the analyzer found busy-waiting
+// (PS2Runtime::idleLoop); evaluates to taken.
+#define PS2_IDLE_LOOP(address, taken) runtime->idleLoop((address), (taken))
 inline uint32_t ps2_clz32(uint32_t val) {
 #if defined(_MSC_VER)
     unsigned long idx;
@@ -71,7 +113,11 @@ inline uint32_t ps2_clz32(uint32_t val) {
 #define PS2_PAND(a, b) _mm_and_si128((__m128i)(a), (__m128i)(b))
 #define PS2_POR(a, b) _mm_or_si128((__m128i)(a), (__m128i)(b))
 #define PS2_PXOR(a, b) _mm_xor_si128((__m128i)(a), (__m128i)(b))
+#if defined(PS2_SIMD_AVX512VL)
+#define PS2_PNOR(a, b) _mm_ternarylogic_epi32((__m128i)(a), (__m128i)(b), (__m128i)(b), 0x03)
+#else
 #define PS2_PNOR(a, b) _mm_xor_si128(_mm_or_si128((__m128i)(a), (__m128i)(b)), _mm_set1_epi32(0xFFFFFFFF))
+#endif
 
 // PS2 VU (Vector Unit) operations
 #define PS2_VADD(a, b) _mm_add_ps((__m128)(a), (__m128)(b))
@@ -124,35 +170,96 @@ inline uint32_t ps2_clz32(uint32_t val) {
 #define PS2_PSRLVW(a, b) _mm_custom_srlv_epi32((__m128i)(a), (__m128i)(b))
 #define PS2_PSRAVW(a, b) _mm_custom_srav_epi32((__m128i)(a), (__m128i)(b))
 
-// Helper function declarations for custom variable shifts
+// Variable shifts use the low 5 bits of each count lane.
+#if defined(USE_SSE2NEON)
 inline __m128i _mm_custom_sllv_epi32(__m128i a, __m128i count) {
-    int32_t a_arr[4], count_arr[4], result[4];
-    _mm_storeu_si128((__m128i*)a_arr, a);
-    _mm_storeu_si128((__m128i*)count_arr, count);
-    for (int i = 0; i < 4; i++) {
-        result[i] = a_arr[i] << (count_arr[i] & 0x1F);
-    }
-    return _mm_loadu_si128((__m128i*)result);
+    int32x4_t n = vandq_s32(vreinterpretq_s32_m128i(count), vdupq_n_s32(0x1F));
+    return vreinterpretq_m128i_u32(vshlq_u32(vreinterpretq_u32_m128i(a), n));
 }
 
 inline __m128i _mm_custom_srlv_epi32(__m128i a, __m128i count) {
-    int32_t a_arr[4], count_arr[4], result[4];
-    _mm_storeu_si128((__m128i*)a_arr, a);
-    _mm_storeu_si128((__m128i*)count_arr, count);
-    for (int i = 0; i < 4; i++) {
-        result[i] = (uint32_t)a_arr[i] >> (count_arr[i] & 0x1F);
-    }
-    return _mm_loadu_si128((__m128i*)result);
+    int32x4_t n = vandq_s32(vreinterpretq_s32_m128i(count), vdupq_n_s32(0x1F));
+    return vreinterpretq_m128i_u32(vshlq_u32(vreinterpretq_u32_m128i(a), vnegq_s32(n)));
 }
 
 inline __m128i _mm_custom_srav_epi32(__m128i a, __m128i count) {
-    int32_t a_arr[4], count_arr[4], result[4];
-    _mm_storeu_si128((__m128i*)a_arr, a);
-    _mm_storeu_si128((__m128i*)count_arr, count);
-    for (int i = 0; i < 4; i++) {
-        result[i] = a_arr[i] >> (count_arr[i] & 0x1F);
-    }
-    return _mm_loadu_si128((__m128i*)result);
+    int32x4_t n = vandq_s32(vreinterpretq_s32_m128i(count), vdupq_n_s32(0x1F));
+    return vreinterpretq_m128i_s32(vshlq_s32(vreinterpretq_s32_m128i(a), vnegq_s32(n)));
+}
+#elif defined(PS2_SIMD_AVX2)
+inline __m128i _mm_custom_sllv_epi32(__m128i a, __m128i count) {
+    return _mm_sllv_epi32(a, _mm_and_si128(count, _mm_set1_epi32(0x1F)));
+}
+
+inline __m128i _mm_custom_srlv_epi32(__m128i a, __m128i count) {
+    return _mm_srlv_epi32(a, _mm_and_si128(count, _mm_set1_epi32(0x1F)));
+}
+
+inline __m128i _mm_custom_srav_epi32(__m128i a, __m128i count) {
+    return _mm_srav_epi32(a, _mm_and_si128(count, _mm_set1_epi32(0x1F)));
+}
+#else
+// SSE4.1 has no per-lane shift counts: shift the whole vector once per lane
+// count and blend the matching lane back together, all in registers.
+#define PS2_SHIFT_BY_LANES(shift, a, count)                                                  \
+    __m128i n = _mm_and_si128(count, _mm_set1_epi32(0x1F));                                   \
+    __m128i r0 = shift(a, _mm_cvtsi32_si128(_mm_cvtsi128_si32(n)));                           \
+    __m128i r1 = shift(a, _mm_cvtsi32_si128(_mm_extract_epi32(n, 1)));                        \
+    __m128i r2 = shift(a, _mm_cvtsi32_si128(_mm_extract_epi32(n, 2)));                        \
+    __m128i r3 = shift(a, _mm_cvtsi32_si128(_mm_extract_epi32(n, 3)));                        \
+    return _mm_blend_epi16(_mm_blend_epi16(r0, r1, 0x0C), _mm_blend_epi16(r2, r3, 0xC0), 0xF0);
+
+inline __m128i _mm_custom_sllv_epi32(__m128i a, __m128i count) {
+    // a * 2^n, with 2^n built in the float exponent field (2^31 converts to 0x80000000).
+    __m128i n = _mm_and_si128(count, _mm_set1_epi32(0x1F));
+    __m128i pow2 = _mm_cvttps_epi32(_mm_castsi128_ps(_mm_add_epi32(_mm_slli_epi32(n, 23), _mm_set1_epi32(0x3F800000))));
+    return _mm_mullo_epi32(a, pow2);
+}
+
+inline __m128i _mm_custom_srlv_epi32(__m128i a, __m128i count) {
+    PS2_SHIFT_BY_LANES(_mm_srl_epi32, a, count)
+}
+
+inline __m128i _mm_custom_srav_epi32(__m128i a, __m128i count) {
+    PS2_SHIFT_BY_LANES(_mm_sra_epi32, a, count)
+}
+#undef PS2_SHIFT_BY_LANES
+#endif
+
+// Horizontal reductions and lane-parallel arithmetic behind the MMI multiply,
+// multiply-add and divide instructions. They used to be expanded lane by lane
+// in the generated code.
+
+// Sum of the four signed words.
+inline int64_t _mm_custom_hadd_epi32_s64(__m128i v) {
+#if defined(PS2_SIMD_AVX2)
+    __m256i wide = _mm256_cvtepi32_epi64(v);
+    __m128i sum = _mm_add_epi64(_mm256_castsi256_si128(wide), _mm256_extracti128_si256(wide, 1));
+#else
+    __m128i sum = _mm_add_epi64(_mm_cvtepi32_epi64(v), _mm_cvtepi32_epi64(_mm_srli_si128(v, 8)));
+#endif
+    return _mm_cvtsi128_si64(_mm_add_epi64(sum, _mm_unpackhi_epi64(sum, sum)));
+}
+
+// Sum of the eight halfwords taken as unsigned.
+inline int64_t _mm_custom_hadd_epu16(__m128i v) {
+    __m128i zero = _mm_setzero_si128();
+    return _mm_custom_hadd_epi32_s64(_mm_add_epi32(_mm_unpacklo_epi16(v, zero), _mm_unpackhi_epi16(v, zero)));
+}
+
+// Truncating signed division of every word by d (d != 0). Doubles hold any
+// int32 quotient exactly, so cvtt gives the same result as the integer divide;
+// INT32_MIN / -1 wraps to INT32_MIN instead of trapping.
+inline __m128i _mm_custom_div_epi32(__m128i a, int32_t d) {
+#if defined(PS2_SIMD_AVX2)
+    __m256d q = _mm256_div_pd(_mm256_cvtepi32_pd(a), _mm256_set1_pd((double)d));
+    return _mm256_cvttpd_epi32(q);
+#else
+    __m128d div = _mm_set1_pd((double)d);
+    __m128i lo = _mm_cvttpd_epi32(_mm_div_pd(_mm_cvtepi32_pd(a), div));
+    __m128i hi = _mm_cvttpd_epi32(_mm_div_pd(_mm_cvtepi32_pd(_mm_srli_si128(a, 8)), div));
+    return _mm_unpacklo_epi64(lo, hi);
+#endif
 }
 
 // PMFHL function implementations
@@ -0,0 +1,70 @@
+#ifndef PS2_SAVESTATE_H
+#define PS2_SAVESTATE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Save state container: a small header followed by one record per memory region.
+// Regions are split into 64 KiB blocks that are LZ compressed independently, so
+// both sides stream through a fixed scratch buffer instead of holding 38 MB twice.
+//
+//   header  : magic "PS2S", version, region count, reserved
+//   region  : id, flags, raw size (u64), block count
+//   block   : u32 stored size (bit 31 = stored uncompressed), payload
+namespace ps2_savestate
+{
+    constexpr uint32_t kMagic = 0x53325350; // "PS2S"
+    constexpr uint32_t kVersion = 1;
+    constexpr uint32_t kBlockSize = 64 * 1024;
+
+    enum RegionId : uint32_t
+    {
+        REGION_CPU_CONTEXT = 1,
+        REGION_RDRAM = 2,
+        REGION_SCRATCHPAD = 3,
+        REGION_IOP_RAM = 4,
+        REGION_GS_VRAM = 5,
+        REGION_GS_REGS = 6,
+        REGION_VIF0_REGS = 7,
+        REGION_VIF1_REGS = 8,
+        REGION_DMA_REGS = 9,
+        REGION_IO_REGS = 10, // sorted (address, value) u32 pairs
+    };
+
+    struct Region
+    {
+        uint32_t id;
+        const void *data;
+        uint64_t size;
+    };
+
+    struct LoadedRegion
+    {
+        uint32_t id = 0;
+        std::vector<uint8_t> data;
+    };
+
+    // Worst case output size of compress() for an input of size bytes.
+    constexpr size_t compressBound(size_t size) { return size + size / 255 + 16; }
+
+    // LZ77 with LZ4-style tokens. Both sides are bounded to one block (offsets are 16 bit).
+    size_t compress(const uint8_t *src, size_t size, uint8_t *dst, size_t capacity);
+    bool decompress(const uint8_t *src, size_t size, uint8_t *dst, size_t rawSize);
+
+    // Compresses and writes the regions synchronously.
+    bool write(const std::string &path, const std::vector<Region> &regions);
+
+    // Takes a copy-on-write snapshot of the regions and returns; compression and the
+    // file write happen in a forked child (or a worker thread working on a copy where
+    // fork is not available). The file appears atomically once it is complete.
+    bool writeAsync(const std::string &path, const std::vector<Region> &regions);
+
+    // Blocks until every writeAsync() has finished. Returns false if any of them failed.
+    bool waitPending();
+
+    bool read(const std::string &path, std::vector<LoadedRegion> &out);
+}
+
+#endif // PS2_SAVESTATE_H
@@ -0,0 +1,64 @@
+#ifndef PS2_VFS_H
+#define PS2_VFS_H
+
+#include <cstdint>
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include "ps2_mapped_file.h"
+
+// Guest device paths (cdrom0:\DATA\FILE.BIN;1, host0:foo, mc0:/BESLES-00000/icon.sys)
+// resolved against a table of mount points. A mount is either a host directory or,
+// for cdrom0:, an ISO9660 image that is mmap'd once and served by memcpy.
+namespace ps2_vfs
+{
+    constexpr uint32_t kCdSectorSize = 2048;
+
+    struct Entry
+    {
+        bool exists = false;
+        bool isDirectory = false;
+        bool readOnly = false;
+        uint64_t size = 0;
+        std::string hostPath;               // empty for entries inside an image
+        std::shared_ptr<MappedFile> image;  // set for entries inside an image
+        uint32_t lsn = 0;                   // first sector inside the image, or assigned on cdrom0:
+    };
+
+    // device is given without the trailing colon ("cdrom0", "host0", "mc0").
+    // A regular file as target is mounted as an ISO9660 image.
+    bool mount(std::string_view device, const std::filesystem::path &target);
+    bool unmount(std::string_view device);
+    void resetMounts(); // restores the default host directory layout
+
+    // True if ps2Path starts with a mounted device prefix.
+    bool hasDevice(std::string_view ps2Path);
+
+    // Image backing cdrom0:, if one is mounted.
+    std::shared_ptr<MappedFile> discImage();
+
+    // Fills dst with bytes of cdrom0: starting at sector lsn. A directory mount
+    // serves the files resolve() gave sectors to; anything unbacked reads as zero.
+    void readSectors(uint32_t lsn, uint8_t *dst, size_t bytes);
+
+    // Case-folded, ";1"-stripped lookup key for a guest path, e.g. "cdrom0:DATA/FILE.BIN".
+    std::string normalizePath(std::string_view ps2Path);
+
+    // Looks an existing file or directory up, memoised per normalized path.
+    Entry resolve(std::string_view ps2Path);
+
+    // Host path a guest path maps to, whether or not it exists yet (for creates).
+    // Returns "" for image mounts and unknown devices.
+    std::string hostPath(std::string_view ps2Path);
+
+    // Drops cached lookups after the guest creates, removes or renames something.
+    void invalidate(std::string_view ps2Path);
+
+    // Opens a guest path in the shared host file table. Image entries and large
+    // read-only host files are served from a mapping instead of a host fd.
+    int32_t open(std::string_view ps2Path, int hostFlags);
+}
+
+#endif // PS2_VFS_H
@@ -0,0 +1,502 @@
+#include "ps2_host_files.h"
+#include "ps2_syscalls.h"
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <thread>
+
+#ifdef _WIN32
+#include <io.h>
+#include <mutex>
+#else
+#include <unistd.h>
+#endif
+
+namespace
+{
+    constexpr uint32_t kSlotFree = 0;
+    constexpr uint32_t kSlotBusy = 1; // being opened or closed
+    constexpr uint32_t kSlotOpen = 2;
+
+    constexpr uint32_t kGenerationMask = (1u << (31 - ps2_host_files::kHostFileSlotBits)) - 1;
+
+    struct HostFileSlot
+    {
+        std::atomic<uint32_t> state{kSlotFree};
+        std::atomic<uint32_t> generation{1};
+        std::atomic<int64_t> offset{0};
+        // Calls currently using fd or memory; close waits for them to finish.
+        std::atomic<uint32_t> users{0};
+        int fd = -1;
+        bool append = false;
+        // Memory-backed slots have fd == -1 and serve reads with memcpy.
+        std::shared_ptr<const void> memoryOwner;
+        const uint8_t *memory = nullptr;
+        uint64_t memorySize = 0;
+#ifdef _WIN32
+        // No positional I/O in the CRT, so seek+read has to be atomic per descriptor.
+        std::mutex ioMutex;
+#endif
+    };
+
+    HostFileSlot g_hostFiles[ps2_host_files::kMaxHostFiles];
+    std::atomic<uint32_t> g_nextSlotHint{0};
+
+    int32_t makeHandle(uint32_t slot, uint32_t generation)
+    {
+        return static_cast<int32_t>((generation << ps2_host_files::kHostFileSlotBits) | slot);
+    }
+
+    HostFileSlot *claimSlot(uint32_t &index)
+    {
+        uint32_t start = g_nextSlotHint.fetch_add(1, std::memory_order_relaxed);
+        for (uint32_t i = 0; i < ps2_host_files::kMaxHostFiles; ++i)
+        {
+            index = (start + i) & (ps2_host_files::kMaxHostFiles - 1);
+            uint32_t expected = kSlotFree;
+            if (g_hostFiles[index].state.compare_exchange_strong(expected, kSlotBusy, std::memory_order_acquire))
+                return &g_hostFiles[index];
+        }
+        return nullptr;
+    }
+
+    HostFileSlot *lookupSlot(int32_t handle)
+    {
+        if (handle <= 0)
+            return nullptr;
+
+        uint32_t raw = static_cast<uint32_t>(handle);
+        HostFileSlot &slot = g_hostFiles[raw & (ps2_host_files::kMaxHostFiles - 1)];
+        if (slot.state.load() != kSlotOpen)
+            return nullptr;
+        if (slot.generation.load() != (raw >> ps2_host_files::kHostFileSlotBits))
+            return nullptr;
+        return &slot;
+    }
+
+    // Holds a slot open for the duration of one call. The handle is checked
+    // again after the count goes up, so either close sees this user and waits
+    // for it, or the pin sees the close and fails.
+    class SlotPin
+    {
+    public:
+        explicit SlotPin(int32_t handle)
+        {
+            HostFileSlot *slot = lookupSlot(handle);
+            if (!slot)
+                return;
+            slot->users.fetch_add(1);
+            if (lookupSlot(handle) != slot)
+            {
+                slot->users.fetch_sub(1, std::memory_order_release);
+                return;
+            }
+            m_slot = slot;
+        }
+
+        ~SlotPin()
+        {
+            if (m_slot)
+                m_slot->users.fetch_sub(1, std::memory_order_release);
+        }
+
+        SlotPin(const SlotPin &) = delete;
+        SlotPin &operator=(const SlotPin &) = delete;
+
+        explicit operator bool() const { return m_slot != nullptr; }
+        HostFileSlot *operator->() const { return m_slot; }
+        HostFileSlot &operator*() const { return *m_slot; }
+
+    private:
+        HostFileSlot *m_slot = nullptr;
+    };
+
+#ifdef _WIN32
+    int hostOpen(const char *path, int flags) { return ::_open(path, flags, _S_IREAD | _S_IWRITE); }
+    int hostClose(int fd) { return ::_close(fd); }
+
+    int64_t hostFileSize(int fd)
+    {
+        struct _stat64 st;
+        return ::_fstat64(fd, &st) == 0 ? static_cast<int64_t>(st.st_size) : -1;
+    }
+
+    int64_t hostReadAt(HostFileSlot &slot, void *dst, size_t size, int64_t offset)
+    {
+        std::lock_guard<std::mutex> lock(slot.ioMutex);
+        if (::_lseeki64(slot.fd, offset, SEEK_SET) < 0)
+            return -1;
+        return ::_read(slot.fd, dst, static_cast<unsigned int>(size));
+    }
+
+    int64_t hostWriteAt(HostFileSlot &slot, const void *src, size_t size, int64_t offset)
+    {
+        std::lock_guard<std::mutex> lock(slot.ioMutex);
+        if (!slot.append && ::_lseeki64(slot.fd, offset, SEEK_SET) < 0)
+            return -1;
+        return ::_write(slot.fd, src, static_cast<unsigned int>(size));
+    }
+#else
+    int hostOpen(const char *path, int flags) { return ::open(path, flags | O_CLOEXEC, 0666); }
+    int hostClose(int fd) { return ::close(fd); }
+
+    int64_t hostFileSize(int fd)
+    {
+        struct stat st;
+        return ::fstat(fd, &st) == 0 ? static_cast<int64_t>(st.st_size) : -1;
+    }
+
+    int64_t hostReadAt(HostFileSlot &slot, void *dst, size_t size, int64_t offset)
+    {
+        ssize_t n;
+        do
+        {
+            n = ::pread(slot.fd, dst, size, static_cast<off_t>(offset));
+        } while (n < 0 && errno == EINTR);
+        return n;
+    }
+
+    int64_t hostWriteAt(HostFileSlot &slot, const void *src, size_t size, int64_t offset)
+    {
+        ssize_t n;
+        do
+        {
+            // O_APPEND descriptors always write at EOF, pwrite offsets are ignored there anyway.
+            n = slot.append ? ::write(slot.fd, src, size) : ::pwrite(slot.fd, src, size, static_cast<off_t>(offset));
+        } while (n < 0 && errno == EINTR);
+        return n;
+    }
+#endif
+
+    int64_t slotSize(const HostFileSlot &slot)
+    {
+        return slot.memory ? static_cast<int64_t>(slot.memorySize) : hostFileSize(slot.fd);
+    }
+
+    // Single host calls are capped so a huge guest request can't overflow the CRT's int counts.
+    constexpr size_t kMaxChunk = 1u << 30;
+
+    int64_t readLoop(HostFileSlot &slot, uint8_t *dst, size_t size, int64_t offset)
+    {
+        if (slot.memory)
+        {
+            if (static_cast<uint64_t>(offset) >= slot.memorySize)
+                return 0;
+            uint64_t available = slot.memorySize - static_cast<uint64_t>(offset);
+            size_t count = available < size ? static_cast<size_t>(available) : size;
+            std::memcpy(dst, slot.memory + offset, count);
+            return static_cast<int64_t>(count);
+        }
+
+        size_t total = 0;
+        while (total < size)
+        {
+            size_t chunk = (size - total) < kMaxChunk ? (size - total) : kMaxChunk;
+            int64_t n = hostReadAt(slot, dst + total, chunk, offset + static_cast<int64_t>(total));
+            if (n < 0)
+                return total > 0 ? static_cast<int64_t>(total) : -1;
+            if (n == 0)
+                break; // EOF
+            total += static_cast<size_t>(n);
+        }
+        return static_cast<int64_t>(total);
+    }
+}
+
+namespace ps2_host_files
+{
+    int hostFlagsFromFio(int ps2Flags)
+    {
+        int flags = 0;
+        switch (ps2Flags & PS2_FIO_O_RDWR)
+        {
+        case PS2_FIO_O_WRONLY:
+            flags = O_WRONLY;
+            break;
+        case PS2_FIO_O_RDWR:
+            flags = O_RDWR;
+            break;
+        default:
+            flags = O_RDONLY;
+            break;
+        }
+
+        if (ps2Flags & PS2_FIO_O_APPEND)
+            flags |= O_APPEND;
+        if (ps2Flags & PS2_FIO_O_CREAT)
+            flags |= O_CREAT;
+        if (ps2Flags & PS2_FIO_O_TRUNC)
+            flags |= O_TRUNC;
+        if (ps2Flags & PS2_FIO_O_EXCL)
+            flags |= O_EXCL;
+#ifdef _WIN32
+        flags |= O_BINARY;
+#endif
+        return flags;
+    }
+
+    int hostFlagsFromMode(const char *mode)
+    {
+        if (!mode)
+            return -1;
+
+        int flags = 0;
+        bool plus = false;
+        bool exclusive = false;
+        for (const char *p = mode + 1; *p; ++p)
+        {
+            if (*p == '+')
+                plus = true;
+            else if (*p == 'x')
+                exclusive = true;
+        }
+
+        switch (mode[0])
+        {
+        case 'r':
+            flags = plus ? O_RDWR : O_RDONLY;
+            break;
+        case 'w':
+            flags = (plus ? O_RDWR : O_WRONLY) | O_CREAT | O_TRUNC;
+            break;
+        case 'a':
+            flags = (plus ? O_RDWR : O_WRONLY) | O_CREAT | O_APPEND;
+            break;
+        default:
+            return -1;
+        }
+
+        if (exclusive)
+            flags |= O_EXCL;
+#ifdef _WIN32
+        flags |= O_BINARY;
+#endif
+        return flags;
+    }
+
+    int32_t open(const std::string &hostPath, int hostFlags)
+    {
+        if (hostFlags < 0)
+        {
+            errno = EINVAL;
+            return -1;
+        }
+
+        // Claim a free slot first so a full table doesn't leak a host fd.
+        uint32_t index = 0;
+        HostFileSlot *slot = claimSlot(index);
+        if (!slot)
+        {
+            errno = EMFILE;
+            return -1;
+        }
+
+        int fd = hostOpen(hostPath.c_str(), hostFlags);
+        if (fd < 0)
+        {
+            slot->state.store(kSlotFree, std::memory_order_release);
+            return -1;
+        }
+
+        slot->fd = fd;
+        slot->append = (hostFlags & O_APPEND) != 0;
+        slot->offset.store(0, std::memory_order_relaxed);
+        uint32_t generation = slot->generation.load(std::memory_order_relaxed);
+        slot->state.store(kSlotOpen, std::memory_order_release);
+        return makeHandle(index, generation);
+    }
+
+    int32_t openMemory(std::shared_ptr<const void> owner, const uint8_t *data, uint64_t size)
+    {
+        uint32_t index = 0;
+        HostFileSlot *slot = claimSlot(index);
+        if (!slot)
+        {
+            errno = EMFILE;
+            return -1;
+        }
+
+        slot->fd = -1;
+        slot->append = false;
+        slot->memoryOwner = std::move(owner);
+        slot->memory = data;
+        slot->memorySize = size;
+        slot->offset.store(0, std::memory_order_relaxed);
+        uint32_t generation = slot->generation.load(std::memory_order_relaxed);
+        slot->state.store(kSlotOpen, std::memory_order_release);
+        return makeHandle(index, generation);
+    }
+
+    int close(int32_t handle)
+    {
+        HostFileSlot *slot = lookupSlot(handle);
+        if (!slot)
+        {
+            errno = EBADF;
+            return -1;
+        }
+
+        uint32_t expected = kSlotOpen;
+        if (!slot->state.compare_exchange_strong(expected, kSlotBusy))
+        {
+            errno = EBADF; // lost a race with another close
+            return -1;
+        }
+
+        // Invalidate outstanding handles before the host fd number can be reused.
+        uint32_t nextGeneration = (slot->generation.load(std::memory_order_relaxed) + 1) & kGenerationMask;
+        slot->generation.store(nextGeneration == 0 ? 1 : nextGeneration, std::memory_order_release);
+
+        // Reads and writes that pinned the slot before it went busy still use fd.
+        while (slot->users.load() != 0)
+            std::this_thread::yield();
+
+        int ret = 0;
+        if (slot->memory)
+        {
+            slot->memory = nullptr;
+            slot->memorySize = 0;
+            slot->memoryOwner.reset();
+        }
+        else
+        {
+            ret = hostClose(slot->fd);
+        }
+        slot->fd = -1;
+        slot->state.store(kSlotFree, std::memory_order_release);
+        return ret;
+    }
+
+    bool isValid(int32_t handle)
+    {
+        return lookupSlot(handle) != nullptr;
+    }
+
+    int64_t read(int32_t handle, void *dst, size_t size)
+    {
+        SlotPin slot(handle);
+        if (!slot)
+        {
+            errno = EBADF;
+            return -1;
+        }
+
+        int64_t offset = slot->offset.load(std::memory_order_relaxed);
+        int64_t n = readLoop(*slot, static_cast<uint8_t *>(dst), size, offset);
+        if (n > 0)
+            slot->offset.fetch_add(n, std::memory_order_relaxed);
+        return n;
+    }
+
+    int64_t readAt(int32_t handle, void *dst, size_t size, int64_t offset)
+    {
+        SlotPin slot(handle);
+        if (!slot)
+        {
+            errno = EBADF;
+            return -1;
+        }
+        return readLoop(*slot, static_cast<uint8_t *>(dst), size, offset);
+    }
+
+    int64_t write(int32_t handle, const void *src, size_t size)
+    {
+        SlotPin slot(handle);
+        if (!slot)
+        {
+            errno = EBADF;
+            return -1;
+        }
+
+        if (slot->memory)
+        {
+            errno = EBADF; // mapped handles are read-only
+            return -1;
+        }
+
+        const uint8_t *bytes = static_cast<const uint8_t *>(src);
+        int64_t offset = slot->offset.load(std::memory_order_relaxed);
+        size_t total = 0;
+        while (total < size)
+        {
+            size_t chunk = (size - total) < kMaxChunk ? (size - total) : kMaxChunk;
+            int64_t n = hostWriteAt(*slot, bytes + total, chunk, offset + static_cast<int64_t>(total));
+            if (n <= 0)
+            {
+                if (total == 0)
+                    return -1;
+                break;
+            }
+            total += static_cast<size_t>(n);
+        }
+
+        if (slot->append)
+            slot->offset.store(hostFileSize(slot->fd), std::memory_order_relaxed);
+        else
+            slot->offset.fetch_add(static_cast<int64_t>(total), std::memory_order_relaxed);
+        return static_cast<int64_t>(total);
+    }
+
+    int64_t seek(int32_t handle, int64_t offset, int whence)
+    {
+        SlotPin slot(handle);
+        if (!slot)
+        {
+            errno = EBADF;
+            return -1;
+        }
+
+        int64_t base = 0;
+        switch (whence)
+        {
+        case SEEK_SET:
+            base = 0;
+            break;
+        case SEEK_CUR:
+            base = slot->offset.load(std::memory_order_relaxed);
+            break;
+        case SEEK_END:
+            base = slotSize(*slot);
+            if (base < 0)
+                return -1;
+            break;
+        default:
+            errno = EINVAL;
+            return -1;
+        }
+
+        int64_t newOffset = base + offset;
+        if (newOffset < 0)
+        {
+            errno = EINVAL;
+            return -1;
+        }
+        slot->offset.store(newOffset, std::memory_order_relaxed);
+        return newOffset;
+    }
+
+    int64_t tell(int32_t handle)
+    {
+        SlotPin slot(handle);
+        if (!slot)
+        {
+            errno = EBADF;
+            return -1;
+        }
+        return slot->offset.load(std::memory_order_relaxed);
+    }
+
+    int64_t size(int32_t handle)
+    {
+        SlotPin slot(handle);
+        if (!slot)
+        {
+            errno = EBADF;
+            return -1;
+        }
+        return slotSize(*slot);
+    }
+}
@@ -0,0 +1,310 @@
+#include "ps2_journal.h"
+#include "ps2_varint.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+    constexpr uint32_t kJournalMagic = 0x4A325350; // "PS2J"
+    constexpr uint32_t kJournalVersion = 1;
+
+    constexpr uint8_t kKindMask = 0x3F;
+    constexpr uint8_t kHasValue = 0x40;
+    constexpr uint8_t kHasBytes = 0x80;
+
+    constexpr size_t kFlushThreshold = 64 * 1024;
+    // A thread waiting this long for its turn means the guest left the recorded path.
+    constexpr auto kReplayTimeout = std::chrono::seconds(5);
+
+    struct Record
+    {
+        uint8_t kind = 0;
+        uint32_t threadId = 0;
+        uint64_t value = 0;
+        const uint8_t *bytes = nullptr;
+        size_t size = 0;
+        size_t next = 0; // offset of the following record
+    };
+
+    std::mutex g_mutex;
+    std::condition_variable g_turn;
+    ps2_journal::Mode g_mode = ps2_journal::Mode::Off;
+    std::string g_path;
+    uint64_t g_eventIndex = 0;
+
+    // Recording
+    std::ofstream g_out;
+    std::vector<uint8_t> g_pending;
+
+    // Replay
+    std::vector<uint8_t> g_journal;
+    size_t g_cursor = 0;
+
+    thread_local int t_threadId = 1;
+
+    bool parseRecord(size_t pos, Record &rec)
+    {
+        if (pos >= g_journal.size())
+            return false;
+
+        uint8_t tag = g_journal[pos++];
+        rec.kind = tag & kKindMask;
+
+        uint64_t tid = 0;
+        if (!ps2_varint::get(g_journal, pos, tid))
+            return false;
+        rec.threadId = static_cast<uint32_t>(tid);
+
+        rec.value = 0;
+        if ((tag & kHasValue) && !ps2_varint::get(g_journal, pos, rec.value))
+            return false;
+
+        rec.bytes = nullptr;
+        rec.size = 0;
+        if (tag & kHasBytes)
+        {
+            uint64_t size = 0;
+            if (!ps2_varint::get(g_journal, pos, size) || size > g_journal.size() - pos)
+                return false;
+            rec.bytes = g_journal.data() + pos;
+            rec.size = static_cast<size_t>(size);
+            pos += rec.size;
+        }
+        rec.next = pos;
+        return true;
+    }
+
+    void flushLocked()
+    {
+        if (!g_pending.empty())
+        {
+            g_out.write(reinterpret_cast<const char *>(g_pending.data()), g_pending.size());
+            g_pending.clear();
+        }
+    }
+
+    void appendLocked(uint8_t kind, const uint64_t *value, const uint8_t *data, size_t size)
+    {
+        uint8_t tag = kind | (value ? kHasValue : 0) | (data ? kHasBytes : 0);
+        g_pending.push_back(tag);
+        ps2_varint::put(g_pending, static_cast<uint32_t>(t_threadId));
+        if (value)
+            ps2_varint::put(g_pending, *value);
+        if (data)
+        {
+            ps2_varint::put(g_pending, size);
+            g_pending.insert(g_pending.end(), data, data + size);
+        }
+        ++g_eventIndex;
+
+        if (g_pending.size() >= kFlushThreshold)
+            flushLocked();
+    }
+
+    void abandonReplayLocked(const char *reason)
+    {
+        std::cerr << "[journal] replay of " << g_path << " stopped at event " << g_eventIndex
+                  << " (" << reason << "), continuing live" << std::endl;
+        g_mode = ps2_journal::Mode::Off;
+        g_journal.clear();
+        g_cursor = 0;
+        g_turn.notify_all();
+    }
+
+    // Waits until the journal head is this thread's event of the given kind and
+    // consumes it. Returns false (with replay abandoned) on divergence.
+    bool takeTurnLocked(std::unique_lock<std::mutex> &lock, uint8_t kind, Record &rec)
+    {
+        auto deadline = std::chrono::steady_clock::now() + kReplayTimeout;
+        while (g_mode == ps2_journal::Mode::Replay)
+        {
+            if (g_cursor >= g_journal.size())
+            {
+                abandonReplayLocked("journal exhausted");
+                return false;
+            }
+            if (!parseRecord(g_cursor, rec))
+            {
+                abandonReplayLocked("corrupt record");
+                return false;
+            }
+
+            if (rec.threadId == static_cast<uint32_t>(t_threadId))
+            {
+                if (rec.kind != kind)
+                {
+                    abandonReplayLocked("event mismatch");
+                    return false;
+                }
+                g_cursor = rec.next;
+                ++g_eventIndex;
+                g_turn.notify_all();
+                return true;
+            }
+
+            if (g_turn.wait_until(lock, deadline) == std::cv_status::timeout)
+            {
+                abandonReplayLocked("thread order diverged");
+                return false;
+            }
+        }
+        return false;
+    }
+}
+
+namespace ps2_journal
+{
+    bool startRecording(const std::string &path)
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        if (g_mode != Mode::Off)
+        {
+            std::cerr << "[journal] already active on " << g_path << std::endl;
+            return false;
+        }
+
+        g_out.open(path, std::ios::binary | std::ios::trunc);
+        if (!g_out)
+        {
+            std::cerr << "[journal] failed to create " << path << std::endl;
+            return false;
+        }
+
+        uint32_t header[2] = {kJournalMagic, kJournalVersion};
+        g_out.write(reinterpret_cast<const char *>(header), sizeof(header));
+
+        g_path = path;
+        g_eventIndex = 0;
+        g_pending.clear();
+        g_mode = Mode::Record;
+        return true;
+    }
+
+    bool startReplay(const std::string &path)
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        if (g_mode != Mode::Off)
+        {
+            std::cerr << "[journal] already active on " << g_path << std::endl;
+            return false;
+        }
+
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if (!in)
+        {
+            std::cerr << "[journal] failed to open " << path << std::endl;
+            return false;
+        }
+
+        std::vector<uint8_t> data(static_cast<size_t>(in.tellg()));
+        in.seekg(0);
+        in.read(reinterpret_cast<char *>(data.data()), data.size());
+
+        uint32_t header[2] = {};
+        if (!in || data.size() < sizeof(header))
+        {
+            std::cerr << "[journal] " << path << " is truncated" << std::endl;
+            return false;
+        }
+        std::memcpy(header, data.data(), sizeof(header));
+        if (header[0] != kJournalMagic || header[1] != kJournalVersion)
+        {
+            std::cerr << "[journal] " << path << " is not a version " << kJournalVersion << " journal" << std::endl;
+            return false;
+        }
+
+        g_journal = std::move(data);
+        g_cursor = sizeof(header);
+        g_path = path;
+        g_eventIndex = 0;
+        g_mode = Mode::Replay;
+        return true;
+    }
+
+    void stop()
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        if (g_mode == Mode::Record)
+        {
+            flushLocked();
+            g_out.close();
+            std::cout << "[journal] recorded " << g_eventIndex << " events to " << g_path << std::endl;
+        }
+        else if (g_mode == Mode::Replay)
+        {
+            std::cout << "[journal] replayed " << g_eventIndex << " events from " << g_path << std::endl;
+            g_journal.clear();
+            g_cursor = 0;
+        }
+        g_mode = Mode::Off;
+        g_turn.notify_all();
+    }
+
+    Mode mode()
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        return g_mode;
+    }
+
+    void setCurrentThread(int threadId)
+    {
+        t_threadId = threadId;
+    }
+
+    void sequence(EventKind kind)
+    {
+        std::unique_lock<std::mutex> lock(g_mutex);
+        if (g_mode == Mode::Record)
+        {
+            appendLocked(kind, nullptr, nullptr, 0);
+        }
+        else if (g_mode == Mode::Replay)
+        {
+            Record rec;
+            takeTurnLocked(lock, kind, rec);
+        }
+    }
+
+    uint64_t value(EventKind kind, uint64_t live)
+    {
+        std::unique_lock<std::mutex> lock(g_mutex);
+        if (g_mode == Mode::Record)
+        {
+            appendLocked(kind, &live, nullptr, 0);
+        }
+        else if (g_mode == Mode::Replay)
+        {
+            Record rec;
+            if (takeTurnLocked(lock, kind, rec))
+                return rec.value;
+        }
+        return live;
+    }
+
+    void bytes(EventKind kind, uint8_t *data, size_t size)
+    {
+        std::unique_lock<std::mutex> lock(g_mutex);
+        if (g_mode == Mode::Record)
+        {
+            appendLocked(kind, nullptr, data, size);
+        }
+        else if (g_mode == Mode::Replay)
+        {
+            Record rec;
+            if (takeTurnLocked(lock, kind, rec))
+            {
+                if (rec.size != size)
+                {
+                    abandonReplayLocked("payload size mismatch");
+                    return;
+                }
+                std::memcpy(data, rec.bytes, size);
+            }
+        }
+    }
+}
@@ -0,0 +1,1452 @@
+#include "ps2_memcard.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    // Files left dirty but open are written back after this much inactivity.
+    constexpr auto kIdleFlushDelay = std::chrono::seconds(2);
+
+    constexpr uint16_t kDirMode = ps2_memcard::kModeRead | ps2_memcard::kModeWrite | ps2_memcard::kModeExecute |
+                                  ps2_memcard::kModeDirectory | ps2_memcard::kMode0400 | ps2_memcard::kModeExists;
+    constexpr uint16_t kFileMode = ps2_memcard::kModeRead | ps2_memcard::kModeWrite | ps2_memcard::kModeExecute |
+                                   ps2_memcard::kModeFile | ps2_memcard::kMode0400 | ps2_memcard::kModeExists;
+
+    // libmc open flags, same values as the fio ones
+    constexpr int kOpenRead = 0x0001;
+    constexpr int kOpenWrite = 0x0002;
+    constexpr int kOpenCreate = 0x0200;
+    constexpr int kOpenTrunc = 0x0400;
+
+    // ---- raw .ps2 image layout (8 MB card, 512 byte pages, 2 pages per cluster) ----
+
+    constexpr uint32_t kPageSize = 512;
+    constexpr uint32_t kSpareSize = 16;
+    constexpr uint32_t kPagesPerCluster = 2;
+    constexpr uint32_t kPagesPerBlock = 16;
+    constexpr uint32_t kClustersPerCard = 8192;
+    constexpr uint32_t kImagePages = kClustersPerCard * kPagesPerCluster;
+    constexpr uint32_t kImageSizeRaw = kImagePages * kPageSize;
+    constexpr uint32_t kImageSizeEcc = kImagePages * (kPageSize + kSpareSize);
+    constexpr uint32_t kIfcCluster = 8;
+    constexpr uint32_t kFatClusters = 32;
+    constexpr uint32_t kAllocOffset = kIfcCluster + 1 + kFatClusters;
+    constexpr uint32_t kDirEntrySize = 512;
+    constexpr uint32_t kEntriesPerCluster = ps2_memcard::kClusterSize / kDirEntrySize;
+    constexpr uint32_t kFatFree = 0x7FFFFFFF;
+    constexpr uint32_t kFatEnd = 0xFFFFFFFF;
+    constexpr uint32_t kFatAllocated = 0x80000000;
+    constexpr char kSuperblockMagic[] = "Sony PS2 Memory Card Format ";
+
+    struct McNode
+    {
+        std::string name;
+        uint16_t mode = kFileMode;
+        ps2_memcard::DateTime created;
+        ps2_memcard::DateTime modified;
+        McNode *parent = nullptr;
+        std::vector<std::unique_ptr<McNode>> children; // card order
+
+        std::vector<uint8_t> data;
+        bool loaded = true;    // directory-backed files load contents on first open
+        uint32_t diskSize = 0; // size while not loaded
+        bool dirty = false;
+        Clock::time_point lastWrite{};
+        int openCount = 0;
+
+        bool isDirectory() const { return (mode & ps2_memcard::kModeDirectory) != 0; }
+        uint32_t size() const { return loaded ? static_cast<uint32_t>(data.size()) : diskSize; }
+    };
+
+    struct McCard
+    {
+        bool mounted = false;
+        bool formatted = true;
+        bool isImage = false;
+        bool imageEcc = true;
+        uint8_t imageCardFlags = 0x52;
+        bool imageFlushQueued = false;
+        bool reportedChange = false;
+        std::filesystem::path location;
+        std::unique_ptr<McNode> root;
+        std::string cwd = "/";
+
+        // sceMcGetDir continuation state
+        std::string listPattern;
+        size_t listPosition = 0;
+    };
+
+    struct McOpenFile
+    {
+        bool used = false;
+        int port = 0;
+        McNode *node = nullptr;
+        uint32_t position = 0;
+        int mode = 0;
+    };
+
+    std::mutex g_mcMutex;
+    McCard g_cards[ps2_memcard::kMaxPorts];
+    McOpenFile g_openFiles[ps2_memcard::kMaxOpenFiles];
+
+    // Background writer. Jobs carry their own snapshot of the data they write,
+    // so they never need the card lock (image rebuilds take it themselves).
+    class WriteBackQueue
+    {
+    public:
+        ~WriteBackQueue()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (!m_worker.joinable())
+                    return;
+                m_stop = true;
+            }
+            m_cv.notify_all();
+            m_worker.join();
+        }
+
+        void push(std::function<void()> job)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_jobs.push_back(std::move(job));
+                if (!m_worker.joinable())
+                    m_worker = std::thread([this]
+                                           { run(); });
+            }
+            m_cv.notify_all();
+        }
+
+        void start(std::function<void()> idleScan)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_idleScan = std::move(idleScan);
+            if (!m_worker.joinable())
+                m_worker = std::thread([this]
+                                       { run(); });
+        }
+
+        void drain()
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_idleCv.wait(lock, [this]
+                          { return m_jobs.empty() && !m_busy; });
+        }
+
+    private:
+        void run()
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (true)
+            {
+                if (m_jobs.empty())
+                {
+                    if (m_stop)
+                        break;
+                    m_cv.wait_for(lock, kIdleFlushDelay);
+                    if (m_jobs.empty() && m_idleScan && !m_stop)
+                    {
+                        auto scan = m_idleScan;
+                        lock.unlock();
+                        scan(); // queues jobs for files that went quiet
+                        lock.lock();
+                    }
+                    continue;
+                }
+
+                auto job = std::move(m_jobs.front());
+                m_jobs.pop_front();
+                m_busy = true;
+                lock.unlock();
+                job();
+                lock.lock();
+                m_busy = false;
+                if (m_jobs.empty())
+                    m_idleCv.notify_all();
+            }
+            m_idleCv.notify_all();
+        }
+
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        std::condition_variable m_idleCv;
+        std::deque<std::function<void()>> m_jobs;
+        std::function<void()> m_idleScan;
+        std::thread m_worker;
+        bool m_busy = false;
+        bool m_stop = false;
+    };
+
+    WriteBackQueue g_writeBack;
+
+    ps2_memcard::DateTime currentDateTime()
+    {
+        std::time_t now = std::time(nullptr);
+        std::tm local{};
+#ifdef _WIN32
+        localtime_s(&local, &now);
+#else
+        localtime_r(&now, &local);
+#endif
+        ps2_memcard::DateTime dt;
+        dt.sec = static_cast<uint8_t>(local.tm_sec);
+        dt.min = static_cast<uint8_t>(local.tm_min);
+        dt.hour = static_cast<uint8_t>(local.tm_hour);
+        dt.day = static_cast<uint8_t>(local.tm_mday);
+        dt.month = static_cast<uint8_t>(local.tm_mon + 1);
+        dt.year = static_cast<uint16_t>(local.tm_year + 1900);
+        return dt;
+    }
+
+    bool validPort(int port)
+    {
+        return port >= 0 && port < ps2_memcard::kMaxPorts;
+    }
+
+    std::unique_ptr<McNode> makeRoot()
+    {
+        auto root = std::make_unique<McNode>();
+        root->mode = kDirMode;
+        root->created = root->modified = currentDateTime();
+        return root;
+    }
+
+    McNode *findChild(McNode *dir, const std::string &name)
+    {
+        for (auto &child : dir->children)
+        {
+            if (child->name == name)
+                return child.get();
+        }
+        return nullptr;
+    }
+
+    std::vector<std::string> splitCardPath(const std::string &path)
+    {
+        std::vector<std::string> parts;
+        size_t pos = 0;
+        while (pos <= path.size())
+        {
+            size_t next = path.find('/', pos);
+            if (next == std::string::npos)
+                next = path.size();
+            std::string part = path.substr(pos, next - pos);
+            if (part == "..")
+            {
+                if (!parts.empty())
+                    parts.pop_back();
+            }
+            else if (!part.empty() && part != ".")
+            {
+                parts.push_back(std::move(part));
+            }
+            pos = next + 1;
+        }
+        return parts;
+    }
+
+    // Absolute, normalized component list for a path relative to the card's cwd.
+    std::vector<std::string> cardComponents(const McCard &card, const std::string &path)
+    {
+        if (!path.empty() && path[0] == '/')
+            return splitCardPath(path);
+        return splitCardPath(card.cwd + "/" + path);
+    }
+
+    McNode *lookup(McCard &card, const std::vector<std::string> &components)
+    {
+        McNode *node = card.root.get();
+        for (const std::string &part : components)
+        {
+            if (!node || !node->isDirectory())
+                return nullptr;
+            node = findChild(node, part);
+        }
+        return node;
+    }
+
+    std::string nodeRelativePath(const McNode *node)
+    {
+        std::string path;
+        for (const McNode *n = node; n && n->parent; n = n->parent)
+            path = "/" + n->name + path;
+        return path.empty() ? "/" : path;
+    }
+
+    std::filesystem::path nodeHostPath(const McCard &card, const McNode *node)
+    {
+        std::filesystem::path path = card.location;
+        std::vector<const McNode *> chain;
+        for (const McNode *n = node; n && n->parent; n = n->parent)
+            chain.push_back(n);
+        for (auto it = chain.rbegin(); it != chain.rend(); ++it)
+            path /= (*it)->name;
+        return path;
+    }
+
+    uint32_t clustersFor(uint32_t bytes)
+    {
+        return (bytes + ps2_memcard::kClusterSize - 1) / ps2_memcard::kClusterSize;
+    }
+
+    uint32_t usedClusters(const McNode *node)
+    {
+        if (!node->isDirectory())
+            return clustersFor(node->size());
+
+        uint32_t entries = static_cast<uint32_t>(node->children.size()) + 2;
+        uint32_t total = (entries + kEntriesPerCluster - 1) / kEntriesPerCluster;
+        for (const auto &child : node->children)
+            total += usedClusters(child.get());
+        return total;
+    }
+
+    uint32_t freeClusters(const McCard &card)
+    {
+        uint32_t used = card.root ? usedClusters(card.root.get()) : 0;
+        return used >= ps2_memcard::kCardClusters ? 0 : ps2_memcard::kCardClusters - used;
+    }
+
+    // ---- host directory backend ----
+
+    void scanHostDirectory(McNode *dir, const std::filesystem::path &hostDir)
+    {
+        std::error_code ec;
+        for (std::filesystem::directory_iterator it(hostDir, ec), end; !ec && it != end; it.increment(ec))
+        {
+            auto node = std::make_unique<McNode>();
+            node->name = it->path().filename().string();
+            node->parent = dir;
+            node->created = node->modified = currentDateTime();
+            if (it->is_directory(ec))
+            {
+                node->mode = kDirMode;
+                scanHostDirectory(node.get(), it->path());
+            }
+            else
+            {
+                node->mode = kFileMode;
+                node->loaded = false;
+                node->diskSize = static_cast<uint32_t>(it->file_size(ec));
+            }
+            dir->children.push_back(std::move(node));
+        }
+    }
+
+    bool loadHostFile(const McCard &card, McNode *node)
+    {
+        if (node->loaded)
+            return true;
+
+        std::ifstream in(nodeHostPath(card, node), std::ios::binary);
+        if (!in)
+            return false;
+        node->data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        node->loaded = true;
+        return true;
+    }
+
+    void writeHostFileAtomically(const std::filesystem::path &path, const std::vector<uint8_t> &bytes)
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(path.parent_path(), ec);
+        std::filesystem::path tmp = path;
+        tmp += ".tmp";
+        {
+            std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+            if (!out)
+            {
+                std::cerr << "Memcard write-back error: cannot write '" << tmp.string() << "'" << std::endl;
+                return;
+            }
+            out.write(reinterpret_cast<const char *>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+        }
+        std::filesystem::rename(tmp, path, ec);
+        if (ec)
+            std::cerr << "Memcard write-back error: " << ec.message() << " for '" << path.string() << "'" << std::endl;
+    }
+
+    // ---- .ps2 image backend ----
+
+    uint8_t parity8(uint8_t b)
+    {
+        b ^= b >> 4;
+        b ^= b >> 2;
+        b ^= b >> 1;
+        return b & 1;
+    }
+
+    // Hamming code over a 128 byte chunk, as written into each page's spare area.
+    void eccCalculate(const uint8_t *chunk, uint8_t out[3])
+    {
+        static const uint8_t kColumnMasks[] = {0x55, 0x33, 0x0F, 0x00, 0xAA, 0xCC, 0xF0};
+        uint8_t columnParity = 0x77;
+        uint8_t lineParity0 = 0x7F;
+        uint8_t lineParity1 = 0x7F;
+        for (uint32_t i = 0; i < 128; ++i)
+        {
+            uint8_t b = chunk[i];
+            uint8_t mask = 0;
+            for (uint32_t m = 0; m < 7; ++m)
+                mask |= parity8(b & kColumnMasks[m]) << m;
+            columnParity ^= mask;
+            if (parity8(b))
+            {
+                lineParity0 ^= static_cast<uint8_t>(~i);
+                lineParity1 ^= static_cast<uint8_t>(i);
+            }
+        }
+        out[0] = columnParity;
+        out[1] = lineParity0 & 0x7F;
+        out[2] = lineParity1;
+    }
+
+    uint32_t le32(const uint8_t *p)
+    {
+        uint32_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    uint16_t le16(const uint8_t *p)
+    {
+        uint16_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    void putLe32(uint8_t *p, uint32_t v) { std::memcpy(p, &v, sizeof(v)); }
+    void putLe16(uint8_t *p, uint16_t v) { std::memcpy(p, &v, sizeof(v)); }
+
+    ps2_memcard::DateTime readTod(const uint8_t *p)
+    {
+        ps2_memcard::DateTime dt;
+        dt.resv = p[0];
+        dt.sec = p[1];
+        dt.min = p[2];
+        dt.hour = p[3];
+        dt.day = p[4];
+        dt.month = p[5];
+        dt.year = le16(p + 6);
+        return dt;
+    }
+
+    void writeTod(uint8_t *p, const ps2_memcard::DateTime &dt)
+    {
+        p[0] = dt.resv;
+        p[1] = dt.sec;
+        p[2] = dt.min;
+        p[3] = dt.hour;
+        p[4] = dt.day;
+        p[5] = dt.month;
+        putLe16(p + 6, dt.year);
+    }
+
+    class ImageReader
+    {
+    public:
+        explicit ImageReader(const std::vector<uint8_t> &image)
+            : m_image(image), m_rawPage(image.size() == kImageSizeEcc ? kPageSize + kSpareSize : kPageSize)
+        {
+        }
+
+        bool readSuperblock()
+        {
+            if (m_image.size() < kPageSize || std::memcmp(m_image.data(), kSuperblockMagic, sizeof(kSuperblockMagic) - 1) != 0)
+                return false;
+            const uint8_t *sb = m_image.data();
+            m_pageLen = le16(sb + 0x28);
+            m_pagesPerCluster = le16(sb + 0x2A);
+            m_allocOffset = le32(sb + 0x34);
+            m_allocEnd = le32(sb + 0x38);
+            m_rootCluster = le32(sb + 0x3C);
+            for (uint32_t i = 0; i < 32; ++i)
+                m_ifcList[i] = le32(sb + 0x50 + i * 4);
+            m_cardFlags = sb[0x151];
+            return m_pageLen == kPageSize && m_pagesPerCluster == kPagesPerCluster;
+        }
+
+        uint8_t cardFlags() const { return m_cardFlags; }
+        uint32_t rootCluster() const { return m_rootCluster; }
+
+        bool readCluster(uint32_t absCluster, uint8_t *out) const
+        {
+            for (uint32_t p = 0; p < kPagesPerCluster; ++p)
+            {
+                uint64_t offset = static_cast<uint64_t>(absCluster * kPagesPerCluster + p) * m_rawPage;
+                if (offset + kPageSize > m_image.size())
+                    return false;
+                std::memcpy(out + p * kPageSize, m_image.data() + offset, kPageSize);
+            }
+            return true;
+        }
+
+        uint32_t fatEntry(uint32_t relCluster) const
+        {
+            constexpr uint32_t perCluster = ps2_memcard::kClusterSize / 4;
+            uint32_t fatIndex = relCluster / perCluster;
+            uint32_t ifcIndex = fatIndex / perCluster;
+            if (ifcIndex >= 32)
+                return kFatEnd;
+
+            uint8_t buffer[ps2_memcard::kClusterSize];
+            if (!readCluster(m_ifcList[ifcIndex], buffer))
+                return kFatEnd;
+            uint32_t fatCluster = le32(buffer + (fatIndex % perCluster) * 4);
+            if (!readCluster(fatCluster, buffer))
+                return kFatEnd;
+            return le32(buffer + (relCluster % perCluster) * 4);
+        }
+
+        // Follows a FAT chain, stopping after byteCount bytes.
+        std::vector<uint8_t> readChain(uint32_t relCluster, uint32_t byteCount) const
+        {
+            std::vector<uint8_t> out;
+            out.reserve(byteCount);
+            uint8_t buffer[ps2_memcard::kClusterSize];
+            uint32_t guard = 0;
+            while (out.size() < byteCount && relCluster != kFatEnd && guard++ < kClustersPerCard)
+            {
+                if (!readCluster(m_allocOffset + relCluster, buffer))
+                    break;
+                size_t take = std::min<size_t>(ps2_memcard::kClusterSize, byteCount - out.size());
+                out.insert(out.end(), buffer, buffer + take);
+                uint32_t next = fatEntry(relCluster);
+                if (next == kFatEnd || !(next & kFatAllocated))
+                    break;
+                relCluster = next & ~kFatAllocated;
+            }
+            return out;
+        }
+
+        void readDirectory(McNode *dir, uint32_t relCluster, uint32_t entryCount, int depth) const
+        {
+            if (depth > 32)
+                return;
+
+            std::vector<uint8_t> raw = readChain(relCluster, entryCount * kDirEntrySize);
+            uint32_t count = static_cast<uint32_t>(raw.size() / kDirEntrySize);
+            for (uint32_t i = 2; i < count; ++i) // skip "." and ".."
+            {
+                const uint8_t *ent = raw.data() + i * kDirEntrySize;
+                uint16_t mode = le16(ent);
+                if (!(mode & ps2_memcard::kModeExists))
+                    continue;
+
+                auto node = std::make_unique<McNode>();
+                node->mode = mode;
+                node->parent = dir;
+                node->created = readTod(ent + 8);
+                node->modified = readTod(ent + 24);
+                node->name.assign(reinterpret_cast<const char *>(ent + 64), strnlen(reinterpret_cast<const char *>(ent + 64), 32));
+
+                uint32_t length = le32(ent + 4);
+                uint32_t cluster = le32(ent + 16);
+                if (node->isDirectory())
+                    readDirectory(node.get(), cluster, length, depth + 1);
+                else if (length > 0)
+                    node->data = readChain(cluster, length);
+                dir->children.push_back(std::move(node));
+            }
+        }
+
+        uint32_t rootEntryCount() const
+        {
+            uint8_t buffer[ps2_memcard::kClusterSize];
+            if (!readCluster(m_allocOffset + m_rootCluster, buffer))
+                return 0;
+            return le32(buffer + 4); // "." of the root holds the entry count
+        }
+
+    private:
+        const std::vector<uint8_t> &m_image;
+        uint32_t m_rawPage;
+        uint32_t m_pageLen = 0;
+        uint32_t m_pagesPerCluster = 0;
+        uint32_t m_allocOffset = 0;
+        uint32_t m_allocEnd = 0;
+        uint32_t m_rootCluster = 0;
+        uint32_t m_ifcList[32] = {};
+        uint8_t m_cardFlags = 0x52;
+    };
+
+    // Lays a fresh filesystem out for the whole tree: clusters are handed out
+    // depth-first, so every file and directory ends up as one contiguous chain.
+    class ImageWriter
+    {
+    public:
+        ImageWriter() : m_clusters(kClustersPerCard * ps2_memcard::kClusterSize, 0), m_fat(ps2_memcard::kCardClusters, kFatFree) {}
+
+        bool build(const McNode *root, bool ecc, uint8_t cardFlags, std::vector<uint8_t> &out)
+        {
+            if ((cardFlags & 0x10) == 0) // erased flash reads as 0xFF unless CF_ERASE_ZEROES
+                std::fill(m_clusters.begin(), m_clusters.end(), 0xFF);
+
+            uint32_t rootEntries = static_cast<uint32_t>(root->children.size()) + 2;
+            uint32_t rootCluster = allocate((rootEntries + kEntriesPerCluster - 1) / kEntriesPerCluster);
+            if (rootCluster != 0)
+                return false;
+            if (!writeDirectory(root, rootCluster, 0, 0, true))
+                return false;
+
+            writeSuperblock(cardFlags);
+            writeFat();
+
+            const uint32_t rawPage = ecc ? kPageSize + kSpareSize : kPageSize;
+            out.assign(static_cast<size_t>(kImagePages) * rawPage, 0);
+            for (uint32_t page = 0; page < kImagePages; ++page)
+            {
+                const uint8_t *src = m_clusters.data() + static_cast<size_t>(page) * kPageSize;
+                uint8_t *dst = out.data() + static_cast<size_t>(page) * rawPage;
+                std::memcpy(dst, src, kPageSize);
+                if (ecc)
+                {
+                    for (uint32_t chunk = 0; chunk < 4; ++chunk)
+                        eccCalculate(src + chunk * 128, dst + kPageSize + chunk * 3);
+                }
+            }
+            return true;
+        }
+
+    private:
+        uint8_t *cluster(uint32_t absCluster) { return m_clusters.data() + static_cast<size_t>(absCluster) * ps2_memcard::kClusterSize; }
+
+        // Returns the first relative cluster of a new chain, kFatEnd for empty or full.
+        uint32_t allocate(uint32_t count)
+        {
+            if (count == 0 || m_nextFree + count > ps2_memcard::kCardClusters)
+                return kFatEnd;
+            uint32_t first = m_nextFree;
+            for (uint32_t i = 0; i < count; ++i)
+                m_fat[first + i] = (i + 1 == count) ? kFatEnd : (kFatAllocated | (first + i + 1));
+            m_nextFree += count;
+            return first;
+        }
+
+        void writeChain(uint32_t first, const uint8_t *data, size_t size)
+        {
+            for (size_t offset = 0; offset < size; offset += ps2_memcard::kClusterSize)
+            {
+                size_t take = std::min<size_t>(ps2_memcard::kClusterSize, size - offset);
+                std::memcpy(cluster(kAllocOffset + first + static_cast<uint32_t>(offset / ps2_memcard::kClusterSize)), data + offset, take);
+            }
+        }
+
+        static void fillEntry(uint8_t *ent, uint16_t mode, uint32_t length, uint32_t clusterNo, uint32_t dirEntry,
+                              const ps2_memcard::DateTime &created, const ps2_memcard::DateTime &modified, const std::string &name)
+        {
+            std::memset(ent, 0, kDirEntrySize);
+            putLe16(ent, mode);
+            putLe32(ent + 4, length);
+            writeTod(ent + 8, created);
+            putLe32(ent + 16, clusterNo);
+            putLe32(ent + 20, dirEntry);
+            writeTod(ent + 24, modified);
+            std::memcpy(ent + 64, name.data(), std::min<size_t>(name.size(), 32));
+        }
+
+        bool writeDirectory(const McNode *dir, uint32_t first, uint32_t parentCluster, uint32_t indexInParent, bool isRoot)
+        {
+            uint32_t entryCount = static_cast<uint32_t>(dir->children.size()) + 2;
+            std::vector<uint8_t> entries(static_cast<size_t>(entryCount) * kDirEntrySize, 0);
+
+            if (isRoot)
+            {
+                fillEntry(entries.data(), kDirMode, entryCount, 0, 0, dir->created, dir->modified, ".");
+                fillEntry(entries.data() + kDirEntrySize, (kDirMode & ~ps2_memcard::kModeRead) | ps2_memcard::kModeHidden,
+                          0, 0, 0, dir->created, dir->modified, "..");
+            }
+            else
+            {
+                fillEntry(entries.data(), kDirMode, 0, parentCluster, indexInParent, dir->created, dir->modified, ".");
+                fillEntry(entries.data() + kDirEntrySize, kDirMode & ~ps2_memcard::kModeRead, 0, 0, 0, dir->created, dir->modified, "..");
+            }
+
+            for (uint32_t i = 0; i < dir->children.size(); ++i)
+            {
+                const McNode *child = dir->children[i].get();
+                uint8_t *ent = entries.data() + static_cast<size_t>(i + 2) * kDirEntrySize;
+                if (child->isDirectory())
+                {
+                    uint32_t childEntries = static_cast<uint32_t>(child->children.size()) + 2;
+                    uint32_t childFirst = allocate((childEntries + kEntriesPerCluster - 1) / kEntriesPerCluster);
+                    if (childFirst == kFatEnd)
+                        return false;
+                    fillEntry(ent, child->mode, childEntries, childFirst, 0, child->created, child->modified, child->name);
+                    if (!writeDirectory(child, childFirst, first, i + 2, false))
+                        return false;
+                }
+                else
+                {
+                    uint32_t size = static_cast<uint32_t>(child->data.size());
+                    uint32_t childFirst = kFatEnd;
+                    if (size > 0)
+                    {
+                        childFirst = allocate(clustersFor(size));
+                        if (childFirst == kFatEnd)
+                            return false;
+                        writeChain(childFirst, child->data.data(), size);
+                    }
+                    fillEntry(ent, child->mode, size, childFirst, 0, child->created, child->modified, child->name);
+                }
+            }
+
+            writeChain(first, entries.data(), entries.size());
+            return true;
+        }
+
+        void writeSuperblock(uint8_t cardFlags)
+        {
+            uint8_t *sb = cluster(0);
+            std::memset(sb, 0, ps2_memcard::kClusterSize);
+            std::memcpy(sb, kSuperblockMagic, sizeof(kSuperblockMagic) - 1);
+            std::memcpy(sb + 0x1C, "1.2.0.0", 7);
+            putLe16(sb + 0x28, kPageSize);
+            putLe16(sb + 0x2A, kPagesPerCluster);
+            putLe16(sb + 0x2C, kPagesPerBlock);
+            putLe16(sb + 0x2E, 0xFF00);
+            putLe32(sb + 0x30, kClustersPerCard);
+            putLe32(sb + 0x34, kAllocOffset);
+            putLe32(sb + 0x38, ps2_memcard::kCardClusters);
+            putLe32(sb + 0x3C, 0);                                 // root directory cluster
+            putLe32(sb + 0x40, kClustersPerCard / 8 - 1);          // backup block 1
+            putLe32(sb + 0x44, kClustersPerCard / 8 - 2);          // backup block 2
+            putLe32(sb + 0x50, kIfcCluster);
+            for (uint32_t i = 0; i < 32; ++i)
+                putLe32(sb + 0xD0 + i * 4, 0xFFFFFFFF); // no bad blocks
+            sb[0x150] = 2;                              // PS2 card
+            sb[0x151] = cardFlags;
+        }
+
+        void writeFat()
+        {
+            uint8_t *ifc = cluster(kIfcCluster);
+            std::memset(ifc, 0, ps2_memcard::kClusterSize);
+            for (uint32_t i = 0; i < kFatClusters; ++i)
+                putLe32(ifc + i * 4, kIfcCluster + 1 + i);
+
+            constexpr uint32_t perCluster = ps2_memcard::kClusterSize / 4;
+            for (uint32_t i = 0; i < kFatClusters; ++i)
+            {
+                uint8_t *fat = cluster(kIfcCluster + 1 + i);
+                for (uint32_t e = 0; e < perCluster; ++e)
+                {
+                    uint32_t index = i * perCluster + e;
+                    putLe32(fat + e * 4, index < m_fat.size() ? m_fat[index] : kFatFree);
+                }
+            }
+        }
+
+        std::vector<uint8_t> m_clusters;
+        std::vector<uint32_t> m_fat;
+        uint32_t m_nextFree = 0;
+    };
+
+    std::unique_ptr<McNode> loadImageTree(const std::vector<uint8_t> &image, uint8_t &cardFlags)
+    {
+        ImageReader reader(image);
+        if (!reader.readSuperblock())
+            return nullptr;
+
+        cardFlags = reader.cardFlags();
+        auto root = makeRoot();
+        reader.readDirectory(root.get(), reader.rootCluster(), reader.rootEntryCount(), 0);
+        return root;
+    }
+
+    // ---- write-back scheduling (called with g_mcMutex held) ----
+
+    void queueImageFlush(int port)
+    {
+        McCard &card = g_cards[port];
+        if (card.imageFlushQueued)
+            return;
+        card.imageFlushQueued = true;
+
+        g_writeBack.push([port]
+                         {
+            std::vector<uint8_t> bytes;
+            std::filesystem::path target;
+            {
+                std::lock_guard<std::mutex> lock(g_mcMutex);
+                McCard &card = g_cards[port];
+                card.imageFlushQueued = false;
+                if (!card.mounted || !card.isImage)
+                    return;
+                ImageWriter writer;
+                if (!writer.build(card.root.get(), card.imageEcc, card.imageCardFlags, bytes))
+                {
+                    std::cerr << "Memcard write-back error: card " << port << " contents exceed 8 MB" << std::endl;
+                    return;
+                }
+                target = card.location;
+            }
+            writeHostFileAtomically(target, bytes); });
+    }
+
+    void queueFileFlush(int port, McNode *node)
+    {
+        McCard &card = g_cards[port];
+        if (!node->dirty)
+            return;
+        node->dirty = false;
+
+        if (card.isImage)
+        {
+            queueImageFlush(port);
+            return;
+        }
+
+        auto snapshot = std::make_shared<std::vector<uint8_t>>(node->data);
+        std::filesystem::path target = nodeHostPath(card, node);
+        g_writeBack.push([target, snapshot]
+                         { writeHostFileAtomically(target, *snapshot); });
+    }
+
+    // Structural changes (mkdir/delete/rename) are replayed in order on the host.
+    void queueHostOperation(int port, std::function<void()> op)
+    {
+        if (g_cards[port].isImage)
+        {
+            queueImageFlush(port);
+            return;
+        }
+        g_writeBack.push(std::move(op));
+    }
+
+    void queueDirtyFiles(int port, McNode *node, bool idleOnly, Clock::time_point now)
+    {
+        if (node->isDirectory())
+        {
+            for (auto &child : node->children)
+                queueDirtyFiles(port, child.get(), idleOnly, now);
+            return;
+        }
+        if (node->dirty && (!idleOnly || now - node->lastWrite >= kIdleFlushDelay))
+            queueFileFlush(port, node);
+    }
+
+    void idleScan()
+    {
+        std::lock_guard<std::mutex> lock(g_mcMutex);
+        Clock::time_point now = Clock::now();
+        for (int port = 0; port < ps2_memcard::kMaxPorts; ++port)
+        {
+            if (g_cards[port].mounted && g_cards[port].root)
+                queueDirtyFiles(port, g_cards[port].root.get(), true, now);
+        }
+    }
+
+    void markModified(McNode *node)
+    {
+        node->dirty = true;
+        node->lastWrite = Clock::now();
+        node->modified = currentDateTime();
+    }
+
+    McCard *cardFor(int port)
+    {
+        if (!validPort(port))
+            return nullptr;
+        McCard &card = g_cards[port];
+        if (!card.mounted)
+        {
+            // Unconfigured slots fall back to ./mc<port>, like the mc0: VFS mount.
+            std::error_code ec;
+            std::filesystem::path root = std::filesystem::current_path(ec) / ("mc" + std::to_string(port));
+            std::filesystem::create_directories(root, ec);
+            card.mounted = true;
+            card.isImage = false;
+            card.location = root;
+            card.root = makeRoot();
+            card.cwd = "/";
+            scanHostDirectory(card.root.get(), root);
+            g_writeBack.start(idleScan);
+        }
+        return &card;
+    }
+
+    McOpenFile *openFileFor(int32_t fd)
+    {
+        if (fd < 0 || fd >= ps2_memcard::kMaxOpenFiles || !g_openFiles[fd].used)
+            return nullptr;
+        return &g_openFiles[fd];
+    }
+
+    // Drops the descriptors of a card whose node tree is about to be replaced.
+    void dropOpenFiles(int port)
+    {
+        for (McOpenFile &file : g_openFiles)
+        {
+            if (file.used && file.port == port)
+                file = McOpenFile{};
+        }
+    }
+
+    bool hasOpenFiles(const McNode *node)
+    {
+        if (node->openCount > 0)
+            return true;
+        for (const auto &child : node->children)
+        {
+            if (hasOpenFiles(child.get()))
+                return true;
+        }
+        return false;
+    }
+
+    bool wildcardMatch(const char *pattern, const char *name)
+    {
+        if (*pattern == '\0')
+            return *name == '\0';
+        if (*pattern == '*')
+            return wildcardMatch(pattern + 1, name) || (*name && wildcardMatch(pattern, name + 1));
+        if (*name && (*pattern == '?' || *pattern == *name))
+            return wildcardMatch(pattern + 1, name + 1);
+        return false;
+    }
+
+    ps2_memcard::EntryInfo entryInfo(const McNode *node, const std::string &name)
+    {
+        ps2_memcard::EntryInfo info;
+        info.name = name;
+        info.mode = node->mode;
+        info.size = node->isDirectory() ? static_cast<uint32_t>(node->children.size()) + 2 : node->size();
+        info.created = node->created;
+        info.modified = node->modified;
+        return info;
+    }
+}
+
+namespace ps2_memcard
+{
+    bool mountDirectory(int port, const std::filesystem::path &root)
+    {
+        if (!validPort(port))
+            return false;
+
+        std::error_code ec;
+        std::filesystem::create_directories(root, ec);
+        if (!std::filesystem::is_directory(root, ec))
+        {
+            std::cerr << "Memcard error: '" << root.string() << "' is not a directory" << std::endl;
+            return false;
+        }
+
+        flushAll(true);
+        std::lock_guard<std::mutex> lock(g_mcMutex);
+        dropOpenFiles(port);
+        McCard &card = g_cards[port];
+        card = McCard{};
+        card.mounted = true;
+        card.location = std::filesystem::absolute(root, ec);
+        card.root = makeRoot();
+        scanHostDirectory(card.root.get(), card.location);
+        g_writeBack.start(idleScan);
+        std::cout << "Memcard: slot " << port << " -> " << card.location.string() << std::endl;
+        return true;
+    }
+
+    bool mountImage(int port, const std::filesystem::path &image)
+    {
+        if (!validPort(port))
+            return false;
+
+        std::error_code ec;
+        bool exists = std::filesystem::exists(image, ec);
+        std::vector<uint8_t> bytes;
+        if (exists)
+        {
+            std::ifstream in(image, std::ios::binary);
+            bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+            if (bytes.size() != kImageSizeRaw && bytes.size() != kImageSizeEcc)
+            {
+                std::cerr << "Memcard error: '" << image.string() << "' is not an 8 MB card image" << std::endl;
+                return false;
+            }
+        }
+
+        flushAll(true);
+        std::lock_guard<std::mutex> lock(g_mcMutex);
+        dropOpenFiles(port);
+        McCard &card = g_cards[port];
+        card = McCard{};
+        card.mounted = true;
+        card.isImage = true;
+        card.location = std::filesystem::absolute(image, ec);
+
+        if (exists)
+        {
+            card.imageEcc = bytes.size() == kImageSizeEcc;
+            card.root = loadImageTree(bytes, card.imageCardFlags);
+            if (!card.root)
+            {
+                // Unformatted card: keep it empty until the game formats it.
+                card.formatted = false;
+                card.root = makeRoot();
+            }
+        }
+        else
+        {
+            card.root = makeRoot();
+            queueImageFlush(port); // materialise a freshly formatted card
+        }
+
+        g_writeBack.start(idleScan);
+        std::cout << "Memcard: slot " << port << " -> image " << card.location.string() << std::endl;
+        return true;
+    }
+
+    void unmount(int port)
+    {
+        if (!validPort(port))
+            return;
+        flushAll(true);
+        std::lock_guard<std::mutex> lock(g_mcMutex);
+        dropOpenFiles(port);
+        g_cards[port] = McCard{};
+    }
+
+    void flushAll(bool wait)
+    {
+        {
+            std::lock_guard<std::mutex> lock(g_mcMutex);
+            for (int port = 0; port < kMaxPorts; ++port)
+            {
+                if (g_cards[port].mounted && g_cards[port].root)
+                    queueDirtyFiles(port, g_cards[port].root.get(), false, Clock::now());
+            }
+        }
+        if (wait)
+            g_writeBack.drain();
+    }
+
+    int32_t getInfo(int port, int32_t &type, int32_t &freeSpace, int32_t &format)
+    {
+        std::lock_guard<std::mutex> lock(g_mcMutex);
+        McCard *card = cardFor(port);
+        if (!card)
+            return kResNoEntry;
+
+        type = 2; // sceMcTypePS2
+        format = card->formatted ? 1 : 0;
+        freeSpace = card->formatted ? static_cast<int32_t>(freeClusters(*card)) : 0;
+
+        // The first query after insertion reports a "new card" like the real driver.
+        if (!card->reportedChange)
+        {
+            card->reportedChange = true;
+            return card->formatted ? kResChangedCard : kResNoFormat;
+        }
+        return card->formatted ? kResSucceed : kResNoFormat;
+    }
+
+    int32_t open(int port, const std::string &path, int mode)
+    {
+        std::lock_guard<std::mutex> lock(g_mcMutex);
+        McCard *card = cardFor(port);
+        if (!card)
+            return kResNoEntry;
+        if (!card->formatted)
+            return kResNoFormat;
+
+        int32_t fd = -1;
+        for (int32_t i = 0; i < kMaxOpenFiles; ++i)
+        {
+            if (!g_openFiles[i].used)
+            {
+                fd = i;
+                break;
+            }
+        }
+        if (fd < 0)
+            return kResUpLimitHandle;
+
+        std::vector<std::string> components = cardComponents(*card, path);
+        if (components.empty())
+            return kResDeniedPermit;
+
+        McNode *node = lookup(*card, components);
+        if (!node)
+        {
+            if (!(mode & kOpenCreate))
+                return kResNoEntry;
+
+            std::vector<std::string> parentPath(components.begin(), components.end() - 1);
+            McNode *parent = lookup(*card, parentPath);
+            if (!parent || !parent->isDirectory())
+                return kResNoEntry;
+            if (freeClusters(*card) == 0)
+                return kResFullDevice;
+
+            auto created = std::make_unique<McNode>();
+            created->name = components.back().substr(0, 31);
+            created->mode = kFileMode;
+            created->parent = parent;
+            created->created = created->modified = currentDateTime();
+            node = created.get();
+            parent->children.push_back(std::move(created));
+            markModified(node);
+        }
+        else if (node->isDirectory())
+        {
+            return kResDeniedPermit;
+        }
+        else if (!card->isImage && !loadHostFile(*card, node))
+        {
+            return kResNoEntry;
+        }
+
+        if ((mode & kOpenWrite) && (node->mode & kModeProtected))
+            return kResDeniedPermit;
+        if (mode & kOpenTrunc)
+        {
+            node->data.clear();
+            markModified(node);
+        }
+
+        McOpenFile &file = g_openFiles[fd];
+        file.used = true;
+        file.port = port;
+        file.node = node;
+        file.position = 0;
+        file.mode = mode;
+        ++node->openCount;
+        return fd;
+    }
+
+    int32_t close(int32_t fd)
+    {
+        std::lock_guard<std::mutex> lock(g_mcMutex);
+        McOpenFile *file = openFileFor(fd);
+        if (!file)
+            return kResDeniedPermit;
+
+        --file->node->openCount;
+        queueFileFlush(file->port, file->node);
+        *file = McOpenFile{};
+        return kResSucceed;
+    }
+
+    int32_t read(int32_t fd, void *dst, int32_t size)
+    {
+        std::lock_guard<std::mutex> lock(g_mcMutex);
+        McOpenFile *file = openFileFor(fd);
+        if (!file || !(file->mode & kOpenRead))
+            return kResDeniedPermit;
+        if (size <= 0)
+            return 0;
+
+        const std::vector<uint8_t> &data = file->node->data;
+        if (file->position >= data.size())
+            return 0;
+        uint32_t count = std::min<uint32_t>(static_cast<uint32_t>(size), static_cast<uint32_t>(data.size()) - file->position);
+        std::memcpy(dst, data.data() + file->position, count);
+        file->position += count;
+        return static_cast<int32_t>(count);
+    }
+
+    int32_t write(int32_t fd, const void *src, int32_t size)
+    {
+        std::lock_guard<std::mutex> lock(g_mcMutex);
+        McOpenFile *file = openFileFor(fd);
+        if (!file || !(file->mode & kOpenWrite))
+            return kResDeniedPermit;
+        if (size <= 0)
+            return 0;
+
+        McNode *node = file->node;
+        uint64_t end = static_cast<uint64_t>(file->position) + static_cast<uint32_t>(size);
+        uint32_t extraClusters = end > node->data.size() ? clustersFor(static_cast<uint32_t>(end)) - clustersFor(static_cast<uint32_t>(node->data.size())) : 0;
+        if (extraClusters > freeClusters(g_cards[file->port]))
+            return kResFullDevice;
+
+        if (end > node->data.size())
+            node->data.resize(static_cast<size_t>(end));
+        std::memcpy(node->data.data() + file->position, src, static_cast<size_t>(size));
+        file->position = static_cast<uint32_t>(end);
+        markModified(node);
+        return size;
+    }
+
+    int32_t seek(int32_t fd, int32_t offset, int whence)
+    {
+        std::lock_guard<std::mutex> lock(g_mcMutex);
+        McOpenFile *file = openFileFor(fd);
+        if (!file)
+            return kResDeniedPermit;
+
+        int64_t base = 0;
+        if (whence == 1)
+            base = file->position;
+        else if (whence == 2)
+            base = static_cast<int64_t>(file->node->data.size());
+        int64_t position = base + offset;
+        if (position < 0)
+            return kResDeniedPermit;
+        file->position = static_cast<uint32_t>(position);
+        return static_cast<int32_t>(position);
+    }
+
+    int32_t flush(int32_t fd)
+    {
+        std::lock_guard<std::mutex> lock(g_mcMutex);
+        McOpenFile *file = openFileFor(fd);
+        if (!file)
+            return kResDeniedPermit;
+        queueFileFlush(file->port, file->node);
+        return kResSucceed;
+    }
+
+    int32_t mkdir(int port, const std::string &path)
+    {
+        std::lock_guard<std::mutex> lock(g_mcMutex);
+        McCard *card = cardFor(port);
+        if (!card)
+            return kResNoEntry;
+        if (!card->formatted)
+            return kResNoFormat;
+
+        std::vector<std::string> components = cardComponents(*card, path);
+        if (components.empty())
+            return kResNoEntry;
+        if (lookup(*card, components))
+            return kResNoEntry; // already exists
+        McNode *parent = lookup(*card, std::vector<std::string>(components.begin(), components.end() - 1));
+        if (!parent || !parent->isDirectory())
+            return kResNoEntry;
+        if (freeClusters(*card) == 0)
+            return kResFullDevice;
+
+        auto dir = std::make_unique<McNode>();
+        dir->name = components.back().substr(0, 31);
+        dir->mode = kDirMode;
+        dir->parent = parent;
+        dir->created = dir->modified = currentDateTime();
+        std::filesystem::path hostDir = card->isImage ? std::filesystem::path() : nodeHostPath(*card, dir.get());
+        parent->children.push_back(std::move(dir));
+
+        queueHostOperation(port, [hostDir]
+                           {
+            std::error_code ec;
+            std::filesystem::create_directories(hostDir, ec); });
+        return kResSucceed;
+    }
+
+    int32_t chdir(int port, const std::string &path, std::string &previous)
+    {
+        std::lock_guard<std::mutex> lock(g_mcMutex);
+        McCard *card = cardFor(port);
+        if (!card)
+            return kResNoEntry;
+
+        previous = card->cwd;
+        std::vector<std::string> components = cardComponents(*card, path);
+        McNode *node = lookup(*card, components);
+        if (!node || !node->isDirectory())
+            return kResNoEntry;
+        card->cwd = nodeRelativePath(node);
+        return kResSucceed;
+    }
+
+    int32_t remove(int port, const std::string &path)
+    {
+        std::lock_guard<std::mutex> lock(g_mcMutex);
+        McCard *card = cardFor(port);
+        if (!card)
+            return kResNoEntry;
+
+        McNode *node = lookup(*card, cardComponents(*card, path));
+        if (!node || !node->parent)
+            return kResNoEntry;
+        if (node->isDirectory() && !node->children.empty())
+            return kResNotEmpty;
+        if (hasOpenFiles(node))
+            return kResDeniedPermit;
+
+        std::filesystem::path hostPath = card->isImage ? std::filesystem::path() : nodeHostPath(*card, node);
+        auto &siblings = node->parent->children;
+        siblings.erase(std::remove_if(siblings.begin(), siblings.end(), [node](const std::unique_ptr<McNode> &n)
+                                      { return n.get() == node; }),
+                       siblings.end());
+
+        queueHostOperation(port, [hostPath]
+                           {
+            std::error_code ec;
+            std::filesystem::remove(hostPath, ec); });
+        return kResSucceed;
+    }
+
+    int32_t rename(int port, const std::string &from, const std::string &toName)
+    {
+        std::lock_guard<std::mutex> lock(g_mcMutex);
+        McCard *card = cardFor(port);
+        if (!card)
+            return kResNoEntry;
+
+        McNode *node = lookup(*card, cardComponents(*card, from));
+        if (!node || !node->parent)
+            return kResNoEntry;
+        // libmc renames in place, the new name is a bare entry name
+        std::string newName = toName.substr(toName.find_last_of('/') == std::string::npos ? 0 : toName.find_last_of('/') + 1).substr(0, 31);
+        if (newName.empty() || findChild(node->parent, newName))
+            return kResNoEntry;
+        if (hasOpenFiles(node))
+            return kResDeniedPermit;
+
+        std::filesystem::path oldHost = card->isImage ? std::filesystem::path() : nodeHostPath(*card, node);
+        node->name = newName;
+        std::filesystem::path newHost = card->isImage ? std::filesystem::path() : nodeHostPath(*card, node);
+
+        queueHostOperation(port, [oldHost, newHost]
+                           {
+            std::error_code ec;
+            std::filesystem::rename(oldHost, newHost, ec); });
+        return kResSucceed;
+    }
+
+    int32_t setFileInfo(int port, const std::string &path, const EntryInfo &info, uint32_t valid)
+    {
+        McNode *node = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(g_mcMutex);
+            McCard *card = cardFor(port);
+            if (!card)
+                return kResNoEntry;
+            node = lookup(*card, cardComponents(*card, path));
+            if (!node || !node->parent)
+                return kResNoEntry;
+
+            if (valid & 0x01)
+                node->created = info.created;
+            if (valid & 0x02)
+                node->modified = info.modified;
+            if (valid & 0x04)
+            {
+                // only the user-settable bits, type and existence stay as they are
+                constexpr uint16_t kUserBits = kModeRead | kModeWrite | kModeExecute | kModeProtected | kModeHidden;
+                node->mode = static_cast<uint16_t>((node->mode & ~kUserBits) | (info.mode & kUserBits));
+            }
+            if (card->isImage)
+                queueImageFlush(port);
+        }
+
+        if (valid & 0x08)
+            return rename(port, path, info.name);
+        return kResSucceed;
+    }
+
+    int32_t format(int port)
+    {
+        std::lock_guard<std::mutex> lock(g_mcMutex);
+        McCard *card = cardFor(port);
+        if (!card)
+            return kResNoEntry;
+        if (hasOpenFiles(card->root.get()))
+            return kResDeniedPermit;
+
+        std::vector<std::filesystem::path> hostEntries;
+        if (!card->isImage)
+        {
+            for (const auto &child : card->root->children)
+                hostEntries.push_back(nodeHostPath(*card, child.get()));
+        }
+
+        card->root = makeRoot();
+        card->cwd = "/";
+        card->formatted = true;
+        queueHostOperation(port, [hostEntries]
+                           {
+            std::error_code ec;
+            for (const auto &entry : hostEntries)
+                std::filesystem::remove_all(entry, ec); });
+        return kResSucceed;
+    }
+
+    int32_t unformat(int port)
+    {
+        int32_t ret = format(port);
+        if (ret == kResSucceed)
+        {
+            std::lock_guard<std::mutex> lock(g_mcMutex);
+            g_cards[port].formatted = false;
+        }
+        return ret;
+    }
+
+    int32_t getEntSpace(int port, const std::string &path)
+    {
+        std::lock_guard<std::mutex> lock(g_mcMutex);
+        McCard *card = cardFor(port);
+        if (!card)
+            return kResNoEntry;
+
+        McNode *node = lookup(*card, cardComponents(*card, path));
+        if (!node || !node->isDirectory())
+            return kResNoEntry;
+
+        // Free entry slots in the directory's last cluster.
+        uint32_t entries = static_cast<uint32_t>(node->children.size()) + 2;
+        uint32_t remainder = entries % kEntriesPerCluster;
+        return remainder == 0 ? 0 : static_cast<int32_t>(kEntriesPerCluster - remainder);
+    }
+
+    int32_t getDir(int port, const std::string &pattern, bool continueListing, int32_t maxEntries,
+                   std::vector<EntryInfo> &out)
+    {
+        std::lock_guard<std::mutex> lock(g_mcMutex);
+        McCard *card = cardFor(port);
+        if (!card)
+            return kResNoEntry;
+        if (!card->formatted)
+            return kResNoFormat;
+
+        if (!continueListing)
+        {
+            card->listPattern = pattern;
+            card->listPosition = 0;
+        }
+
+        std::vector<std::string> components = cardComponents(*card, card->listPattern);
+        std::string namePattern = components.empty() ? "*" : components.back();
+        if (!components.empty())
+            components.pop_back();
+
+        McNode *dir = lookup(*card, components);
+        if (!dir || !dir->isDirectory())
+            return kResNoEntry;
+
+        // "." and ".." come first, like on the card
+        std::vector<EntryInfo> matches;
+        if (dir->parent)
+        {
+            if (wildcardMatch(namePattern.c_str(), "."))
+                matches.push_back(entryInfo(dir, "."));
+            if (wildcardMatch(namePattern.c_str(), ".."))
+                matches.push_back(entryInfo(dir->parent, ".."));
+        }
+        for (const auto &child : dir->children)
+        {
+            if (wildcardMatch(namePattern.c_str(), child->name.c_str()))
+                matches.push_back(entryInfo(child.get(), child->name));
+        }
+
+        out.clear();
+        while (card->listPosition < matches.size() && static_cast<int32_t>(out.size()) < maxEntries)
+            out.push_back(matches[card->listPosition++]);
+        return static_cast<int32_t>(out.size());
+    }
+}
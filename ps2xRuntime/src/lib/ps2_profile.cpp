@@ -0,0 +1,157 @@
+#include "ps2_profile.h"
+#include "ps2_profile_format.h"
+#include "ps2_varint.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+    struct BranchCounts
+    {
+        uint64_t taken = 0;
+        uint64_t notTaken = 0;
+    };
+
+    // Only the owning thread writes its table; the lock is uncontended except
+    // while stop() merges.
+    struct ThreadCounts
+    {
+        std::mutex mutex;
+        std::unordered_map<uint32_t, uint64_t> entries;
+        std::unordered_map<uint32_t, BranchCounts> branches;
+    };
+
+    std::mutex g_mutex;
+    std::string g_path;
+    // Kept alive past their thread, so counts of guest threads that exited still get written.
+    std::vector<std::shared_ptr<ThreadCounts>> g_tables;
+
+    thread_local std::shared_ptr<ThreadCounts> t_counts;
+
+    ThreadCounts &threadCounts()
+    {
+        if (!t_counts)
+        {
+            t_counts = std::make_shared<ThreadCounts>();
+            std::lock_guard<std::mutex> lock(g_mutex);
+            g_tables.push_back(t_counts);
+        }
+        return *t_counts;
+    }
+
+}
+
+namespace ps2_profile
+{
+    bool start(const std::string &path)
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        if (active())
+        {
+            std::cerr << "[profile] already writing " << g_path << std::endl;
+            return false;
+        }
+
+        // Fail now rather than after the run.
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out)
+        {
+            std::cerr << "[profile] failed to create " << path << std::endl;
+            return false;
+        }
+
+        for (const auto &table : g_tables)
+        {
+            std::lock_guard<std::mutex> tableLock(table->mutex);
+            table->entries.clear();
+            table->branches.clear();
+        }
+
+        g_path = path;
+        g_active.store(true, std::memory_order_relaxed);
+        return true;
+    }
+
+    void stop()
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        if (!g_active.exchange(false, std::memory_order_relaxed))
+            return;
+
+        std::unordered_map<uint32_t, uint64_t> entries;
+        std::unordered_map<uint32_t, BranchCounts> branches;
+        for (const auto &table : g_tables)
+        {
+            std::lock_guard<std::mutex> tableLock(table->mutex);
+            for (const auto &[address, count] : table->entries)
+                entries[address] += count;
+            for (const auto &[address, counts] : table->branches)
+            {
+                BranchCounts &merged = branches[address];
+                merged.taken += counts.taken;
+                merged.notTaken += counts.notTaken;
+            }
+        }
+
+        std::vector<std::pair<uint32_t, uint64_t>> sortedEntries(entries.begin(), entries.end());
+        std::sort(sortedEntries.begin(), sortedEntries.end());
+        std::vector<std::pair<uint32_t, BranchCounts>> sortedBranches(branches.begin(), branches.end());
+        std::sort(sortedBranches.begin(), sortedBranches.end(), [](const auto &a, const auto &b)
+                  { return a.first < b.first; });
+
+        std::vector<uint8_t> data;
+        ps2_varint::put(data, sortedEntries.size());
+        uint32_t previous = 0;
+        for (const auto &[address, count] : sortedEntries)
+        {
+            ps2_varint::put(data, address - previous);
+            ps2_varint::put(data, count);
+            previous = address;
+        }
+        ps2_varint::put(data, sortedBranches.size());
+        previous = 0;
+        for (const auto &[address, counts] : sortedBranches)
+        {
+            ps2_varint::put(data, address - previous);
+            ps2_varint::put(data, counts.taken);
+            ps2_varint::put(data, counts.notTaken);
+            previous = address;
+        }
+
+        std::ofstream out(g_path, std::ios::binary | std::ios::trunc);
+        uint32_t header[2] = {ps2_profile_format::kMagic, ps2_profile_format::kVersion};
+        out.write(reinterpret_cast<const char *>(header), sizeof(header));
+        out.write(reinterpret_cast<const char *>(data.data()), data.size());
+        if (!out)
+        {
+            std::cerr << "[profile] failed to write " << g_path << std::endl;
+            return;
+        }
+
+        std::cout << "[profile] wrote " << sortedEntries.size() << " functions and " << sortedBranches.size()
+                  << " branches to " << g_path << std::endl;
+    }
+
+    void recordEntry(uint32_t address)
+    {
+        ThreadCounts &counts = threadCounts();
+        std::lock_guard<std::mutex> lock(counts.mutex);
+        ++counts.entries[address];
+    }
+
+    void recordBranch(uint32_t address, bool taken)
+    {
+        ThreadCounts &counts = threadCounts();
+        std::lock_guard<std::mutex> lock(counts.mutex);
+        BranchCounts &branch = counts.branches[address];
+        if (taken)
+            ++branch.taken;
+        else
+            ++branch.notTaken;
+    }
+}
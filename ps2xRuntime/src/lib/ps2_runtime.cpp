@@ -1,9 +1,15 @@
 #include "ps2_runtime.h"
 #include "ps2_syscalls.h"
+#include "ps2_memcard.h"
+#include "ps2_savestate.h"
+#include "ps2_journal.h"
+#include "ps2_profile.h"
+#include "ps2_mapped_file.h"
 #include "ps2_runtime_macros.h"
 #include <iostream>
-#include <fstream>
 #include <algorithm>
+#include <array>
+#include <chrono>
 #include <cstring>
 #include <atomic>
 #include <thread>
@@ -54,6 +60,24 @@ struct ProgramHeader
 
 #define PT_LOAD 1 // Loadable segment
 
+namespace
+{
+    // Direct-mapped cache of recent dispatch targets, per host thread so lookups
+    // need no locking. Entries from an older function table generation are ignored.
+    constexpr size_t kDispatchCacheSize = 256;
+    // Larger code ranges fall back to the hash map (32 MiB of pointers on 64-bit hosts).
+    constexpr size_t kMaxDispatchTableEntries = 4u << 20;
+
+    struct DispatchCacheEntry
+    {
+        uint32_t address;
+        uint32_t generation;
+        PS2Runtime::RecompiledFunction func;
+    };
+
+    thread_local std::array<DispatchCacheEntry, kDispatchCacheSize> t_dispatchCache{};
+}
+
 static constexpr int FB_WIDTH = 640;
 static constexpr int FB_HEIGHT = 448;
 static constexpr uint32_t DEFAULT_FB_ADDR = 0x00100000; // location in RDRAM the guest will draw to
@@ -161,6 +185,84 @@ static void UploadFrame(Texture2D &tex, PS2Runtime *rt)
     UpdateTexture(tex, scratch.data());
 }
 
+// Keyboard mapped onto a digital pad. Bits follow the scePadRead button word and are active low.
+static uint16_t SamplePadButtons()
+{
+    struct KeyBit
+    {
+        int key;
+        uint16_t bit;
+    };
+    static constexpr KeyBit kKeys[] = {
+        {KEY_BACKSPACE, 1u << 0}, // SELECT
+        {KEY_ENTER, 1u << 3},     // START
+        {KEY_UP, 1u << 4},
+        {KEY_RIGHT, 1u << 5},
+        {KEY_DOWN, 1u << 6},
+        {KEY_LEFT, 1u << 7},
+        {KEY_ONE, 1u << 8},  // L2
+        {KEY_TWO, 1u << 9},  // R2
+        {KEY_Q, 1u << 10},   // L1
+        {KEY_W, 1u << 11},   // R1
+        {KEY_S, 1u << 12},   // TRIANGLE
+        {KEY_X, 1u << 13},   // CIRCLE
+        {KEY_Z, 1u << 14},   // CROSS
+        {KEY_A, 1u << 15},   // SQUARE
+    };
+
+    uint16_t buttons = 0xFFFF;
+    for (const KeyBit &k : kKeys)
+    {
+        if (IsKeyDown(k.key))
+        {
+            buttons &= static_cast<uint16_t>(~k.bit);
+        }
+    }
+    return buttons;
+}
+
+// The build may target AVX2/AVX-512 (PS2X_SIMD); fail cleanly instead of
+// dying on the first illegal instruction in recompiled code.
+static bool HostSupportsBuildSimd(const char *&level)
+{
+#if defined(USE_SSE2NEON)
+    level = "NEON";
+    return true;
+#elif defined(_MSC_VER)
+    int regs[4] = {};
+    __cpuid(regs, 1);
+    const bool sse41 = (regs[2] & (1 << 19)) != 0;
+    const bool osxsave = (regs[2] & (1 << 27)) != 0;
+    const unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+    __cpuidex(regs, 7, 0);
+    const bool avx2 = (regs[1] & (1 << 5)) != 0 && (xcr0 & 0x6) == 0x6;
+    const bool avx512 = (regs[1] & (1 << 16)) != 0 && (regs[1] & (1 << 31)) != 0 && (xcr0 & 0xE6) == 0xE6;
+#if defined(PS2_SIMD_AVX512VL)
+    level = "AVX-512VL";
+    return avx512;
+#elif defined(PS2_SIMD_AVX2)
+    level = "AVX2";
+    return avx2;
+#else
+    (void)avx2;
+    (void)avx512;
+    level = "SSE4.1";
+    return sse41;
+#endif
+#else
+#if defined(PS2_SIMD_AVX512VL)
+    level = "AVX-512VL";
+    return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl");
+#elif defined(PS2_SIMD_AVX2)
+    level = "AVX2";
+    return __builtin_cpu_supports("avx2");
+#else
+    level = "SSE4.1";
+    return __builtin_cpu_supports("sse4.1");
+#endif
+#endif
+}
+
 PS2Runtime::PS2Runtime()
 {
     std::memset(&m_cpuContext, 0, sizeof(m_cpuContext));
@@ -184,6 +286,13 @@ PS2Runtime::~PS2Runtime()
 
 bool PS2Runtime::initialize(const char *title)
 {
+    const char *simdLevel = nullptr;
+    if (!HostSupportsBuildSimd(simdLevel))
+    {
+        std::cerr << "This build requires " << simdLevel << ", which this CPU does not support" << std::endl;
+        return false;
+    }
+
     if (!m_memory.initialize())
     {
         std::cerr << "Failed to initialize PS2 memory" << std::endl;
@@ -199,15 +308,24 @@ bool PS2Runtime::initialize(const char *title)
 
 bool PS2Runtime::loadELF(const std::string &elfPath)
 {
-    std::ifstream file(elfPath, std::ios::binary);
+    // Segments are copied straight from the mapping into guest memory.
+    std::shared_ptr<MappedFile> file = MappedFile::open(elfPath);
     if (!file)
     {
         std::cerr << "Failed to open ELF file: " << elfPath << std::endl;
         return false;
     }
 
+    const uint8_t *image = file->data();
+    const uint64_t imageSize = file->size();
+
     ElfHeader header;
-    file.read(reinterpret_cast<char *>(&header), sizeof(header));
+    if (imageSize < sizeof(header))
+    {
+        std::cerr << "ELF file too small: " << elfPath << std::endl;
+        return false;
+    }
+    std::memcpy(&header, image, sizeof(header));
 
     if (header.magic != ELF_MAGIC)
     {
@@ -226,8 +344,13 @@ bool PS2Runtime::loadELF(const std::string &elfPath)
     for (uint16_t i = 0; i < header.phnum; i++)
     {
         ProgramHeader ph;
-        file.seekg(header.phoff + i * header.phentsize);
-        file.read(reinterpret_cast<char *>(&ph), sizeof(ph));
+        uint64_t phOffset = header.phoff + static_cast<uint64_t>(i) * header.phentsize;
+        if (phOffset + sizeof(ph) > imageSize)
+        {
+            std::cerr << "Program header " << i << " lies outside the ELF file" << std::endl;
+            return false;
+        }
+        std::memcpy(&ph, image + phOffset, sizeof(ph));
 
         if (ph.type == PT_LOAD && ph.filesz > 0)
         {
@@ -235,14 +358,13 @@ bool PS2Runtime::loadELF(const std::string &elfPath)
                       << " - 0x" << (ph.vaddr + ph.memsz)
                       << " (size: 0x" << ph.memsz << ")" << std::dec << std::endl;
 
-            // Allocate temporary buffer for the segment
-            std::vector<uint8_t> buffer(ph.filesz);
-
-            // Read segment data
-            file.seekg(ph.offset);
-            file.read(reinterpret_cast<char *>(buffer.data()), ph.filesz);
+            if (static_cast<uint64_t>(ph.offset) + ph.filesz > imageSize)
+            {
+                std::cerr << "Segment data at 0x" << std::hex << ph.offset << std::dec
+                          << " lies outside the ELF file" << std::endl;
+                return false;
+            }
 
-            // Copy to memory
             uint32_t physAddr = m_memory.translateAddress(ph.vaddr);
             uint8_t *dest = nullptr;
             if (ph.vaddr >= PS2_SCRATCHPAD_BASE && ph.vaddr < PS2_SCRATCHPAD_BASE + PS2_SCRATCHPAD_SIZE)
@@ -253,7 +375,7 @@ bool PS2Runtime::loadELF(const std::string &elfPath)
             {
                 dest = m_memory.getRDRAM() + physAddr;
             }
-            std::memcpy(dest, buffer.data(), ph.filesz);
+            std::memcpy(dest, image + ph.offset, ph.filesz);
 
             if (ph.memsz > ph.filesz)
             {
@@ -280,9 +402,163 @@ bool PS2Runtime::loadELF(const std::string &elfPath)
     return true;
 }
 
+void PS2Runtime::saveState(const std::string &statePath)
+{
+    std::lock_guard<std::mutex> lock(m_stateMutex);
+    m_requestedStatePath = statePath;
+    m_stateRequested.store(true, std::memory_order_release);
+}
+
+void PS2Runtime::writeRequestedState()
+{
+    std::string statePath;
+    {
+        std::lock_guard<std::mutex> lock(m_stateMutex);
+        statePath = std::move(m_requestedStatePath);
+        m_requestedStatePath.clear();
+        m_stateRequested.store(false, std::memory_order_relaxed);
+    }
+
+    std::vector<std::pair<uint32_t, uint32_t>> ioRegs(m_memory.m_ioRegisters.begin(), m_memory.m_ioRegisters.end());
+    std::sort(ioRegs.begin(), ioRegs.end());
+
+    std::vector<ps2_savestate::Region> regions = {
+        {ps2_savestate::REGION_CPU_CONTEXT, &m_cpuContext, sizeof(m_cpuContext)},
+        {ps2_savestate::REGION_RDRAM, m_memory.getRDRAM(), PS2_RAM_SIZE},
+        {ps2_savestate::REGION_SCRATCHPAD, m_memory.getScratchpad(), PS2_SCRATCHPAD_SIZE},
+        {ps2_savestate::REGION_IOP_RAM, m_memory.getIOPRAM(), 2 * 1024 * 1024},
+        {ps2_savestate::REGION_GS_VRAM, m_memory.getGSVRAM(), PS2_GS_VRAM_SIZE},
+        {ps2_savestate::REGION_GS_REGS, &m_memory.gs_regs, sizeof(m_memory.gs_regs)},
+        {ps2_savestate::REGION_VIF0_REGS, &m_memory.vif0_regs, sizeof(m_memory.vif0_regs)},
+        {ps2_savestate::REGION_VIF1_REGS, &m_memory.vif1_regs, sizeof(m_memory.vif1_regs)},
+        {ps2_savestate::REGION_DMA_REGS, m_memory.dma_regs, sizeof(m_memory.dma_regs)},
+        {ps2_savestate::REGION_IO_REGS, ioRegs.data(), ioRegs.size() * sizeof(ioRegs[0])},
+    };
+
+    if (!ps2_savestate::writeAsync(statePath, regions))
+    {
+        std::cerr << "Failed to write save state " << statePath << std::endl;
+        return;
+    }
+    std::cout << "Save state taken at PC=0x" << std::hex << m_cpuContext.pc << std::dec << ", writing " << statePath << std::endl;
+}
+
+bool PS2Runtime::loadState(const std::string &statePath)
+{
+    std::vector<ps2_savestate::LoadedRegion> regions;
+    if (!ps2_savestate::read(statePath, regions))
+    {
+        return false;
+    }
+
+    struct Target
+    {
+        void *data;
+        size_t size;
+        bool found;
+    };
+    std::unordered_map<uint32_t, Target> targets = {
+        {ps2_savestate::REGION_CPU_CONTEXT, {&m_cpuContext, sizeof(m_cpuContext), false}},
+        {ps2_savestate::REGION_RDRAM, {m_memory.getRDRAM(), PS2_RAM_SIZE, false}},
+        {ps2_savestate::REGION_SCRATCHPAD, {m_memory.getScratchpad(), PS2_SCRATCHPAD_SIZE, false}},
+        {ps2_savestate::REGION_IOP_RAM, {m_memory.getIOPRAM(), 2 * 1024 * 1024, false}},
+        {ps2_savestate::REGION_GS_VRAM, {m_memory.getGSVRAM(), PS2_GS_VRAM_SIZE, false}},
+        {ps2_savestate::REGION_GS_REGS, {&m_memory.gs_regs, sizeof(m_memory.gs_regs), false}},
+        {ps2_savestate::REGION_VIF0_REGS, {&m_memory.vif0_regs, sizeof(m_memory.vif0_regs), false}},
+        {ps2_savestate::REGION_VIF1_REGS, {&m_memory.vif1_regs, sizeof(m_memory.vif1_regs), false}},
+        {ps2_savestate::REGION_DMA_REGS, {m_memory.dma_regs, sizeof(m_memory.dma_regs), false}},
+    };
+
+    // Validate everything before touching the live state.
+    const ps2_savestate::LoadedRegion *ioRegs = nullptr;
+    for (const auto &region : regions)
+    {
+        if (region.id == ps2_savestate::REGION_IO_REGS)
+        {
+            if (region.data.size() % (2 * sizeof(uint32_t)) != 0)
+            {
+                std::cerr << "Save state " << statePath << " has a malformed IO register block" << std::endl;
+                return false;
+            }
+            ioRegs = &region;
+            continue;
+        }
+
+        auto it = targets.find(region.id);
+        if (it == targets.end())
+        {
+            continue; // written by a newer runtime, nothing to restore it into
+        }
+        if (region.data.size() != it->second.size)
+        {
+            std::cerr << "Save state " << statePath << " region " << region.id << " has size " << region.data.size()
+                      << ", expected " << it->second.size << std::endl;
+            return false;
+        }
+        it->second.found = true;
+    }
+
+    for (const auto &[id, target] : targets)
+    {
+        if (!target.found)
+        {
+            std::cerr << "Save state " << statePath << " is missing region " << id << std::endl;
+            return false;
+        }
+    }
+
+    // Only a function entry taken from the dispatch loop can be resumed by dispatch().
+    for (const auto &region : regions)
+    {
+        if (region.id != ps2_savestate::REGION_CPU_CONTEXT)
+        {
+            continue;
+        }
+        R5900Context saved;
+        std::memcpy(&saved, region.data.data(), sizeof(saved));
+        if (!hasFunction(saved.pc))
+        {
+            std::cerr << "Save state " << statePath << " stopped at PC=0x" << std::hex << saved.pc << std::dec
+                      << ", which is not a recompiled function entry; it cannot be resumed" << std::endl;
+            return false;
+        }
+    }
+
+    for (const auto &region : regions)
+    {
+        auto it = targets.find(region.id);
+        if (it != targets.end())
+        {
+            std::memcpy(it->second.data, region.data.data(), region.data.size());
+        }
+    }
+
+    m_memory.m_ioRegisters.clear();
+    if (ioRegs)
+    {
+        for (size_t i = 0; i + 8 <= ioRegs->data.size(); i += 8)
+        {
+            uint32_t pair[2];
+            std::memcpy(pair, ioRegs->data.data() + i, sizeof(pair));
+            m_memory.m_ioRegisters[pair[0]] = pair[1];
+        }
+    }
+
+    m_stateLoaded = true;
+    std::cout << "Save state loaded from " << statePath << ". PC=0x" << std::hex << m_cpuContext.pc << std::dec << std::endl;
+    return true;
+}
+
 void PS2Runtime::registerFunction(uint32_t address, RecompiledFunction func)
 {
     m_functionTable[address] = func;
+
+    uint32_t index = (address - m_dispatchBase) >> 2;
+    if ((address & 3) == 0 && index < m_dispatchTable.size())
+    {
+        m_dispatchTable[index] = func;
+    }
+    m_functionGeneration.fetch_add(1, std::memory_order_release);
 }
 
 bool PS2Runtime::hasFunction(uint32_t address) const
@@ -308,6 +584,104 @@ PS2Runtime::RecompiledFunction PS2Runtime::lookupFunction(uint32_t address)
     return defaultFunction;
 }
 
+void PS2Runtime::buildDispatchTable()
+{
+    m_dispatchTable.clear();
+    m_dispatchBase = 0;
+    if (m_functionTable.empty())
+    {
+        return;
+    }
+
+    uint32_t lo = UINT32_MAX;
+    uint32_t hi = 0;
+    for (const auto &[address, func] : m_functionTable)
+    {
+        lo = std::min(lo, address);
+        hi = std::max(hi, address);
+    }
+
+    size_t entries = static_cast<size_t>((hi - lo) >> 2) + 1;
+    if (entries > kMaxDispatchTableEntries)
+    {
+        std::cout << "[dispatch] code range 0x" << std::hex << lo << "-0x" << hi << std::dec
+                  << " too sparse for a flat table, using the hash map" << std::endl;
+        return;
+    }
+
+    m_dispatchBase = lo;
+    m_dispatchTable.assign(entries, nullptr);
+    for (const auto &[address, func] : m_functionTable)
+    {
+        if ((address & 3) == 0)
+        {
+            m_dispatchTable[(address - lo) >> 2] = func;
+        }
+    }
+    m_functionGeneration.fetch_add(1, std::memory_order_release);
+}
+
+PS2Runtime::RecompiledFunction PS2Runtime::findFunction(uint32_t address)
+{
+    DispatchCacheEntry &entry = t_dispatchCache[(address >> 2) & (kDispatchCacheSize - 1)];
+    uint32_t generation = m_functionGeneration.load(std::memory_order_acquire);
+    if (entry.func && entry.address == address && entry.generation == generation)
+    {
+        return entry.func;
+    }
+
+    RecompiledFunction func = nullptr;
+    uint32_t index = (address - m_dispatchBase) >> 2;
+    if ((address & 3) == 0 && index < m_dispatchTable.size())
+    {
+        func = m_dispatchTable[index];
+    }
+    else
+    {
+        auto it = m_functionTable.find(address);
+        if (it != m_functionTable.end())
+        {
+            func = it->second;
+        }
+    }
+
+    if (func)
+    {
+        entry = {address, generation, func};
+    }
+    return func;
+}
+
+void PS2Runtime::dispatch(uint8_t *rdram, R5900Context *ctx, uint32_t exitPc)
+{
+    while (ctx->pc != exitPc)
+    {
+        // No recompiled frames are live here, so the main context can be resumed from ctx->pc.
+        if (ctx == &m_cpuContext && m_stateRequested.load(std::memory_order_acquire))
+        {
+            writeRequestedState();
+        }
+
+        uint32_t pc = ctx->pc;
+        RecompiledFunction func = findFunction(pc);
+        if (!func)
+        {
+            std::cerr << "[dispatch] no recompiled function at 0x" << std::hex << pc << std::dec
+                      << ", stopping thread" << std::endl;
+            return;
+        }
+
+        ps2RunCall(func, rdram, ctx, this);
+
+        if (ctx->pc == kFellOffEndAddress)
+        {
+            std::cerr << "[dispatch] function at 0x" << std::hex << pc << std::dec
+                      << " ran off its end, stopping thread" << std::endl;
+            return;
+        }
+    }
+}
+
 void PS2Runtime::SignalException(R5900Context *ctx, PS2Exception exception)
 {
     if (exception == EXCEPTION_INTEGER_OVERFLOW)
@@ -401,13 +775,77 @@ void PS2Runtime::HandleIntegerOverflow(R5900Context *ctx)
     m_cpuContext.pc = 0x80000000; // Default PS2 exception handler address
 }
 
+bool PS2Runtime::idleLoop(uint32_t address, bool taken)
+{
+    constexpr uint32_t kSpinIterations = 64;
+    constexpr uint32_t kYieldIterations = 1024;
+
+    // Back edges the current wait took in a row within this frame.
+    thread_local uint32_t t_loop = 0;
+    thread_local uint64_t t_vblank = 0;
+    thread_local uint32_t t_iterations = 0;
+
+    if (!taken)
+    {
+        t_loop = 0;
+        t_iterations = 0;
+        return false;
+    }
+
+    uint64_t vblank = m_vblankCount.load(std::memory_order_relaxed);
+    if (address != t_loop || vblank != t_vblank)
+    {
+        t_loop = address;
+        t_vblank = vblank;
+        t_iterations = 0;
+    }
+
+    if (++t_iterations <= kSpinIterations)
+    {
+        _mm_pause();
+    }
+    else if (t_iterations <= kYieldIterations)
+    {
+        std::this_thread::yield();
+    }
+    else
+    {
+        std::unique_lock<std::mutex> lock(m_vblankMutex);
+        m_vblankSignal.wait_for(lock, std::chrono::milliseconds(1), [&]()
+                                { return m_vblankCount.load(std::memory_order_relaxed) != vblank; });
+    }
+    return true;
+}
+
+uint64_t PS2Runtime::waitForVblank()
+{
+    std::unique_lock<std::mutex> lock(m_vblankMutex);
+    uint64_t vblank = m_vblankCount.load(std::memory_order_relaxed);
+    m_vblankSignal.wait(lock, [&]()
+                        { return m_vblankCount.load(std::memory_order_relaxed) != vblank; });
+    return m_vblankCount.load(std::memory_order_relaxed);
+}
+
 void PS2Runtime::run()
 {
-    RecompiledFunction entryPoint = lookupFunction(m_cpuContext.pc);
+    if (!hasFunction(m_cpuContext.pc))
+    {
+        std::cerr << "Warning: no recompiled function at entry point 0x" << std::hex << m_cpuContext.pc << std::dec << std::endl;
+    }
+    buildDispatchTable();
 
-    m_cpuContext.r[4] = _mm_set1_epi32(0);           // A0 = 0 (argc)
-    m_cpuContext.r[5] = _mm_set1_epi32(0);           // A1 = 0 (argv)
-    m_cpuContext.r[29] = _mm_set1_epi32(0x02000000); // SP = top of RAM
+    if (!m_stateLoaded)
+    {
+        m_cpuContext.r[4] = _mm_set1_epi32(0);           // A0 = 0 (argc)
+        m_cpuContext.r[5] = _mm_set1_epi32(0);           // A1 = 0 (argv)
+        m_cpuContext.r[29] = _mm_set1_epi32(0x02000000); // SP = top of RAM
+        m_cpuContext.r[31] = _mm_set_epi32(0, 0, 0, static_cast<int32_t>(kGuestExitAddress)); // RA = exit
+    }
+
+    if (!profilePath.empty())
+    {
+        ps2_profile::start(profilePath);
+    }
 
     std::cout << "Starting execution at address 0x" << std::hex << m_cpuContext.pc << std::dec << std::endl;
 
@@ -418,12 +856,12 @@ void PS2Runtime::run()
 
     g_activeThreads.store(1, std::memory_order_relaxed);
 
-    std::thread gameThread([&, entryPoint]()
+    std::thread gameThread([&]()
                            {
         ThreadNaming::SetCurrentThreadName("GameThread");
         try
         {
-            entryPoint(m_memory.getRDRAM(), &m_cpuContext, this);
+            dispatch(m_memory.getRDRAM(), &m_cpuContext, kGuestExitAddress);
             std::cout << "Game thread returned. PC=0x" << std::hex << m_cpuContext.pc
                       << " RA=0x" << static_cast<uint32_t>(_mm_extract_epi32(m_cpuContext.r[31], 0)) << std::dec << std::endl;
         }
@@ -463,12 +901,18 @@ void PS2Runtime::run()
                 lastVif = curVif;
             }
         }
+        m_padButtons.store(SamplePadButtons(), std::memory_order_relaxed);
         UploadFrame(frameTex, this);
 
         BeginDrawing();
         ClearBackground(BLACK);
         DrawTexture(frameTex, 0, 0, WHITE);
         EndDrawing();
+        {
+            std::lock_guard<std::mutex> lock(m_vblankMutex);
+            m_vblankCount.fetch_add(1, std::memory_order_relaxed);
+        }
+        m_vblankSignal.notify_all();
 
         if (WindowShouldClose())
         {
@@ -496,5 +940,11 @@ void PS2Runtime::run()
     UnloadTexture(frameTex);
     CloseWindow();
 
+    // Don't lose saves still sitting in the memory card write-back queue.
+    ps2_memcard::flushAll(true);
+    ps2_savestate::waitPending();
+    ps2_journal::stop();
+    ps2_profile::stop();
+
     std::cout << "[run] exiting loop, activeThreads=" << g_activeThreads.load(std::memory_order_relaxed) << std::endl;
 }
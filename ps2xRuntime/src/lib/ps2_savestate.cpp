@@ -0,0 +1,533 @@
+#include "ps2_savestate.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <atomic>
+#include <filesystem>
+#include <io.h>
+#include <thread>
+#else
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    constexpr uint32_t kStoredFlag = 0x80000000u;
+    constexpr size_t kMinMatch = 4;
+    constexpr size_t kLastLiterals = 5; // a match never reaches the last bytes of a block
+    constexpr uint32_t kHashBits = 12;
+    constexpr size_t kMaxOffset = 0xFFFF;
+
+    struct FileHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t regionCount;
+        uint32_t reserved;
+    };
+
+    struct RegionHeader
+    {
+        uint32_t id;
+        uint32_t flags;
+        uint64_t rawSize;
+        uint32_t blockCount;
+        uint32_t reserved;
+    };
+
+    inline uint32_t load32(const uint8_t *p)
+    {
+        uint32_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    inline uint32_t hash32(uint32_t v)
+    {
+        return (v * 2654435761u) >> (32 - kHashBits);
+    }
+
+    // Bounds-checked output cursor for the compressor.
+    struct OutBuffer
+    {
+        uint8_t *data;
+        size_t capacity;
+        size_t pos = 0;
+        bool overflow = false;
+
+        void byte(uint8_t v)
+        {
+            if (pos >= capacity)
+            {
+                overflow = true;
+                return;
+            }
+            data[pos++] = v;
+        }
+
+        void bytes(const uint8_t *src, size_t size)
+        {
+            if (size == 0)
+                return;
+            if (size > capacity - pos)
+            {
+                overflow = true;
+                return;
+            }
+            std::memcpy(data + pos, src, size);
+            pos += size;
+        }
+
+        void length(size_t extra)
+        {
+            while (extra >= 255)
+            {
+                byte(255);
+                extra -= 255;
+            }
+            byte(static_cast<uint8_t>(extra));
+        }
+    };
+
+    void emitSequence(OutBuffer &out, const uint8_t *literals, size_t literalCount, size_t offset, size_t matchLength)
+    {
+        size_t matchCode = matchLength ? matchLength - kMinMatch : 0;
+        uint8_t token = static_cast<uint8_t>((std::min<size_t>(literalCount, 15) << 4) | std::min<size_t>(matchCode, 15));
+        out.byte(token);
+        if (literalCount >= 15)
+            out.length(literalCount - 15);
+        out.bytes(literals, literalCount);
+
+        if (!matchLength)
+            return;
+        out.byte(static_cast<uint8_t>(offset));
+        out.byte(static_cast<uint8_t>(offset >> 8));
+        if (matchCode >= 15)
+            out.length(matchCode - 15);
+    }
+
+    bool readLength(const uint8_t *src, size_t size, size_t &pos, size_t &value)
+    {
+        uint8_t b;
+        do
+        {
+            if (pos >= size)
+                return false;
+            b = src[pos++];
+            value += b;
+        } while (b == 255);
+        return true;
+    }
+
+    // Raw descriptor output; the forked writer must not touch stdio or the heap.
+    class FileSink
+    {
+    public:
+        explicit FileSink(const char *path)
+        {
+#ifdef _WIN32
+            m_fd = ::_open(path, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+            m_fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+        }
+
+        ~FileSink() { close(); }
+
+        bool isOpen() const { return m_fd >= 0; }
+
+        bool write(const void *data, size_t size)
+        {
+            const uint8_t *p = static_cast<const uint8_t *>(data);
+            while (size > 0)
+            {
+#ifdef _WIN32
+                int n = ::_write(m_fd, p, static_cast<unsigned int>(std::min<size_t>(size, 1u << 30)));
+#else
+                ssize_t n = ::write(m_fd, p, size);
+                if (n < 0 && errno == EINTR)
+                    continue;
+#endif
+                if (n <= 0)
+                    return false;
+                p += n;
+                size -= static_cast<size_t>(n);
+            }
+            return true;
+        }
+
+        bool close()
+        {
+            if (m_fd < 0)
+                return true;
+#ifdef _WIN32
+            bool ok = ::_close(m_fd) == 0;
+#else
+            bool ok = ::close(m_fd) == 0;
+#endif
+            m_fd = -1;
+            return ok;
+        }
+
+    private:
+        int m_fd = -1;
+    };
+
+    bool replaceFile(const char *from, const char *to)
+    {
+#ifdef _WIN32
+        std::error_code ec;
+        std::filesystem::rename(from, to, ec);
+        return !ec;
+#else
+        return ::rename(from, to) == 0;
+#endif
+    }
+
+    // scratch must hold compressBound(kBlockSize) bytes. Runs in the forked child, so
+    // everything it needs has to be allocated by the caller.
+    bool writeFile(const char *tmpPath, const char *path, const ps2_savestate::Region *regions, size_t count,
+                   uint8_t *scratch)
+    {
+        using namespace ps2_savestate;
+
+        FileSink sink(tmpPath);
+        if (!sink.isOpen())
+            return false;
+
+        FileHeader header{kMagic, kVersion, static_cast<uint32_t>(count), 0};
+        bool ok = sink.write(&header, sizeof(header));
+
+        for (size_t i = 0; ok && i < count; ++i)
+        {
+            const Region &region = regions[i];
+            RegionHeader rh{};
+            rh.id = region.id;
+            rh.rawSize = region.size;
+            rh.blockCount = static_cast<uint32_t>((region.size + kBlockSize - 1) / kBlockSize);
+            ok = sink.write(&rh, sizeof(rh));
+
+            const uint8_t *src = static_cast<const uint8_t *>(region.data);
+            for (uint64_t offset = 0; ok && offset < region.size; offset += kBlockSize)
+            {
+                size_t len = static_cast<size_t>(std::min<uint64_t>(kBlockSize, region.size - offset));
+                size_t packed = compress(src + offset, len, scratch, compressBound(kBlockSize));
+                if (packed == 0 || packed >= len)
+                {
+                    uint32_t tag = static_cast<uint32_t>(len) | kStoredFlag;
+                    ok = sink.write(&tag, sizeof(tag)) && sink.write(src + offset, len);
+                }
+                else
+                {
+                    uint32_t tag = static_cast<uint32_t>(packed);
+                    ok = sink.write(&tag, sizeof(tag)) && sink.write(scratch, packed);
+                }
+            }
+        }
+
+        ok = sink.close() && ok;
+        if (!ok)
+        {
+            std::remove(tmpPath);
+            return false;
+        }
+        return replaceFile(tmpPath, path);
+    }
+
+    struct PendingSave
+    {
+        std::string path;
+#ifdef _WIN32
+        std::thread worker;
+        std::shared_ptr<std::atomic<bool>> ok;
+#else
+        pid_t pid = -1;
+#endif
+    };
+
+    std::mutex g_pendingMutex;
+    std::vector<PendingSave> g_pending;
+
+#ifndef _WIN32
+    // Returns false while the child is still running (only possible when !block).
+    bool reapChild(const PendingSave &save, bool block, bool &ok)
+    {
+        int status = 0;
+        pid_t r;
+        do
+        {
+            r = ::waitpid(save.pid, &status, block ? 0 : WNOHANG);
+        } while (r < 0 && errno == EINTR);
+
+        if (r == 0)
+            return false;
+
+        ok = r > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        if (!ok)
+        {
+            std::cerr << "[savestate] failed to write " << save.path << std::endl;
+        }
+        return true;
+    }
+#endif
+}
+
+namespace ps2_savestate
+{
+    size_t compress(const uint8_t *src, size_t size, uint8_t *dst, size_t capacity)
+    {
+        OutBuffer out{dst, capacity};
+        uint32_t table[1u << kHashBits] = {}; // position + 1, 0 = empty
+
+        size_t anchor = 0;
+        size_t ip = 0;
+        size_t matchLimit = size > kLastLiterals + kMinMatch ? size - kLastLiterals : 0;
+
+        while (ip + kMinMatch <= matchLimit)
+        {
+            uint32_t seq = load32(src + ip);
+            uint32_t h = hash32(seq);
+            uint32_t candidate = table[h];
+            table[h] = static_cast<uint32_t>(ip + 1);
+
+            if (candidate && ip - (candidate - 1) <= kMaxOffset && load32(src + candidate - 1) == seq)
+            {
+                size_t match = candidate - 1;
+                size_t len = kMinMatch;
+                while (ip + len < matchLimit && src[match + len] == src[ip + len])
+                    ++len;
+
+                emitSequence(out, src + anchor, ip - anchor, ip - match, len);
+                if (out.overflow)
+                    return 0;
+
+                ip += len;
+                anchor = ip;
+                continue;
+            }
+
+            // Step faster through data that refuses to match.
+            ip += 1 + ((ip - anchor) >> 6);
+        }
+
+        emitSequence(out, src + anchor, size - anchor, 0, 0);
+        return out.overflow ? 0 : out.pos;
+    }
+
+    bool decompress(const uint8_t *src, size_t size, uint8_t *dst, size_t rawSize)
+    {
+        size_t sp = 0;
+        size_t dp = 0;
+        while (sp < size)
+        {
+            uint8_t token = src[sp++];
+
+            size_t literals = token >> 4;
+            if (literals == 15 && !readLength(src, size, sp, literals))
+                return false;
+            if (literals > size - sp || literals > rawSize - dp)
+                return false;
+            if (literals)
+                std::memcpy(dst + dp, src + sp, literals);
+            sp += literals;
+            dp += literals;
+
+            if (sp == size)
+                break; // final sequence carries literals only
+
+            if (size - sp < 2)
+                return false;
+            size_t offset = src[sp] | (static_cast<size_t>(src[sp + 1]) << 8);
+            sp += 2;
+
+            size_t len = token & 0x0F;
+            if (len == 15 && !readLength(src, size, sp, len))
+                return false;
+            len += kMinMatch;
+
+            if (offset == 0 || offset > dp || len > rawSize - dp)
+                return false;
+
+            // Byte copy on purpose: overlapping matches replicate runs.
+            const uint8_t *from = dst + dp - offset;
+            for (size_t i = 0; i < len; ++i)
+                dst[dp + i] = from[i];
+            dp += len;
+        }
+        return dp == rawSize;
+    }
+
+    bool write(const std::string &path, const std::vector<Region> &regions)
+    {
+        std::vector<uint8_t> scratch(compressBound(kBlockSize));
+        std::string tmpPath = path + ".tmp";
+        if (!writeFile(tmpPath.c_str(), path.c_str(), regions.data(), regions.size(), scratch.data()))
+        {
+            std::cerr << "[savestate] failed to write " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool writeAsync(const std::string &path, const std::vector<Region> &regions)
+    {
+        PendingSave save;
+        save.path = path;
+
+#ifdef _WIN32
+        // No fork: copy the regions (a memcpy pass over ~38 MB) and compress on a worker.
+        auto copies = std::make_shared<std::vector<std::vector<uint8_t>>>();
+        auto copied = std::make_shared<std::vector<Region>>();
+        copies->reserve(regions.size());
+        for (const Region &region : regions)
+        {
+            const uint8_t *src = static_cast<const uint8_t *>(region.data);
+            copies->emplace_back(src, src + region.size);
+            copied->push_back({region.id, copies->back().data(), region.size});
+        }
+
+        save.ok = std::make_shared<std::atomic<bool>>(false);
+        save.worker = std::thread([path, copies, copied, ok = save.ok]()
+                                  { ok->store(write(path, *copied)); });
+#else
+        // The scratch buffer and paths are set up before fork(); the child only runs
+        // the compressor and raw syscalls on its private copy of the address space.
+        std::vector<uint8_t> scratch(compressBound(kBlockSize));
+        std::string tmpPath = path + ".tmp";
+
+        pid_t pid = ::fork();
+        if (pid < 0)
+        {
+            std::cerr << "[savestate] fork failed (" << std::strerror(errno) << "), saving synchronously" << std::endl;
+            return write(path, regions);
+        }
+        if (pid == 0)
+        {
+            bool ok = writeFile(tmpPath.c_str(), path.c_str(), regions.data(), regions.size(), scratch.data());
+            ::_exit(ok ? 0 : 1);
+        }
+        save.pid = pid;
+#endif
+
+        std::lock_guard<std::mutex> lock(g_pendingMutex);
+#ifndef _WIN32
+        // Reap children that already finished so they don't linger as zombies.
+        g_pending.erase(std::remove_if(g_pending.begin(), g_pending.end(),
+                                       [](const PendingSave &p)
+                                       {
+                                           bool ok;
+                                           return reapChild(p, false, ok);
+                                       }),
+                        g_pending.end());
+#endif
+        g_pending.push_back(std::move(save));
+        return true;
+    }
+
+    bool waitPending()
+    {
+        std::vector<PendingSave> pending;
+        {
+            std::lock_guard<std::mutex> lock(g_pendingMutex);
+            pending.swap(g_pending);
+        }
+
+        bool allOk = true;
+        for (PendingSave &save : pending)
+        {
+#ifdef _WIN32
+            if (save.worker.joinable())
+                save.worker.join();
+            allOk = save.ok->load() && allOk;
+#else
+            bool ok = false;
+            reapChild(save, true, ok);
+            allOk = ok && allOk;
+#endif
+        }
+        return allOk;
+    }
+
+    bool read(const std::string &path, std::vector<LoadedRegion> &out)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+        {
+            std::cerr << "[savestate] failed to open " << path << std::endl;
+            return false;
+        }
+
+        FileHeader header{};
+        if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) || header.magic != kMagic)
+        {
+            std::cerr << "[savestate] " << path << " is not a save state" << std::endl;
+            return false;
+        }
+        if (header.version != kVersion)
+        {
+            std::cerr << "[savestate] " << path << " has unsupported version " << header.version << std::endl;
+            return false;
+        }
+
+        std::vector<uint8_t> packed(compressBound(kBlockSize));
+        out.clear();
+        out.reserve(header.regionCount);
+
+        for (uint32_t i = 0; i < header.regionCount; ++i)
+        {
+            RegionHeader rh{};
+            if (!file.read(reinterpret_cast<char *>(&rh), sizeof(rh)) ||
+                rh.blockCount != (rh.rawSize + kBlockSize - 1) / kBlockSize)
+            {
+                std::cerr << "[savestate] " << path << " is truncated or corrupt" << std::endl;
+                return false;
+            }
+
+            LoadedRegion region;
+            region.id = rh.id;
+            region.data.resize(static_cast<size_t>(rh.rawSize));
+
+            for (uint32_t block = 0; block < rh.blockCount; ++block)
+            {
+                uint64_t offset = static_cast<uint64_t>(block) * kBlockSize;
+                size_t len = static_cast<size_t>(std::min<uint64_t>(kBlockSize, rh.rawSize - offset));
+
+                uint32_t tag = 0;
+                if (!file.read(reinterpret_cast<char *>(&tag), sizeof(tag)))
+                {
+                    std::cerr << "[savestate] " << path << " is truncated or corrupt" << std::endl;
+                    return false;
+                }
+
+                uint8_t *dst = region.data.data() + offset;
+                bool ok;
+                if (tag & kStoredFlag)
+                {
+                    ok = (tag & ~kStoredFlag) == len && file.read(reinterpret_cast<char *>(dst), len);
+                }
+                else
+                {
+                    ok = tag <= packed.size() && file.read(reinterpret_cast<char *>(packed.data()), tag) &&
+                         decompress(packed.data(), tag, dst, len);
+                }
+                if (!ok)
+                {
+                    std::cerr << "[savestate] " << path << " is truncated or corrupt" << std::endl;
+                    return false;
+                }
+            }
+            out.push_back(std::move(region));
+        }
+        return true;
+    }
+}
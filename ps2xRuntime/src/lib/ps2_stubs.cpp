@@ -1,44 +1,21 @@
 #include "ps2_stubs.h"
 #include "ps2_runtime.h"
+#include "ps2_host_files.h"
+#include "ps2_vfs.h"
+#include "ps2_memcard.h"
+#include "ps2_journal.h"
 #include <iostream>
+#include <algorithm>
 #include <cstring>
 #include <cstdio>
 #include <cstdlib>
 #include <cmath>
+#include <ctime>
 #include <vector>
 #include <unordered_map>
 #include <filesystem>
 #include <mutex>
 
-namespace
-{
-    std::unordered_map<uint32_t, FILE *> g_file_map;
-    uint32_t g_next_file_handle = 1; // Start file handles > 0 (0 is NULL)
-    std::mutex g_file_mutex;
-
-    uint32_t generate_file_handle()
-    {
-        uint32_t handle = 0;
-        do
-        {
-            handle = g_next_file_handle++;
-            if (g_next_file_handle == 0)
-                g_next_file_handle = 1;
-        } while (handle == 0 || g_file_map.count(handle));
-        return handle;
-    }
-
-    FILE *get_file_ptr(uint32_t handle)
-    {
-        if (handle == 0)
-            return nullptr;
-        std::lock_guard<std::mutex> lock(g_file_mutex);
-        auto it = g_file_map.find(handle);
-        return (it != g_file_map.end()) ? it->second : nullptr;
-    }
-
-}
-
 namespace
 {
     // convert a host pointer within rdram back to a PS2 address
@@ -84,6 +61,103 @@ namespace
     }
 }
 
+namespace
+{
+    // libmc command numbers reported through sceMcSync
+    constexpr int32_t kMcFuncGetInfo = 0x01;
+    constexpr int32_t kMcFuncOpen = 0x02;
+    constexpr int32_t kMcFuncClose = 0x03;
+    constexpr int32_t kMcFuncSeek = 0x04;
+    constexpr int32_t kMcFuncRead = 0x05;
+    constexpr int32_t kMcFuncWrite = 0x06;
+    constexpr int32_t kMcFuncFlush = 0x0A;
+    constexpr int32_t kMcFuncMkdir = 0x0B;
+    constexpr int32_t kMcFuncChDir = 0x0C;
+    constexpr int32_t kMcFuncGetDir = 0x0D;
+    constexpr int32_t kMcFuncSetInfo = 0x0E;
+    constexpr int32_t kMcFuncDelete = 0x0F;
+    constexpr int32_t kMcFuncFormat = 0x10;
+    constexpr int32_t kMcFuncUnformat = 0x11;
+    constexpr int32_t kMcFuncGetEntSpace = 0x12;
+    constexpr int32_t kMcFuncRename = 0x13;
+
+    constexpr int32_t kMcExecIdle = -1;
+    constexpr int32_t kMcExecFinish = 1;
+
+    constexpr uint32_t kMcTblGetDirSize = 64;
+
+    std::mutex g_mcCommandMutex;
+    bool g_mcCommandPending = false;
+    int32_t g_mcCommand = 0;
+    int32_t g_mcCommandResult = 0;
+
+    void mcFinishCommand(int32_t cmd, int32_t result)
+    {
+        std::lock_guard<std::mutex> lock(g_mcCommandMutex);
+        g_mcCommandPending = true;
+        g_mcCommand = cmd;
+        g_mcCommandResult = result;
+    }
+
+    bool mcTakeCommand(int32_t &cmd, int32_t &result)
+    {
+        std::lock_guard<std::mutex> lock(g_mcCommandMutex);
+        if (!g_mcCommandPending)
+            return false;
+        g_mcCommandPending = false;
+        cmd = g_mcCommand;
+        result = g_mcCommandResult;
+        return true;
+    }
+
+    void writeMcDateTime(uint8_t *dst, const ps2_memcard::DateTime &dt)
+    {
+        dst[0] = dt.resv;
+        dst[1] = dt.sec;
+        dst[2] = dt.min;
+        dst[3] = dt.hour;
+        dst[4] = dt.day;
+        dst[5] = dt.month;
+        std::memcpy(dst + 6, &dt.year, sizeof(dt.year));
+    }
+
+    ps2_memcard::DateTime readMcDateTime(const uint8_t *src)
+    {
+        ps2_memcard::DateTime dt;
+        dt.resv = src[0];
+        dt.sec = src[1];
+        dt.min = src[2];
+        dt.hour = src[3];
+        dt.day = src[4];
+        dt.month = src[5];
+        std::memcpy(&dt.year, src + 6, sizeof(dt.year));
+        return dt;
+    }
+
+    // sceMcTblGetDir: _Create, _Modify, FileSizeByte, AttrFile, Reserve1, Reserve2, PdaAplNo, EntryName[32]
+    void writeMcTblGetDir(uint8_t *dst, const ps2_memcard::EntryInfo &entry)
+    {
+        std::memset(dst, 0, kMcTblGetDirSize);
+        writeMcDateTime(dst + 0, entry.created);
+        writeMcDateTime(dst + 8, entry.modified);
+        std::memcpy(dst + 16, &entry.size, sizeof(entry.size));
+        std::memcpy(dst + 20, &entry.mode, sizeof(entry.mode));
+        std::memcpy(dst + 32, entry.name.data(), std::min<size_t>(entry.name.size(), 31));
+    }
+
+    ps2_memcard::EntryInfo readMcTblGetDir(const uint8_t *src)
+    {
+        ps2_memcard::EntryInfo entry;
+        entry.created = readMcDateTime(src + 0);
+        entry.modified = readMcDateTime(src + 8);
+        std::memcpy(&entry.size, src + 16, sizeof(entry.size));
+        std::memcpy(&entry.mode, src + 20, sizeof(entry.mode));
+        const char *name = reinterpret_cast<const char *>(src + 32);
+        entry.name.assign(name, strnlen(name, 32));
+        return entry;
+    }
+}
+
 namespace ps2_stubs
 {
 
@@ -710,15 +784,14 @@ namespace ps2_stubs
 
         if (hostPath && hostMode)
         {
-            // TODO: Add translation for PS2 paths like mc0:, host:, cdrom:, etc.
-            // treating as direct host path
+            // Device paths (cdrom0:, host0:, mc0:) go through the VFS, anything else is a direct host path
             std::cout << "ps2_stub fopen: path='" << hostPath << "', mode='" << hostMode << "'" << std::endl;
-            FILE *fp = ::fopen(hostPath, hostMode);
-            if (fp)
+            int hostFlags = ps2_host_files::hostFlagsFromMode(hostMode);
+            int32_t handle = ps2_vfs::hasDevice(hostPath) ? ps2_vfs::open(hostPath, hostFlags)
+                                                          : ps2_host_files::open(hostPath, hostFlags);
+            if (handle > 0)
             {
-                std::lock_guard<std::mutex> lock(g_file_mutex);
-                file_handle = generate_file_handle();
-                g_file_map[file_handle] = fp;
+                file_handle = static_cast<uint32_t>(handle);
                 std::cout << "  -> handle=0x" << std::hex << file_handle << std::dec << std::endl;
             }
             else
@@ -744,13 +817,9 @@ namespace ps2_stubs
 
         if (file_handle != 0)
         {
-            std::lock_guard<std::mutex> lock(g_file_mutex);
-            auto it = g_file_map.find(file_handle);
-            if (it != g_file_map.end())
+            if (ps2_host_files::close(static_cast<int32_t>(file_handle)) == 0)
             {
-                FILE *fp = it->second;
-                ret = ::fclose(fp);
-                g_file_map.erase(it);
+                ret = 0;
             }
             else
             {
@@ -776,17 +845,24 @@ namespace ps2_stubs
         size_t items_read = 0;
 
         uint8_t *hostPtr = getMemPtr(rdram, ptrAddr);
-        FILE *fp = get_file_ptr(file_handle);
+        bool fileValid = ps2_host_files::isValid(static_cast<int32_t>(file_handle));
 
-        if (hostPtr && fp && size > 0 && count > 0)
+        if (hostPtr && fileValid && size > 0 && count > 0)
         {
-            items_read = ::fread(hostPtr, size, count, fp);
+            uint64_t total = static_cast<uint64_t>(size) * count;
+            uint64_t maxSize = PS2_RAM_SIZE - (ptrAddr & PS2_RAM_MASK);
+            if (total > maxSize)
+                total = maxSize;
+
+            int64_t bytesRead = ps2_host_files::read(static_cast<int32_t>(file_handle), hostPtr, static_cast<size_t>(total));
+            if (bytesRead > 0)
+                items_read = static_cast<size_t>(bytesRead) / size;
         }
         else
         {
             std::cerr << "fread error: Invalid arguments."
                       << " Ptr: 0x" << std::hex << ptrAddr << " (host ptr valid: " << (hostPtr != nullptr) << ")"
-                      << ", Handle: 0x" << file_handle << " (file valid: " << (fp != nullptr) << ")" << std::dec
+                      << ", Handle: 0x" << file_handle << " (file valid: " << fileValid << ")" << std::dec
                       << ", Size: " << size << ", Count: " << count << std::endl;
         }
         // returns the number of items successfully read.
@@ -802,17 +878,24 @@ namespace ps2_stubs
         size_t items_written = 0;
 
         const uint8_t *hostPtr = getConstMemPtr(rdram, ptrAddr);
-        FILE *fp = get_file_ptr(file_handle);
+        bool fileValid = ps2_host_files::isValid(static_cast<int32_t>(file_handle));
 
-        if (hostPtr && fp && size > 0 && count > 0)
+        if (hostPtr && fileValid && size > 0 && count > 0)
         {
-            items_written = ::fwrite(hostPtr, size, count, fp);
+            uint64_t total = static_cast<uint64_t>(size) * count;
+            uint64_t maxSize = PS2_RAM_SIZE - (ptrAddr & PS2_RAM_MASK);
+            if (total > maxSize)
+                total = maxSize;
+
+            int64_t bytesWritten = ps2_host_files::write(static_cast<int32_t>(file_handle), hostPtr, static_cast<size_t>(total));
+            if (bytesWritten > 0)
+                items_written = static_cast<size_t>(bytesWritten) / size;
         }
         else
         {
             std::cerr << "fwrite error: Invalid arguments."
                       << " Ptr: 0x" << std::hex << ptrAddr << " (host ptr valid: " << (hostPtr != nullptr) << ")"
-                      << ", Handle: 0x" << file_handle << " (file valid: " << (fp != nullptr) << ")" << std::dec
+                      << ", Handle: 0x" << file_handle << " (file valid: " << fileValid << ")" << std::dec
                       << ", Size: " << size << ", Count: " << count << std::endl;
         }
         // returns the number of items successfully written.
@@ -823,19 +906,21 @@ namespace ps2_stubs
     {
         uint32_t file_handle = getRegU32(ctx, 4); // $a0
         uint32_t format_addr = getRegU32(ctx, 5); // $a1
-        FILE *fp = get_file_ptr(file_handle);
+        bool fileValid = ps2_host_files::isValid(static_cast<int32_t>(file_handle));
         const char *format = reinterpret_cast<const char *>(getConstMemPtr(rdram, format_addr));
         int ret = -1;
 
-        if (fp && format)
+        if (fileValid && format)
         {
             // TODO this implementation ignores all arguments beyond the format string
-            ret = std::fprintf(fp, "%s", format);
+            size_t len = std::strlen(format);
+            int64_t written = ps2_host_files::write(static_cast<int32_t>(file_handle), format, len);
+            ret = written < 0 ? -1 : static_cast<int>(written);
         }
         else
         {
             std::cerr << "fprintf error: Invalid file handle or format address."
-                      << " Handle: 0x" << std::hex << file_handle << " (file valid: " << (fp != nullptr) << ")"
+                      << " Handle: 0x" << std::hex << file_handle << " (file valid: " << fileValid << ")"
                       << ", Format: 0x" << format_addr << " (host ptr valid: " << (format != nullptr) << ")" << std::dec
                       << std::endl;
         }
@@ -846,19 +931,17 @@ namespace ps2_stubs
 
     void fseek(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        uint32_t file_handle = getRegU32(ctx, 4); // $a0
-        long offset = (long)getRegU32(ctx, 5);    // $a1 (Note: might need 64-bit for large files?)
-        int whence = (int)getRegU32(ctx, 6);      // $a2 (SEEK_SET, SEEK_CUR, SEEK_END)
-        int ret = -1;                             // Default error
+        uint32_t file_handle = getRegU32(ctx, 4);       // $a0
+        int32_t offset = (int32_t)getRegU32(ctx, 5);    // $a1 (Note: might need 64-bit for large files?)
+        int whence = (int)getRegU32(ctx, 6);            // $a2 (SEEK_SET, SEEK_CUR, SEEK_END)
+        int ret = -1;                                   // Default error
 
-        FILE *fp = get_file_ptr(file_handle);
-
-        if (fp)
+        if (ps2_host_files::isValid(static_cast<int32_t>(file_handle)))
         {
             // Ensure whence is valid (0, 1, 2)
             if (whence >= 0 && whence <= 2)
             {
-                ret = ::fseek(fp, offset, whence);
+                ret = ps2_host_files::seek(static_cast<int32_t>(file_handle), offset, whence) < 0 ? -1 : 0;
             }
             else
             {
@@ -877,21 +960,15 @@ namespace ps2_stubs
     void ftell(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
         uint32_t file_handle = getRegU32(ctx, 4); // $a0
-        long ret = -1L;
-
-        FILE *fp = get_file_ptr(file_handle);
+        int64_t ret = ps2_host_files::tell(static_cast<int32_t>(file_handle));
 
-        if (fp)
-        {
-            ret = ::ftell(fp);
-        }
-        else
+        if (ret < 0)
         {
             std::cerr << "ftell error: Invalid file handle 0x" << std::hex << file_handle << std::dec << std::endl;
         }
 
         // returns the current position, or -1L on error.
-        if (ret > 0xFFFFFFFFL || ret < 0)
+        if (ret > 0xFFFFFFFFLL || ret < 0)
         {
             setReturnS32(ctx, -1);
         }
@@ -911,17 +988,14 @@ namespace ps2_stubs
         {
             ret = ::fflush(NULL);
         }
+        else if (ps2_host_files::isValid(static_cast<int32_t>(file_handle)))
+        {
+            // Host files are unbuffered raw fds, every write already reached the OS.
+            ret = 0;
+        }
         else
         {
-            FILE *fp = get_file_ptr(file_handle);
-            if (fp)
-            {
-                ret = ::fflush(fp);
-            }
-            else
-            {
-                std::cerr << "fflush error: Invalid file handle 0x" << std::hex << file_handle << std::dec << std::endl;
-            }
+            std::cerr << "fflush error: Invalid file handle 0x" << std::hex << file_handle << std::dec << std::endl;
         }
         // returns 0 on success, EOF on error.
         setReturnS32(ctx, ret);
@@ -1016,14 +1090,16 @@ namespace ps2_stubs
             ++logCount;
         }
 
-        size_t bytes = static_cast<size_t>(sectors) * 2048; // CD/DVD sector size
+        size_t bytes = static_cast<size_t>(sectors) * ps2_vfs::kCdSectorSize; // CD/DVD sector size
         if (bytes > 0)
         {
             uint32_t offset = buf & PS2_RAM_MASK;
             size_t maxBytes = PS2_RAM_SIZE - offset;
             if (bytes > maxBytes)
                 bytes = maxBytes;
-            std::memset(rdram + offset, 0, bytes);
+
+            // Served from the mapped disc image, or the host files sceCdSearchFile gave sectors to.
+            ps2_vfs::readSectors(lbn, rdram + offset, bytes);
         }
 
         setReturnS32(ctx, 1); // Success
@@ -1038,7 +1114,10 @@ namespace ps2_stubs
             ++logCount;
         }
 
-        setReturnS32(ctx, 0); // 0 = completed/not busy
+        // Reads complete synchronously for now, but the poll result is journaled so a
+        // replay sees the same completion points once they don't.
+        int32_t status = static_cast<int32_t>(ps2_journal::value(ps2_journal::EVENT_CD_SYNC, 0));
+        setReturnS32(ctx, status); // 0 = completed/not busy
     }
 
     void sceCdGetError(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
@@ -2008,7 +2087,36 @@ namespace ps2_stubs
 
     void sceCdReadClock(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        TODO_NAMED("sceCdReadClock", rdram, ctx, runtime);
+        uint32_t clockAddr = getRegU32(ctx, 4);
+        if (!clockAddr)
+        {
+            setReturnS32(ctx, 0);
+            return;
+        }
+
+        std::time_t now = static_cast<std::time_t>(
+            ps2_journal::value(ps2_journal::EVENT_HOST_TIME, static_cast<uint64_t>(std::time(nullptr))));
+        std::tm local{};
+        uint8_t *clock = getMemPtr(rdram, clockAddr);
+#ifdef _WIN32
+        localtime_s(&local, &now);
+#else
+        localtime_r(&now, &local);
+#endif
+        auto bcd = [](int v)
+        { return static_cast<uint8_t>(((v / 10) << 4) | (v % 10)); };
+
+        // sceCdCLOCK: stat, second, minute, hour, pad, day, month, year (BCD)
+        clock[0] = 0;
+        clock[1] = bcd(local.tm_sec);
+        clock[2] = bcd(local.tm_min);
+        clock[3] = bcd(local.tm_hour);
+        clock[4] = 0;
+        clock[5] = bcd(local.tm_mday);
+        clock[6] = bcd(local.tm_mon + 1);
+        clock[7] = bcd(local.tm_year % 100);
+
+        setReturnS32(ctx, 1);
     }
 
     void sceCdReadIOPm(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
@@ -2018,7 +2126,38 @@ namespace ps2_stubs
 
     void sceCdSearchFile(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        TODO_NAMED("sceCdSearchFile", rdram, ctx, runtime);
+        uint32_t fileAddr = getRegU32(ctx, 4); // $a0 - sceCdlFILE *
+        uint32_t nameAddr = getRegU32(ctx, 5); // $a1 - "\\DIR\\FILE.BIN;1"
+
+        uint8_t *cdFile = getMemPtr(rdram, fileAddr);
+        const char *name = reinterpret_cast<const char *>(getConstMemPtr(rdram, nameAddr));
+        if (!cdFile || !name)
+        {
+            std::cerr << "sceCdSearchFile error: Invalid file or name address" << std::endl;
+            setReturnS32(ctx, 0);
+            return;
+        }
+
+        ps2_vfs::Entry entry = ps2_vfs::resolve(std::string("cdrom0:") + name);
+        if (!entry.exists || entry.isDirectory || entry.lsn == 0)
+        {
+            std::cerr << "sceCdSearchFile: '" << name << "' not found" << std::endl;
+            setReturnS32(ctx, 0);
+            return;
+        }
+
+        // sceCdlFILE: lsn, size, name[16], date[8]. Directory mounts get a synthetic lsn
+        // that sceCdRead maps back to the host file.
+        uint32_t lsn = entry.lsn;
+        uint32_t size = static_cast<uint32_t>(entry.size);
+        std::memset(cdFile, 0, 32);
+        std::memcpy(cdFile + 0, &lsn, sizeof(lsn));
+        std::memcpy(cdFile + 4, &size, sizeof(size));
+        const char *baseName = std::strrchr(name, '\\');
+        baseName = baseName ? baseName + 1 : name;
+        std::strncpy(reinterpret_cast<char *>(cdFile + 8), baseName, 15);
+
+        setReturnS32(ctx, 1);
     }
 
     void sceCdSeek(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
@@ -2093,7 +2232,7 @@ namespace ps2_stubs
 
     void sceCdSyncS(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        TODO_NAMED("sceCdSyncS", rdram, ctx, runtime);
+        sceCdSync(rdram, ctx, runtime);
     }
 
     void sceCdTrayReq(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
@@ -2343,7 +2482,9 @@ namespace ps2_stubs
 
     void sceGsSyncV(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        TODO_NAMED("sceGsSyncV", rdram, ctx, runtime);
+        // Waits for the next vblank and returns its field (0 even, 1 odd).
+        uint64_t vblank = ps2_journal::value(ps2_journal::EVENT_VBLANK, runtime->waitForVblank());
+        setReturnS32(ctx, static_cast<int32_t>(vblank & 1));
     }
 
     void sceGsSyncVCallback(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
@@ -2388,102 +2529,298 @@ namespace ps2_stubs
 
     void sceMcChangeThreadPriority(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        TODO_NAMED("sceMcChangeThreadPriority", rdram, ctx, runtime);
+        // Card I/O never waits on an IOP thread here, priority is irrelevant.
+        setReturnS32(ctx, 0);
     }
 
     void sceMcChdir(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        TODO_NAMED("sceMcChdir", rdram, ctx, runtime);
+        int port = (int)getRegU32(ctx, 4);      // $a0
+        uint32_t pathAddr = getRegU32(ctx, 6);  // $a2
+        uint32_t pwdAddr = getRegU32(ctx, 7);   // $a3 (optional, receives the old directory)
+
+        const char *path = reinterpret_cast<const char *>(getConstMemPtr(rdram, pathAddr));
+        if (!path)
+        {
+            setReturnS32(ctx, -1);
+            return;
+        }
+
+        std::string previous;
+        int32_t result = ps2_memcard::chdir(port, path, previous);
+        if (char *pwd = pwdAddr ? reinterpret_cast<char *>(getMemPtr(rdram, pwdAddr)) : nullptr)
+        {
+            std::strncpy(pwd, previous.c_str(), 1023);
+            pwd[1023] = '\0';
+        }
+        mcFinishCommand(kMcFuncChDir, result);
+        setReturnS32(ctx, 0);
     }
 
     void sceMcClose(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        TODO_NAMED("sceMcClose", rdram, ctx, runtime);
+        int32_t fd = (int32_t)getRegU32(ctx, 4); // $a0
+        mcFinishCommand(kMcFuncClose, ps2_memcard::close(fd));
+        setReturnS32(ctx, 0);
     }
 
     void sceMcDelete(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        TODO_NAMED("sceMcDelete", rdram, ctx, runtime);
+        int port = (int)getRegU32(ctx, 4);     // $a0
+        uint32_t pathAddr = getRegU32(ctx, 6); // $a2
+
+        const char *path = reinterpret_cast<const char *>(getConstMemPtr(rdram, pathAddr));
+        if (!path)
+        {
+            setReturnS32(ctx, -1);
+            return;
+        }
+
+        mcFinishCommand(kMcFuncDelete, ps2_memcard::remove(port, path));
+        setReturnS32(ctx, 0);
     }
 
     void sceMcFlush(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        TODO_NAMED("sceMcFlush", rdram, ctx, runtime);
+        int32_t fd = (int32_t)getRegU32(ctx, 4); // $a0
+        mcFinishCommand(kMcFuncFlush, ps2_memcard::flush(fd));
+        setReturnS32(ctx, 0);
     }
 
     void sceMcFormat(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        TODO_NAMED("sceMcFormat", rdram, ctx, runtime);
+        int port = (int)getRegU32(ctx, 4); // $a0
+        mcFinishCommand(kMcFuncFormat, ps2_memcard::format(port));
+        setReturnS32(ctx, 0);
     }
 
     void sceMcGetDir(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        TODO_NAMED("sceMcGetDir", rdram, ctx, runtime);
+        int port = (int)getRegU32(ctx, 4);          // $a0
+        uint32_t pathAddr = getRegU32(ctx, 6);      // $a2
+        uint32_t mode = getRegU32(ctx, 7);          // $a3 (0 = new listing, 1 = continue)
+        int32_t maxEntries = (int32_t)getRegU32(ctx, 8); // $t0
+        uint32_t tableAddr = getRegU32(ctx, 9);     // $t1 (sceMcTblGetDir[maxEntries])
+
+        const char *path = reinterpret_cast<const char *>(getConstMemPtr(rdram, pathAddr));
+        uint8_t *table = getMemPtr(rdram, tableAddr);
+        if (!path || !table || maxEntries < 0)
+        {
+            setReturnS32(ctx, -1);
+            return;
+        }
+
+        uint32_t room = (PS2_RAM_SIZE - (tableAddr & PS2_RAM_MASK)) / kMcTblGetDirSize;
+        maxEntries = std::min<int32_t>(maxEntries, static_cast<int32_t>(room));
+
+        std::vector<ps2_memcard::EntryInfo> entries;
+        int32_t result = ps2_memcard::getDir(port, path, mode != 0, maxEntries, entries);
+        for (size_t i = 0; i < entries.size(); ++i)
+            writeMcTblGetDir(table + i * kMcTblGetDirSize, entries[i]);
+        mcFinishCommand(kMcFuncGetDir, result);
+        setReturnS32(ctx, 0);
     }
 
     void sceMcGetEntSpace(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        TODO_NAMED("sceMcGetEntSpace", rdram, ctx, runtime);
+        int port = (int)getRegU32(ctx, 4);     // $a0
+        uint32_t pathAddr = getRegU32(ctx, 6); // $a2
+
+        const char *path = reinterpret_cast<const char *>(getConstMemPtr(rdram, pathAddr));
+        if (!path)
+        {
+            setReturnS32(ctx, -1);
+            return;
+        }
+
+        mcFinishCommand(kMcFuncGetEntSpace, ps2_memcard::getEntSpace(port, path));
+        setReturnS32(ctx, 0);
     }
 
     void sceMcGetInfo(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        TODO_NAMED("sceMcGetInfo", rdram, ctx, runtime);
+        int port = (int)getRegU32(ctx, 4);        // $a0
+        uint32_t typeAddr = getRegU32(ctx, 6);    // $a2
+        uint32_t freeAddr = getRegU32(ctx, 7);    // $a3
+        uint32_t formatAddr = getRegU32(ctx, 8);  // $t0
+
+        int32_t type = 0;
+        int32_t freeClusters = 0;
+        int32_t format = 0;
+        int32_t result = ps2_memcard::getInfo(port, type, freeClusters, format);
+
+        if (uint8_t *p = typeAddr ? getMemPtr(rdram, typeAddr) : nullptr)
+            std::memcpy(p, &type, sizeof(type));
+        if (uint8_t *p = freeAddr ? getMemPtr(rdram, freeAddr) : nullptr)
+            std::memcpy(p, &freeClusters, sizeof(freeClusters));
+        if (uint8_t *p = formatAddr ? getMemPtr(rdram, formatAddr) : nullptr)
+            std::memcpy(p, &format, sizeof(format));
+
+        mcFinishCommand(kMcFuncGetInfo, result);
+        setReturnS32(ctx, 0);
     }
 
     void sceMcGetSlotMax(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        TODO_NAMED("sceMcGetSlotMax", rdram, ctx, runtime);
+        setReturnS32(ctx, 1); // no multitap
     }
 
     void sceMcInit(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        TODO_NAMED("sceMcInit", rdram, ctx, runtime);
+        std::cout << "ps2_stub sceMcInit" << std::endl;
+        setReturnS32(ctx, 0);
     }
 
     void sceMcMkdir(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        TODO_NAMED("sceMcMkdir", rdram, ctx, runtime);
+        int port = (int)getRegU32(ctx, 4);     // $a0
+        uint32_t pathAddr = getRegU32(ctx, 6); // $a2
+
+        const char *path = reinterpret_cast<const char *>(getConstMemPtr(rdram, pathAddr));
+        if (!path)
+        {
+            setReturnS32(ctx, -1);
+            return;
+        }
+
+        mcFinishCommand(kMcFuncMkdir, ps2_memcard::mkdir(port, path));
+        setReturnS32(ctx, 0);
     }
 
     void sceMcOpen(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        TODO_NAMED("sceMcOpen", rdram, ctx, runtime);
+        int port = (int)getRegU32(ctx, 4);     // $a0
+        uint32_t pathAddr = getRegU32(ctx, 6); // $a2
+        int mode = (int)getRegU32(ctx, 7);     // $a3
+
+        const char *path = reinterpret_cast<const char *>(getConstMemPtr(rdram, pathAddr));
+        if (!path)
+        {
+            setReturnS32(ctx, -1);
+            return;
+        }
+
+        int32_t fd = ps2_memcard::open(port, path, mode);
+        static int logCount = 0;
+        if (logCount < 16)
+        {
+            std::cout << "ps2_stub sceMcOpen: port=" << port << " path='" << path << "' mode=0x" << std::hex << mode
+                      << std::dec << " -> " << fd << std::endl;
+            ++logCount;
+        }
+        mcFinishCommand(kMcFuncOpen, fd);
+        setReturnS32(ctx, 0);
     }
 
     void sceMcRead(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        TODO_NAMED("sceMcRead", rdram, ctx, runtime);
+        int32_t fd = (int32_t)getRegU32(ctx, 4); // $a0
+        uint32_t bufAddr = getRegU32(ctx, 5);    // $a1
+        int32_t size = (int32_t)getRegU32(ctx, 6); // $a2
+
+        uint8_t *buf = getMemPtr(rdram, bufAddr);
+        if (!buf)
+        {
+            setReturnS32(ctx, -1);
+            return;
+        }
+
+        size = std::min<int32_t>(size, static_cast<int32_t>(PS2_RAM_SIZE - (bufAddr & PS2_RAM_MASK)));
+        mcFinishCommand(kMcFuncRead, ps2_memcard::read(fd, buf, size));
+        setReturnS32(ctx, 0);
     }
 
     void sceMcRename(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        TODO_NAMED("sceMcRename", rdram, ctx, runtime);
+        int port = (int)getRegU32(ctx, 4);     // $a0
+        uint32_t fromAddr = getRegU32(ctx, 6); // $a2
+        uint32_t toAddr = getRegU32(ctx, 7);   // $a3
+
+        const char *from = reinterpret_cast<const char *>(getConstMemPtr(rdram, fromAddr));
+        const char *to = reinterpret_cast<const char *>(getConstMemPtr(rdram, toAddr));
+        if (!from || !to)
+        {
+            setReturnS32(ctx, -1);
+            return;
+        }
+
+        mcFinishCommand(kMcFuncRename, ps2_memcard::rename(port, from, to));
+        setReturnS32(ctx, 0);
     }
 
     void sceMcSeek(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        TODO_NAMED("sceMcSeek", rdram, ctx, runtime);
+        int32_t fd = (int32_t)getRegU32(ctx, 4);     // $a0
+        int32_t offset = (int32_t)getRegU32(ctx, 5); // $a1
+        int whence = (int)getRegU32(ctx, 6);         // $a2
+        mcFinishCommand(kMcFuncSeek, ps2_memcard::seek(fd, offset, whence));
+        setReturnS32(ctx, 0);
     }
 
     void sceMcSetFileInfo(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        TODO_NAMED("sceMcSetFileInfo", rdram, ctx, runtime);
+        int port = (int)getRegU32(ctx, 4);     // $a0
+        uint32_t pathAddr = getRegU32(ctx, 6); // $a2
+        uint32_t infoAddr = getRegU32(ctx, 7); // $a3 (sceMcTblGetDir)
+        uint32_t valid = getRegU32(ctx, 8);    // $t0
+
+        const char *path = reinterpret_cast<const char *>(getConstMemPtr(rdram, pathAddr));
+        const uint8_t *info = getConstMemPtr(rdram, infoAddr);
+        if (!path || !info)
+        {
+            setReturnS32(ctx, -1);
+            return;
+        }
+
+        mcFinishCommand(kMcFuncSetInfo, ps2_memcard::setFileInfo(port, path, readMcTblGetDir(info), valid));
+        setReturnS32(ctx, 0);
     }
 
     void sceMcSync(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        TODO_NAMED("sceMcSync", rdram, ctx, runtime);
+        uint32_t cmdAddr = getRegU32(ctx, 5);    // $a1
+        uint32_t resultAddr = getRegU32(ctx, 6); // $a2
+
+        // Every command completes before its sceMc* call returns, so waiting and
+        // polling (mode 0/1) behave the same. Disk writes happen in the background.
+        int32_t cmd = 0;
+        int32_t result = 0;
+        if (!mcTakeCommand(cmd, result))
+        {
+            setReturnS32(ctx, kMcExecIdle);
+            return;
+        }
+
+        if (uint8_t *p = cmdAddr ? getMemPtr(rdram, cmdAddr) : nullptr)
+            std::memcpy(p, &cmd, sizeof(cmd));
+        if (uint8_t *p = resultAddr ? getMemPtr(rdram, resultAddr) : nullptr)
+            std::memcpy(p, &result, sizeof(result));
+        setReturnS32(ctx, kMcExecFinish);
     }
 
     void sceMcUnformat(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        TODO_NAMED("sceMcUnformat", rdram, ctx, runtime);
+        int port = (int)getRegU32(ctx, 4); // $a0
+        mcFinishCommand(kMcFuncUnformat, ps2_memcard::unformat(port));
+        setReturnS32(ctx, 0);
     }
 
     void sceMcWrite(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        TODO_NAMED("sceMcWrite", rdram, ctx, runtime);
+        int32_t fd = (int32_t)getRegU32(ctx, 4);   // $a0
+        uint32_t bufAddr = getRegU32(ctx, 5);      // $a1
+        int32_t size = (int32_t)getRegU32(ctx, 6); // $a2
+
+        const uint8_t *buf = getConstMemPtr(rdram, bufAddr);
+        if (!buf)
+        {
+            setReturnS32(ctx, -1);
+            return;
+        }
+
+        size = std::min<int32_t>(size, static_cast<int32_t>(PS2_RAM_SIZE - (bufAddr & PS2_RAM_MASK)));
+        mcFinishCommand(kMcFuncWrite, ps2_memcard::write(fd, buf, size));
+        setReturnS32(ctx, 0);
     }
 
     void sceMpegAddBs(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
@@ -2708,7 +3045,25 @@ namespace ps2_stubs
 
     void scePadRead(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        TODO_NAMED("scePadRead", rdram, ctx, runtime);
+        uint32_t port = getRegU32(ctx, 4);
+        uint32_t dataAddr = getRegU32(ctx, 6);
+        if (!dataAddr)
+        {
+            setReturnS32(ctx, 0);
+            return;
+        }
+
+        // Digital pad frame: status, id 0x41, buttons (active low), then centred sticks.
+        uint8_t frame[32] = {};
+        uint16_t buttons = port == 0 ? runtime->padButtons() : 0xFFFF;
+        frame[1] = 0x41;
+        frame[2] = static_cast<uint8_t>(buttons);
+        frame[3] = static_cast<uint8_t>(buttons >> 8);
+        std::memset(frame + 4, 0x80, 4);
+
+        ps2_journal::bytes(ps2_journal::EVENT_PAD_READ, frame, sizeof(frame));
+        std::memcpy(getMemPtr(rdram, dataAddr), frame, sizeof(frame));
+        setReturnS32(ctx, 1);
     }
 
     void scePadReqIntToStr(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
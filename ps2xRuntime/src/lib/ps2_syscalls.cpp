@@ -2,6 +2,9 @@
 #include "ps2_runtime.h"
 #include "ps2_runtime_macros.h"
 #include "ps2_stubs.h"
+#include "ps2_host_files.h"
+#include "ps2_vfs.h"
+#include "ps2_journal.h"
 #include <iostream>
 #include <cstring>
 #include <cstdio>
@@ -20,9 +23,6 @@
 #endif
 
 
-std::unordered_map<int, FILE *> g_fileDescriptors;
-int g_nextFd = 3; // Start after stdin, stdout, stderr
-
 struct ThreadInfo
 {
     uint32_t entry = 0;
@@ -52,84 +52,6 @@ static std::unordered_map<int, std::shared_ptr<SemaInfo>> g_semas;
 static int g_nextSemaId = 1;
 std::atomic<int> g_activeThreads{0};
 
-int allocatePs2Fd(FILE *file)
-{
-    if (!file)
-        return -1;
-    int fd = g_nextFd++;
-    g_fileDescriptors[fd] = file;
-    return fd;
-}
-
-FILE *getHostFile(int ps2Fd)
-{
-    auto it = g_fileDescriptors.find(ps2Fd);
-    if (it != g_fileDescriptors.end())
-    {
-        return it->second;
-    }
-    return nullptr;
-}
-
-void releasePs2Fd(int ps2Fd)
-{
-    g_fileDescriptors.erase(ps2Fd);
-}
-
-const char *translateFioMode(int ps2Flags)
-{
-    bool read = (ps2Flags & PS2_FIO_O_RDONLY) || (ps2Flags & PS2_FIO_O_RDWR);
-    bool write = (ps2Flags & PS2_FIO_O_WRONLY) || (ps2Flags & PS2_FIO_O_RDWR);
-    bool append = (ps2Flags & PS2_FIO_O_APPEND);
-    bool create = (ps2Flags & PS2_FIO_O_CREAT);
-    bool truncate = (ps2Flags & PS2_FIO_O_TRUNC);
-
-    if (read && write)
-    {
-        if (create && truncate)
-            return "w+b";
-        if (create)
-            return "a+b";
-        return "r+b";
-    }
-    else if (write)
-    {
-        if (append)
-            return "ab";
-        if (create && truncate)
-            return "wb";
-        if (create)
-            return "wx";
-        return "r+b";
-    }
-    else if (read)
-    {
-        return "rb";
-    }
-    return "rb";
-}
-
-std::string translatePs2Path(const char *ps2Path)
-{
-    std::string pathStr(ps2Path);
-    if (pathStr.rfind("host0:", 0) == 0)
-    {
-        // Map host0: to ./host_fs/ relative to executable
-        std::filesystem::path hostBasePath = std::filesystem::current_path() / "host_fs";
-        std::filesystem::create_directories(hostBasePath); // Ensure it exists
-        return (hostBasePath / pathStr.substr(6)).string();
-    }
-    else if (pathStr.rfind("cdrom0:", 0) == 0)
-    {
-        // Map cdrom0: to ./cd_fs/ relative to executable (for example)
-        std::filesystem::path cdBasePath = std::filesystem::current_path() / "cd_fs";
-        std::filesystem::create_directories(cdBasePath); // Ensure it exists
-        return (cdBasePath / pathStr.substr(7)).string();
-    }
-    std::cerr << "Warning: Unsupported PS2 path prefix: " << pathStr << std::endl;
-    return "";
-}
-
 #include "ps2_syscalls.h"
 
 namespace ps2_syscalls
@@ -253,10 +175,11 @@ namespace ps2_syscalls
             }
 
             SET_GPR_U32(threadCtx, 4, info.arg);
+            SET_GPR_U32(threadCtx, 31, PS2Runtime::kGuestExitAddress); // returning from the entry ends the thread
             threadCtx->pc = info.entry;
-
-            PS2Runtime::RecompiledFunction func = runtime->lookupFunction(info.entry);
             g_currentThreadId = tid;
+            ps2_journal::setCurrentThread(tid);
+            ps2_journal::sequence(ps2_journal::EVENT_THREAD_START);
 
             std::cout << "[StartThread] id=" << tid
                       << " entry=0x" << std::hex << info.entry
@@ -266,7 +189,7 @@ namespace ps2_syscalls
 
             try
             {
-                func(rdram, threadCtx, runtime);
+                runtime->dispatch(rdram, threadCtx, PS2Runtime::kGuestExitAddress);
             }
             catch (const std::exception &e)
             {
@@ -622,6 +545,10 @@ namespace ps2_syscalls
             ++logCount;
         }
 
+        // Alarms fire synchronously here; journal the point so replay keeps the
+        // same interleaving with other threads.
+        ps2_journal::sequence(ps2_journal::EVENT_ALARM);
+
         // If the handler looks like a semaphore id, just kick it now.
         if (arg)
         {
@@ -814,31 +741,14 @@ namespace ps2_syscalls
             return;
         }
 
-        std::string hostPath = translatePs2Path(ps2Path);
-        if (hostPath.empty())
-        {
-            std::cerr << "fioOpen error: Failed to translate path '" << ps2Path << "'" << std::endl;
-            setReturnS32(ctx, -1);
-            return;
-        }
-
-        const char *mode = translateFioMode(flags);
-        std::cout << "fioOpen: '" << hostPath << "' flags=0x" << std::hex << flags << std::dec << " mode='" << mode << "'" << std::endl;
-
-        FILE *fp = ::fopen(hostPath.c_str(), mode);
-        if (!fp)
-        {
-            std::cerr << "fioOpen error: fopen failed for '" << hostPath << "': " << strerror(errno) << std::endl;
-            setReturnS32(ctx, -1); // e.g., -ENOENT, -EACCES
-            return;
-        }
+        int hostFlags = ps2_host_files::hostFlagsFromFio(flags);
+        std::cout << "fioOpen: '" << ps2Path << "' flags=0x" << std::hex << flags << std::dec << std::endl;
 
-        int ps2Fd = allocatePs2Fd(fp);
+        int32_t ps2Fd = ps2_vfs::open(ps2Path, hostFlags);
         if (ps2Fd < 0)
         {
-            std::cerr << "fioOpen error: Failed to allocate PS2 file descriptor" << std::endl;
-            ::fclose(fp);
-            setReturnS32(ctx, -1); // e.g., -EMFILE
+            std::cerr << "fioOpen error: open failed for '" << ps2Path << "': " << strerror(errno) << std::endl;
+            setReturnS32(ctx, -1); // e.g., -ENOENT, -EACCES, -EMFILE
             return;
         }
 
@@ -851,19 +761,15 @@ namespace ps2_syscalls
         int ps2Fd = (int)getRegU32(ctx, 4); // $a0
         std::cout << "fioClose: fd=" << ps2Fd << std::endl;
 
-        FILE *fp = getHostFile(ps2Fd);
-        if (!fp)
+        if (ps2_host_files::close(ps2Fd) != 0)
         {
             std::cerr << "fioClose warning: Invalid PS2 file descriptor " << ps2Fd << std::endl;
             setReturnS32(ctx, -1); // e.g., -EBADF
             return;
         }
 
-        int ret = ::fclose(fp);
-        releasePs2Fd(ps2Fd);
-
         // returns 0 on success, -1 on error
-        setReturnS32(ctx, ret == 0 ? 0 : -1);
+        setReturnS32(ctx, 0);
     }
 
     void fioRead(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
@@ -873,7 +779,6 @@ namespace ps2_syscalls
         size_t size = getRegU32(ctx, 6);      // $a2
 
         uint8_t *hostBuf = getMemPtr(rdram, bufAddr);
-        FILE *fp = getHostFile(ps2Fd);
 
         if (!hostBuf)
         {
@@ -881,7 +786,7 @@ namespace ps2_syscalls
             setReturnS32(ctx, -1); // -EFAULT
             return;
         }
-        if (!fp)
+        if (!ps2_host_files::isValid(ps2Fd))
         {
             std::cerr << "fioRead error: Invalid file descriptor " << ps2Fd << std::endl;
             setReturnS32(ctx, -1); // -EBADF
@@ -893,16 +798,16 @@ namespace ps2_syscalls
             return;
         }
 
-        size_t bytesRead = 0;
-        {
-            std::lock_guard<std::mutex> lock(g_sys_fd_mutex);
-            bytesRead = fread(hostBuf, 1, size, fp);
-        }
+        // Never run past the end of RDRAM, the guest buffer is contiguous from bufAddr.
+        size_t maxSize = PS2_RAM_SIZE - (bufAddr & PS2_RAM_MASK);
+        if (size > maxSize)
+            size = maxSize;
 
-        if (bytesRead < size && ferror(fp))
+        // pread straight into guest memory, no shared lock or stdio buffer in between.
+        int64_t bytesRead = ps2_host_files::read(ps2Fd, hostBuf, size);
+        if (bytesRead < 0)
         {
-            std::cerr << "fioRead error: fread failed for fd " << ps2Fd << ": " << strerror(errno) << std::endl;
-            clearerr(fp);
+            std::cerr << "fioRead error: read failed for fd " << ps2Fd << ": " << strerror(errno) << std::endl;
             setReturnS32(ctx, -1); // -EIO or other appropriate error
             return;
         }
@@ -918,7 +823,6 @@ namespace ps2_syscalls
         size_t size = getRegU32(ctx, 6);      // $a2
 
         const uint8_t *hostBuf = getConstMemPtr(rdram, bufAddr);
-        FILE *fp = getHostFile(ps2Fd);
 
         if (!hostBuf)
         {
@@ -926,7 +830,7 @@ namespace ps2_syscalls
             setReturnS32(ctx, -1); // -EFAULT
             return;
         }
-        if (!fp)
+        if (!ps2_host_files::isValid(ps2Fd))
         {
             std::cerr << "fioWrite error: Invalid file descriptor " << ps2Fd << std::endl;
             setReturnS32(ctx, -1); // -EBADF
@@ -938,21 +842,15 @@ namespace ps2_syscalls
             return;
         }
 
-        size_t bytesWritten = ::fwrite(hostBuf, 1, size, fp);
+        size_t maxSize = PS2_RAM_SIZE - (bufAddr & PS2_RAM_MASK);
+        if (size > maxSize)
+            size = maxSize;
 
-        if (bytesWritten < size)
+        int64_t bytesWritten = ps2_host_files::write(ps2Fd, hostBuf, size);
+        if (bytesWritten < 0)
         {
-            if (ferror(fp))
-            {
-                std::cerr << "fioWrite error: fwrite failed for fd " << ps2Fd << ": " << strerror(errno) << std::endl;
-                clearerr(fp);
-                setReturnS32(ctx, -1); // -EIO, -ENOSPC etc.
-            }
-            else
-            {
-                // Partial write without error? Possible but idk.
-                setReturnS32(ctx, (int32_t)bytesWritten);
-            }
+            std::cerr << "fioWrite error: write failed for fd " << ps2Fd << ": " << strerror(errno) << std::endl;
+            setReturnS32(ctx, -1); // -EIO, -ENOSPC etc.
             return;
         }
 
@@ -966,8 +864,7 @@ namespace ps2_syscalls
         int32_t offset = getRegU32(ctx, 5);  // $a1 (PS2 seems to use 32-bit offset here commonly)
         int whence = (int)getRegU32(ctx, 6); // $a2 (PS2 FIO_SEEK constants)
 
-        FILE *fp = getHostFile(ps2Fd);
-        if (!fp)
+        if (!ps2_host_files::isValid(ps2Fd))
         {
             std::cerr << "fioLseek error: Invalid file descriptor " << ps2Fd << std::endl;
             setReturnS32(ctx, -1); // -EBADF
@@ -992,31 +889,21 @@ namespace ps2_syscalls
             return;
         }
 
-        if (::fseek(fp, static_cast<long>(offset), hostWhence) != 0)
+        int64_t newPos = ps2_host_files::seek(ps2Fd, offset, hostWhence);
+        if (newPos < 0)
         {
-            std::cerr << "fioLseek error: fseek failed for fd " << ps2Fd << ": " << strerror(errno) << std::endl;
-            setReturnS32(ctx, -1); // Return error code
-            return;
+            std::cerr << "fioLseek error: seek failed for fd " << ps2Fd << ": " << strerror(errno) << std::endl;
+            setReturnS32(ctx, -1);
         }
-
-        long newPos = ::ftell(fp);
-        if (newPos < 0)
+        else if (newPos > 0x7FFFFFFFLL)
         {
-            std::cerr << "fioLseek error: ftell failed after fseek for fd " << ps2Fd << ": " << strerror(errno) << std::endl;
+            // the return register is a signed 32-bit offset
+            std::cerr << "fioLseek warning: New position exceeds 32-bit for fd " << ps2Fd << std::endl;
             setReturnS32(ctx, -1);
         }
         else
         {
-            // maybe we dont need this check. if position fits in 32 bits
-            if (newPos > 0xFFFFFFFFL)
-            {
-                std::cerr << "fioLseek warning: New position exceeds 32-bit for fd " << ps2Fd << std::endl;
-                setReturnS32(ctx, -1);
-            }
-            else
-            {
-                setReturnS32(ctx, (int32_t)newPos);
-            }
+            setReturnS32(ctx, (int32_t)newPos);
         }
     }
 
@@ -1033,7 +920,7 @@ namespace ps2_syscalls
             setReturnS32(ctx, -1); // -EFAULT
             return;
         }
-        std::string hostPath = translatePs2Path(ps2Path);
+        std::string hostPath = ps2_vfs::hostPath(ps2Path);
         if (hostPath.empty())
         {
             std::cerr << "fioMkdir error: Failed to translate path '" << ps2Path << "'" << std::endl;
@@ -1054,6 +941,7 @@ namespace ps2_syscalls
         }
         else
         {
+            ps2_vfs::invalidate(ps2Path);
             setReturnS32(ctx, 0); // Success
         }
     }
@@ -1070,7 +958,7 @@ namespace ps2_syscalls
             return;
         }
 
-        std::string hostPath = translatePs2Path(ps2Path);
+        std::string hostPath = ps2_vfs::hostPath(ps2Path);
         if (hostPath.empty())
         {
             std::cerr << "fioChdir error: Failed to translate path '" << ps2Path << "'" << std::endl;
@@ -1107,7 +995,7 @@ namespace ps2_syscalls
             setReturnS32(ctx, -1);
             return;
         }
-        std::string hostPath = translatePs2Path(ps2Path);
+        std::string hostPath = ps2_vfs::hostPath(ps2Path);
         if (hostPath.empty())
         {
             std::cerr << "fioRmdir error: Failed to translate path '" << ps2Path << "'" << std::endl;
@@ -1128,13 +1016,13 @@ namespace ps2_syscalls
         }
         else
         {
+            ps2_vfs::invalidate(ps2Path);
             setReturnS32(ctx, 0); // Success
         }
     }
 
     void fioGetstat(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
     {
-        // we wont implement this for now.
         uint32_t pathAddr = getRegU32(ctx, 4);    // $a0
         uint32_t statBufAddr = getRegU32(ctx, 5); // $a1
 
@@ -1154,15 +1042,25 @@ namespace ps2_syscalls
             return;
         }
 
-        std::string hostPath = translatePs2Path(ps2Path);
-        if (hostPath.empty())
+        ps2_vfs::Entry entry = ps2_vfs::resolve(ps2Path);
+        if (!entry.exists)
         {
-            std::cerr << "fioGetstat error: Bad path translate" << std::endl;
-            setReturnS32(ctx, -1);
+            setReturnS32(ctx, -1); // -ENOENT
             return;
         }
 
-        setReturnS32(ctx, -1);
+        // io_stat_t: mode, attr, size, ctime[8], atime[8], mtime[8], hisize
+        uint32_t mode = (entry.isDirectory ? PS2_FIO_S_IFDIR : PS2_FIO_S_IFREG) | (entry.readOnly ? 0x0124 : 0x01B6);
+        uint32_t attr = 0;
+        uint32_t sizeLo = static_cast<uint32_t>(entry.size);
+        uint32_t sizeHi = static_cast<uint32_t>(entry.size >> 32);
+        std::memset(ps2StatBuf, 0, 40);
+        std::memcpy(ps2StatBuf + 0, &mode, sizeof(mode));
+        std::memcpy(ps2StatBuf + 4, &attr, sizeof(attr));
+        std::memcpy(ps2StatBuf + 8, &sizeLo, sizeof(sizeLo));
+        std::memcpy(ps2StatBuf + 36, &sizeHi, sizeof(sizeHi));
+
+        setReturnS32(ctx, 0);
     }
 
     void fioRemove(uint8_t *rdram, R5900Context *ctx, PS2Runtime *runtime)
@@ -1176,7 +1074,7 @@ namespace ps2_syscalls
             return;
         }
 
-        std::string hostPath = translatePs2Path(ps2Path);
+        std::string hostPath = ps2_vfs::hostPath(ps2Path);
         if (hostPath.empty())
         {
             std::cerr << "fioRemove error: Path translate fail" << std::endl;
@@ -1197,6 +1095,7 @@ namespace ps2_syscalls
         }
         else
         {
+            ps2_vfs::invalidate(ps2Path);
             setReturnS32(ctx, 0); // Success
         }
     }
@@ -0,0 +1,584 @@
+#include "ps2_vfs.h"
+#include "ps2_host_files.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+    // Read-only host files at least this large are mmap'd instead of pread.
+    constexpr uint64_t kMapThreshold = 256 * 1024;
+    constexpr int kMaxIsoDepth = 32;
+    // Sectors handed to host directory files start past the ISO system area and
+    // volume descriptors, so LSN 0 never names a file.
+    constexpr uint32_t kFirstHostLsn = 0x20;
+
+    struct IsoEntry
+    {
+        uint32_t lsn = 0;
+        uint32_t size = 0;
+        bool isDirectory = false;
+    };
+
+    // A host file given a run of sectors on a directory-backed cdrom0:.
+    struct HostSectors
+    {
+        uint32_t lsn = 0;
+        uint32_t count = 0;
+        std::string hostPath;
+        std::shared_ptr<MappedFile> mapping; // opened by the first read
+    };
+
+    struct Mount
+    {
+        std::filesystem::path root;
+        std::shared_ptr<MappedFile> image;
+        std::unordered_map<std::string, IsoEntry> isoIndex; // folded relative path -> entry
+        std::unordered_map<std::string, uint32_t> hostLsns; // host path -> first sector
+        std::vector<HostSectors> hostSectors;               // ascending lsn
+        uint32_t nextLsn = kFirstHostLsn;
+    };
+
+    std::shared_mutex g_vfsMutex;
+    std::unordered_map<std::string, Mount> g_mounts;
+    std::unordered_map<std::string, ps2_vfs::Entry> g_resolveCache;
+    bool g_defaultsApplied = false;
+
+    std::mutex g_mappedMutex;
+    std::unordered_map<std::string, std::weak_ptr<MappedFile>> g_mappedFiles;
+
+    uint32_t readLe32(const uint8_t *p)
+    {
+        return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+               (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+    }
+
+    std::string canonicalDevice(std::string_view device)
+    {
+        std::string dev;
+        for (char c : device)
+            dev.push_back(static_cast<char>(std::tolower(static_cast<unsigned char>(c))));
+        if (dev == "cdrom")
+            return "cdrom0";
+        if (dev == "host")
+            return "host0";
+        return dev;
+    }
+
+    // Drops the ";1" version suffix and the trailing '.' ISO9660 adds to extension-less names.
+    std::string stripVersion(std::string_view component)
+    {
+        size_t semi = component.find(';');
+        if (semi != std::string_view::npos)
+            component = component.substr(0, semi);
+        while (!component.empty() && component.back() == '.')
+            component.remove_suffix(1);
+        return std::string(component);
+    }
+
+    std::string foldCase(std::string_view s)
+    {
+        std::string out(s);
+        for (char &c : out)
+            c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+        return out;
+    }
+
+    // Splits "dev:rest" into device and version-stripped path components (original case).
+    bool splitPath(std::string_view ps2Path, std::string &device, std::vector<std::string> &components)
+    {
+        size_t colon = ps2Path.find(':');
+        if (colon == std::string_view::npos || colon == 0)
+            return false;
+
+        device = canonicalDevice(ps2Path.substr(0, colon));
+        components.clear();
+
+        std::string_view rest = ps2Path.substr(colon + 1);
+        size_t pos = 0;
+        while (pos <= rest.size())
+        {
+            size_t next = rest.find_first_of("/\\", pos);
+            if (next == std::string_view::npos)
+                next = rest.size();
+            std::string_view part = rest.substr(pos, next - pos);
+            if (!part.empty() && part != ".")
+            {
+                if (part == "..")
+                {
+                    if (!components.empty())
+                        components.pop_back();
+                }
+                else
+                {
+                    std::string stripped = stripVersion(part);
+                    if (!stripped.empty())
+                        components.push_back(std::move(stripped));
+                }
+            }
+            pos = next + 1;
+        }
+        return true;
+    }
+
+    std::string joinFolded(const std::vector<std::string> &components)
+    {
+        std::string out;
+        for (const std::string &c : components)
+        {
+            if (!out.empty())
+                out.push_back('/');
+            out += foldCase(c);
+        }
+        return out;
+    }
+
+    void indexIsoDirectory(const MappedFile &image, uint32_t lsn, uint32_t size, const std::string &prefix,
+                           std::unordered_map<std::string, IsoEntry> &index, int depth)
+    {
+        if (depth > kMaxIsoDepth)
+            return;
+
+        const uint64_t begin = static_cast<uint64_t>(lsn) * ps2_vfs::kCdSectorSize;
+        const uint64_t end = begin + size;
+        if (end > image.size())
+            return;
+
+        const uint8_t *data = image.data();
+        uint64_t pos = begin;
+        while (pos < end)
+        {
+            uint8_t len = data[pos];
+            if (len == 0)
+            {
+                // records never straddle sectors, zero padding up to the next one
+                pos = (pos / ps2_vfs::kCdSectorSize + 1) * ps2_vfs::kCdSectorSize;
+                continue;
+            }
+            if (len < 34 || pos + len > end)
+                break;
+
+            const uint8_t *rec = data + pos;
+            uint8_t nameLen = rec[32];
+            const char *name = reinterpret_cast<const char *>(rec + 33);
+            bool selfOrParent = nameLen == 1 && (name[0] == 0 || name[0] == 1);
+            if (!selfOrParent && 33u + nameLen <= len)
+            {
+                IsoEntry entry;
+                entry.lsn = readLe32(rec + 2);
+                entry.size = readLe32(rec + 10);
+                entry.isDirectory = (rec[25] & 0x02) != 0;
+
+                std::string folded = foldCase(stripVersion(std::string_view(name, nameLen)));
+                std::string path = prefix.empty() ? folded : prefix + "/" + folded;
+                index[path] = entry;
+                if (entry.isDirectory)
+                    indexIsoDirectory(image, entry.lsn, entry.size, path, index, depth + 1);
+            }
+            pos += len;
+        }
+    }
+
+    bool indexIsoImage(const MappedFile &image, std::unordered_map<std::string, IsoEntry> &index)
+    {
+        const uint64_t pvdOffset = 16ull * ps2_vfs::kCdSectorSize;
+        if (image.size() < pvdOffset + ps2_vfs::kCdSectorSize)
+            return false;
+
+        const uint8_t *pvd = image.data() + pvdOffset;
+        if (pvd[0] != 1 || std::memcmp(pvd + 1, "CD001", 5) != 0)
+            return false;
+
+        const uint8_t *root = pvd + 156;
+        IsoEntry rootEntry{readLe32(root + 2), readLe32(root + 10), true};
+        index[""] = rootEntry;
+        indexIsoDirectory(image, rootEntry.lsn, rootEntry.size, "", index, 0);
+        return true;
+    }
+
+    void applyDefaultsLocked()
+    {
+        if (g_defaultsApplied)
+            return;
+        g_defaultsApplied = true;
+
+        std::error_code ec;
+        const std::filesystem::path cwd = std::filesystem::current_path(ec);
+        auto addDir = [&](const char *device, const char *dir, bool create)
+        {
+            if (g_mounts.count(device))
+                return;
+            Mount mount;
+            mount.root = cwd / dir;
+            if (create)
+                std::filesystem::create_directories(mount.root, ec);
+            g_mounts.emplace(device, std::move(mount));
+        };
+
+        addDir("host0", "host_fs", true);
+        addDir("cdrom0", "cd_fs", true);
+        addDir("mc0", "mc0", false);
+        addDir("mc1", "mc1", false);
+    }
+
+    // Case-insensitive match of one component inside a host directory.
+    bool findHostChild(const std::filesystem::path &dir, const std::string &component, std::filesystem::path &out)
+    {
+        std::error_code ec;
+        std::filesystem::path exact = dir / component;
+        if (std::filesystem::exists(exact, ec))
+        {
+            out = std::move(exact);
+            return true;
+        }
+
+        const std::string folded = foldCase(component);
+        for (std::filesystem::directory_iterator it(dir, ec), endIt; !ec && it != endIt; it.increment(ec))
+        {
+            if (foldCase(stripVersion(it->path().filename().string())) == folded)
+            {
+                out = it->path();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::shared_ptr<MappedFile> mapArchive(const std::string &hostPath)
+    {
+        std::lock_guard<std::mutex> lock(g_mappedMutex);
+        auto it = g_mappedFiles.find(hostPath);
+        if (it != g_mappedFiles.end())
+        {
+            if (auto existing = it->second.lock())
+                return existing;
+        }
+
+        auto mapped = MappedFile::open(hostPath);
+        if (mapped)
+            g_mappedFiles[hostPath] = mapped;
+        return mapped;
+    }
+
+    // Gives a host file a stable run of sectors, so sceCdSearchFile can report an
+    // LSN that readSectors maps back to it.
+    uint32_t assignHostLsn(Mount &mount, const std::string &hostPath, uint64_t size)
+    {
+        auto it = mount.hostLsns.find(hostPath);
+        if (it != mount.hostLsns.end())
+            return it->second;
+
+        uint64_t sectors = std::max<uint64_t>(1, (size + ps2_vfs::kCdSectorSize - 1) / ps2_vfs::kCdSectorSize);
+        if (sectors > UINT32_MAX - mount.nextLsn)
+            return 0;
+
+        HostSectors run;
+        run.lsn = mount.nextLsn;
+        run.count = static_cast<uint32_t>(sectors);
+        run.hostPath = hostPath;
+        mount.nextLsn += run.count;
+        mount.hostLsns.emplace(hostPath, run.lsn);
+        mount.hostSectors.push_back(std::move(run));
+        return mount.hostSectors.back().lsn;
+    }
+}
+
+namespace ps2_vfs
+{
+    bool mount(std::string_view device, const std::filesystem::path &target)
+    {
+        std::error_code ec;
+        Mount mount;
+        if (std::filesystem::is_regular_file(target, ec))
+        {
+            mount.image = MappedFile::open(target);
+            if (!mount.image || !indexIsoImage(*mount.image, mount.isoIndex))
+            {
+                std::cerr << "VFS error: '" << target.string() << "' is not a readable ISO9660 image" << std::endl;
+                return false;
+            }
+        }
+        else if (std::filesystem::is_directory(target, ec))
+        {
+            mount.root = std::filesystem::absolute(target, ec);
+        }
+        else
+        {
+            std::cerr << "VFS error: mount target '" << target.string() << "' does not exist" << std::endl;
+            return false;
+        }
+
+        std::unique_lock<std::shared_mutex> lock(g_vfsMutex);
+        applyDefaultsLocked();
+        g_mounts[canonicalDevice(device)] = std::move(mount);
+        g_resolveCache.clear();
+        std::cout << "VFS: mounted " << canonicalDevice(device) << ": -> " << target.string() << std::endl;
+        return true;
+    }
+
+    bool unmount(std::string_view device)
+    {
+        std::unique_lock<std::shared_mutex> lock(g_vfsMutex);
+        g_resolveCache.clear();
+        return g_mounts.erase(canonicalDevice(device)) != 0;
+    }
+
+    void resetMounts()
+    {
+        std::unique_lock<std::shared_mutex> lock(g_vfsMutex);
+        g_mounts.clear();
+        g_resolveCache.clear();
+        g_defaultsApplied = false;
+        applyDefaultsLocked();
+    }
+
+    bool hasDevice(std::string_view ps2Path)
+    {
+        size_t colon = ps2Path.find(':');
+        if (colon == std::string_view::npos || colon == 0)
+            return false;
+
+        std::unique_lock<std::shared_mutex> lock(g_vfsMutex);
+        applyDefaultsLocked();
+        return g_mounts.count(canonicalDevice(ps2Path.substr(0, colon))) != 0;
+    }
+
+    std::shared_ptr<MappedFile> discImage()
+    {
+        std::shared_lock<std::shared_mutex> lock(g_vfsMutex);
+        auto it = g_mounts.find("cdrom0");
+        return it != g_mounts.end() ? it->second.image : nullptr;
+    }
+
+    std::string normalizePath(std::string_view ps2Path)
+    {
+        std::string device;
+        std::vector<std::string> components;
+        if (!splitPath(ps2Path, device, components))
+            return {};
+        return device + ":" + joinFolded(components);
+    }
+
+    Entry resolve(std::string_view ps2Path)
+    {
+        std::string device;
+        std::vector<std::string> components;
+        if (!splitPath(ps2Path, device, components))
+            return {};
+
+        const std::string key = device + ":" + joinFolded(components);
+        {
+            std::shared_lock<std::shared_mutex> lock(g_vfsMutex);
+            auto cached = g_resolveCache.find(key);
+            if (cached != g_resolveCache.end())
+                return cached->second;
+        }
+
+        std::unique_lock<std::shared_mutex> lock(g_vfsMutex);
+        applyDefaultsLocked();
+        auto mountIt = g_mounts.find(device);
+        if (mountIt == g_mounts.end())
+            return {};
+        Mount &mount = mountIt->second;
+
+        Entry entry;
+        if (mount.image)
+        {
+            auto isoIt = mount.isoIndex.find(joinFolded(components));
+            if (isoIt == mount.isoIndex.end())
+                return {};
+            entry.exists = true;
+            entry.isDirectory = isoIt->second.isDirectory;
+            entry.readOnly = true;
+            entry.size = isoIt->second.size;
+            entry.image = mount.image;
+            entry.lsn = isoIt->second.lsn;
+        }
+        else
+        {
+            std::filesystem::path current = mount.root;
+            for (const std::string &component : components)
+            {
+                std::filesystem::path next;
+                if (!findHostChild(current, component, next))
+                    return {}; // misses aren't cached, the guest may create the file next
+                current = std::move(next);
+            }
+
+            std::error_code ec;
+            entry.exists = true;
+            entry.isDirectory = std::filesystem::is_directory(current, ec);
+            entry.size = entry.isDirectory ? 0 : static_cast<uint64_t>(std::filesystem::file_size(current, ec));
+            entry.hostPath = current.string();
+            if (device == "cdrom0" && !entry.isDirectory)
+                entry.lsn = assignHostLsn(mount, entry.hostPath, entry.size);
+        }
+
+        g_resolveCache[key] = entry;
+        return entry;
+    }
+
+    void readSectors(uint32_t lsn, uint8_t *dst, size_t bytes)
+    {
+        const uint64_t begin = static_cast<uint64_t>(lsn) * kCdSectorSize;
+        size_t done = 0;
+        while (done < bytes)
+        {
+            // Find what backs the next byte under the lock, copy outside it.
+            const uint64_t position = begin + done;
+            std::shared_ptr<MappedFile> source;
+            uint64_t sourceOffset = 0;
+            uint64_t spanEnd = UINT64_MAX; // where the current file or gap ends
+            {
+                std::unique_lock<std::shared_mutex> lock(g_vfsMutex);
+                applyDefaultsLocked();
+                auto mountIt = g_mounts.find("cdrom0");
+                if (mountIt != g_mounts.end() && mountIt->second.image)
+                {
+                    source = mountIt->second.image;
+                    sourceOffset = position;
+                }
+                else if (mountIt != g_mounts.end())
+                {
+                    std::vector<HostSectors> &runs = mountIt->second.hostSectors;
+                    auto next = std::upper_bound(runs.begin(), runs.end(), position, [](uint64_t value, const HostSectors &run)
+                                                 { return value < static_cast<uint64_t>(run.lsn) * kCdSectorSize; });
+                    if (next != runs.end())
+                        spanEnd = static_cast<uint64_t>(next->lsn) * kCdSectorSize;
+                    if (next != runs.begin())
+                    {
+                        HostSectors &run = *std::prev(next);
+                        uint64_t runBegin = static_cast<uint64_t>(run.lsn) * kCdSectorSize;
+                        uint64_t runEnd = runBegin + static_cast<uint64_t>(run.count) * kCdSectorSize;
+                        if (position < runEnd)
+                        {
+                            if (!run.mapping)
+                                run.mapping = mapArchive(run.hostPath);
+                            source = run.mapping;
+                            sourceOffset = position - runBegin;
+                            spanEnd = runEnd;
+                        }
+                    }
+                }
+            }
+
+            size_t span = static_cast<size_t>(std::min<uint64_t>(bytes - done, spanEnd - position));
+            size_t copied = 0;
+            if (source && sourceOffset < source->size())
+            {
+                copied = static_cast<size_t>(std::min<uint64_t>(span, source->size() - sourceOffset));
+                std::memcpy(dst + done, source->data() + sourceOffset, copied);
+            }
+            std::memset(dst + done + copied, 0, span - copied); // past the end of a file or the image
+            done += span;
+        }
+    }
+
+    std::string hostPath(std::string_view ps2Path)
+    {
+        std::string device;
+        std::vector<std::string> components;
+        if (!splitPath(ps2Path, device, components))
+        {
+            std::cerr << "Warning: Unsupported PS2 path prefix: " << ps2Path << std::endl;
+            return {};
+        }
+
+        std::filesystem::path current;
+        {
+            std::unique_lock<std::shared_mutex> lock(g_vfsMutex);
+            applyDefaultsLocked();
+            auto mountIt = g_mounts.find(device);
+            if (mountIt == g_mounts.end() || mountIt->second.image)
+            {
+                std::cerr << "Warning: Unsupported PS2 path prefix: " << ps2Path << std::endl;
+                return {};
+            }
+            current = mountIt->second.root;
+        }
+
+        // Follow existing components case-insensitively, keep the guest's spelling for the rest.
+        bool matching = true;
+        for (const std::string &component : components)
+        {
+            std::filesystem::path next;
+            if (matching && findHostChild(current, component, next))
+            {
+                current = std::move(next);
+                continue;
+            }
+            matching = false;
+            current /= component;
+        }
+        return current.string();
+    }
+
+    void invalidate(std::string_view ps2Path)
+    {
+        const std::string key = normalizePath(ps2Path);
+        if (key.empty())
+            return;
+
+        const std::string childPrefix = key.back() == ':' ? key : key + "/";
+        std::unique_lock<std::shared_mutex> lock(g_vfsMutex);
+        for (auto it = g_resolveCache.begin(); it != g_resolveCache.end();)
+        {
+            if (it->first == key || it->first.compare(0, childPrefix.size(), childPrefix) == 0)
+                it = g_resolveCache.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    int32_t open(std::string_view ps2Path, int hostFlags)
+    {
+        const bool readOnly = (hostFlags & (O_WRONLY | O_RDWR | O_CREAT | O_TRUNC | O_APPEND)) == 0;
+        Entry entry = resolve(ps2Path);
+
+        if (entry.image)
+        {
+            if (!readOnly)
+            {
+                errno = EROFS;
+                return -1;
+            }
+            if (entry.isDirectory)
+            {
+                errno = EISDIR;
+                return -1;
+            }
+            uint64_t offset = static_cast<uint64_t>(entry.lsn) * kCdSectorSize;
+            uint64_t size = std::min<uint64_t>(entry.size, entry.image->size() - std::min(offset, entry.image->size()));
+            return ps2_host_files::openMemory(entry.image, entry.image->data() + offset, size);
+        }
+
+        if (readOnly && entry.exists && !entry.isDirectory && entry.size >= kMapThreshold)
+        {
+            if (auto mapped = mapArchive(entry.hostPath))
+                return ps2_host_files::openMemory(mapped, mapped->data(), mapped->size());
+        }
+
+        std::string path = entry.exists ? entry.hostPath : hostPath(ps2Path);
+        if (path.empty())
+        {
+            errno = ENOENT;
+            return -1;
+        }
+
+        if (!readOnly)
+        {
+            // size and existence are about to change
+            invalidate(ps2Path);
+            std::lock_guard<std::mutex> lock(g_mappedMutex);
+            g_mappedFiles.erase(path);
+        }
+        return ps2_host_files::open(path, hostFlags);
+    }
+}
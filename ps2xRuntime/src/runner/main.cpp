@@ -1,4 +1,7 @@
 #include "ps2_runtime.h"
+#include "ps2_vfs.h"
+#include "ps2_memcard.h"
+#include "ps2_journal.h"
 #include "register_functions.h"
 #include <iostream>
 #include <string>
@@ -7,11 +10,69 @@ int main(int argc, char *argv[])
 {
     if (argc < 2)
     {
-        std::cout << "Usage: " << argv[0] << " <elf_file>" << std::endl;
+        std::cout << "Usage: " << argv[0] << " <elf_file> [--mount <device>=<host dir, iso or .ps2 card>]... [--load-state <file>] [--record <journal> | --replay <journal>] [--profile <file>]" << std::endl;
         return 1;
     }
 
     std::string elfPath = argv[1];
+    std::string statePath;
+    std::string profilePath;
+
+    for (int i = 2; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--mount" && i + 1 < argc)
+        {
+            std::string spec = argv[++i];
+            size_t eq = spec.find('=');
+            bool mounted = false;
+            if (eq != std::string::npos)
+            {
+                std::string device = spec.substr(0, eq);
+                std::filesystem::path target = spec.substr(eq + 1);
+                if (device == "mc0" || device == "mc1")
+                {
+                    // Memory cards take a host directory or a raw .ps2 image.
+                    int port = device[2] - '0';
+                    mounted = std::filesystem::is_directory(target)
+                                  ? ps2_memcard::mountDirectory(port, target) && ps2_vfs::mount(device, target)
+                                  : ps2_memcard::mountImage(port, target);
+                }
+                else
+                {
+                    mounted = ps2_vfs::mount(device, target);
+                }
+            }
+            if (!mounted)
+            {
+                std::cerr << "Invalid mount '" << spec << "', expected <device>=<path>" << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--load-state" && i + 1 < argc)
+        {
+            statePath = argv[++i];
+        }
+        else if ((arg == "--record" || arg == "--replay") && i + 1 < argc)
+        {
+            std::string journalPath = argv[++i];
+            bool started = arg == "--record" ? ps2_journal::startRecording(journalPath)
+                                             : ps2_journal::startReplay(journalPath);
+            if (!started)
+            {
+                return 1;
+            }
+        }
+        else if (arg == "--profile" && i + 1 < argc)
+        {
+            profilePath = argv[++i];
+        }
+        else
+        {
+            std::cerr << "Unknown argument: " << arg << std::endl;
+            return 1;
+        }
+    }
 
     PS2Runtime runtime;
     if (!runtime.initialize("ps2xRuntime (Raylib host)"))
@@ -28,7 +89,14 @@ int main(int argc, char *argv[])
         return 1;
     }
 
+    if (!statePath.empty() && !runtime.loadState(statePath))
+    {
+        std::cerr << "Failed to load save state: " << statePath << std::endl;
+        return 1;
+    }
+
+    runtime.profilePath = profilePath;
     runtime.run();
 
     return 0;
-}
\ No newline at end of file
+}
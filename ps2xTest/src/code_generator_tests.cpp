@@ -1,7 +1,12 @@
 #include "MiniTest.h"
+#include "ps2recomp/call_graph.h"
 #include "ps2recomp/code_generator.h"
+#include "ps2recomp/idle_loops.h"
 #include "ps2recomp/instructions.h"
+#include "ps2recomp/output_sharding.h"
+#include "ps2recomp/profile_data.h"
 #include "ps2recomp/types.h"
+#include <filesystem>
 
 using namespace ps2recomp;
 
@@ -30,6 +35,40 @@ static Instruction makeNop(uint32_t address)
     return inst;
 }
 
+static Instruction makeImmediate(uint32_t address, uint32_t opcode, uint32_t rs, uint32_t rt, int16_t imm)
+{
+    Instruction inst;
+    inst.address = address;
+    inst.opcode = opcode;
+    inst.rs = rs;
+    inst.rt = rt;
+    inst.immediate = static_cast<uint16_t>(imm);
+    inst.simmediate = static_cast<uint32_t>(static_cast<int32_t>(imm));
+    inst.raw = (opcode << 26) | (rs << 21) | (rt << 16) | inst.immediate;
+    return inst;
+}
+
+static Instruction makeRegister(uint32_t address, uint32_t opcode, uint32_t function, uint32_t rs, uint32_t rt, uint32_t rd)
+{
+    Instruction inst;
+    inst.address = address;
+    inst.opcode = opcode;
+    inst.function = function;
+    inst.rs = rs;
+    inst.rt = rt;
+    inst.rd = rd;
+    inst.raw = (opcode << 26) | (rs << 21) | (rt << 16) | (rd << 11) | function;
+    return inst;
+}
+
+static Instruction makeConditionalBranch(uint32_t address, uint32_t opcode, uint32_t rs, uint32_t rt, uint32_t target)
+{
+    Instruction inst = makeImmediate(address, opcode, rs, rt, static_cast<int16_t>((static_cast<int32_t>(target) - static_cast<int32_t>(address + 4)) / 4));
+    inst.isBranch = true;
+    inst.hasDelaySlot = true;
+    return inst;
+}
+
 void register_code_generator_tests()
 {
     MiniTest::Case("CodeGenerator", [](TestCase &tc)
@@ -107,6 +146,25 @@ void register_code_generator_tests()
         t.IsTrue(generated.find("goto label_") == std::string::npos, "external branch should not use goto");
     });
 
+    tc.Run("running off the end sets the fell-off pc", [](TestCase &t) {
+        Function func;
+        func.name = "no_return";
+        func.start = 0x3100;
+        func.end = 0x3108;
+        func.isRecompiled = true;
+        func.isStub = false;
+
+        std::vector<Instruction> instructions{
+            makeImmediate(0x3100, OPCODE_ADDIU, 0, 2, 1), // addiu $2, $zero, 1
+            makeNop(0x3104)};
+
+        CodeGenerator gen({});
+        std::string generated = gen.generateFunction(func, instructions, false);
+        size_t epilogue = generated.rfind("PS2_FELL_OFF_END();");
+        t.IsTrue(epilogue != std::string::npos && generated.find('}', epilogue) == generated.size() - 2,
+                 "the epilogue should mark the pc as run off the end");
+    });
+
     tc.Run("jumps to known symbols call by name", [](TestCase &t) {
         Function func;
         func.name = "call_symbol";
@@ -134,8 +192,8 @@ void register_code_generator_tests()
         CodeGenerator gen({targetSym});
         std::string generated = gen.generateFunction(func, instructions, false);
 
-        t.IsTrue(generated.find("target_func(rdram, ctx, runtime); return;") != std::string::npos,
-                 "jump to known function should emit direct call");
+        t.IsTrue(generated.find("PS2_TAIL_CALL(target_func);") != std::string::npos,
+                 "jump to known function should emit a tail call");
     });
 
     tc.Run("jump to unknown target sets pc", [](TestCase &t) {
@@ -171,10 +229,8 @@ void register_code_generator_tests()
             func.isRecompiled = true;
             func.isStub = false;
 
-            JumpTableEntry entry;
-            entry.index = 0;
-            entry.target = 0x8000;
-            std::vector<JumpTableEntry> entries{entry};
+            JumpTable table{};
+            table.entries.push_back({0, 0x8000});
 
             Instruction inst{};
             inst.opcode = OPCODE_REGIMM;
@@ -182,9 +238,9 @@ void register_code_generator_tests()
             CodeGenerator gen({});
             gen.setRenamedFunctions({{0x8000, "renamed_target"}});
 
-            std::string sw = gen.generateJumpTableSwitch(inst, 0x0, entries);
+            std::string sw = gen.generateJumpTableSwitch(inst, table, {});
 
-        t.IsTrue(sw.find("renamed_target(rdram, ctx, runtime);") != std::string::npos,
+        t.IsTrue(sw.find("PS2_TAIL_CALL(renamed_target);") != std::string::npos,
                  "jump table should use renamed function name");
         });
 
@@ -218,7 +274,451 @@ void register_code_generator_tests()
 
             t.IsTrue(generated.find("void ps2___is_pointer(") != std::string::npos,
                      "definition should use sanitized name");
-            t.IsTrue(generated.find("ps2___is_pointer(rdram, ctx, runtime); return;") != std::string::npos,
+            t.IsTrue(generated.find("PS2_TAIL_CALL(ps2___is_pointer);") != std::string::npos,
                      "call should use sanitized name");
+        });
+
+        tc.Run("constant base registers fold into fixed addresses", [](TestCase &t) {
+            Function func;
+            func.name = "const_fold";
+            func.start = 0xA000;
+            func.end = 0xA018;
+            func.isRecompiled = true;
+            func.isStub = false;
+
+            std::vector<Instruction> instructions{
+                makeImmediate(0xA000, OPCODE_LUI, 0, 8, 0x0012),  // lui   $8, 0x12
+                makeImmediate(0xA004, OPCODE_LW, 8, 9, 0x0345),   // lw    $9, 0x345($8)
+                makeImmediate(0xA008, OPCODE_LUI, 0, 8, 0x0020),  // lui   $8, 0x20
+                makeImmediate(0xA00C, OPCODE_ADDIU, 8, 8, -0x10), // addiu $8, $8, -0x10
+                makeImmediate(0xA010, OPCODE_SW, 8, 9, -4),       // sw    $9, -4($8)
+                makeImmediate(0xA014, OPCODE_LW, 9, 10, 0)};      // lw    $10, 0($9)
+
+            CodeGenerator gen({});
+            std::string generated = gen.generateFunction(func, instructions, false);
+
+            t.IsTrue(generated.find("READ32(0x120345)") != std::string::npos, "lui/lw pair should read a fixed address");
+            t.IsTrue(generated.find("WRITE32(0x1FFFEC, GPR_U32(ctx, 9))") != std::string::npos,
+                     "lui/addiu/sw should write a fixed address");
+            t.IsTrue(generated.find("SET_GPR_U32(ctx, 8, 0x1FFFF0);") != std::string::npos,
+                     "addiu of a known register should become a constant");
+            t.IsTrue(generated.find("// dead write to $8 removed") != std::string::npos,
+                     "overwritten address registers should be dropped");
+            t.IsTrue(generated.find("READ32(ADD32(GPR_U32(ctx, 9), 0))") != std::string::npos,
+                     "loaded values must not be treated as constants");
+        });
+
+        tc.Run("gp relative accesses use the bootstrap gp", [](TestCase &t) {
+            Function func;
+            func.name = "gp_fold";
+            func.start = 0xB000;
+            func.end = 0xB014;
+            func.isRecompiled = true;
+            func.isStub = false;
+
+            std::vector<Instruction> instructions{
+                makeImmediate(0xB000, OPCODE_LW, 28, 2, -0x7FF0), // lw $2, -0x7ff0($gp)
+                makeImmediate(0xB004, OPCODE_LUI, 0, 4, 0x0030),  // lui $4, 0x30
+                makeBranch(0xB008, 0),                            // beq $1, $1, 0xB010
+                makeNop(0xB00C),
+                makeImmediate(0xB010, OPCODE_SW, 4, 2, 0)};       // sw $2, 0($4) at a branch target
+
+            CodeGenerator gen({});
+            CodeGenerator::BootstrapInfo info;
+            info.valid = true;
+            info.gp = 0x00480000;
+            gen.setBootstrapInfo(info);
+            std::string generated = gen.generateFunction(func, instructions, false);
+
+            t.IsTrue(generated.find("READ32(0x478010)") != std::string::npos, "$gp based load should use a fixed address");
+            t.IsTrue(generated.find("WRITE32(ADD32(GPR_U32(ctx, 4), 0)") != std::string::npos,
+                     "constants must not flow across a branch target");
+            t.IsTrue(generated.find("dead write") == std::string::npos, "writes live into a branch are kept");
+        });
+
+        tc.Run("liveness drops writes overwritten on every path", [](TestCase &t) {
+            Function func;
+            func.name = "liveness";
+            func.start = 0xC000;
+            func.end = 0xC028;
+            func.isRecompiled = true;
+            func.isStub = false;
+
+            std::vector<Instruction> instructions{
+                makeRegister(0xC000, OPCODE_SPECIAL, SPECIAL_MULT, 4, 5, 0),    // mult  $4, $5
+                makeRegister(0xC004, OPCODE_SPECIAL, SPECIAL_MFLO, 0, 0, 2),    // mflo  $2
+                makeRegister(0xC008, OPCODE_SPECIAL, SPECIAL_ADDU, 4, 5, 3),    // addu  $3, $4, $5
+                makeBranch(0xC00C, 2),                                          // beq   $1, $1, 0xC018
+                makeNop(0xC010),
+                makeRegister(0xC014, OPCODE_SPECIAL, SPECIAL_ADDU, 5, 5, 3),    // addu  $3, $5, $5
+                makeRegister(0xC018, OPCODE_SPECIAL, SPECIAL_ADDU, 4, 4, 3),    // addu  $3, $4, $4
+                makeRegister(0xC01C, OPCODE_COP1, COP1_S_C_EQ, COP1_S, 2, 1),   // c.eq.s $f1, $f2
+                makeRegister(0xC020, OPCODE_COP1, COP1_S_C_LT, COP1_S, 4, 3),   // c.lt.s $f3, $f4
+                makeRegister(0xC024, OPCODE_SPECIAL, SPECIAL_MULT, 2, 6, 0)};   // mult  $2, $6
+
+            CodeGenerator gen({});
+            std::string generated = gen.generateFunction(func, instructions, false);
+
+            t.IsTrue(generated.find("ctx->lo = (uint32_t)result; }") != std::string::npos, "first mult should only store the live LO half");
+            t.IsTrue(generated.find("ctx->lo = (uint32_t)result; ctx->hi = (uint32_t)(result >> 32); }") != std::string::npos,
+                     "HI/LO are live at function exit");
+
+            size_t first = generated.find("// dead write to $3 removed");
+            t.IsTrue(first != std::string::npos && generated.find("// dead write to $3 removed", first + 1) != std::string::npos,
+                     "$3 writes overwritten on both paths should be dropped");
+            t.IsTrue(generated.find("SET_GPR_U32(ctx, 3, ADD32(GPR_U32(ctx, 4), GPR_U32(ctx, 4)))") != std::string::npos,
+                     "the write live at function exit must stay");
+            t.IsTrue(generated.find("// dead write to fcc removed") != std::string::npos, "overwritten compare should be dropped");
+            t.IsTrue(generated.find("FPU_C_LT_S") != std::string::npos, "last compare must stay");
+        });
+
+        tc.Run("loops and diamonds become structured blocks", [](TestCase &t) {
+            Function func;
+            func.name = "structured";
+            func.start = 0xD000;
+            func.end = 0xD030;
+            func.isRecompiled = true;
+            func.isStub = false;
+
+            std::vector<Instruction> instructions{
+                makeImmediate(0xD000, OPCODE_LW, 4, 3, 0),                            // loop: lw    $3, 0($4)
+                makeConditionalBranch(0xD004, OPCODE_BEQ, 3, 0, 0xD018),              //       beq   $3, $0, else
+                makeImmediate(0xD008, OPCODE_ADDIU, 4, 4, 4),                         //       addiu $4, $4, 4
+                makeRegister(0xD00C, OPCODE_SPECIAL, SPECIAL_ADDU, 2, 3, 2),          //       addu  $2, $2, $3
+                makeBranch(0xD010, 2),                                                //       b     join
+                makeNop(0xD014),
+                makeRegister(0xD018, OPCODE_SPECIAL, SPECIAL_SUBU, 2, 5, 2),          // else: subu  $2, $2, $5
+                makeConditionalBranch(0xD01C, OPCODE_REGIMM, 2, REGIMM_BLTZ, 0xD02C), // join: bltz  $2, out
+                makeNop(0xD020),
+                makeConditionalBranch(0xD024, OPCODE_BNE, 4, 6, 0xD000),              //       bne   $4, $6, loop
+                makeNop(0xD028),
+                makeRegister(0xD02C, OPCODE_SPECIAL, SPECIAL_ADDU, 2, 2, 2)};         // out:  addu  $2, $2, $2
+
+            CodeGenerator gen({});
+            std::string generated = gen.generateFunction(func, instructions, false);
+
+            t.IsTrue(generated.find("do {") != std::string::npos, "back edge should close a do/while loop");
+            t.IsTrue(generated.find("} while (GPR_U32(ctx, 4) != GPR_U32(ctx, 6));") != std::string::npos, "latch condition should drive the loop");
+            t.IsTrue(generated.find("if (!(GPR_U32(ctx, 3) == GPR_U32(ctx, 0))) {") != std::string::npos, "forward branch should open an if");
+            t.IsTrue(generated.find("} else {") != std::string::npos, "arm ending in an unconditional jump should become the else");
+            t.IsTrue(generated.find("break;") != std::string::npos, "branch to the loop follow should break");
+            t.IsTrue(generated.find("goto") == std::string::npos && generated.find("label_") == std::string::npos,
+                     "structured function needs no labels");
+
+            // Jumping into the middle of the loop makes it irreducible.
+            func.start = 0xE000;
+            func.end = 0xE014;
+            std::vector<Instruction> irreducible{
+                makeConditionalBranch(0xE000, OPCODE_BEQ, 4, 0, 0xE00C),
+                makeNop(0xE004),
+                makeRegister(0xE008, OPCODE_SPECIAL, SPECIAL_ADDU, 2, 3, 2),
+                makeRegister(0xE00C, OPCODE_SPECIAL, SPECIAL_ADDU, 2, 2, 3),
+                makeConditionalBranch(0xE010, OPCODE_BNE, 2, 3, 0xE008),
+                makeNop(0xE014)};
+            generated = gen.generateFunction(func, irreducible, false);
+
+            t.IsTrue(generated.find("goto label_e00c;") != std::string::npos && generated.find("goto label_e008;") != std::string::npos,
+                     "irreducible flow should fall back to gotos");
+            t.IsTrue(generated.find("do {") == std::string::npos, "no loop should be formed");
+        });
+
+        tc.Run("small leaf functions are inlined at jal sites", [](TestCase &t) {
+            Symbol leafSym;
+            leafSym.name = "leaf";
+            leafSym.address = 0x5000;
+            leafSym.isFunction = true;
+
+            Function leaf;
+            leaf.name = "leaf";
+            leaf.start = 0x5000;
+            leaf.end = 0x5014;
+            leaf.isRecompiled = true;
+            leaf.isStub = false;
+
+            Instruction ret = makeRegister(0x500C, OPCODE_SPECIAL, SPECIAL_JR, 31, 0, 0);
+            ret.hasDelaySlot = true;
+            leaf.instructions = {
+                makeBranch(0x5000, 2),                                         // b     0x500C
+                makeNop(0x5004),
+                makeRegister(0x5008, OPCODE_SPECIAL, SPECIAL_ADDU, 4, 5, 2),   // addu  $2, $4, $5
+                ret,                                                           // jr    $ra
+                makeRegister(0x5010, OPCODE_SPECIAL, SPECIAL_ADDU, 2, 2, 2)};  // addu  $2, $2, $2
+
+            auto makeJal = [](uint32_t address, uint32_t target) {
+                Instruction jal{};
+                jal.address = address;
+                jal.opcode = OPCODE_JAL;
+                jal.target = (target >> 2) & 0x3FFFFFF;
+                jal.hasDelaySlot = true;
+                jal.isCall = true;
+                jal.raw = 0x0C000000 | jal.target;
+                return jal;
+            };
+
+            Function func;
+            func.name = "caller";
+            func.start = 0x6000;
+            func.end = 0x6010;
+            func.isRecompiled = true;
+            func.isStub = false;
+            std::vector<Instruction> instructions{makeJal(0x6000, 0x5000), makeNop(0x6004),
+                                                  makeJal(0x6008, 0x5000), makeNop(0x600C)};
+
+            CodeGenerator gen({leafSym});
+            gen.setInlineFunctions({leaf});
+            std::string generated = gen.generateFunction(func, instructions, false);
+
+            t.IsTrue(generated.find("PS2_CALL(leaf)") == std::string::npos, "inlined calls should not call the leaf");
+            t.IsTrue(generated.find("SET_GPR_U32(ctx, 31, 0x6008);") != std::string::npos, "jal should still link");
+            t.IsTrue(generated.find("goto label_500c_i1;") != std::string::npos && generated.find("label_500c_i1:") != std::string::npos &&
+                         generated.find("goto label_500c_i2;") != std::string::npos && generated.find("label_500c_i2:") != std::string::npos,
+                     "each inlined copy should get its own labels");
+            t.IsTrue(generated.find("ctx->pc = GPR_U32(ctx, 31)") == std::string::npos, "inlined jr $ra should fall through");
+
+            leaf.instructions[2] = makeRegister(0x5008, OPCODE_SPECIAL, SPECIAL_JALR, 4, 0, 31); // jalr $4
+            gen.setInlineFunctions({leaf});
+            t.Equals(gen.inlineFunctionCount(), size_t(0), "functions that call out must not be inlined");
+        });
+
+        tc.Run("jump tables dispatch through a switch inside the function", [](TestCase &t) {
+            Function func;
+            func.name = "dispatch";
+            func.start = 0x7000;
+            func.end = 0x7020;
+            func.isRecompiled = true;
+            func.isStub = false;
+
+            Instruction jr = makeRegister(0x7000, OPCODE_SPECIAL, SPECIAL_JR, 2, 0, 0);
+            jr.hasDelaySlot = true;
+            Instruction ret = makeRegister(0x700C, OPCODE_SPECIAL, SPECIAL_JR, 31, 0, 0);
+            ret.hasDelaySlot = true;
+            Instruction ret2 = ret;
+            ret2.address = 0x7018;
+            std::vector<Instruction> instructions{
+                jr,                                                            // jr    $2
+                makeNop(0x7004),
+                makeRegister(0x7008, OPCODE_SPECIAL, SPECIAL_ADDU, 4, 5, 3),   // addu  $3, $4, $5
+                ret,
+                makeNop(0x7010),
+                makeRegister(0x7014, OPCODE_SPECIAL, SPECIAL_SUBU, 4, 5, 3),   // subu  $3, $4, $5
+                ret2,
+                makeNop(0x701C)};
+
+            JumpTable table{};
+            table.address = 0x9000;
+            table.baseRegister = 2;
+            table.jumpAddress = 0x7000;
+            table.entries = {{0, 0x7008}, {1, 0x7014}, {2, 0x7008}, {3, 0x8000}};
+
+            CodeGenerator gen({});
+            gen.setJumpTables({table});
+            std::string generated = gen.generateFunction(func, instructions, false);
+
+            t.IsTrue(generated.find("switch (GPR_U32(ctx, 2)) {") != std::string::npos, "jr through a table should switch on its register");
+            t.IsTrue(generated.find("case 0x7008: goto label_7008;") != std::string::npos && generated.find("label_7008:") != std::string::npos &&
+                         generated.find("case 0x7014: goto label_7014;") != std::string::npos && generated.find("label_7014:") != std::string::npos,
+                     "cases inside the function should goto their labels");
+            t.IsTrue(generated.find("case 0x7008:") == generated.rfind("case 0x7008:"), "repeated targets should share one case");
+            t.IsTrue(generated.find("case 0x8000: ctx->pc = 0x8000; return;") != std::string::npos, "cases outside the function should leave through pc");
+            t.IsTrue(generated.find("default: ctx->pc = GPR_U32(ctx, 2); return;") != std::string::npos, "unknown targets should still dispatch");
+        });
+
+        tc.Run("profiles mark cold code and hint one-sided branches", [](TestCase &t) {
+            Function func;
+            func.name = "profiled";
+            func.start = 0xA000;
+            func.end = 0xA010;
+            func.isRecompiled = true;
+            func.isStub = false;
+
+            std::vector<Instruction> instructions{
+                makeConditionalBranch(0xA000, OPCODE_BNE, 4, 5, 0xA00C),     // bne   $4, $5, 0xA00C
+                makeNop(0xA004),
+                makeRegister(0xA008, OPCODE_SPECIAL, SPECIAL_ADDU, 4, 5, 2), // addu  $2, $4, $5
+                makeRegister(0xA00C, OPCODE_SPECIAL, SPECIAL_ADDU, 2, 2, 2)};
+
+            ProfileData written;
+            written.addEntries(0xA000, 1000);
+            written.addBranch(0xA000, 990, 10);
+            std::string path = (std::filesystem::temp_directory_path() / "ps2recomp_test.profile").string();
+            t.IsTrue(written.save(path), "profile should save");
+
+            ProfileData profile;
+            t.IsTrue(profile.load(path), "profile should load");
+            std::filesystem::remove(path);
+            t.Equals(profile.entries(0xA000), uint64_t(1000), "entry counts should round-trip");
+            t.IsTrue(profile.branch(0xA000) && profile.branch(0xA000)->notTaken == 10, "branch counts should round-trip");
+
+            CodeGenerator gen({});
+            gen.setProfile(&profile);
+            std::string generated = gen.generateFunction(func, instructions, false);
+            t.IsTrue(generated.find("[[gnu::cold]]") == std::string::npos, "functions that ran should not be cold");
+            t.IsTrue(generated.find(")) [[unlikely]] {") != std::string::npos, "a branch almost always taken should skip its then arm");
+
+            func.start = 0xB000;
+            t.IsTrue(gen.generateFunction(func, instructions, false).find("[[gnu::cold]] void") != std::string::npos,
+                     "functions that never ran should be cold");
+
+            CodeGenerator instrumented({});
+            instrumented.setProfileInstrumentation(true);
+            generated = instrumented.generateFunction(func, instructions, false);
+            t.IsTrue(generated.find("PS2_PROFILE_ENTER(0xb000);") != std::string::npos, "instrumented functions should count entries");
+            t.IsTrue(generated.find("PS2_PROFILE_BRANCH(0xa000, ") != std::string::npos, "instrumented branches should count outcomes");
+        });
+
+        tc.Run("busy-wait loops are found and get an idle hook", [](TestCase &t) {
+            Function func;
+            func.name = "wait_flag";
+            func.start = 0xC000;
+            func.end = 0xC010;
+            func.isRecompiled = true;
+            func.isStub = false;
+
+            std::vector<Instruction> instructions{
+                makeImmediate(0xC000, OPCODE_LW, 4, 2, 0),                   // lw    $2, 0($4)
+                makeImmediate(0xC004, OPCODE_ANDI, 2, 2, 1),                 // andi  $2, $2, 1
+                makeConditionalBranch(0xC008, OPCODE_BEQ, 2, 0, 0xC000),     // beqz  $2, 0xC000
+                makeNop(0xC00C)};
+            auto noPolling = [](uint32_t) { return false; };
+
+            std::vector<uint32_t> loops = findIdleLoops(instructions, noPolling);
+            t.IsTrue(loops.size() == 1 && loops[0] == 0xC008, "a loop spinning on a load should be idle");
+
+            std::vector<Instruction> walking = instructions;
+            walking[1] = makeImmediate(0xC004, OPCODE_ADDIU, 4, 4, 4);       // addiu $4, $4, 4
+            t.IsTrue(findIdleLoops(walking, noPolling).empty(), "a loop walking memory should not be idle");
+
+            std::vector<Instruction> storing = instructions;
+            storing[1] = makeImmediate(0xC004, OPCODE_SW, 4, 0, 4);          // sw    $0, 4($4)
+            t.IsTrue(findIdleLoops(storing, noPolling).empty(), "a loop that stores should not be idle");
+
+            Instruction jal{};
+            jal.address = 0xD000;
+            jal.opcode = OPCODE_JAL;
+            jal.target = (0x9000 >> 2) & 0x3FFFFFF;
+            jal.hasDelaySlot = true;
+            jal.isCall = true;
+            jal.raw = 0x0C000000 | jal.target;
+            std::vector<Instruction> polling{
+                jal,                                                         // jal   PollSema
+                makeNop(0xD004),
+                makeConditionalBranch(0xD008, OPCODE_REGIMM, 2, REGIMM_BLTZ, 0xD000), // bltz $2, 0xD000
+                makeNop(0xD00C)};
+            loops = findIdleLoops(polling, [](uint32_t target) { return target == 0x9000; });
+            t.IsTrue(loops.size() == 1 && loops[0] == 0xD008, "a loop on a polling syscall should be idle");
+            t.IsTrue(findIdleLoops(polling, noPolling).empty(), "a loop calling anything else should not be idle");
+            t.IsTrue(isPollingCall("PollSema") && !isPollingCall("WaitSema"), "only non-blocking calls poll");
+
+            CodeGenerator gen({});
+            gen.setIdleLoops({0xC008});
+            std::string generated = gen.generateFunction(func, instructions, false);
+            t.IsTrue(generated.find("} while (PS2_IDLE_LOOP(0xc008, ") != std::string::npos,
+                     "idle loops should pass every latch outcome to the hook");
+        });
+
+        tc.Run("an idle loop entered again reports each exit to the hook", [](TestCase &t) {
+            Function func;
+            func.name = "wait_each_item";
+            func.start = 0xC000;
+            func.end = 0xC01C;
+            func.isRecompiled = true;
+            func.isStub = false;
+
+            std::vector<Instruction> instructions{
+                makeImmediate(0xC000, OPCODE_ADDIU, 5, 5, -1),               // loop: addiu $5, $5, -1
+                makeImmediate(0xC004, OPCODE_LW, 4, 2, 0),                   // wait: lw    $2, 0($4)
+                makeImmediate(0xC008, OPCODE_ANDI, 2, 2, 1),                 //       andi  $2, $2, 1
+                makeConditionalBranch(0xC00C, OPCODE_BEQ, 2, 0, 0xC004),     //       beqz  $2, wait
+                makeNop(0xC010),
+                makeConditionalBranch(0xC014, OPCODE_BNE, 5, 0, 0xC000),     //       bnez  $5, loop
+                makeNop(0xC018)};
+
+            std::vector<uint32_t> loops = findIdleLoops(instructions, [](uint32_t) { return false; });
+            t.IsTrue(loops.size() == 1 && loops[0] == 0xC00C, "only the inner wait should be idle");
+
+            CodeGenerator gen({});
+            gen.setIdleLoops({0xC00C});
+            std::string generated = gen.generateFunction(func, instructions, false);
+            size_t hook = generated.find("PS2_IDLE_LOOP(0xc00c, ");
+            t.IsTrue(hook != std::string::npos && generated.find("PS2_IDLE_LOOP", hook + 1) == std::string::npos,
+                     "the hook should only be called from the latch condition");
+            t.IsTrue(generated.find("} while (PS2_IDLE_LOOP(0xc00c, ") != std::string::npos,
+                     "leaving the wait should reach the hook so the next entry starts over");
+
+            std::vector<Instruction> forever = instructions;
+            forever[3] = makeConditionalBranch(0xC00C, OPCODE_BEQ, 0, 0, 0xC004); // b wait
+            t.IsTrue(findIdleLoops(forever, [](uint32_t) { return false; }).empty(),
+                     "a loop whose latch never exits cannot report leaving it");
+        });
+
+        tc.Run("word multiplies use words 0 and 2 and both HI/LO pairs", [](TestCase &t) {
+            CodeGenerator gen({});
+
+            Instruction pmultuw = makeRegister(0xC000, OPCODE_MMI, MMI_MMI3, 4, 5, 6); // pmultuw $6, $4, $5
+            pmultuw.sa = MMI3_PMULTUW;
+            pmultuw.isMMI = true;
+            std::string generated = gen.translateInstruction(pmultuw);
+
+            t.IsTrue(generated.find("_mm_mul_epu32(GPR_VEC(ctx, 4), GPR_VEC(ctx, 5))") != std::string::npos,
+                     "pmultuw should multiply the even words unsigned");
+            t.IsTrue(generated.find("_mm_mullo_epi32") == std::string::npos, "pmultuw keeps full 64-bit products");
+            t.IsTrue(generated.find("ctx->lo1 = ") != std::string::npos && generated.find("ctx->hi1 = ") != std::string::npos,
+                     "pmultuw should set LO1/HI1 from the upper doubleword");
+            t.IsTrue(generated.find("SET_GPR_VEC(ctx, 6, prod)") != std::string::npos, "pmultuw should write both products to rd");
+
+            Instruction pmaddw = makeRegister(0xC004, OPCODE_MMI, MMI_MMI2, 4, 5, 6); // pmaddw $6, $4, $5
+            pmaddw.sa = MMI2_PMADDW;
+            pmaddw.isMMI = true;
+            generated = gen.translateInstruction(pmaddw);
+
+            t.IsTrue(generated.find("_mm_mul_epi32(GPR_VEC(ctx, 4), GPR_VEC(ctx, 5))") != std::string::npos,
+                     "pmaddw should multiply the even words signed");
+            t.IsTrue(generated.find("ctx->hi1, (int32_t)ctx->lo1, (int32_t)ctx->hi, (int32_t)ctx->lo") != std::string::npos,
+                     "pmaddw should accumulate into both HI/LO pairs");
+            t.IsTrue(generated.find("ctx->lo1 = ") != std::string::npos && generated.find("ctx->hi1 = ") != std::string::npos,
+                     "pmaddw should set LO1/HI1 from the upper doubleword");
+            t.IsTrue(generated.find("SET_GPR_VEC(ctx, 6, sum)") != std::string::npos, "pmaddw should write both sums to rd");
+        });
+
+        tc.Run("output shards keep callees next to their callers", [](TestCase &t) {
+            std::vector<Function> functions(4);
+            functions[0].start = 0x1000;
+            functions[0].callees = {0x3000};
+            functions[1].start = 0x2000;
+            functions[2].start = 0x3000;
+            functions[2].callers = {0x1000};
+            functions[3].start = 0x4000; // not emitted
+
+            auto shards = shardFunctions(functions, {10, 20, 10, 0}, 2);
+            t.Equals(shards.size(), size_t(2), "two shards expected");
+            t.IsTrue(shards[0] == std::vector<size_t>{0, 2}, "callee should follow its caller in the first shard");
+            t.IsTrue(shards[1] == std::vector<size_t>{1}, "unrelated function should fill the second shard");
+
+            shards = shardFunctions(functions, {10, 20, 10, 0}, 8);
+            t.Equals(shards.size(), size_t(3), "no more shards than functions");
+        });
+
+        tc.Run("call graph components and hotness follow the calls", [](TestCase &t) {
+            // 0 calls 1 from a loop; 1 and 2 call each other; 3 calls itself.
+            CallGraph graph(4, {{0, 1, 8.0}, {1, 2, 1.0}, {2, 1, 1.0}, {3, 3, 1.0}});
+
+            t.Equals(graph.componentCount(), size_t(3), "1 and 2 should share a component");
+            t.Equals(graph.component(1), graph.component(2), "mutual recursion is one component");
+            t.IsTrue(graph.component(1) < graph.component(0), "callees are numbered before callers");
+            t.IsFalse(graph.isRecursive(0), "0 is not recursive");
+            t.IsTrue(graph.isRecursive(1) && graph.isRecursive(2), "1 and 2 are mutually recursive");
+            t.IsTrue(graph.isRecursive(3), "3 calls itself");
+
+            std::vector<double> hotness = graph.estimateHotness({1.0, 1.0, 1.0, 1.0});
+            t.Equals(hotness[0], 1.0, "an uncalled function runs once");
+            t.Equals(hotness[1], (1.0 + 8.0) * 3.0, "loop call and recursion scale the callee");
+            t.Equals(hotness[3], 2.0, "a self call counts one extra level");
+
+            std::vector<Instruction> loop(4);
+            for (uint32_t i = 0; i < 4; ++i)
+                loop[i].address = 0x1000 + i * 4;
+            loop[2] = makeBranch(0x1008, static_cast<uint32_t>(-2)); // back to 0x1004
+            std::vector<uint32_t> depths = loopDepths(loop, 0x1000, 0x1010);
+            t.IsTrue(depths == std::vector<uint32_t>{0, 1, 1, 1}, "loop body and delay slot are one level deep");
         }); });
 }
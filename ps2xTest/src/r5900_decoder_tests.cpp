@@ -1,8 +1,61 @@
 #include "MiniTest.h"
 #include "ps2recomp/r5900_decoder.h"
+#include "ps2recomp/decoded_image.h"
+#include <cstdio>
+#include <string>
+#include <vector>
 
 using namespace ps2recomp;
 
+// Every decoded field and flag of a against b; the first difference names the field.
+static std::string decodeDifference(const Instruction &a, const Instruction &b)
+{
+#define PS2_COMPARE(field) \
+    if (a.field != b.field) \
+        return #field;
+    PS2_COMPARE(address)
+    PS2_COMPARE(opcode)
+    PS2_COMPARE(rs)
+    PS2_COMPARE(rt)
+    PS2_COMPARE(rd)
+    PS2_COMPARE(sa)
+    PS2_COMPARE(function)
+    PS2_COMPARE(immediate)
+    PS2_COMPARE(simmediate)
+    PS2_COMPARE(target)
+    PS2_COMPARE(raw)
+    PS2_COMPARE(isMMI)
+    PS2_COMPARE(isVU)
+    PS2_COMPARE(isBranch)
+    PS2_COMPARE(isJump)
+    PS2_COMPARE(isCall)
+    PS2_COMPARE(isReturn)
+    PS2_COMPARE(hasDelaySlot)
+    PS2_COMPARE(isMultimedia)
+    PS2_COMPARE(isStore)
+    PS2_COMPARE(isLoad)
+    PS2_COMPARE(mmiType)
+    PS2_COMPARE(mmiFunction)
+    PS2_COMPARE(pmfhlVariation)
+    PS2_COMPARE(vuFunction)
+    PS2_COMPARE(vectorInfo.isVector)
+    PS2_COMPARE(vectorInfo.usesQReg)
+    PS2_COMPARE(vectorInfo.usesPReg)
+    PS2_COMPARE(vectorInfo.modifiesMAC)
+    PS2_COMPARE(vectorInfo.vectorField)
+    PS2_COMPARE(vectorInfo.fsf)
+    PS2_COMPARE(vectorInfo.ftf)
+    PS2_COMPARE(modificationInfo.modifiesGPR)
+    PS2_COMPARE(modificationInfo.modifiesFPR)
+    PS2_COMPARE(modificationInfo.modifiesVFR)
+    PS2_COMPARE(modificationInfo.modifiesVIR)
+    PS2_COMPARE(modificationInfo.modifiesVIC)
+    PS2_COMPARE(modificationInfo.modifiesMemory)
+    PS2_COMPARE(modificationInfo.modifiesControl)
+#undef PS2_COMPARE
+    return {};
+}
+
 void register_r5900_decoder_tests()
 {
     MiniTest::Case("R5900Decoder", [](TestCase &tc)
@@ -189,5 +242,149 @@ void register_r5900_decoder_tests()
         t.IsTrue(inst.isReturn, "eret should be marked as return");
         t.IsFalse(inst.hasDelaySlot, "eret should not have a delay slot");
         t.IsTrue(inst.modificationInfo.modifiesControl, "eret changes control state");
+    });
+
+    tc.Run("table decoded MMI and FPU encodings keep their flags", [](TestCase &t) {
+        R5900Decoder decoder;
+
+        uint32_t pand = (OPCODE_MMI << 26) | (1 << 21) | (2 << 16) | (3 << 11) | (MMI2_PAND << 6) | MMI_MMI2;
+        Instruction mmi = decoder.decodeInstruction(0xB000, pand);
+        t.IsTrue(mmi.isMMI, "pand should set isMMI");
+        t.IsTrue(mmi.isMultimedia, "pand should set multimedia flag");
+        t.IsTrue(mmi.modificationInfo.modifiesGPR, "pand writes rd");
+        t.IsFalse(mmi.isBranch || mmi.isLoad || mmi.isStore, "pand is plain ALU");
+
+        uint32_t addS = (OPCODE_COP1 << 26) | (COP1_S << 21) | (2 << 16) | (1 << 11) | (0 << 6) | COP1_S_ADD;
+        Instruction fpu = decoder.decodeInstruction(0xB004, addS);
+        t.IsTrue(fpu.modificationInfo.modifiesFPR, "add.s writes fd");
+        t.IsFalse(fpu.modificationInfo.modifiesGPR, "add.s leaves GPRs alone");
+
+        uint32_t bc1t = (OPCODE_COP1 << 26) | (COP1_BC << 21) | (COP1_BC_BCT << 16) | 0x0004;
+        Instruction branch = decoder.decodeInstruction(0xB008, bc1t);
+        t.IsTrue(branch.isBranch, "bc1t should be a branch");
+        t.IsTrue(branch.hasDelaySlot, "bc1t has a delay slot");
+        t.IsFalse(branch.isCall, "bc1t does not link");
+
+        uint32_t lq = (OPCODE_LQ << 26) | (29 << 21) | (4 << 16) | 0x0010;
+        Instruction load = decoder.decodeInstruction(0xB00C, lq);
+        t.IsTrue(load.isLoad && load.isMultimedia, "lq is a 128-bit load");
+    });
+
+    tc.Run("table decode matches the rabbitizer decode", [](TestCase &t) {
+        R5900Decoder decoder;
+        std::vector<uint32_t> words;
+
+        // Register fields that hit $zero, $ra and ordinary registers in every position.
+        const uint32_t regs[][3] = {{0, 0, 0}, {31, 31, 31}, {4, 5, 6}, {29, 0, 2}, {0, 7, 0}, {8, 0, 31}};
+        auto fields = [&](uint32_t base, bool withShift)
+        {
+            for (const auto &r : regs)
+            {
+                uint32_t word = base | (r[0] << 21) | (r[1] << 16) | (r[2] << 11);
+                words.push_back(word);
+                if (withShift)
+                    words.push_back(word | (17 << 6));
+            }
+        };
+
+        for (uint32_t op = 0; op < 64; ++op)
+        {
+            fields((op << 26) | 0x8004, false); // negative immediate / low target bits
+            fields((op << 26) | 0x0010, false);
+        }
+        for (uint32_t fn = 0; fn < 64; ++fn)
+            fields((OPCODE_SPECIAL << 26) | fn, true);
+        for (uint32_t rt = 0; rt < 32; ++rt)
+        {
+            words.push_back((OPCODE_REGIMM << 26) | (4 << 21) | (rt << 16) | 0xFFF0);
+            words.push_back((OPCODE_REGIMM << 26) | (rt << 16) | 0x0004);
+        }
+        for (uint32_t fn = 0; fn < 64; ++fn)
+            fields((OPCODE_MMI << 26) | fn, true);
+        for (uint32_t group : {MMI_MMI0, MMI_MMI1, MMI_MMI2, MMI_MMI3, MMI_PMFHL, MMI_PMTHL})
+        {
+            for (uint32_t sa = 0; sa < 32; ++sa)
+                fields((OPCODE_MMI << 26) | (sa << 6) | group, false);
+        }
+        for (uint32_t rs = 0; rs < 32; ++rs)
+        {
+            for (uint32_t fn = 0; fn < 64; ++fn)
+            {
+                words.push_back((OPCODE_COP1 << 26) | (rs << 21) | (2 << 16) | (1 << 11) | (3 << 6) | fn);
+                words.push_back((OPCODE_COP2 << 26) | (rs << 21) | (2 << 16) | (1 << 11) | (3 << 6) | fn);
+            }
+            for (uint32_t rt = 0; rt < 4; ++rt)
+                words.push_back((OPCODE_COP1 << 26) | (rs << 21) | (rt << 16) | 0xFFFC);
+        }
+
+        // Words rabbitizer reports as pseudo-ops.
+        const uint32_t pseudos[] = {
+            0x00000000,                                                  // nop
+            (OPCODE_SPECIAL << 26) | (5 << 21) | (4 << 11) | SPECIAL_ADDU, // move $4, $5
+            (OPCODE_SPECIAL << 26) | (5 << 21) | (4 << 11) | SPECIAL_OR,   // move $4, $5
+            (OPCODE_SPECIAL << 26) | (5 << 16) | (4 << 11) | SPECIAL_SUBU, // negu $4, $5
+            (OPCODE_SPECIAL << 26) | (5 << 21) | (4 << 11) | SPECIAL_NOR,  // not $4, $5
+            (OPCODE_BEQ << 26) | 0x0004,                                 // b
+            (OPCODE_BEQ << 26) | (4 << 21) | 0x0004,                     // beqz $4
+            (OPCODE_BNE << 26) | (4 << 21) | 0x0004,                     // bnez $4
+            (OPCODE_BEQL << 26) | (4 << 21) | 0x0004,                    // beqzl $4
+            (OPCODE_REGIMM << 26) | (REGIMM_BGEZAL << 16) | 0x0004,      // bal
+            (OPCODE_ADDIU << 26) | (4 << 16) | 0x1234,                   // li $4, 0x1234
+            (OPCODE_ORI << 26) | (4 << 16) | 0x1234,                     // li $4, 0x1234
+            (OPCODE_SPECIAL << 26) | (31 << 21) | SPECIAL_JR,            // jr $ra
+            (OPCODE_SPECIAL << 26) | (25 << 21) | (31 << 11) | SPECIAL_JALR, // jalr $t9
+            (OPCODE_MMI << 26) | (5 << 16) | (4 << 11) | (MMI3_POR << 6) | MMI_MMI3, // pmove $4, $5
+            (OPCODE_COP1 << 26) | (COP1_BC << 21) | (COP1_BC_BCF << 16) | 0x0004, // bc1f
+        };
+        words.insert(words.end(), std::begin(pseudos), std::end(pseudos));
+
+        size_t mismatches = 0;
+        std::string first;
+        for (size_t i = 0; i < words.size(); ++i)
+        {
+            uint32_t address = 0x00100000 + static_cast<uint32_t>(i * 4);
+            std::string field = decodeDifference(decoder.decodeInstruction(address, words[i]),
+                                                 decoder.decodeInstructionSlow(address, words[i]));
+            if (field.empty())
+                continue;
+            if (mismatches++ == 0)
+            {
+                char word[16];
+                std::snprintf(word, sizeof(word), "0x%08X", words[i]);
+                first = std::string(word) + " differs in " + field;
+            }
+        }
+
+        t.Equals(mismatches, size_t(0), "table decode should match rabbitizer, first: " + first);
+    });
+
+    tc.Run("packed instructions unpack to the decoded fields", [](TestCase &t) {
+        R5900Decoder decoder;
+
+        uint32_t words[] = {
+            (OPCODE_MMI << 26) | (1 << 21) | (2 << 16) | (3 << 11) | (MMI2_PAND << 6) | MMI_MMI2,
+            (OPCODE_BNE << 26) | (4 << 21) | (5 << 16) | 0xFFFC,
+            (OPCODE_LQ << 26) | (29 << 21) | (4 << 16) | 0x0010,
+            (OPCODE_COP1 << 26) | (COP1_S << 21) | (2 << 16) | (1 << 11) | COP1_S_ADD,
+        };
+
+        for (uint32_t i = 0; i < 4; ++i)
+        {
+            uint32_t address = 0xC000 + i * 4;
+            Instruction inst = decoder.decodeInstruction(address, words[i]);
+            Instruction round = PackedInstruction::pack(inst).unpack(address);
+
+            t.Equals(round.address, inst.address, "address comes from the position");
+            t.Equals(round.raw, inst.raw, "raw word is kept");
+            t.Equals(round.simmediate, inst.simmediate, "immediate is rederived");
+            t.Equals(round.target, inst.target, "jump target is rederived");
+            t.Equals(round.isBranch, inst.isBranch, "branch flag is kept");
+            t.Equals(round.hasDelaySlot, inst.hasDelaySlot, "delay slot flag is kept");
+            t.Equals(round.isMultimedia, inst.isMultimedia, "multimedia flag is kept");
+            t.Equals(round.isLoad, inst.isLoad, "load flag is kept");
+            t.Equals(round.modificationInfo.modifiesGPR, inst.modificationInfo.modifiesGPR, "GPR write flag is kept");
+            t.Equals(round.modificationInfo.modifiesFPR, inst.modificationInfo.modifiesFPR, "FPR write flag is kept");
+            t.Equals(round.vectorInfo.vectorField, inst.vectorInfo.vectorField, "vector field is kept");
+        }
     }); });
 }